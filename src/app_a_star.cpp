@@ -12,10 +12,13 @@
 
 #include <algorithm> // std::find_if
 #include <climits>
+#include <cmath>
 #include <cstdio> // snprintf
 #include <set>
 #include <vector>
 
+#include "path_finding.h"
+#include "path_hierarchy.h"
 #include "random.h"
 
 namespace
@@ -128,6 +131,9 @@ Graph randomGraph(int width, int height)
 
 void drawVisitedGraph(const Graph& graph, const VisitedGraph& visited, const NodeSet& nodesToVisit)
 {
+  if(!SandboxEnabled)
+    return;
+
   auto& nodes = graph.nodes;
   for(int i = 0; i < (int)nodes.size(); ++i)
   {
@@ -169,6 +175,12 @@ struct AStarAlgorithm
     return randomGraph(width, height);
   }
 
+  static Graph generateInput(int size)
+  {
+    const int side = std::max(2, int(std::sqrt(size)));
+    return randomGraph(side, side);
+  }
+
   static Output execute(Graph input)
   {
     auto& nodes = input.nodes;
@@ -205,9 +217,12 @@ struct AStarAlgorithm
           sandbox_circle(node.renderPos, 1.2, Red);
           sandbox_circle(neighborRenderPos, 1.2, Green);
           sandbox_line(node.renderPos, neighborRenderPos, Green);
-          char buffer[256];
-          sprintf(buffer, "%d+%d=%d", neighborDistanceFromEnd, neighborCost, neighborDistanceFromEnd + neighborCost);
-          sandbox_text(neighborRenderPos, buffer, Green);
+          if(SandboxEnabled)
+          {
+            char buffer[256];
+            sprintf(buffer, "%d+%d=%d", neighborDistanceFromEnd, neighborCost, neighborDistanceFromEnd + neighborCost);
+            sandbox_text(neighborRenderPos, buffer, Green);
+          }
           sandbox_breakpoint();
 
           visited.visitNode(neighbor, nodeIndex, nodeCost + 1);
@@ -263,6 +278,160 @@ struct AStarAlgorithm
   }
 };
 
-IApp* create() { return createAlgorithmApp(std::make_unique<ConcreteAlgorithm<AStarAlgorithm>>()); }
-const int reg = registerApp("PathFind.AStar", &create);
+// The library version: binary heap, f-scores computed once, scratch memory reusable between queries
+struct FastAStarAlgorithm : AStarAlgorithm
+{
+  static Output execute(Graph input)
+  {
+    PathGraph graph;
+    for(auto& node : input.nodes)
+    {
+      const int index = graph.addNode(node.pos);
+      for(int neighbor : node.neighbours)
+        graph.addEdge(index, neighbor, 1);
+    }
+
+    PathScratch scratch;
+    Output result;
+    findPath(graph, input.startNode, input.endNode, PathHeuristic::Manhattan, scratch, result);
+    return result;
+  }
+};
+
+// Uniform grid, with Jump Point Search
+struct JumpPointSearchAlgorithm
+{
+  struct Input
+  {
+    BitGrid walls;
+    GridCell start, goal;
+  };
+
+  static constexpr float cellSize = 1.0f;
+
+  static Vec2 cellCenter(const BitGrid& grid, GridCell cell)
+  {
+    return Vec2(cell.x + 0.5f - grid.width / 2.f, cell.y + 0.5f - grid.height / 2.f) * cellSize;
+  }
+
+  static GridCell randomFreeCell(const BitGrid& walls)
+  {
+    while(true)
+    {
+      const GridCell cell = {randomInt(0, walls.width), randomInt(0, walls.height)};
+      if(!walls.get(cell.x, cell.y))
+        return cell;
+    }
+  }
+
+  static Input generateInput()
+  {
+    Input input;
+    input.walls.resize(40, 30);
+
+    // a few random walls
+    for(int i = 0; i < 30; ++i)
+    {
+      int x = randomInt(0, 40);
+      int y = randomInt(0, 30);
+      const bool horizontal = randomInt(0, 2);
+      for(int k = randomInt(3, 12); k > 0 && input.walls.contains(x, y); --k)
+      {
+        input.walls.set(x, y);
+        (horizontal ? x : y)++;
+      }
+    }
+
+    input.start = randomFreeCell(input.walls);
+    input.goal = randomFreeCell(input.walls);
+    return input;
+  }
+
+  static std::vector<GridCell> execute(Input input)
+  {
+    PathScratch scratch;
+    std::vector<GridCell> path;
+    findGridPath(input.walls, input.start, input.goal, scratch, path);
+    return path;
+  }
+
+  static void display(const Input& input, const std::vector<GridCell>& output)
+  {
+    const auto& walls = input.walls;
+    for(int y = 0; y < walls.height; ++y)
+    {
+      for(int x = 0; x < walls.width; ++x)
+      {
+        if(walls.get(x, y))
+          sandbox_rect(cellCenter(walls, {x, y}) - Vec2(0.5, 0.5) * cellSize, Vec2(1, 1) * cellSize, Gray);
+      }
+    }
+
+    sandbox_circle(cellCenter(walls, input.start), 0.4, Yellow);
+    sandbox_circle(cellCenter(walls, input.goal), 0.4, LightBlue);
+
+    for(int i = 1; i < (int)output.size(); ++i)
+      sandbox_line(cellCenter(walls, output[i - 1]), cellCenter(walls, output[i]), Green);
+  }
+};
+
+// Hierarchical: the path goes through the entrances between clusters
+struct HierarchicalAlgorithm : JumpPointSearchAlgorithm
+{
+  static constexpr int clusterSize = 8;
+
+  struct Output
+  {
+    std::vector<GridCell> path;
+    std::vector<GridCell> entrances;
+  };
+
+  static Output execute(Input input)
+  {
+    PathHierarchy hierarchy;
+    hierarchy.build(input.walls, clusterSize);
+
+    Output output;
+    for(auto& cluster : hierarchy.clusters)
+    {
+      for(auto& node : cluster.nodes)
+        output.entrances.push_back(node.cell);
+    }
+
+    HierarchyScratch scratch;
+    findHierarchicalPath(hierarchy, input.walls, input.start, input.goal, scratch, output.path);
+    return output;
+  }
+
+  static void display(const Input& input, const Output& output)
+  {
+    const auto& walls = input.walls;
+    for(int x = 0; x <= walls.width; x += clusterSize)
+    {
+      const float px = (x - walls.width / 2.f) * cellSize;
+      sandbox_line(Vec2(px, -walls.height / 2.f * cellSize), Vec2(px, walls.height / 2.f * cellSize), Red);
+    }
+    for(int y = 0; y <= walls.height; y += clusterSize)
+    {
+      const float py = (y - walls.height / 2.f) * cellSize;
+      sandbox_line(Vec2(-walls.width / 2.f * cellSize, py), Vec2(walls.width / 2.f * cellSize, py), Red);
+    }
+
+    for(auto& cell : output.entrances)
+      sandbox_circle(cellCenter(walls, cell), 0.2, White);
+
+    JumpPointSearchAlgorithm::display(input, output.path);
+  }
+};
+
+template<typename Algorithm>
+IApp* create()
+{
+  return createAlgorithmApp(std::make_unique<ConcreteAlgorithm<Algorithm>>());
+}
+
+const int reg = registerApp("PathFind.AStar", &create<AStarAlgorithm>);
+const int regFast = registerApp("PathFind.AStar.Fast", &create<FastAStarAlgorithm>);
+const int regJps = registerApp("PathFind.JPS", &create<JumpPointSearchAlgorithm>);
+const int regHierarchical = registerApp("PathFind.HPA", &create<HierarchicalAlgorithm>);
 }
@@ -14,6 +14,7 @@
 #include <vector>
 
 #include "random.h"
+#include "rasterize_lines.h"
 
 namespace
 {
@@ -205,6 +206,34 @@ struct BresenhamAlgorithm
   }
 };
 
-IApp* create() { return createAlgorithmApp(std::make_unique<ConcreteAlgorithm<BresenhamAlgorithm>>()); }
-const int reg = registerApp("Bresenham's LineDrawing", &create);
+// The library version, into a bit grid: every cell the segment goes through
+struct SupercoverAlgorithm : BresenhamAlgorithm
+{
+  static Output execute(Segment input)
+  {
+    BitGrid grid(gridWidth, gridHeight);
+    const GridSegment segment = {input.start, input.end};
+    rasterizeLinesSupercover({1, &segment}, grid);
+
+    Output output;
+    for(int y = 0; y < gridHeight; y++)
+    {
+      for(int x = 0; x < gridWidth; x++)
+      {
+        if(grid.get(x, y))
+          output.push_back({x, y});
+      }
+    }
+    return output;
+  }
+};
+
+template<typename Algorithm>
+IApp* create()
+{
+  return createAlgorithmApp(std::make_unique<ConcreteAlgorithm<Algorithm>>());
+}
+
+const int reg = registerApp("Bresenham's LineDrawing", &create<BresenhamAlgorithm>);
+const int regSupercover = registerApp("Bresenham's LineDrawing.Supercover", &create<SupercoverAlgorithm>);
 } // namespace
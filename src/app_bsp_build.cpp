@@ -11,12 +11,15 @@
 #include "core/geom.h"
 #include "core/sandbox.h"
 
+#include <algorithm>
 #include <cassert>
 #include <cmath>
+#include <cstdio>
 #include <vector>
 
 #include "bounding_box.h"
 #include "bsp.h"
+#include "datasets.h"
 #include "random.h"
 #include "random_polygon.h"
 #include "split_polygon.h"
@@ -66,16 +69,65 @@ float sign(float a)
     return -1;
 }
 
+// Scattered square obstacles, 4 faces each
+Polygon2f createRandomMap(int faceCount)
+{
+  const int squareCount = std::max(1, faceCount / 4);
+  const int gridSize = std::ceil(std::sqrt(squareCount));
+  const float cellSize = 4;
+
+  Polygon2f r;
+
+  for(int i = 0; i < squareCount; ++i)
+  {
+    const Vec2 cell = Vec2(i % gridSize, i / gridSize) * cellSize - Vec2(gridSize, gridSize) * (cellSize * 0.5f);
+    const Vec2 size = randomPos({1, 1}, {3, 3});
+    const Vec2 min = cell + randomPos({0, 0}, Vec2(cellSize, cellSize) - size);
+
+    // counter-clockwise: the normals point outside
+    const int first = r.vertices.size();
+    r.vertices.push_back(min);
+    r.vertices.push_back(min + Vec2(size.x, 0));
+    r.vertices.push_back(min + size);
+    r.vertices.push_back(min + Vec2(0, size.y));
+
+    for(int k = 0; k < 4; ++k)
+      r.faces.push_back({first + k, first + (k + 1) % 4});
+  }
+
+  return r;
+}
+
+BspBuildOptions exhaustiveOptions() { return {}; }
+
+BspBuildOptions sampledOptions()
+{
+  BspBuildOptions options;
+  options.candidates = BspCandidates::Sampled;
+  options.candidateCount = 16;
+  options.splitPenalty = 1;
+  return options;
+}
+
+template<BspBuildOptions (*Options)()>
 struct BspBuild
 {
   static Polygon2f generateInput() { return createRandomPolygon2f(); }
+  static Polygon2f generateInput(int size) { return createRandomMap(size); }
+  static Polygon2f loadDataset(const std::string& path) { return loadPolygon(path); }
 
   struct BspHolder
   {
     std::unique_ptr<BspNode> root;
+    BspBuildReport report;
   };
 
-  static BspHolder execute(Polygon2f input) { return {createBspTree(input)}; }
+  static BspHolder execute(Polygon2f input)
+  {
+    BspHolder r;
+    r.root = createBspTree(input, Options(), &r.report);
+    return r;
+  }
 
   static void display(const Polygon2f& input, const BspHolder& output)
   {
@@ -86,6 +138,14 @@ struct BspBuild
       std::vector<Hyperplane> clips;
       drawBspNode(output.root.get(), clips);
     }
+
+    if(SandboxEnabled)
+    {
+      char buffer[256];
+      snprintf(buffer, sizeof buffer, "depth: %d, nodes: %d, split faces: %d, build: %.2fms", output.report.depth,
+            output.report.nodeCount, output.report.splitCount, output.report.buildTime * 1000.0);
+      sandbox_text({-15, 12}, buffer, White);
+    }
   }
 
   static void drawBspNode(const BspNode* node, std::vector<Hyperplane>& clips)
@@ -150,6 +210,12 @@ struct BspBuild
   }
 };
 
-IApp* create() { return createAlgorithmApp(std::make_unique<ConcreteAlgorithm<BspBuild>>()); }
-const int registered = registerApp("Bsp.Build", &create);
+template<BspBuildOptions (*Options)()>
+IApp* create()
+{
+  return createAlgorithmApp(std::make_unique<ConcreteAlgorithm<BspBuild<Options>>>());
+}
+
+const int registered = registerApp("Bsp.Build", &create<exhaustiveOptions>);
+const int registeredSampled = registerApp("Bsp.Build.Sampled", &create<sampledOptions>);
 }
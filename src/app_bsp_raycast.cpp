@@ -54,18 +54,21 @@ float raycast(Vec2 a, Vec2 b, const BspNode* root)
 
   while(stack.size())
   {
-    for(auto& entry : stack)
+    if(SandboxEnabled)
     {
-      auto color = &entry == &stack.back() ? Green : LightBlue;
-
-      const auto beg = lerp(a, b, entry.beg);
-      const auto end = lerp(a, b, entry.end);
-      sandbox_line(beg, end, color);
-      char buf[256];
-      sprintf(buf, "%d", int(stack.size()) - int(&entry - &stack.front()));
-      sandbox_text((beg + end) * 0.5, buf);
-      sandbox_circle(beg, 0.2, color);
-      sandbox_circle(end, 0.2, color);
+      for(auto& entry : stack)
+      {
+        auto color = &entry == &stack.back() ? Green : LightBlue;
+
+        const auto beg = lerp(a, b, entry.beg);
+        const auto end = lerp(a, b, entry.end);
+        sandbox_line(beg, end, color);
+        char buf[256];
+        sprintf(buf, "%d", int(stack.size()) - int(&entry - &stack.front()));
+        sandbox_text((beg + end) * 0.5, buf);
+        sandbox_circle(beg, 0.2, color);
+        sandbox_circle(end, 0.2, color);
+      }
     }
 
     auto curr = stack.back();
@@ -149,6 +152,7 @@ struct BspRaycast
   {
     Polygon2f polygon;
     std::unique_ptr<BspNode> bspRoot;
+    CompiledBsp compiledBsp;
     Vec2 rayPos;
     Vec2 rayDir;
   };
@@ -182,6 +186,7 @@ struct BspRaycast
     AlgoInput input;
     input.polygon = poly;
     input.bspRoot = createBspTree(poly);
+    input.compiledBsp = compileBsp(input.bspRoot.get());
     input.rayPos = randomPos({-20, -2}, {-15, +2});
     input.rayDir = randomPos({+10, -10}, {+10, +10}) - input.rayPos;
     return input;
@@ -202,6 +207,11 @@ struct BspRaycast
 
     sandbox_line(input.rayPos, input.rayPos + input.rayDir * fraction, Green);
     sandbox_circle(input.rayPos, 0.2, Green);
+
+    // the compiled form also gives the normal of the hit
+    const auto hit = ::raycast(input.compiledBsp, input.rayPos, input.rayPos + input.rayDir);
+    const auto hitPos = input.rayPos + input.rayDir * hit.fraction;
+    sandbox_line(hitPos, hitPos + hit.normal * 2, LightBlue);
   }
 };
 
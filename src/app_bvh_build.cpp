@@ -11,6 +11,8 @@
 #include "core/geom.h"
 #include "core/sandbox.h"
 
+#include <cmath>
+#include <cstdio>
 #include <memory>
 #include <vector>
 
@@ -63,19 +65,25 @@ void drawNode(int curr, span<const BvhNode> allNodes, int depth = 0)
     drawNode(node->children[1], allNodes, depth + 1);
 }
 
+template<BvhSplitter Splitter>
 struct BoundingVolumeHierarchy
 {
-  static Input generateInput()
+  static Input generateInput() { return generateInput(20); }
+
+  static Input generateInput(int size)
   {
+    // keep the triangle density of the default input
+    const float scale = std::sqrt(size / 20.0f);
+
     Input r;
 
-    for(int k = 0; k < 20; ++k)
+    for(int k = 0; k < size; ++k)
     {
       Triangle t;
 
       do
       {
-        t.a = randomPos(Vec2(-20, -10), Vec2(20, 10));
+        t.a = randomPos(Vec2(-20, -10) * scale, Vec2(20, 10) * scale);
         t.b = t.a + randomPos(Vec2(0, 0), Vec2(3, 3));
         t.c = t.a + randomPos(Vec2(0, 0), Vec2(3, 3));
       } while(det2d(t.b - t.a, t.c - t.a) < 0.5);
@@ -98,7 +106,10 @@ struct BoundingVolumeHierarchy
       box.add(obj.c);
       boxes.push_back(box);
     }
-    return {computeBoundingVolumeHierarchy(boxes)};
+
+    BvhBuildOptions options;
+    options.splitter = Splitter;
+    return {computeBoundingVolumeHierarchy(boxes, options)};
   }
 
   static void display(const Input& input, Output output)
@@ -111,10 +122,26 @@ struct BoundingVolumeHierarchy
     }
 
     if(output.nodes.size())
+    {
       drawNode(0, output.nodes);
+
+      if(SandboxEnabled)
+      {
+        char buffer[64];
+        snprintf(buffer, sizeof buffer, "expected query cost: %.2f", computeBvhCost(output.nodes));
+        sandbox_text(output.nodes[0].boundaries.max + Vec2(1, 1), buffer, White);
+      }
+    }
   }
 };
 
-IApp* create() { return createAlgorithmApp(std::make_unique<ConcreteAlgorithm<BoundingVolumeHierarchy>>()); }
-const int registered = registerApp("Bvh.Build", &create);
+template<BvhSplitter Splitter>
+IApp* create()
+{
+  return createAlgorithmApp(std::make_unique<ConcreteAlgorithm<BoundingVolumeHierarchy<Splitter>>>());
+}
+
+const int registered = registerApp("Bvh.Build", &create<BvhSplitter::Median>);
+const int registeredSah = registerApp("Bvh.Build.SAH", &create<BvhSplitter::BinnedSah>);
+const int registeredMorton = registerApp("Bvh.Build.LBVH", &create<BvhSplitter::Morton>);
 }
@@ -0,0 +1,159 @@
+// Copyright (C) 2024 - Sebastien Alaiwan
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+
+///////////////////////////////////////////////////////////////////////////////
+// BVH of moving objects, updated each frame instead of being rebuilt
+
+#include "core/app.h"
+#include "core/drawer.h"
+#include "core/geom.h"
+
+#include <cstdio>
+#include <vector>
+
+#include "bvh.h"
+#include "dynamic_bvh.h"
+#include "random.h"
+
+namespace
+{
+
+const Vec2 WorldMin{-30, -15};
+const Vec2 WorldMax{30, 15};
+
+struct Circle
+{
+  Vec2 center;
+  Vec2 velocity;
+  float radius;
+  int handle;
+};
+
+BoundingBox boundingBox(const Circle& c)
+{
+  BoundingBox box;
+  box.add(c.center - Vec2(c.radius, c.radius));
+  box.add(c.center + Vec2(c.radius, c.radius));
+  return box;
+}
+
+// Space: switch between reinsertions (enlarged boxes) and refits.
+// Return: enable/disable the rotations.
+struct DynamicBvhApp : IApp
+{
+  DynamicBvhApp()
+  {
+    for(int k = 0; k < 200; ++k)
+    {
+      Circle c;
+      c.center = randomPos(WorldMin, WorldMax);
+      c.velocity = randomPos({-0.1, -0.1}, {0.1, 0.1});
+      c.radius = randomFloat(0.2, 1);
+      shapes.push_back(c);
+    }
+
+    createTree();
+  }
+
+  void createTree()
+  {
+    DynamicBvhOptions options;
+    options.margin = refit ? 0.0f : 0.5f;
+    options.rotations = rotations;
+
+    bvh = DynamicBvh(options);
+    for(int i = 0; i < (int)shapes.size(); ++i)
+      shapes[i].handle = bvh.insert(boundingBox(shapes[i]), i);
+  }
+
+  void tick() override
+  {
+    reinsertions = 0;
+
+    for(auto& c : shapes)
+    {
+      c.center = c.center + c.velocity;
+
+      if(c.center.x < WorldMin.x || c.center.x > WorldMax.x)
+        c.velocity.x = -c.velocity.x;
+      if(c.center.y < WorldMin.y || c.center.y > WorldMax.y)
+        c.velocity.y = -c.velocity.y;
+
+      if(refit)
+        bvh.setBox(c.handle, boundingBox(c));
+      else if(bvh.move(c.handle, boundingBox(c)))
+        ++reinsertions;
+    }
+
+    if(refit)
+      bvh.refit();
+  }
+
+  void draw(IDrawer* drawer) override
+  {
+    bvh.traverse(
+          [&](const BoundingBox& box)
+          {
+            drawer->rect(box.min, box.max - box.min, Gray);
+            return true;
+          },
+          [](int) {});
+
+    for(auto& c : shapes)
+      drawer->circle(c.center, c.radius, Blue);
+
+    // compare with a tree built from scratch, with one object per leaf too
+    std::vector<BoundingBox> boxes;
+    boxes.reserve(shapes.size());
+    for(auto& c : shapes)
+      boxes.push_back(boundingBox(c));
+
+    BvhBuildOptions options;
+    options.splitter = BvhSplitter::BinnedSah;
+    options.maxLeafSize = 1;
+    const auto rebuilt = computeBoundingVolumeHierarchy(boxes, options);
+    const float rebuiltCost = computeBvhCost(rebuilt);
+
+    char buffer[256];
+    snprintf(buffer, sizeof buffer, "%s, rotations %s", refit ? "refit" : "reinsertions", rotations ? "on" : "off");
+    drawer->text(WorldMax + Vec2(1, 0), buffer, White);
+
+    snprintf(buffer, sizeof buffer, "expected query cost: %.2f (rebuilt with SAH: %.2f)", bvh.cost(), rebuiltCost);
+    drawer->text(WorldMax + Vec2(1, -2), buffer, White);
+
+    snprintf(buffer, sizeof buffer, "height: %d, reinsertions: %d", bvh.height(), reinsertions);
+    drawer->text(WorldMax + Vec2(1, -4), buffer, White);
+  }
+
+  void processEvent(InputEvent inputEvent) override
+  {
+    if(!inputEvent.pressed)
+      return;
+
+    switch(inputEvent.key)
+    {
+    case Key::Space:
+      refit = !refit;
+      createTree();
+      break;
+    case Key::Return:
+      rotations = !rotations;
+      createTree();
+      break;
+    default:
+      break;
+    }
+  }
+
+  std::vector<Circle> shapes;
+  DynamicBvh bvh;
+  bool refit = false;
+  bool rotations = true;
+  int reinsertions = 0;
+};
+
+const int registered = registerApp("Bvh.Dynamic", []() -> IApp* { return new DynamicBvhApp; });
+}
@@ -27,57 +27,25 @@ struct Circle
   float radius;
 };
 
-std::vector<short> status_bvh;
-
-bool intersectsAABB(Vec2 a, Vec2 b, BoundingBox aabb)
+// first intersection of [a;b] with the circle, as a ratio of the segment length (0 if 'a' is inside)
+float raycastCircle(Vec2 a, Vec2 b, const Circle& circle)
 {
-  auto delta = b - a;
-
-  float tmin = 0;
-  float tmax = 1;
-
-  float tx1 = (aabb.min.x - a.x) / delta.x;
-  float tx2 = (aabb.max.x - a.x) / delta.x;
-  tmin = max(tmin, min(tx1, tx2));
-  tmax = min(tmax, max(tx1, tx2));
-
-  float ty1 = (aabb.min.y - a.y) / delta.y;
-  float ty2 = (aabb.max.y - a.y) / delta.y;
-  tmin = max(tmin, min(ty1, ty2));
-  tmax = min(tmax, max(ty1, ty2));
-
-  return tmax >= tmin;
-}
-
-float raycast(Vec2 a, Vec2 b, span<const BvhNode> bvh)
-{
-  status_bvh.clear();
-  status_bvh.resize(bvh.len);
-
-  std::vector<int> stack;
-  stack.reserve(bvh.len);
-
-  stack.push_back(0);
-
-  while(stack.size())
-  {
-    const int curr = stack.back();
-    stack.pop_back();
-
-    status_bvh[curr] = 2; // tested
-    if(!intersectsAABB(a, b, bvh[curr].boundaries))
-      continue;
+  const auto delta = b - a;
+  const auto rel = a - circle.center;
 
-    status_bvh[curr] = 1; // tested, intersection found
+  const float c = rel * rel - circle.radius * circle.radius;
+  if(c <= 0)
+    return 0;
 
-    if(bvh[curr].children[0])
-      stack.push_back(bvh[curr].children[0]);
+  const float qa = delta * delta;
+  const float qb = rel * delta;
+  const float discriminant = qb * qb - qa * c;
 
-    if(bvh[curr].children[1])
-      stack.push_back(bvh[curr].children[1]);
-  }
+  if(discriminant < 0 || qa == 0)
+    return INFINITY;
 
-  return 1;
+  const float t = (-qb - std::sqrt(discriminant)) / qa;
+  return t >= 0 ? t : INFINITY;
 }
 
 struct BvhRaycastApp : IApp
@@ -107,7 +75,7 @@ struct BvhRaycastApp : IApp
         box.add(obj.center + Vec2(obj.radius, obj.radius));
         boxes.push_back(box);
       }
-      bvh = computeBoundingVolumeHierarchy(boxes);
+      bvh = computeFlatBvh(boxes);
     }
 
     compute();
@@ -120,27 +88,18 @@ struct BvhRaycastApp : IApp
       drawer->circle(c.center, c.radius, Blue);
 
     // draw BVH
-    for(auto& node : bvh)
+    for(auto& node : bvh.nodes)
       drawer->rect(node.boundaries.min, node.boundaries.max - node.boundaries.min, Gray);
 
-    for(auto& node : bvh)
+    // draw the shapes tested by the raycast, and the one hit
+    for(auto index : testedShapes)
+      drawer->circle(shapes[index].center, shapes[index].radius, Yellow);
+
+    if(hit.object >= 0)
     {
-      auto i = int(&node - bvh.data());
-      if(status_bvh[i] != 0)
-      {
-        auto margin = Vec2(0.1, 0.1);
-        drawer->rect(node.boundaries.min + margin, node.boundaries.max - node.boundaries.min - 2 * margin,
-              status_bvh[i] == 1 ? Yellow : White);
-
-        if(status_bvh[i] == 1)
-        {
-          for(auto index : node.objects)
-          {
-            auto& tri = shapes[index];
-            drawer->circle(tri.center, tri.radius, Yellow);
-          }
-        }
-      }
+      auto& c = shapes[hit.object];
+      drawer->circle(c.center, c.radius, Red);
+      drawCross(drawer, rayStart + (rayTarget - rayStart) * hit.t, Red);
     }
 
     // draw selection
@@ -201,14 +160,26 @@ struct BvhRaycastApp : IApp
     compute();
   }
 
-  void compute() { rayRatio = raycast(rayStart, rayTarget, bvh); }
+  void compute()
+  {
+    testedShapes.clear();
+
+    auto intersectShape = [&](int index, float /* maxT */)
+    {
+      testedShapes.push_back(index);
+      return raycastCircle(rayStart, rayTarget, shapes[index]);
+    };
+
+    hit = raycast(bvh, rayStart, rayTarget - rayStart, 1.0f, intersectShape);
+  }
 
   std::vector<Circle> shapes;
-  std::vector<BvhNode> bvh;
+  FlatBvh bvh;
 
   Vec2 rayStart; // the starting position
   Vec2 rayTarget; // the target position
-  float rayRatio; // the amount of move we can do
+  BvhHit hit; // 'hit.t' is the amount of move we can do
+  std::vector<int> testedShapes;
 
   int currentSelection = 0;
 };
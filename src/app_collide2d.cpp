@@ -22,6 +22,7 @@ struct Input
   bool left, right, up, down;
   bool force;
   bool changeShape;
+  bool changeMode;
 };
 
 struct World
@@ -29,8 +30,10 @@ struct World
   Vec2 pos;
   float angle;
   Shape shape = Circle;
+  bool continuous = false; // sweepMove instead of slideMove
 
   std::vector<Segment> segments;
+  SegmentGrid grid;
 };
 
 Vec2 direction(float angle) { return Vec2(cos(angle), sin(angle)); }
@@ -131,6 +134,8 @@ World createWorld()
   };
 
   pushPolygon(world.segments, points5);
+
+  world.grid = gridSegments(world.segments);
   return world;
 }
 
@@ -154,6 +159,9 @@ void tick(World& world, Input input)
   if(input.changeShape)
     world.shape = Shape(1 - world.shape);
 
+  if(input.changeMode)
+    world.continuous = !world.continuous;
+
   world.angle += omega;
   auto const delta = direction(world.angle) * thrust;
 
@@ -161,8 +169,10 @@ void tick(World& world, Input input)
 
   if(input.force)
     world.pos += delta;
+  else if(world.continuous)
+    sweepMove(world.pos, world.shape, delta, segments, world.grid);
   else
-    slideMove(world.pos, world.shape, delta, segments);
+    slideMove(world.pos, world.shape, delta, segments, world.grid);
 }
 
 struct Collide2DApp : IApp
@@ -208,6 +218,9 @@ struct Collide2DApp : IApp
 
     if(inputEvent.pressed && inputEvent.key == Key::Space)
       input.changeShape = true;
+
+    if(inputEvent.pressed && inputEvent.key == Key::Return)
+      input.changeMode = true;
   }
 
   bool keyState[128]{};
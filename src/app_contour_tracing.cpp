@@ -13,6 +13,7 @@
 #include <array>
 #include <vector>
 
+#include "contour_tracing.h"
 #include "random.h"
 
 namespace
@@ -291,6 +292,43 @@ struct ContourTracingAlgorithm
   }
 };
 
-IApp* create() { return createAlgorithmApp(std::make_unique<ConcreteAlgorithm<ContourTracingAlgorithm>>()); }
-const int reg = registerApp("ContourTracing", &create);
+// The library version: marching squares over a bit grid
+struct MarchingSquaresAlgorithm : ContourTracingAlgorithm
+{
+  static std::vector<PolygonBorder> execute(Grid input)
+  {
+    BitGrid mask(gridWidth, gridHeight);
+    for(int y = 0; y < gridHeight; y++)
+    {
+      for(int x = 0; x < gridWidth; x++)
+      {
+        if(input[tileIndex({x, y})])
+          mask.set(x, y);
+      }
+    }
+
+    const Contours contours = extractContours(mask, {});
+
+    std::vector<PolygonBorder> output;
+    for(int i = 0; i < contours.size(); i++)
+    {
+      PolygonBorder border;
+      for(auto p : contours.contour(i))
+        border.push_back(p * tileRenderSize - Vec2(gridWidth, gridHeight) * (tileRenderSize / 2.f));
+      border.push_back(border.front());
+      output.push_back(border);
+    }
+
+    return output;
+  }
+};
+
+template<typename Algorithm>
+IApp* create()
+{
+  return createAlgorithmApp(std::make_unique<ConcreteAlgorithm<Algorithm>>());
+}
+
+const int reg = registerApp("ContourTracing", &create<ContourTracingAlgorithm>);
+const int regMarchingSquares = registerApp("ContourTracing.MarchingSquares", &create<MarchingSquaresAlgorithm>);
 } // namespace
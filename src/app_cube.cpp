@@ -10,6 +10,7 @@
 #include "core/app.h"
 #include "core/drawer.h"
 #include "core/geom.h"
+#include "core/matrix4.h"
 
 #include <cmath>
 
@@ -24,46 +25,22 @@ struct SpinningCube : IApp
     drawer->line(Vec3{0, 0, 0}, Vec3{0, 1, 0}, Green);
     drawer->line(Vec3{0, 0, 0}, Vec3{0, 0, 1}, Blue);
 
+    // in the order expected by 'box'
     Vec3 vertices[] = {
           {-1, -1, -1},
+          {+1, -1, -1},
           {-1, +1, -1},
           {+1, +1, -1},
-          {+1, -1, -1},
           {-1, -1, +1},
+          {+1, -1, +1},
           {-1, +1, +1},
           {+1, +1, +1},
-          {+1, -1, +1},
     };
 
-    for(auto& v : vertices)
-    {
-      Vec3 orig = v;
-      v.z = orig.z * cos(angle) - orig.x * sin(angle);
-      v.x = orig.z * sin(angle) + orig.x * cos(angle);
-
-      const auto angle2 = angle * 0.5;
-
-      orig = v;
-      v.x = orig.x * cos(angle2) - orig.y * sin(angle2);
-      v.y = orig.x * sin(angle2) + orig.y * cos(angle2);
-
-      v = v * 5;
-    }
-
-    drawer->line(vertices[0], vertices[1], White);
-    drawer->line(vertices[1], vertices[2], White);
-    drawer->line(vertices[2], vertices[3], White);
-    drawer->line(vertices[3], vertices[0], White);
-
-    drawer->line(vertices[4], vertices[5], White);
-    drawer->line(vertices[5], vertices[6], White);
-    drawer->line(vertices[6], vertices[7], White);
-    drawer->line(vertices[7], vertices[4], White);
+    const auto transform = scale({5, 5, 5}) * rotateZ(angle * 0.5) * rotateY(angle);
+    transformPoints(transform, vertices, vertices);
 
-    drawer->line(vertices[0], vertices[4], White);
-    drawer->line(vertices[1], vertices[5], White);
-    drawer->line(vertices[2], vertices[6], White);
-    drawer->line(vertices[3], vertices[7], White);
+    drawer->box(vertices, White);
   }
 
   float angle = 0;
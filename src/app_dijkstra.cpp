@@ -10,11 +10,16 @@
 #include "core/algorithm_app.h"
 #include "core/sandbox.h"
 
+#include <algorithm>
 #include <climits>
+#include <cmath>
 #include <cstdio> // snprintf
 #include <set>
+#include <stdexcept>
 #include <vector>
 
+#include "datasets.h"
+#include "path_finding.h"
 #include "random.h"
 
 namespace
@@ -42,16 +47,16 @@ struct Output
   std::vector<int> cost;
 };
 
-Graph randomGraph()
+// 'N x N' nodes
+Graph randomGraph(int N)
 {
   Graph r;
 
   auto& nodes = r.nodes;
 
-  static const int N = 7;
   static const auto spacing = 4.2f;
 
-  auto getId = [](int x, int y) { return x + y * N; };
+  auto getId = [N](int x, int y) { return x + y * N; };
 
   nodes.resize(N * N);
 
@@ -98,9 +103,74 @@ Graph randomGraph()
   return r;
 }
 
+CsrGraph toCsr(const Graph& graph)
+{
+  CsrGraph r;
+  for(auto& node : graph.nodes)
+  {
+    r.positions.push_back(node.pos);
+    for(auto& neighbor : node.neighboors)
+    {
+      r.edgeTarget.push_back(neighbor.id);
+      r.edgeCost.push_back(neighbor.cost);
+    }
+    r.edgeStart.push_back(r.edgeTarget.size());
+  }
+  return r;
+}
+
+Graph fromCsr(const CsrGraph& graph, int startNode)
+{
+  if(startNode < 0 || startNode >= graph.nodeCount())
+    throw std::runtime_error("The start node isn't in the graph");
+
+  Graph r;
+  r.nodes.resize(graph.nodeCount());
+  for(int i = 0; i < graph.nodeCount(); ++i)
+  {
+    r.nodes[i].pos = graph.positions[i];
+    for(int k = graph.edgeStart[i]; k < graph.edgeStart[i + 1]; ++k)
+    {
+      if(graph.edgeTarget[k] < 0 || graph.edgeTarget[k] >= graph.nodeCount())
+        throw std::runtime_error("An edge leads out of the graph");
+      r.nodes[i].neighboors.push_back({graph.edgeTarget[k], graph.edgeCost[k]});
+    }
+  }
+  r.startNode = startNode;
+  return r;
+}
+}
+
+// Stored in its CSR form, then the start node
+template<>
+struct InputCodec<Graph>
+{
+  static void write(CorpusWriter& writer, const Graph& graph)
+  {
+    InputCodec<CsrGraph>::write(writer, toCsr(graph));
+    InputCodec<int>::write(writer, graph.startNode);
+  }
+
+  static void read(CorpusReader& reader, Graph& graph)
+  {
+    CsrGraph csr;
+    int startNode;
+    InputCodec<CsrGraph>::read(reader, csr);
+    InputCodec<int>::read(reader, startNode);
+    graph = fromCsr(csr, startNode);
+  }
+};
+
+namespace
+{
 struct DijkstraAlgorithm
 {
-  static Graph generateInput() { return randomGraph(); }
+  static Graph generateInput() { return randomGraph(7); }
+
+  static Graph generateInput(int size) { return randomGraph(std::max(2, int(std::sqrt(size)))); }
+
+  // the search starts from the first node
+  static Graph loadDataset(const std::string& path) { return fromCsr(loadGraph(path), 0); }
 
   static Output execute(Graph input)
   {
@@ -157,21 +227,24 @@ struct DijkstraAlgorithm
 
       sandbox_circle(nodes[current].pos, 2, Red);
 
-      for(int i = 0; i < (int)nodes.size(); ++i)
+      if(SandboxEnabled)
       {
-        if(r.cost[i] == INT_MAX)
-          continue;
+        for(int i = 0; i < (int)nodes.size(); ++i)
+        {
+          if(r.cost[i] == INT_MAX)
+            continue;
 
-        char buffer[32];
-        sprintf(buffer, "%d", r.cost[i]);
+          char buffer[32];
+          sprintf(buffer, "%d", r.cost[i]);
 
-        const bool highlight = todo.find(i) != todo.end();
-        sandbox_text(nodes[i].pos, buffer, highlight ? Green : White);
+          const bool highlight = todo.find(i) != todo.end();
+          sandbox_text(nodes[i].pos, buffer, highlight ? Green : White);
 
-        if(r.provenance[i] != i)
-        {
-          const int prov = r.provenance[i];
-          sandbox_line(input.nodes[prov].pos, input.nodes[i].pos, White);
+          if(r.provenance[i] != i)
+          {
+            const int prov = r.provenance[i];
+            sandbox_line(input.nodes[prov].pos, input.nodes[i].pos, White);
+          }
         }
       }
 
@@ -221,6 +294,43 @@ struct DijkstraAlgorithm
   }
 };
 
-IApp* create() { return createAlgorithmApp(std::make_unique<ConcreteAlgorithm<DijkstraAlgorithm>>()); }
-const int reg = registerApp("PathFind.Dijkstra", &create);
+// The library version: compressed rows, radix heap
+struct FastDijkstraAlgorithm : DijkstraAlgorithm
+{
+  static Output execute(Graph input)
+  {
+    PathGraph graph;
+    for(auto& node : input.nodes)
+    {
+      const int index = graph.addNode(node.pos);
+      for(auto& nb : node.neighboors)
+        graph.addEdge(index, nb.id, nb.cost);
+    }
+
+    PathScratch scratch;
+    findShortestPaths(graph, {1, &input.startNode}, {}, scratch);
+
+    Output r{};
+    r.cost.resize(graph.size(), INT_MAX);
+    r.provenance.resize(graph.size(), INT_MAX);
+    for(int i = 0; i < graph.size(); ++i)
+    {
+      if(scratch.isReached(i))
+      {
+        r.cost[i] = int(scratch.cost[i]);
+        r.provenance[i] = scratch.provenance[i];
+      }
+    }
+    return r;
+  }
+};
+
+template<typename Algorithm>
+IApp* create()
+{
+  return createAlgorithmApp(std::make_unique<ConcreteAlgorithm<Algorithm>>());
+}
+
+const int reg = registerApp("PathFind.Dijkstra", &create<DijkstraAlgorithm>);
+const int regFast = registerApp("PathFind.Dijkstra.Fast", &create<FastDijkstraAlgorithm>);
 }
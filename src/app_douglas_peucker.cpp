@@ -10,11 +10,14 @@
 #include "core/algorithm_app.h"
 #include "core/sandbox.h"
 
+#include <algorithm>
 #include <cmath>
 #include <cstdio> // snprintf
 #include <vector>
 
+#include "datasets.h"
 #include "random.h"
+#include "simplify_polyline.h"
 
 namespace
 {
@@ -161,10 +164,15 @@ std::vector<Segment> simplify_DouglasPeucker(const std::vector<Vec2>& input, flo
 
 struct DouglasPeuckerAlgorithm
 {
-  static std::vector<Vec2> generateInput()
+  static std::vector<Vec2> generateInput() { return randomPolyline(int(randomFloat(3, 15))); }
+
+  static std::vector<Vec2> generateInput(int size) { return randomPolyline(std::max(3, size)); }
+
+  static std::vector<Vec2> loadDataset(const std::string& path) { return loadPoints(path); }
+
+  static std::vector<Vec2> randomPolyline(int N)
   {
     std::vector<Vec2> points;
-    const int N = int(randomFloat(3, 15));
     const float length = 40.0f;
 
     for(int i = 0; i < N; ++i)
@@ -203,6 +211,28 @@ struct DouglasPeuckerAlgorithm
   }
 };
 
-IApp* create() { return createAlgorithmApp(std::make_unique<ConcreteAlgorithm<DouglasPeuckerAlgorithm>>()); }
-const int reg = registerApp("DouglasPeucker", &create);
+// The library version: explicit stack, vectorised distances, independent ranges in parallel
+struct FastDouglasPeuckerAlgorithm : DouglasPeuckerAlgorithm
+{
+  static std::vector<Segment> execute(std::vector<Vec2> input)
+  {
+    const float maxDistanceToSimplify = 3.0f;
+
+    const std::vector<int> kept = simplifyPolyline_DouglasPeucker(input, maxDistanceToSimplify, 0);
+
+    std::vector<Segment> result;
+    for(int i = 0; i + 1 < (int)kept.size(); ++i)
+      result.push_back({kept[i], kept[i + 1]});
+    return result;
+  }
+};
+
+template<typename Algorithm>
+IApp* create()
+{
+  return createAlgorithmApp(std::make_unique<ConcreteAlgorithm<Algorithm>>());
+}
+
+const int reg = registerApp("DouglasPeucker", &create<DouglasPeuckerAlgorithm>);
+const int regFast = registerApp("DouglasPeucker.Fast", &create<FastDouglasPeuckerAlgorithm>);
 }
@@ -10,18 +10,18 @@
 #include "core/algorithm_app.h"
 #include "core/sandbox.h"
 
-#include <algorithm>
 #include <cmath>
 #include <vector>
 
 #include "bounding_box.h"
+#include "datasets.h"
+#include "predicates.h"
 #include "random.h"
 #include "random_polygon.h"
+#include "triangulate_polygon.h"
 
 namespace
 {
-static float cross(Vec2 v, Vec2 w) { return v.x * w.y - v.y * w.x; }
-
 struct Segment
 {
   int a, b;
@@ -39,18 +39,47 @@ void drawPolygon(const Polygon2f& input, Color color)
     sandbox_line(input.vertices[face.a], input.vertices[face.b], color);
 }
 
-Ear polygonEarFromIndex(const Polygon2f& polygon, int index)
+// The polygon being clipped: the ring of its remaining vertices
+struct ClippedPolygon
+{
+  PolygonRings rings;
+  std::vector<int> positionOf; // by vertex of the polygon
+  std::vector<bool> removed; // by position
+  int remaining = 0;
+
+  explicit ClippedPolygon(const Polygon2f& polygon)
+  {
+    toRings(polygon, rings);
+    positionOf.assign(polygon.vertices.size(), -1);
+    for(int k = 0; k < rings.size(); ++k)
+      positionOf[rings.vertexOf[k]] = k;
+    removed.assign(rings.size(), false);
+    remaining = rings.size();
+  }
+};
+
+void drawPolygon(const ClippedPolygon& polygon, Color color)
+{
+  const auto& rings = polygon.rings;
+  for(int k = 0; k < rings.size(); ++k)
+  {
+    if(!polygon.removed[k])
+      sandbox_line(rings.points[k], rings.points[rings.next[k]], color);
+  }
+}
+
+Ear polygonEarFromIndex(const ClippedPolygon& polygon, int index)
 {
   Ear ear;
   ear.tip = index;
   ear.a = -1;
   ear.b = -1;
-  for(Face face : polygon.faces)
+
+  const int k = polygon.positionOf[index];
+  if(k >= 0 && !polygon.removed[k])
   {
-    if(face.a == index)
-      ear.b = face.b;
-    else if(face.b == index)
-      ear.a = face.a;
+    ear.a = polygon.rings.vertexOf[polygon.rings.prev[k]];
+    ear.b = polygon.rings.vertexOf[polygon.rings.next[k]];
   }
 
   return ear;
@@ -59,12 +88,7 @@ Ear polygonEarFromIndex(const Polygon2f& polygon, int index)
 bool isInsideTriangle(Vec2 a, Vec2 b, Vec2 c, Vec2 point)
 {
   auto isOnTheRightOfSegment = [](Vec2 segmentStart, Vec2 segmentEnd, Vec2 point)
-  {
-    const Vec2 a = point - segmentStart;
-    const Vec2 b = segmentEnd - point;
-    const float epsilon = 0.0001;
-    return cross(a, b) > -epsilon;
-  };
+  { return orient2d(segmentStart, segmentEnd, point) <= 0; };
 
   return isOnTheRightOfSegment(a, b, point) && isOnTheRightOfSegment(b, c, point) && isOnTheRightOfSegment(c, a, point);
 }
@@ -77,10 +101,7 @@ bool isValidEar(const Polygon2f& polygon, Ear& ear)
   const Vec2 a = polygon.vertices[ear.a];
   const Vec2 b = polygon.vertices[ear.b];
   const Vec2 tip = polygon.vertices[ear.tip];
-  const Vec2 segmentA = tip - a;
-  const Vec2 segmentB = b - tip;
-  const float epsilon = 0.0001; // In order to ignore "flat" corners.
-  const bool convexAngle = cross(segmentA, segmentB) < -epsilon;
+  const bool convexAngle = orient2d(a, tip, b) < 0; // "flat" corners aren't ears
   if(!convexAngle)
     return false;
 
@@ -93,22 +114,25 @@ bool isValidEar(const Polygon2f& polygon, Ear& ear)
   return true;
 };
 
-void removeFacesForCorner(Polygon2f& polygon, int idx)
+// unlinks the tip: its neighbours become linked by a new face
+void removeCorner(ClippedPolygon& polygon, int idx)
 {
-  auto isConcernedFace = [idx](Face face) { return (face.a == idx || face.b == idx); };
-  auto it = std::remove_if(polygon.faces.begin(), polygon.faces.end(), isConcernedFace);
-  polygon.faces.erase(it, polygon.faces.end());
+  auto& rings = polygon.rings;
+  const int k = polygon.positionOf[idx];
+  rings.next[rings.prev[k]] = rings.next[k];
+  rings.prev[rings.next[k]] = rings.prev[k];
+  polygon.removed[k] = true;
+  polygon.remaining--;
 }
 
-Segment clipEar(Polygon2f& polygon)
+Segment clipEar(const Polygon2f& input, ClippedPolygon& polygon)
 {
-  for(int idx = 0; idx < (int)polygon.vertices.size(); idx++)
+  for(int idx = 0; idx < (int)input.vertices.size(); idx++)
   {
     Ear ear = polygonEarFromIndex(polygon, idx);
-    if(isValidEar(polygon, ear))
+    if(isValidEar(input, ear))
     {
-      removeFacesForCorner(polygon, idx);
-      polygon.faces.push_back({ear.a, ear.b});
+      removeCorner(polygon, idx);
       return {ear.a, ear.b};
     }
   }
@@ -121,17 +145,21 @@ struct EarClippingAlgorithm
 {
   static Polygon2f generateInput() { return createRandomPolygon2f(); }
 
+  static Polygon2f loadDataset(const std::string& path) { return loadPolygon(path); }
+
   static std::vector<Segment> execute(Polygon2f input)
   {
+    ClippedPolygon polygon(input);
+
     std::vector<Segment> result;
-    while(input.faces.size() > 3)
+    while(polygon.remaining > 3)
     {
-      drawPolygon(input, Yellow);
+      drawPolygon(polygon, Yellow);
       sandbox_breakpoint();
-      Segment segment = clipEar(input);
+      Segment segment = clipEar(input, polygon);
       result.push_back(segment);
     }
-    drawPolygon(input, Yellow);
+    drawPolygon(polygon, Yellow);
     sandbox_breakpoint();
     return result;
   }
@@ -144,6 +172,47 @@ struct EarClippingAlgorithm
   }
 };
 
-IApp* create() { return createAlgorithmApp(std::make_unique<ConcreteAlgorithm<EarClippingAlgorithm>>()); }
-const int reg = registerApp("EarClipping", &create);
+// The library versions: only the diagonals are kept
+template<TriangleMesh (*Triangulate)(const Polygon2f&)>
+struct PolygonTriangulationAlgorithm
+{
+  static Polygon2f generateInput() { return createRandomPolygon2f(); }
+
+  static Polygon2f loadDataset(const std::string& path) { return loadPolygon(path); }
+
+  static std::vector<Segment> execute(Polygon2f input)
+  {
+    const auto mesh = Triangulate(input);
+    sandbox_printf("Triangulated, %d triangles\n", (int)mesh.triangles.size());
+
+    std::vector<Segment> result;
+    for(int t = 0; t < (int)mesh.triangles.size(); ++t)
+    {
+      auto& triangle = mesh.triangles[t];
+      for(int i = 0; i < 3; ++i)
+      {
+        if(triangle.neighbours[i] > t)
+          result.push_back({triangle.vertices[i], triangle.vertices[(i + 1) % 3]});
+      }
+    }
+    return result;
+  }
+
+  static void display(const Polygon2f& input, span<const Segment> output)
+  {
+    EarClippingAlgorithm::display(input, output);
+  }
+};
+
+template<typename Algorithm>
+IApp* create()
+{
+  return createAlgorithmApp(std::make_unique<ConcreteAlgorithm<Algorithm>>());
+}
+
+const int reg = registerApp("EarClipping", &create<EarClippingAlgorithm>);
+const int regFast =
+      registerApp("EarClipping.Fast", &create<PolygonTriangulationAlgorithm<triangulatePolygon_EarClipping>>);
+const int regMonotone =
+      registerApp("EarClipping.Monotone", &create<PolygonTriangulationAlgorithm<triangulatePolygon_Monotone>>);
 }
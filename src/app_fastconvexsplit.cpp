@@ -11,21 +11,18 @@
 #include "core/geom.h"
 #include "core/sandbox.h"
 
-#include <cassert>
 #include <cmath>
-#include <deque>
 #include <vector>
 
 #include "bounding_box.h"
+#include "convex_decomposition.h"
+#include "datasets.h"
 #include "random.h"
 #include "random_polygon.h"
-#include "split_polygon.h"
 
 namespace
 {
 
-constexpr auto epsilon = 0.01f;
-
 const Color colors[] = {
       {0, 1, 0, 1},
       {0, 1, 1, 1},
@@ -83,118 +80,7 @@ void drawPolygon(const Polygon2f& poly, Color color)
   }
 }
 
-bool isConvex(const Polygon2f& poly)
-{
-  for(auto face : poly.faces)
-  {
-    const auto T = poly.vertices[face.b] - poly.vertices[face.a];
-    const auto N = -rotateLeft(T); // normals point to the outside
-    for(auto vertex : poly.vertices)
-    {
-      auto dv = vertex - poly.vertices[face.a];
-      if(dotProduct(dv, N) > epsilon)
-        return false;
-    }
-  }
-
-  return true;
-}
-
-Plane chooseCuttingPlane(const Polygon2f& poly)
-{
-  Plane bestPlane;
-  int bestScore = 0;
-
-  for(auto face : poly.faces)
-  {
-    const auto T = poly.vertices[face.b] - poly.vertices[face.a];
-    const auto N = normalize(-rotateLeft(T));
-    const auto plane = Plane{N, dotProduct(N, poly.vertices[face.a])};
-
-    int frontCount = 0;
-    int backCount = 0;
-
-    for(auto v : poly.vertices)
-    {
-      if(dotProduct(v, plane.normal) > plane.dist + epsilon)
-        frontCount++;
-      else
-        backCount++;
-    }
-
-    const int score = std::min(frontCount, backCount);
-    if(score > bestScore)
-    {
-      bestScore = score;
-      bestPlane = plane;
-    }
-  }
-
-  return bestPlane;
-}
-
-std::vector<Polygon2f> decomposePolygonToConvexParts(const Polygon2f& input)
-{
-  std::deque<Polygon2f> fifo;
-  fifo.push_back(input);
-
-  std::vector<Polygon2f> result;
-
-  while(fifo.size())
-  {
-    auto poly = fifo.front();
-    fifo.pop_front();
-
-    if(poly.faces.empty())
-      continue;
-
-    if(isConvex(poly))
-    {
-      result.push_back(poly);
-      continue;
-    }
-
-    auto plane = chooseCuttingPlane(poly);
-
-    {
-      for(auto& p : result)
-        drawPolygon(p, White);
-      for(auto& p : fifo)
-        drawPolygon(p, Gray);
-
-      drawPolygon(poly, LightBlue);
-
-      const auto T = rotateLeft(plane.normal);
-      auto p = plane.normal * plane.dist;
-      auto shift = plane.normal * 0.1;
-      auto tmin = p + T * +1000;
-      auto tmax = p + T * -1000;
-      sandbox_line(tmin + shift, tmax + shift, Yellow);
-      sandbox_line(tmin - shift, tmax - shift, Yellow);
-      sandbox_breakpoint();
-    }
-
-    Polygon2f front, back;
-    splitPolygonAgainstPlane(poly, plane, front, back);
-
-    fifo.push_back(front);
-    fifo.push_back(back);
-
-    {
-      for(auto& p : result)
-        drawPolygon(p, White);
-      for(auto& p : fifo)
-        drawPolygon(p, Gray);
-
-      drawPolygon(front, Red);
-      drawPolygon(back, Green);
-      sandbox_breakpoint();
-    }
-  }
-
-  return result;
-}
-
+template<ConvexDecomposition (*Decompose)(const Polygon2f&)>
 struct FastConvexSplit
 {
   static Polygon2f generateInput()
@@ -220,7 +106,9 @@ struct FastConvexSplit
     return input;
   }
 
-  static std::vector<Polygon2f> execute(Polygon2f input) { return decomposePolygonToConvexParts(input); }
+  static std::vector<Polygon2f> execute(Polygon2f input) { return toPolygons(Decompose(input)); }
+
+  static Polygon2f loadDataset(const std::string& path) { return loadPolygon(path); }
 
   static void display(const Polygon2f& input, span<const Polygon2f> output)
   {
@@ -231,6 +119,13 @@ struct FastConvexSplit
   }
 };
 
-IApp* create() { return createAlgorithmApp(std::make_unique<ConcreteAlgorithm<FastConvexSplit>>()); }
-const int registered = registerApp("FastConvexSplit", &create);
+template<typename Algorithm>
+IApp* create()
+{
+  return createAlgorithmApp(std::make_unique<ConcreteAlgorithm<Algorithm>>());
+}
+
+const int registered = registerApp("FastConvexSplit", &create<FastConvexSplit<decomposeToConvex_Split>>);
+const int registeredHertelMehlhorn =
+      registerApp("FastConvexSplit.HertelMehlhorn", &create<FastConvexSplit<decomposeToConvex_HertelMehlhorn>>);
 }
@@ -13,23 +13,18 @@
 
 #include <cmath>
 
+#include "light_clusters.h"
+
 namespace
 {
 float lerp(float a, float b, float r) { return (a * (1.f - r)) + (b * r); }
 
-const int CX = 16;
-const int CY = 8;
-const int CZ = 24;
-
 struct FrustumClusters : IApp
 {
   // input data:
 
   // frustum definition
-  static constexpr float near = 10;
-  static constexpr float far = 40;
-  static constexpr float aspectRatio = 16.0 / 9.0;
-  static constexpr float fovY = M_PI / 3.0;
+  ClusterGridOptions options;
 
   // sphere position
   Vec3 sphereCenter = {4, 0, -5};
@@ -38,79 +33,19 @@ struct FrustumClusters : IApp
   // output data:
 
   // intermediate
-  Vec3 planesX[CX + 1];
-  Vec3 planesY[CY + 1];
+  ClusterGrid grid;
 
   // result
-  bool clusters[CZ][CY][CX]{};
+  ClusterRange clusters{};
 
   FrustumClusters() { recompute(); }
 
   void recompute()
   {
-    for(auto& slice : clusters)
-      for(auto& row : slice)
-        for(auto& cell : row)
-          cell = false;
-
-    // compute the normals of the planes splitting the frustum.
-    // all those planes contain (0;0;0)
-    const float tanHalfFovY = tan(fovY / 2);
-
-    // pencil of planes on the Y axis
-    const float fhx = far * tanHalfFovY * aspectRatio;
-
-    for(int ix = 0; ix <= CX; ++ix)
-    {
-      const auto rx = float(ix) / float(CX);
-      Vec3 ray{lerp(-fhx, +fhx, rx), 0, -far};
-      planesX[ix] = normalize(crossProduct(ray, Vec3(0, 1, 0)));
-    }
-
-    // pencil of planes on the X axis
-    const float fhy = far * tanHalfFovY;
-
-    for(int iy = 0; iy <= CY; ++iy)
-    {
-      const auto ry = float(iy) / float(CY);
-      Vec3 ray{0, lerp(-fhy, +fhy, ry), -far};
-      planesY[iy] = normalize(crossProduct(ray, Vec3(-1, 0, 0)));
-    }
-
-    // determine which planes are the tightest boundaries for the sphere
-    int minPlaneX, maxPlaneX;
-    {
-      minPlaneX = 0;
-      maxPlaneX = CX;
-      for(int ix = 0; ix <= CX; ++ix)
-      {
-        if(dotProduct(planesX[ix], sphereCenter) > sphereRadius)
-          minPlaneX = max(minPlaneX, ix);
-        if(dotProduct(planesX[ix], sphereCenter) < -sphereRadius)
-          maxPlaneX = min(maxPlaneX, ix);
-      }
-    }
+    grid.build(options);
 
-    int minPlaneY, maxPlaneY;
-    {
-      minPlaneY = 0;
-      maxPlaneY = CY;
-      for(int iy = 0; iy <= CY; ++iy)
-      {
-        if(dotProduct(planesY[iy], sphereCenter) > sphereRadius)
-          minPlaneY = max(minPlaneY, iy);
-        if(dotProduct(planesY[iy], sphereCenter) < -sphereRadius)
-          maxPlaneY = min(maxPlaneY, iy);
-      }
-    }
-
-    const int minPlaneZ = max(0, (-sphereCenter.z - sphereRadius - near) * CZ / (far - near));
-    const int maxPlaneZ = min(CZ, (-sphereCenter.z + sphereRadius - near) * CZ / (far - near) + 1);
-
-    for(int z = minPlaneZ; z < maxPlaneZ; ++z)
-      for(int y = minPlaneY; y < maxPlaneY; ++y)
-        for(int x = minPlaneX; x < maxPlaneX; ++x)
-          clusters[z][y][x] = true;
+    const LightSphere sphere{sphereCenter, sphereRadius};
+    computeClusterRanges(grid, {1, &sphere}, {1, &clusters});
   }
 
   void keydown(Key key)
@@ -136,12 +71,21 @@ struct FrustumClusters : IApp
     case Key::PageDown:
       sphereRadius *= (1.0 / 1.10);
       break;
+    case Key::Space:
+      options.exponentialZ = !options.exponentialZ;
+      break;
     default:
       break;
     }
     recompute();
   }
 
+  void processEvent(InputEvent inputEvent) override
+  {
+    if(inputEvent.pressed)
+      keydown(inputEvent.key);
+  }
+
   void draw(IDrawer* drawer) override
   {
     struct txform : Vec3
@@ -156,7 +100,13 @@ struct FrustumClusters : IApp
     drawer->line(txform{0, 0, 0}, txform{0, 1, 0}, Green);
     drawer->line(txform{0, 0, 0}, txform{0, 0, 1}, Blue);
 
-    const float tanHalfFovY = tan(fovY / 2);
+    const float near = options.near;
+    const float far = options.far;
+    const float aspectRatio = options.aspectRatio;
+    const float tanHalfFovY = tan(options.fovY / 2);
+    const int CX = options.countX;
+    const int CY = options.countY;
+    const int CZ = options.countZ;
 
     // near half x, near half y
     const float nhx = near * tanHalfFovY * aspectRatio;
@@ -172,28 +122,27 @@ struct FrustumClusters : IApp
     drawer->line(txform{0, 0, 0}, txform{+nhx, -nhy, -near}, AlphaGray);
     drawer->line(txform{0, 0, 0}, txform{-nhx, -nhy, -near}, AlphaGray);
 
-    drawer->line(txform{-nhx, -nhy, -near}, txform{-nhx, +nhy, -near}, Yellow);
-    drawer->line(txform{-nhx, +nhy, -near}, txform{+nhx, +nhy, -near}, Yellow);
-    drawer->line(txform{+nhx, +nhy, -near}, txform{+nhx, -nhy, -near}, Yellow);
-    drawer->line(txform{+nhx, -nhy, -near}, txform{-nhx, -nhy, -near}, Yellow);
-
-    drawer->line(txform{-fhx, -fhy, -far}, txform{-fhx, +fhy, -far}, Yellow);
-    drawer->line(txform{-fhx, +fhy, -far}, txform{+fhx, +fhy, -far}, Yellow);
-    drawer->line(txform{+fhx, +fhy, -far}, txform{+fhx, -fhy, -far}, Yellow);
-    drawer->line(txform{+fhx, -fhy, -far}, txform{-fhx, -fhy, -far}, Yellow);
+    // the corners of a slice of the frustum, near face first (see 'IDrawer::box')
+    auto slice = [](float nx0, float nx1, float ny0, float ny1, float nz, float fx0, float fx1, float fy0, float fy1,
+                       float fz, Vec3(&corners)[8])
+    {
+      for(int i = 0; i < 8; ++i)
+      {
+        if(i & 4)
+          corners[i] = txform{i & 1 ? fx1 : fx0, i & 2 ? fy1 : fy0, fz};
+        else
+          corners[i] = txform{i & 1 ? nx1 : nx0, i & 2 ? ny1 : ny0, nz};
+      }
+    };
 
-    drawer->line(txform{-nhx, -nhy, -near}, txform{-fhx, -fhy, -far}, Yellow);
-    drawer->line(txform{-nhx, +nhy, -near}, txform{-fhx, +fhy, -far}, Yellow);
-    drawer->line(txform{+nhx, +nhy, -near}, txform{+fhx, +fhy, -far}, Yellow);
-    drawer->line(txform{+nhx, -nhy, -near}, txform{+fhx, -fhy, -far}, Yellow);
+    Vec3 corners[8];
+    slice(-nhx, +nhx, -nhy, +nhy, -near, -fhx, +fhx, -fhy, +fhy, -far, corners);
+    drawer->box(corners, Yellow);
 
     for(int z = 0; z < CZ; ++z)
     {
-      const auto rz0 = float(z + 0) / float(CZ);
-      const auto rz1 = float(z + 1) / float(CZ);
-
-      const auto nz0 = lerp(-near, -far, rz0);
-      const auto nz1 = lerp(-near, -far, rz1);
+      const auto nz0 = -grid.sliceDepths[z + 0];
+      const auto nz1 = -grid.sliceDepths[z + 1];
 
       const float nhx = -nz0 * tanHalfFovY * aspectRatio;
       const float nhy = -nz0 * tanHalfFovY;
@@ -221,22 +170,12 @@ struct FrustumClusters : IApp
           const auto fy1 = lerp(-fhy, +fhy, ry1);
 
           constexpr Color VeryLightGray{0.2, 0.2, 0.2, 0.2};
-          const auto color = clusters[z][y][x] ? Yellow : VeryLightGray;
-
-          drawer->line(txform{nx0, ny0, nz0}, txform{nx0, ny1, nz0}, color);
-          drawer->line(txform{nx0, ny1, nz0}, txform{nx1, ny1, nz0}, color);
-          drawer->line(txform{nx1, ny1, nz0}, txform{nx1, ny0, nz0}, color);
-          drawer->line(txform{nx1, ny0, nz0}, txform{nx0, ny0, nz0}, color);
-
-          drawer->line(txform{fx0, fy0, nz1}, txform{fx0, fy1, nz1}, color);
-          drawer->line(txform{fx0, fy1, nz1}, txform{fx1, fy1, nz1}, color);
-          drawer->line(txform{fx1, fy1, nz1}, txform{fx1, fy0, nz1}, color);
-          drawer->line(txform{fx1, fy0, nz1}, txform{fx0, fy0, nz1}, color);
-
-          drawer->line(txform{nx0, ny0, nz0}, txform{fx0, fy0, nz1}, color);
-          drawer->line(txform{nx0, ny1, nz0}, txform{fx0, fy1, nz1}, color);
-          drawer->line(txform{nx1, ny1, nz0}, txform{fx1, fy1, nz1}, color);
-          drawer->line(txform{nx1, ny0, nz0}, txform{fx1, fy0, nz1}, color);
+          const bool touched = x >= clusters.x0 && x < clusters.x1 && y >= clusters.y0 && y < clusters.y1 &&
+                z >= clusters.z0 && z < clusters.z1;
+          const auto color = touched ? Yellow : VeryLightGray;
+
+          slice(nx0, nx1, ny0, ny1, nz0, fx0, fx1, fy0, fy1, nz1, corners);
+          drawer->box(corners, color);
         }
       }
     }
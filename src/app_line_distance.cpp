@@ -12,8 +12,10 @@
 #include "core/geom.h"
 
 #include <cmath>
+#include <cstdio>
 
 #include "random.h"
+#include "segment_distance.h"
 
 namespace
 {
@@ -145,5 +147,30 @@ struct LineDistance : IApp
   float s, t;
 };
 
+// The same, for the segments [P1; P2] and [Q1; Q2]: the closest points are clamped to them
+struct SegmentDistance : LineDistance
+{
+  void draw(IDrawer* drawer) override
+  {
+    drawer->line(Vec3{0, 0, 0}, Vec3{1, 0, 0}, Red);
+    drawer->line(Vec3{0, 0, 0}, Vec3{0, 1, 0}, Green);
+    drawer->line(Vec3{0, 0, 0}, Vec3{0, 0, 1}, LightBlue);
+
+    drawer->line(P1, P2, White);
+    drawer->line(Q1, Q2, White);
+
+    const float distanceSq = closestPointsOfSegments(P1, P2, Q1, Q2, s, t);
+
+    Vec3 I = P1 + (P2 - P1) * s;
+    Vec3 J = Q1 + (Q2 - Q1) * t;
+    drawer->line(I, J, Red);
+
+    char buf[256];
+    sprintf(buf, "distance: %.2f", sqrt(distanceSq));
+    drawer->text({-10, -10}, buf);
+  }
+};
+
 const int registered = registerApp("App.LineDistance", []() -> IApp* { return new LineDistance; });
+const int registeredSegments = registerApp("App.LineDistance.Segments", []() -> IApp* { return new SegmentDistance; });
 }
@@ -74,8 +74,21 @@ struct MainMenuApp : IApp
       keydown(inputEvent.key);
   }
 
+  int contentVersion() override
+  {
+    if(sub)
+    {
+      const int subVersion = sub->contentVersion();
+      return subVersion < 0 ? -1 : version + subVersion;
+    }
+
+    return version;
+  }
+
   void keydown(Key key)
   {
+    ++version;
+
     const int N = (int)appNames.size();
     switch(key)
     {
@@ -98,6 +111,7 @@ struct MainMenuApp : IApp
   }
 
   int selection = 0;
+  int version = 0;
   std::string selectionName;
   std::unique_ptr<IApp> sub;
   std::vector<std::string> appNames;
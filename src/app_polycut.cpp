@@ -157,11 +157,7 @@ struct PolycutApp : IApp
 
   void compute()
   {
-    m_front = {};
-    m_back = {};
-
-    Polygon2f front, back;
-    splitPolygonAgainstPlane(m_poly, m_cutPlane, m_front, m_back);
+    splitPolygonAgainstPlane(m_poly, m_cutPlane, m_front, m_back, m_buffers);
   }
 
   void recomputePlaneFromFace()
@@ -188,6 +184,7 @@ struct PolycutApp : IApp
   int m_selectedFace = 0;
   Polygon2f m_poly;
   Polygon2f m_front, m_back;
+  SplitPolygonBuffers m_buffers; // kept from one cut to the next
 };
 
 const int registered = registerApp("App.PolyCut", []() -> IApp* { return new PolycutApp; });
@@ -14,6 +14,8 @@
 #include <cstdio>
 #include <vector>
 
+#include "portal_visibility.h"
+
 namespace
 {
 struct AABB
@@ -201,30 +203,6 @@ World createWorld()
   return world;
 }
 
-struct Plane
-{
-  Vec2 normal;
-  float dist;
-};
-
-struct Frustum
-{
-  Plane a, b; // plane normals points towards the inside
-};
-
-bool isOnPositiveSide(const Plane& plane, Vec2 point) { return dotProduct(point, plane.normal) > plane.dist; }
-
-bool intersects(const Frustum& frustum, const Segment& s)
-{
-  if(!isOnPositiveSide(frustum.a, s.a) && !isOnPositiveSide(frustum.a, s.b))
-    return false; // the whole segment is clipped by the 'a' plane
-
-  if(!isOnPositiveSide(frustum.b, s.a) && !isOnPositiveSide(frustum.b, s.b))
-    return false; // the whole segment is clipped by the 'b' plane
-
-  return true;
-}
-
 bool inside(const AABB& aabb, Vec2 pos)
 {
   if(pos.x < aabb.mins.x || pos.x > aabb.maxs.x)
@@ -234,108 +212,31 @@ bool inside(const AABB& aabb, Vec2 pos)
   return true;
 }
 
-Frustum computeFrustum(Vec2 origin, Segment backPlane)
+PortalWorld createPortalWorld(const World& world)
 {
-  Frustum r;
-  r.a.normal = normalize(rotateLeft(backPlane.a - origin));
-  r.b.normal = normalize(rotateLeft(backPlane.b - origin));
-  r.a.dist = dotProduct(r.a.normal, origin);
-  r.b.dist = dotProduct(r.b.normal, origin);
-  if(!isOnPositiveSide(r.a, backPlane.b))
-  {
-    r.a.normal = r.a.normal * -1;
-    r.a.dist = r.a.dist * -1;
-  }
-  if(!isOnPositiveSide(r.b, backPlane.a))
+  PortalWorld r;
+  std::vector<PortalWorld::Portal> portals;
+  for(auto& cell : world.cells)
   {
-    r.b.normal = r.b.normal * -1;
-    r.b.dist = r.b.dist * -1;
-  }
-  return r;
-}
-
-void append(std::vector<int>& dst, const std::vector<int>& src)
-{
-  for(auto val : src)
-    dst.push_back(val);
-}
-
-std::vector<Frustum> frustums;
-
-Segment intersectSegmentWithPositiveHalfPlane(Plane p, Segment s)
-{
-  float distA = dotProduct(p.normal, s.a);
-  float distB = dotProduct(p.normal, s.b);
-
-  if(distA < p.dist && distB < p.dist)
-    return {}; // the segment is fully in the negative half space
-
-  if(distA > p.dist && distB > p.dist)
-    return s; //  the segment is fully in the positive half space
-
-  float fraction = (p.dist - distA) / (distB - distA);
-
-  const auto I = s.a + (s.b - s.a) * fraction;
-
-  if(distA > p.dist)
-    return {s.a, I};
-  else
-    return {I, s.b};
-}
-
-Segment clipSegmentToFrustum(Frustum frustum, Segment s)
-{
-  s = intersectSegmentWithPositiveHalfPlane(frustum.a, s);
-  s = intersectSegmentWithPositiveHalfPlane(frustum.b, s);
-  return s;
-}
-
-std::vector<int> computeListOfVisibleCellsAux(const World& world, int fromCell, Vec2 pos, int depth, Frustum frustum)
-{
-  std::vector<int> r;
-  r.push_back(fromCell);
-
-  if(depth >= 5)
-    return r;
-
-  for(auto& portal : world.cells[fromCell].portals)
-  {
-    auto portalSegment = world.segments[portal.segment];
-    if(portal.destCell == fromCell)
-      continue;
-
-    // backface culling of portals
-    {
-      const auto segmentNormal = rotateLeft(portalSegment.b - portalSegment.a);
-      if(dotProduct(segmentNormal, pos - portalSegment.a) < 0)
-        continue;
-    }
-
-    if(frustum.a.normal == Vec2{} || intersects(frustum, portalSegment))
+    portals.clear();
+    for(auto& portal : cell.portals)
     {
-      auto clippedSegment = portalSegment;
-      if(!(frustum.a.normal == Vec2{}))
-        clippedSegment = clipSegmentToFrustum(frustum, clippedSegment);
-
-      auto subFrustum = computeFrustum(pos, clippedSegment);
-      frustums.push_back(subFrustum);
-      append(r, computeListOfVisibleCellsAux(world, portal.destCell, pos, depth + 1, subFrustum));
+      auto& segment = world.segments[portal.segment];
+      portals.push_back({segment.a, segment.b, portal.destCell});
     }
+    r.addCell(portals);
   }
-
   return r;
 }
 
-std::vector<int> computeListOfVisibleCells(const World& world, int fromCell, Vec2 pos)
-{
-  return computeListOfVisibleCellsAux(world, fromCell, pos, 0, {});
-}
-
 struct Collide2DApp : IApp
 {
   Collide2DApp()
   {
     world = createWorld();
+    portalWorld = createPortalWorld(world);
+    pvs = computePotentiallyVisibleSet(portalWorld);
+    visibleCells.resize(world.cells.size());
 
     pos = Vec2(0, 0);
   }
@@ -376,10 +277,10 @@ struct Collide2DApp : IApp
     static const auto colorCount = sizeof(colors) / sizeof(*colors);
 
     frustums.clear();
-    auto visibleCells = computeListOfVisibleCells(world, currCell, pos);
+    const int visibleCount = computeVisibleCells(portalWorld, &pvs, currCell, pos, scratch, visibleCells, &frustums);
     std::vector<char> visible(world.cells.size());
-    for(auto& cellIdx : visibleCells)
-      visible[cellIdx] = true;
+    for(int i = 0; i < visibleCount; ++i)
+      visible[visibleCells[i]] = true;
 
     for(auto& frustum : frustums)
       drawFrustum(drawer, frustum);
@@ -415,6 +316,12 @@ struct Collide2DApp : IApp
     char buf[256];
     sprintf(buf, "Current cell: %d", currCell);
     drawer->text({-7, -10}, buf);
+
+    int potentiallyVisibleCount = 0;
+    for(int cellIdx = 0; cellIdx < pvs.cellCount; ++cellIdx)
+      potentiallyVisibleCount += pvs.isVisible(currCell, cellIdx);
+    sprintf(buf, "Visible cells: %d (potentially: %d)", visibleCount, potentiallyVisibleCount);
+    drawer->text({-7, -11}, buf);
   }
 
   struct HalfLine
@@ -423,7 +330,7 @@ struct Collide2DApp : IApp
     Vec2 tangent;
   };
 
-  static void drawFrustum(IDrawer* drawer, const Frustum& frustum)
+  static void drawFrustum(IDrawer* drawer, const PortalFrustum& frustum)
   {
     {
       auto point = frustum.a.normal * frustum.a.dist;
@@ -471,6 +378,11 @@ struct Collide2DApp : IApp
 
   bool keyState[128]{};
   World world{};
+  PortalWorld portalWorld;
+  PotentiallyVisibleSet pvs;
+  VisibilityScratch scratch;
+  std::vector<int> visibleCells;
+  std::vector<PortalFrustum> frustums;
   Vec2 pos;
   int currCell = 0;
 };
@@ -32,6 +32,18 @@ struct RandomPolygon
   }
 };
 
-IApp* create() { return createAlgorithmApp(std::make_unique<ConcreteAlgorithm<RandomPolygon>>()); }
-const int reg = registerApp("RandomPolygon", &create);
+// Stress input for the polygon algorithms
+struct LargeRandomPolygon : RandomPolygon
+{
+  static Polygon2f execute(int /*input*/) { return createLargeRandomPolygon2f(10000); }
+};
+
+template<typename Algorithm>
+IApp* create()
+{
+  return createAlgorithmApp(std::make_unique<ConcreteAlgorithm<Algorithm>>());
+}
+
+const int reg = registerApp("RandomPolygon", &create<RandomPolygon>);
+const int regLarge = registerApp("RandomPolygon.Large", &create<LargeRandomPolygon>);
 }
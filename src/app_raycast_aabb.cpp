@@ -11,16 +11,17 @@
 #include "core/drawer.h"
 #include "core/geom.h"
 
+#include <cstdio>
+#include <vector>
+
 #include "bounding_box.h"
 #include "random.h"
+#include "ray_boxes.h"
 
 namespace
 {
-
-float g_enter = 0;
-float g_leave = 1;
-
-float raycast(Vec2 start, Vec2 target, BoundingBox aabb)
+// 'enter' and 'leave' receive the fractions of the segment where the line enters and leaves the box
+float raycast(Vec2 start, Vec2 target, BoundingBox aabb, float& enter, float& leave)
 {
   const float tx0 = (aabb.min.x - start.x) / (target.x - start.x);
   const float tx1 = (aabb.max.x - start.x) / (target.x - start.x);
@@ -34,11 +35,8 @@ float raycast(Vec2 start, Vec2 target, BoundingBox aabb)
   const float ty_min = std::min(ty0, ty1);
   const float ty_max = std::max(ty0, ty1);
 
-  const auto enter = std::max(tx_min, ty_min);
-  const auto leave = std::min(tx_max, ty_max);
-
-  g_enter = enter;
-  g_leave = leave;
+  enter = std::max(tx_min, ty_min);
+  leave = std::min(tx_max, ty_max);
 
   if(enter < 0 && leave < 0)
     return 1; // the box is completely behind the ray
@@ -89,11 +87,11 @@ struct RaycastAgainstAABB : IApp
 
     auto delta = rayTarget - rayStart;
 
-    drawer->text(rayStart + delta * g_enter + Vec2{0, 0.5f}, "enter", Yellow);
-    drawCross(drawer, rayStart + delta * g_enter, Yellow);
+    drawer->text(rayStart + delta * enter + Vec2{0, 0.5f}, "enter", Yellow);
+    drawCross(drawer, rayStart + delta * enter, Yellow);
 
-    drawer->text(rayStart + delta * g_leave + Vec2{0, 0.5f}, "leave", Yellow);
-    drawCross(drawer, rayStart + delta * g_leave, Yellow);
+    drawer->text(rayStart + delta * leave + Vec2{0, 0.5f}, "leave", Yellow);
+    drawCross(drawer, rayStart + delta * leave, Yellow);
 
     // draw start, target, and finish positions
     drawer->text(rayStart, "start", Green);
@@ -146,9 +144,9 @@ struct RaycastAgainstAABB : IApp
     compute();
   }
 
-  void compute()
+  virtual void compute()
   {
-    rayRatio = raycast(rayStart, rayTarget, aabb);
+    rayRatio = raycast(rayStart, rayTarget, aabb, enter, leave);
     rayFinish = rayStart * (1 - rayRatio) + rayTarget * rayRatio;
   }
 
@@ -157,10 +155,77 @@ struct RaycastAgainstAABB : IApp
   Vec2 rayTarget; // the target position
   Vec2 rayFinish; // the finish position
   float rayRatio; // the amount of move we can do
+  float enter = 0; // where the line enters the box (fraction of the move)
+  float leave = 1; // where the line leaves the box (fraction of the move)
 
   int currentSelection = 0;
 };
 
-IApp* create() { return new RaycastAgainstAABB; }
-const int registered = registerApp("RaycastAgainstAABB", &create);
+// The same ray against many boxes, all tested at once
+struct RaycastAgainstManyAABBs : RaycastAgainstAABB
+{
+  RaycastAgainstManyAABBs()
+  {
+    for(int i = 0; i < 64; ++i)
+    {
+      BoundingBox box;
+      box.min = randomPos({-20, -10}, {18, 8});
+      box.max = box.min + randomPos({0.5, 0.5}, {2, 2});
+      boxes.push_back(box);
+    }
+
+    enters.resize(boxes.size());
+    leaves.resize(boxes.size());
+    compute();
+  }
+
+  void draw(IDrawer* drawer) override
+  {
+    for(int i = 0; i < (int)boxes.size(); ++i)
+    {
+      const BoundingBox box = boxes[i];
+      drawer->rect(box.min, box.max - box.min, enters[i] <= leaves[i] ? Yellow : White);
+    }
+
+    drawer->line(rayStart, rayTarget, hitCount ? Red : White);
+    drawer->line(rayStart, rayFinish, Green);
+    drawCross(drawer, rayFinish, Green);
+
+    char buf[256];
+    sprintf(buf, "%d boxes hit", hitCount);
+    drawer->text(rayStart, buf, Green);
+  }
+
+  void compute() override
+  {
+    if(enters.size() != boxes.size())
+      return; // still in the base constructor
+
+    const Vec2 invDir = safeInverse(rayTarget - rayStart);
+    hitCount = intersectRayBoxes(boxes, rayStart, invDir, 0, 1, enters, leaves);
+
+    rayRatio = 1;
+    for(int i = 0; i < (int)boxes.size(); ++i)
+    {
+      if(enters[i] <= leaves[i])
+        rayRatio = std::min(rayRatio, enters[i]);
+    }
+
+    rayFinish = rayStart * (1 - rayRatio) + rayTarget * rayRatio;
+  }
+
+  BoxArray boxes;
+  std::vector<float> enters;
+  std::vector<float> leaves;
+  int hitCount = 0;
+};
+
+template<typename App>
+IApp* create()
+{
+  return new App;
+}
+
+const int registered = registerApp("RaycastAgainstAABB", &create<RaycastAgainstAABB>);
+const int registeredMany = registerApp("RaycastAgainstAABB.Many", &create<RaycastAgainstManyAABBs>);
 }
@@ -11,43 +11,30 @@
 #include "core/drawer.h"
 #include "core/geom.h"
 
-#include <cassert>
 #include <cmath>
 #include <vector>
 
+#include "convex_csg.h"
 #include "random.h"
 
 namespace
 {
 
-struct Hyperplane
-{
-  Vec2 normal;
-  float dist;
-};
-
+// The planes are relative to 'pos'
 struct ConvexPolygon
 {
   Vec2 pos;
-  std::vector<Hyperplane> planes;
+  std::vector<Plane> planes;
 };
 
-std::vector<ConvexPolygon> subtract(ConvexPolygon minuend, const ConvexPolygon& subtrahend)
+void toConvexSet(const ConvexPolygon& polygon, ConvexSet& set, std::vector<Plane>& planes)
 {
-  std::vector<ConvexPolygon> fragments;
-
-  // iteratively cut 'minuend' according to the planes of 'subtrahend'
-  for(auto& sub : subtrahend.planes)
-  {
-    // frag is the convex in-front-of the cutting plane
-    ConvexPolygon frag = minuend;
-    frag.planes.push_back({-sub.normal, -sub.dist - dotProduct(subtrahend.pos - minuend.pos, sub.normal)});
-    fragments.push_back(frag);
+  planes.clear();
+  for(auto& plane : polygon.planes)
+    planes.push_back({plane.normal, plane.dist + dotProduct(plane.normal, polygon.pos)});
 
-    // minuend becomes the convex behind the cutting plane
-    minuend.planes.push_back({sub.normal, sub.dist + dotProduct(subtrahend.pos - minuend.pos, sub.normal)});
-  }
-  return fragments;
+  set.clear();
+  set.addHalfPlanes(planes);
 }
 
 ConvexPolygon randomPolygon()
@@ -61,7 +48,7 @@ ConvexPolygon randomPolygon()
   for(int i = 0; i < N; ++i)
   {
     const auto angle = i * M_PI * 2.0 / N + tilting + randomFloat(-0.3, 0.3);
-    Hyperplane p;
+    Plane p;
     p.dist = dist + randomFloat(-3.0f, 3.0f);
     p.normal.x = cos(angle);
     p.normal.y = sin(angle);
@@ -72,77 +59,6 @@ ConvexPolygon randomPolygon()
   return r;
 }
 
-struct HyperFace
-{
-  Vec2 a, b;
-};
-
-std::vector<HyperFace> clip(const std::vector<HyperFace>& faces, const Hyperplane& plane)
-{
-  std::vector<HyperFace> r;
-
-  std::vector<Vec2> orphans;
-
-  for(auto f : faces)
-  {
-    const auto dist_a = dotProduct(f.a, plane.normal) - plane.dist;
-    const auto dist_b = dotProduct(f.b, plane.normal) - plane.dist;
-
-    if(dist_a > 0 && dist_b > 0)
-      continue; // all outside: discard
-
-    if(dist_a < 0 && dist_b < 0)
-    {
-      r.push_back(f); // all inside: the face doesn't intersect the plane
-      continue;
-    }
-
-    const auto intersection = f.a + (f.b - f.a) * (dist_a / (dist_a - dist_b));
-
-    if(dist_a < 0 && dist_b > 0)
-    {
-      r.push_back({f.a, intersection});
-      orphans.push_back(intersection);
-      continue;
-    }
-
-    if(dist_a > 0 && dist_b < 0)
-    {
-      r.push_back({f.b, intersection});
-      orphans.push_back(intersection);
-      continue;
-    }
-  }
-
-  if(orphans.size())
-  {
-    assert(orphans.size() == 2);
-    r.push_back({orphans[0], orphans[1]});
-  }
-
-  return r;
-}
-
-std::vector<HyperFace> tesselate(const ConvexPolygon& polygon)
-{
-  std::vector<HyperFace> r;
-
-  // make an infinite box
-  {
-    const float max = +200;
-    const float min = -200;
-    r.push_back({{min, min}, {max, min}});
-    r.push_back({{max, min}, {max, max}});
-    r.push_back({{max, max}, {min, max}});
-    r.push_back({{min, max}, {min, min}});
-  }
-
-  for(auto& plane : polygon.planes)
-    r = clip(r, {plane.normal, plane.dist + dotProduct(plane.normal, polygon.pos)});
-
-  return r;
-}
-
 struct SubtractApp : IApp
 {
   SubtractApp()
@@ -156,69 +72,32 @@ struct SubtractApp : IApp
 
   void draw(IDrawer* drawer) override
   {
-    drawPolygon(drawer, m_a, Red);
-    drawPolygon(drawer, m_b, Green);
+    toConvexSet(m_a, m_setA, m_planes);
+    toConvexSet(m_b, m_setB, m_planes);
 
-    for(auto& frag : subtract(m_a, m_b))
-      drawPolygon(drawer, frag, Yellow);
+    subtract(m_setA, m_setB, m_fragments, m_buffers);
+    mergeFragments(m_fragments, m_buffers);
 
-    if(0)
-      drawClipTest(drawer);
+    drawConvexSet(drawer, m_setA, Red);
+    drawConvexSet(drawer, m_setB, Green);
+    drawConvexSet(drawer, m_fragments, Yellow);
   }
 
-  void drawClipTest(IDrawer* drawer)
+  void drawConvexSet(IDrawer* drawer, const ConvexSet& set, Color color)
   {
-    std::vector<HyperFace> faces;
-
-    {
-      const float max = +15; // +1.0 / 0.0;
-      const float min = -15; // -1.0 / 0.0;
-      faces.push_back({{min, min}, {max, min}});
-      faces.push_back({{max, min}, {max, max}});
-      faces.push_back({{max, max}, {min, max}});
-      faces.push_back({{min, max}, {min, min}});
-    }
-
-    Hyperplane plane;
-    static float m_angle = 0;
-    m_angle += 0.01;
-    plane.normal.x = cos(m_angle);
-    plane.normal.y = sin(m_angle);
-    plane.dist = (sin(m_angle * 3.0) + 1.0) * 2.5;
-    const auto clippedFaces = clip(faces, plane);
-
-    for(auto& face : faces)
-    {
-      drawer->line(face.a, face.b, Blue);
-      drawCross(drawer, face.a, Blue);
-      drawCross(drawer, face.b, Blue);
-    }
-
-    for(auto& face : clippedFaces)
+    for(int i = 0; i < set.size(); ++i)
     {
-      drawer->line(face.a, face.b, Yellow);
-      drawCross(drawer, face.a, Yellow);
-      drawCross(drawer, face.b, Yellow);
-    }
-  }
+      const auto vertices = set.verticesOf(i);
 
-  void drawPolygon(IDrawer* drawer, const ConvexPolygon& poly, Color color)
-  {
-    if(0)
-      for(auto& plane : poly.planes)
-        drawer->line(poly.pos, poly.pos + plane.normal * plane.dist, color);
+      Vec2 center{};
+      for(auto v : vertices)
+        center += v;
+      center = center * (1.0 / vertices.len);
+      drawCross(drawer, center, color);
 
-    auto faces = tesselate(poly);
-    Vec2 center{};
-    for(auto& v : faces)
-    {
-      center += v.a;
-      center += v.b;
+      for(int k = 0; k < (int)vertices.len; ++k)
+        drawer->line(vertices[k], vertices[(k + 1) % vertices.len], color);
     }
-    center = center * (1.0 / (faces.size() * 2));
-    drawCross(drawer, center, color);
-    for(auto& face : faces)
-      drawer->line(face.a, face.b, color);
   }
 
   void drawCross(IDrawer* drawer, Vec2 pos, Color color)
@@ -255,6 +134,11 @@ struct SubtractApp : IApp
   }
 
   ConvexPolygon m_a, m_b;
+
+  // kept from one frame to the next, to avoid allocations
+  ConvexSet m_setA, m_setB, m_fragments;
+  ConvexCsgBuffers m_buffers;
+  std::vector<Plane> m_planes;
 };
 
 const int registered = registerApp("App.Subtract", []() -> IApp* { return new SubtractApp; });
@@ -18,6 +18,7 @@
 
 #include "bounding_box.h"
 #include "random.h"
+#include "stroke_polyline.h"
 
 namespace
 {
@@ -137,6 +138,50 @@ struct ThickLineAlgorithm
   }
 };
 
-IApp* create() { return createAlgorithmApp(std::make_unique<ConcreteAlgorithm<ThickLineAlgorithm>>()); }
-const int registered = registerApp("ThickLine", &create);
+// The library version: an indexed triangle mesh, with joins and caps
+template<LineJoin Join, LineCap Cap>
+struct StrokeAlgorithm
+{
+  static ThickLineAlgorithm::Input generateInput() { return ThickLineAlgorithm::generateInput(); }
+
+  static StrokeMesh execute(ThickLineAlgorithm::Input input)
+  {
+    StrokeOptions options;
+    options.halfWidth = input.thickness;
+    options.join = Join;
+    options.cap = Cap;
+
+    const int start[] = {0, (int)input.polyline.size()};
+
+    StrokeMesh mesh;
+    strokePolylines(input.polyline, start, options, mesh);
+    return mesh;
+  }
+
+  static void display(const ThickLineAlgorithm::Input& input, const StrokeMesh& output)
+  {
+    for(int i = 0; i + 2 < (int)output.indices.size(); i += 3)
+    {
+      const Vec2 a = output.vertices[output.indices[i + 0]];
+      const Vec2 b = output.vertices[output.indices[i + 1]];
+      const Vec2 c = output.vertices[output.indices[i + 2]];
+      sandbox_line(a, b, Green);
+      sandbox_line(b, c, Green);
+      sandbox_line(c, a, Green);
+    }
+
+    for(int i = 1; i < (int)input.polyline.size(); ++i)
+      sandbox_line(input.polyline[i - 1], input.polyline[i], Yellow);
+  }
+};
+
+template<typename Algorithm>
+IApp* create()
+{
+  return createAlgorithmApp(std::make_unique<ConcreteAlgorithm<Algorithm>>());
+}
+
+const int registered = registerApp("ThickLine", &create<ThickLineAlgorithm>);
+const int registeredMesh = registerApp("ThickLine.Mesh", &create<StrokeAlgorithm<LineJoin::Miter, LineCap::Butt>>);
+const int registeredRound = registerApp("ThickLine.Round", &create<StrokeAlgorithm<LineJoin::Round, LineCap::Round>>);
 }
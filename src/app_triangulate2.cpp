@@ -18,6 +18,7 @@
 #include <memory>
 #include <vector>
 
+#include "predicates.h"
 #include "random.h"
 
 namespace
@@ -34,8 +35,6 @@ struct Edge
   int a, b;
 };
 
-float det2d(Vec2 a, Vec2 b) { return a.x * b.y - a.y * b.x; }
-
 struct HalfEdge
 {
   int point;
@@ -115,7 +114,7 @@ std::vector<Edge> triangulate(span<const Vec2> points)
   // bootstrap triangulation with first triangle
   {
     // make the triangle CCW if needed
-    if(det2d(points[1] - points[0], points[2] - points[0]) > 0)
+    if(orient2d(points[0], points[1], points[2]) > 0)
     {
       addHalfEdge(/*P*/ 0, /*E*/ 1);
       addHalfEdge(/*P*/ 1, /*E*/ 2);
@@ -195,7 +194,7 @@ std::vector<Edge> triangulate(span<const Vec2> points)
 
       assert(currHe.twin == -1); // make sure we stay on the hull
 
-      if(det2d(p - a, b - a) > 0)
+      if(orient2d(a, b, p) < 0)
       {
         sandbox_printf("   Linking point\n");
         const int e0 = (int)he.size() + 0;
@@ -256,8 +255,7 @@ struct TriangulateAlgorithm
   {
     std::vector<Vec2> r(7);
 
-    for(auto& p : r)
-      p = randomPos({-20, -10}, {20, 10});
+    randomFill(r, {-20, -10}, {20, 10});
 
     // sort points from left to right
     {
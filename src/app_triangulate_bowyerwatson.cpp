@@ -11,29 +11,38 @@
 #include "core/algorithm_app.h"
 #include "core/sandbox.h"
 
+#include <cmath>
 #include <cstdio> // sprintf
 #include <vector>
 
+#include "datasets.h"
 #include "random.h"
 #include "triangulate_bowyerwatson.h"
 
 namespace
 {
+template<std::vector<Edge> (*Triangulate)(span<const Vec2>)>
 struct BowyerWatsonTriangulationAlgorithm
 {
-  static std::vector<Vec2> generateInput()
+  static std::vector<Vec2> generateInput() { return generateInput(15); }
+
+  static std::vector<Vec2> generateInput(int size)
   {
-    std::vector<Vec2> r(15);
+    // keep the point density of the default input
+    const float scale = std::sqrt(size / 15.0f);
+
+    std::vector<Vec2> r(size);
 
-    for(auto& p : r)
-      p = randomPos({-20, -10}, {20, 10});
+    randomFill(r, Vec2(-20, -10) * scale, Vec2(20, 10) * scale);
 
     return r;
   }
 
+  static std::vector<Vec2> loadDataset(const std::string& path) { return loadPoints(path); }
+
   static std::vector<Edge> execute(std::vector<Vec2> input)
   {
-    auto result = triangulate_BowyerWatson({input.size(), input.data()});
+    auto result = Triangulate({input.size(), input.data()});
     sandbox_printf("Triangulated, %d edges\n", (int)result.size());
     return result;
   }
@@ -56,6 +65,12 @@ struct BowyerWatsonTriangulationAlgorithm
   }
 };
 
-IApp* create() { return createAlgorithmApp(std::make_unique<ConcreteAlgorithm<BowyerWatsonTriangulationAlgorithm>>()); }
-const int reg = registerApp("Triangulation.BowyerWatson", &create);
+template<std::vector<Edge> (*Triangulate)(span<const Vec2>)>
+IApp* create()
+{
+  return createAlgorithmApp(std::make_unique<ConcreteAlgorithm<BowyerWatsonTriangulationAlgorithm<Triangulate>>>());
+}
+
+const int reg = registerApp("Triangulation.BowyerWatson", &create<triangulate_BowyerWatson>);
+const int regFast = registerApp("Triangulation.BowyerWatson.Fast", &create<triangulate_BowyerWatsonFast>);
 }
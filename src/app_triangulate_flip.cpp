@@ -10,29 +10,43 @@
 #include "core/algorithm_app.h"
 #include "core/sandbox.h"
 
+#include <cmath>
 #include <cstdio> // sprintf
 #include <vector>
 
+#include "datasets.h"
 #include "random.h"
 #include "triangulate_flip.h"
 
 namespace
 {
+std::vector<Edge> triangulate_FlipParallel(span<const Vec2> points)
+{
+  return computeEdges(triangulateMesh_FlipParallel(points, 0));
+}
+
+template<std::vector<Edge> (*Triangulate)(span<const Vec2>)>
 struct FlipTriangulationAlgorithm
 {
-  static std::vector<Vec2> generateInput()
+  static std::vector<Vec2> generateInput() { return generateInput(15); }
+
+  static std::vector<Vec2> generateInput(int size)
   {
-    std::vector<Vec2> r(15);
+    // keep the point density of the default input
+    const float scale = std::sqrt(size / 15.0f);
+
+    std::vector<Vec2> r(size);
 
-    for(auto& p : r)
-      p = randomPos({-20, -10}, {20, 10});
+    randomFill(r, Vec2(-20, -10) * scale, Vec2(20, 10) * scale);
 
     return r;
   }
 
+  static std::vector<Vec2> loadDataset(const std::string& path) { return loadPoints(path); }
+
   static std::vector<Edge> execute(std::vector<Vec2> input)
   {
-    auto result = triangulate_Flip({input.size(), input.data()});
+    auto result = Triangulate({input.size(), input.data()});
     sandbox_printf("Triangulated, %d edges\n", (int)result.size());
     return result;
   }
@@ -55,6 +69,12 @@ struct FlipTriangulationAlgorithm
   }
 };
 
-IApp* create() { return createAlgorithmApp(std::make_unique<ConcreteAlgorithm<FlipTriangulationAlgorithm>>()); }
-const int reg = registerApp("Triangulation.Flip", &create);
+template<std::vector<Edge> (*Triangulate)(span<const Vec2>)>
+IApp* create()
+{
+  return createAlgorithmApp(std::make_unique<ConcreteAlgorithm<FlipTriangulationAlgorithm<Triangulate>>>());
+}
+
+const int reg = registerApp("Triangulation.Flip", &create<triangulate_Flip>);
+const int regParallel = registerApp("Triangulation.Flip.Parallel", &create<triangulate_FlipParallel>);
 } // namespace
@@ -0,0 +1,268 @@
+#include "baked.h"
+
+#include <cstdio>
+#include <cstring>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+const uint32_t BvhMagic = 0x56425347; // "GSBV"
+const uint32_t BspMagic = 0x53425347; // "GSBS"
+const size_t SectionAlignment = 32;
+
+struct Header
+{
+  uint32_t magic;
+  uint32_t version;
+  uint64_t size; // of the whole block
+  uint32_t sectionCount;
+  uint32_t padding;
+};
+
+struct Section
+{
+  uint64_t offset; // from the start of the block
+  uint64_t count;
+  uint64_t elementSize;
+};
+
+size_t alignUp(size_t n) { return (n + SectionAlignment - 1) / SectionAlignment * SectionAlignment; }
+
+struct SectionData
+{
+  const void* data;
+  size_t count;
+  size_t elementSize;
+};
+
+template<typename T>
+SectionData section(span<const T> s)
+{
+  return {s.ptr, s.len, sizeof(T)};
+}
+
+std::vector<uint8_t> bake(uint32_t magic, span<const SectionData> sections)
+{
+  size_t size = alignUp(sizeof(Header) + sizeof(Section) * sections.len);
+  for(auto& s : sections)
+    size = alignUp(size + s.count * s.elementSize);
+
+  std::vector<uint8_t> r(size);
+
+  Header header{};
+  header.magic = magic;
+  header.version = BakedVersion;
+  header.size = size;
+  header.sectionCount = sections.len;
+  memcpy(r.data(), &header, sizeof header);
+
+  size_t offset = alignUp(sizeof(Header) + sizeof(Section) * sections.len);
+  for(int i = 0; i < (int)sections.len; ++i)
+  {
+    const auto& s = sections[i];
+    const Section entry{offset, s.count, s.elementSize};
+    memcpy(r.data() + sizeof(Header) + sizeof(Section) * i, &entry, sizeof entry);
+
+    if(s.count)
+      memcpy(r.data() + offset, s.data, s.count * s.elementSize);
+    offset = alignUp(offset + s.count * s.elementSize);
+  }
+
+  return r;
+}
+
+// Checks the header and the section table, and gives the address of each section
+bool load(span<const uint8_t> data, uint32_t magic, span<SectionData> sections)
+{
+  if(data.len < sizeof(Header) || uintptr_t(data.ptr) % SectionAlignment)
+    return false;
+
+  Header header;
+  memcpy(&header, data.ptr, sizeof header);
+
+  if(header.magic != magic || header.version != BakedVersion || header.size > data.len ||
+        header.sectionCount != sections.len || sizeof(Header) + sizeof(Section) * sections.len > header.size)
+    return false;
+
+  for(int i = 0; i < (int)sections.len; ++i)
+  {
+    Section entry;
+    memcpy(&entry, data.ptr + sizeof(Header) + sizeof(Section) * i, sizeof entry);
+
+    if(entry.elementSize != sections[i].elementSize || entry.offset % SectionAlignment ||
+          entry.offset > header.size || entry.count > (header.size - entry.offset) / entry.elementSize)
+      return false;
+
+    sections[i].data = data.ptr + entry.offset;
+    sections[i].count = entry.count;
+  }
+
+  return true;
+}
+
+template<typename T>
+span<const T> view(const SectionData& s)
+{
+  return {s.count, (const T*)s.data};
+}
+}
+
+std::vector<uint8_t> bakeBvh(const FlatBvhView& bvh)
+{
+  const SectionData sections[] = {section(bvh.nodes), section(bvh.objects)};
+  return bake(BvhMagic, sections);
+}
+
+std::vector<uint8_t> bakeBsp(const CompiledBspView& bsp)
+{
+  const SectionData sections[] = {
+        section(bsp.normalX),
+        section(bsp.normalY),
+        section(bsp.dist),
+        section(bsp.posChild),
+        section(bsp.negChild),
+  };
+  return bake(BspMagic, sections);
+}
+
+bool loadBakedBvh(span<const uint8_t> data, FlatBvhView& bvh)
+{
+  SectionData sections[] = {{nullptr, 0, sizeof(FlatBvhNode)}, {nullptr, 0, sizeof(int)}};
+  if(!load(data, BvhMagic, sections))
+    return false;
+
+  bvh.nodes = view<FlatBvhNode>(sections[0]);
+  bvh.objects = view<int>(sections[1]);
+  return true;
+}
+
+bool loadBakedBsp(span<const uint8_t> data, CompiledBspView& bsp)
+{
+  SectionData sections[5];
+  for(auto& s : sections)
+    s = {nullptr, 0, 4};
+
+  if(!load(data, BspMagic, sections))
+    return false;
+
+  // all the arrays are indexed by node
+  for(auto& s : sections)
+  {
+    if(s.count != sections[0].count)
+      return false;
+  }
+
+  bsp.normalX = view<float>(sections[0]);
+  bsp.normalY = view<float>(sections[1]);
+  bsp.dist = view<float>(sections[2]);
+  bsp.posChild = view<int>(sections[3]);
+  bsp.negChild = view<int>(sections[4]);
+  return true;
+}
+
+bool writeFile(const char* path, span<const uint8_t> data)
+{
+  FILE* fp = fopen(path, "wb");
+  if(!fp)
+    return false;
+
+  const bool ok = fwrite(data.ptr, 1, data.len, fp) == data.len;
+  return fclose(fp) == 0 && ok;
+}
+
+MappedFile::~MappedFile() { close(); }
+
+#ifdef _WIN32
+
+bool MappedFile::open(const char* path)
+{
+  close();
+
+  HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+  if(file == INVALID_HANDLE_VALUE)
+    return false;
+
+  LARGE_INTEGER size;
+  if(!GetFileSizeEx(file, &size) || size.QuadPart == 0)
+  {
+    CloseHandle(file);
+    return false;
+  }
+
+  // the mapping keeps the file open
+  HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+  CloseHandle(file);
+  if(!mapping)
+    return false;
+
+  m_data = (const uint8_t*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+  if(!m_data)
+  {
+    CloseHandle(mapping);
+    return false;
+  }
+
+  m_handle = mapping;
+  m_size = size.QuadPart;
+  return true;
+}
+
+void MappedFile::close()
+{
+  if(m_data)
+  {
+    UnmapViewOfFile(m_data);
+    CloseHandle(m_handle);
+  }
+
+  m_data = nullptr;
+  m_size = 0;
+  m_handle = nullptr;
+}
+
+#else
+
+bool MappedFile::open(const char* path)
+{
+  close();
+
+  const int fd = ::open(path, O_RDONLY);
+  if(fd < 0)
+    return false;
+
+  struct stat st;
+  if(fstat(fd, &st) != 0 || st.st_size == 0)
+  {
+    ::close(fd);
+    return false;
+  }
+
+  // the mapping stays valid after closing the file
+  void* p = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  ::close(fd);
+  if(p == MAP_FAILED)
+    return false;
+
+  m_data = (const uint8_t*)p;
+  m_size = st.st_size;
+  return true;
+}
+
+void MappedFile::close()
+{
+  if(m_data)
+    munmap((void*)m_data, m_size);
+
+  m_data = nullptr;
+  m_size = 0;
+}
+
+#endif
@@ -0,0 +1,57 @@
+#pragma once
+
+// Baked hierarchies: a FlatBvh or a CompiledBsp serialized to a single relocatable block of memory
+// (offsets instead of pointers), which can be saved offline, then memory-mapped and queried in place,
+// without parsing or allocating anything:
+//
+//   MappedFile file;
+//   FlatBvhView bvh;
+//   if(file.open("level.bvh") && loadBakedBvh(file.data(), bvh))
+//     raycast(bvh, ...);
+//
+// Layout: a header (magic, version, total size, section count), a table of sections
+// (offset, element count, element size), then the sections themselves, each one aligned on 32 bytes.
+// Everything is stored in the byte order of the baking machine: loading it on a machine
+// with another byte order fails (as does loading another version).
+
+#include "core/geom.h"
+
+#include <cstdint>
+#include <vector>
+
+#include "bsp.h"
+#include "bvh.h"
+
+const uint32_t BakedVersion = 1;
+
+std::vector<uint8_t> bakeBvh(const FlatBvhView& bvh);
+std::vector<uint8_t> bakeBsp(const CompiledBspView& bsp);
+
+// Points the view into 'data', which must outlive it, and be aligned on 32 bytes (as a mapped file is).
+// Returns false if 'data' doesn't hold a hierarchy of this type and version.
+// Only the header is checked: the contents are trusted.
+bool loadBakedBvh(span<const uint8_t> data, FlatBvhView& bvh);
+bool loadBakedBsp(span<const uint8_t> data, CompiledBspView& bsp);
+
+bool writeFile(const char* path, span<const uint8_t> data);
+
+// Read-only memory mapping of a whole file
+class MappedFile
+{
+  public:
+  MappedFile() = default;
+  ~MappedFile();
+
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+
+  bool open(const char* path);
+  void close();
+
+  span<const uint8_t> data() const { return {m_size, m_data}; }
+
+  private:
+  const uint8_t* m_data = nullptr;
+  size_t m_size = 0;
+  void* m_handle = nullptr; // Windows only: the mapping object
+};
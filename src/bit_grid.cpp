@@ -0,0 +1,24 @@
+#include "bit_grid.h"
+
+#include <algorithm>
+#include <bitset>
+
+BitGrid::BitGrid(int width_, int height_) { resize(width_, height_); }
+
+void BitGrid::resize(int width_, int height_)
+{
+  width = width_;
+  height = height_;
+  wordsPerRow = (width + 63) / 64;
+  words.assign(size_t(wordsPerRow) * height, 0);
+}
+
+void BitGrid::clear() { std::fill(words.begin(), words.end(), 0); }
+
+int BitGrid::count() const
+{
+  int r = 0;
+  for(auto word : words)
+    r += int(std::bitset<64>(word).count());
+  return r;
+}
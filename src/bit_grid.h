@@ -0,0 +1,29 @@
+#pragma once
+
+// Grids of bits (masks, occupancy ...). The cell (x, y) covers [x; x + 1[ * [y; y + 1[.
+
+#include <cstdint>
+#include <vector>
+
+// One bit per cell, 64 cells per word, row by row
+struct BitGrid
+{
+  int width = 0;
+  int height = 0;
+  int wordsPerRow = 0;
+  std::vector<uint64_t> words;
+
+  BitGrid() = default;
+  BitGrid(int width, int height);
+
+  // all the cells become clear
+  void resize(int width, int height);
+  void clear();
+
+  bool contains(int x, int y) const { return unsigned(x) < unsigned(width) && unsigned(y) < unsigned(height); }
+  bool get(int x, int y) const { return (words[y * wordsPerRow + (x >> 6)] >> (x & 63)) & 1; }
+  bool test(int x, int y) const { return contains(x, y) && get(x, y); } // clear outside of the grid
+  void set(int x, int y) { words[y * wordsPerRow + (x >> 6)] |= uint64_t(1) << (x & 63); }
+
+  int count() const;
+};
@@ -22,3 +22,13 @@ struct BoundingBox
 
   Vec2 min, max;
 };
+
+inline bool overlaps(const BoundingBox& a, const BoundingBox& b)
+{
+  return a.min.x <= b.max.x && b.min.x <= a.max.x && a.min.y <= b.max.y && b.min.y <= a.max.y;
+}
+
+inline bool contains(const BoundingBox& box, Vec2 p)
+{
+  return box.min.x <= p.x && p.x <= box.max.x && box.min.y <= p.y && p.y <= box.max.y;
+}
@@ -1,11 +1,18 @@
 #include "bsp.h"
 
+#include "core/arena.h"
 #include "core/sandbox.h"
+#include "core/zones.h"
 
+#include <algorithm>
 #include <cassert>
+#include <chrono>
 #include <cmath>
 
+#include "morton.h"
+#include "parallel.h"
 #include "polygon.h"
+#include "random.h"
 
 namespace
 {
@@ -61,71 +68,159 @@ Klass classify(const BspFace& face, const Hyperplane& plane, BspFace& posFace, B
   return Klass::Split;
 }
 
-BspFace chooseSplitterFace(span<BspFace> faceList)
+struct BuildContext
 {
-  BspFace bestFace;
-  int bestScore = -1;
+  const BspBuildOptions& options;
+  const int threadCount;
+  RandomGenerator random;
+  BspBuildReport report;
+};
+
+// Size of the smallest side, minus the penalty for the split faces
+float scoreSplitter(const BspFace& splitter, span<const BspFace> faceList, float splitPenalty)
+{
+  const auto plane = Hyperplane{splitter.normal, dotProduct(splitter.normal, splitter.a)};
+
+  int frontCount = 0;
+  int backCount = 0;
+  int splitCount = 0;
 
   for(auto& face : faceList)
   {
-    int frontCount = 0;
-    int backCount = 0;
-
-    const auto plane = Hyperplane{face.normal, dotProduct(face.normal, face.a)};
+    BspFace posFace, negFace;
 
-    for(auto v : faceList)
+    switch(classify(face, plane, posFace, negFace))
     {
-      if(dotProduct(v.a, plane.normal) > plane.dist)
-        frontCount++;
-      else
-        backCount++;
+    case Klass::Coincident:
+      break;
+    case Klass::Positive:
+      frontCount++;
+      break;
+    case Klass::Negative:
+      backCount++;
+      break;
+    case Klass::Split:
+      frontCount++;
+      backCount++;
+      splitCount++;
+      break;
     }
+  }
+
+  return std::min(frontCount, backCount) - splitPenalty * splitCount;
+}
+
+BspFace chooseSplitterFace(span<BspFace> faceList, BuildContext& ctx)
+{
+  auto& options = ctx.options;
+  const int faceCount = faceList.len;
 
-    const int score = std::min(frontCount, backCount);
-    if(score > bestScore)
+  // the faces evaluated as splitters
+  ScratchScope scratch;
+  ScratchVector<int> candidates;
+
+  if(options.candidates == BspCandidates::All || faceCount <= options.candidateCount)
+  {
+    candidates.resize(faceCount);
+    for(int i = 0; i < faceCount; ++i)
+      candidates[i] = i;
+  }
+  else
+  {
+    candidates.resize(options.candidateCount);
+    for(int i = 0; i < options.candidateCount; ++i)
     {
-      bestScore = score;
-      bestFace = face;
+      if(options.candidates == BspCandidates::Sampled)
+        candidates[i] = int64_t(i) * faceCount / options.candidateCount;
+      else
+        candidates[i] = ctx.random.nextInt(0, faceCount);
     }
   }
 
-  return bestFace;
+  const span<const BspFace> faces{faceList.len, faceList.ptr};
+  ScratchVector<float> scores(candidates.size());
+  auto scoreCandidates = [&](int begin, int end)
+  {
+    for(int i = begin; i < end; ++i)
+      scores[i] = scoreSplitter(faces[candidates[i]], faces, options.splitPenalty);
+  };
+
+  const int candidateCount = candidates.size();
+
+  // not worth starting threads for small nodes
+  const int64_t work = int64_t(candidateCount) * faceCount;
+  if(ctx.threadCount > 1 && work >= 65536)
+  {
+    const int taskCount = std::min(candidateCount, ctx.threadCount * 4);
+    parallelFor(taskCount, ctx.threadCount,
+          [&](int k) { scoreCandidates(candidateCount * k / taskCount, candidateCount * (k + 1) / taskCount); });
+  }
+  else
+  {
+    scoreCandidates(0, candidateCount);
+  }
+
+  // the first of the best candidates, whatever the thread count
+  int best = 0;
+  for(int i = 1; i < candidateCount; ++i)
+  {
+    if(scores[i] > scores[best])
+      best = i;
+  }
+
+  return faceList[candidates[best]];
 }
 
-std::unique_ptr<BspNode> createBspTree(span<BspFace> faceList)
+std::unique_ptr<BspNode> createBspTree(span<BspFace> faceList, BuildContext& ctx, int depth)
 {
   if(faceList.len == 0)
     return nullptr;
 
   std::unique_ptr<BspNode> result = std::make_unique<BspNode>();
 
-  auto splitterFace = chooseSplitterFace(faceList);
+  ctx.report.nodeCount++;
+  ctx.report.depth = std::max(ctx.report.depth, depth);
+
+  BspFace splitterFace;
+
+  {
+    SANDBOX_ZONE("bsp: chooseSplitterFace");
+    splitterFace = chooseSplitterFace(faceList, ctx);
+  }
 
   result->plane.normal = splitterFace.normal;
   result->plane.dist = dotProduct(splitterFace.normal, splitterFace.a);
 
-  std::vector<BspFace> posList;
-  std::vector<BspFace> negList;
+  // the lists are only needed to build the children
+  ScratchScope scratch;
+  ScratchVector<BspFace> posList;
+  ScratchVector<BspFace> negList;
 
-  for(auto& face : faceList)
   {
-    BspFace posFace, negFace;
+    SANDBOX_ZONE("bsp: classify");
 
-    switch(classify(face, result->plane, posFace, negFace))
+    for(auto& face : faceList)
     {
-    case Klass::Coincident:
-      result->coincident.push_back(face);
-      break;
-    case Klass::Positive:
-      posList.push_back(face);
-      break;
-    case Klass::Negative:
-      negList.push_back(face);
-      break;
-    case Klass::Split:
-      posList.push_back(posFace);
-      negList.push_back(negFace);
-      break;
+      BspFace posFace, negFace;
+
+      switch(classify(face, result->plane, posFace, negFace))
+      {
+      case Klass::Coincident:
+        result->coincident.push_back(face);
+        break;
+      case Klass::Positive:
+        posList.push_back(face);
+        break;
+      case Klass::Negative:
+        negList.push_back(face);
+        break;
+      case Klass::Split:
+        posList.push_back(posFace);
+        negList.push_back(negFace);
+        ctx.report.splitCount++;
+        sandbox_count("bsp: split faces", 1);
+        break;
+      }
     }
   }
 
@@ -142,8 +237,8 @@ std::unique_ptr<BspNode> createBspTree(span<BspFace> faceList)
     sandbox_breakpoint();
   }
 
-  result->posChild = createBspTree(posList);
-  result->negChild = createBspTree(negList);
+  result->posChild = createBspTree(posList, ctx, depth + 1);
+  result->negChild = createBspTree(negList, ctx, depth + 1);
 
   return result;
 }
@@ -152,7 +247,14 @@ std::unique_ptr<BspNode> createBspTree(span<BspFace> faceList)
 
 std::unique_ptr<BspNode> createBspTree(const Polygon2f& polygon)
 {
-  std::vector<BspFace> bspFaces;
+  return createBspTree(polygon, BspBuildOptions());
+}
+
+std::unique_ptr<BspNode> createBspTree(const Polygon2f& polygon, const BspBuildOptions& options, BspBuildReport* report)
+{
+  const auto startTime = std::chrono::steady_clock::now();
+
+  ScratchVector<BspFace> bspFaces;
   for(auto& face : polygon.faces)
   {
     bspFaces.push_back({});
@@ -162,5 +264,214 @@ std::unique_ptr<BspNode> createBspTree(const Polygon2f& polygon)
     bspFace.normal = normalize(-rotateLeft(bspFace.b - bspFace.a));
   }
 
-  return createBspTree(bspFaces);
+  BuildContext ctx{options, resolveThreadCount(options.threadCount), RandomGenerator(options.seed), {}};
+  auto root = createBspTree(bspFaces, ctx, 1);
+
+  if(report)
+  {
+    *report = ctx.report;
+    report->buildTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+  }
+
+  return root;
+}
+
+CompiledBsp compileBsp(const BspNode* root)
+{
+  CompiledBsp r;
+
+  if(!root)
+    return r;
+
+  struct Pending
+  {
+    const BspNode* node;
+    int parent; // -1 for the root
+    bool positive; // which child of 'parent' this is
+  };
+
+  ScratchScope scratch;
+  ScratchVector<Pending> stack;
+  stack.push_back({root, -1, false});
+
+  while(stack.size())
+  {
+    const auto curr = stack.back();
+    stack.pop_back();
+
+    const int index = r.dist.size();
+    if(curr.parent >= 0)
+      (curr.positive ? r.posChild : r.negChild)[curr.parent] = index;
+
+    auto node = curr.node;
+    r.normalX.push_back(node->plane.normal.x);
+    r.normalY.push_back(node->plane.normal.y);
+    r.dist.push_back(node->plane.dist);
+    r.posChild.push_back(BspEmptyLeaf);
+    r.negChild.push_back(BspSolidLeaf);
+
+    // the positive child comes first, directly after its parent
+    if(node->negChild)
+      stack.push_back({node->negChild.get(), index, false});
+    if(node->posChild)
+      stack.push_back({node->posChild.get(), index, true});
+  }
+
+  return r;
+}
+
+namespace
+{
+// queries per parallel task
+const int BspBatchTaskSize = 1024;
+const int BspPointGroupSize = 8;
+
+// Calls 'query(i)' for each i in [0; count[, from 'threadCount' threads, in the Morton order of 'position(i)':
+// consecutive queries mostly visit the same nodes, which stay in cache.
+template<typename Position, typename Query>
+void runCoherently(int count, int threadCount, Position&& position, Query&& query)
+{
+  ScratchVector<Vec2> positions(count);
+  for(int i = 0; i < count; ++i)
+    positions[i] = position(i);
+
+  ScratchVector<uint32_t> codes(count);
+  computeMortonCodes(positions, codes, threadCount);
+
+  ScratchVector<int> order(count);
+  for(int i = 0; i < count; ++i)
+    order[i] = i;
+  sortByMortonCode(order, codes, threadCount);
+
+  const int taskCount = (count + BspBatchTaskSize - 1) / BspBatchTaskSize;
+  parallelFor(taskCount, threadCount,
+        [&](int task)
+        {
+          for(int i = task * BspBatchTaskSize; i < std::min(count, (task + 1) * BspBatchTaskSize); ++i)
+            query(order[i]);
+        });
+}
+}
+
+BspHit raycast(const CompiledBspView& bsp, Vec2 a, Vec2 b)
+{
+  const Vec2 delta = b - a;
+
+  BspHit hit;
+  float tBeg = 0;
+  int entryNode = -1; // the node whose plane the segment crossed at 'tBeg'
+
+  while(true)
+  {
+    // find the leaf containing the point at 'tBeg', and where the segment leaves it
+    const Vec2 p = a + delta * tBeg;
+    float tEnd = 1;
+    int exitNode = -1;
+
+    int curr = bsp.root();
+    while(curr >= 0)
+    {
+      // the positive side starts at BspEpsilon from the plane
+      const float projP = bsp.normalX[curr] * p.x + bsp.normalY[curr] * p.y - bsp.dist[curr] - BspEpsilon;
+      const float projDelta = bsp.normalX[curr] * delta.x + bsp.normalY[curr] * delta.y;
+
+      bool positive = projP >= 0;
+
+      if(positive ? projDelta < 0 : projDelta > 0)
+      {
+        const float tPlane = tBeg - projP / projDelta;
+
+        // Already leaving this side (the point is on the boundary): it belongs to the other one.
+        // This guarantees that the leaf is left strictly after 'tBeg'.
+        if(tPlane <= tBeg)
+          positive = !positive;
+        else if(tPlane < tEnd)
+        {
+          tEnd = tPlane;
+          exitNode = curr;
+        }
+      }
+
+      curr = positive ? bsp.posChild[curr] : bsp.negChild[curr];
+    }
+
+    if(curr == BspSolidLeaf)
+    {
+      hit.fraction = tBeg;
+      if(entryNode >= 0)
+        hit.normal = {bsp.normalX[entryNode], bsp.normalY[entryNode]};
+      return hit;
+    }
+
+    if(exitNode < 0)
+      return hit;
+
+    tBeg = tEnd;
+    entryNode = exitNode;
+  }
+}
+
+bool isSolid(const CompiledBspView& bsp, Vec2 p)
+{
+  int curr = bsp.root();
+
+  while(curr >= 0)
+  {
+    const float proj = bsp.normalX[curr] * p.x + bsp.normalY[curr] * p.y - bsp.dist[curr];
+    curr = proj >= BspEpsilon ? bsp.posChild[curr] : bsp.negChild[curr];
+  }
+
+  return curr == BspSolidLeaf;
+}
+
+void raycast(const CompiledBspView& bsp, span<const BspRay> rays, span<BspHit> hits, int threadCount)
+{
+  assert(hits.len == rays.len);
+
+  runCoherently(
+        rays.len, threadCount, [&](int i) { return rays[i].a; },
+        [&](int i) { hits[i] = raycast(bsp, rays[i].a, rays[i].b); });
+}
+
+void isSolid(const CompiledBspView& bsp, span<const Vec2> points, span<uint8_t> solid, int threadCount)
+{
+  assert(solid.len == points.len);
+
+  // Reordering the points costs about as much as classifying them: instead, the points of each group
+  // go down the tree together, one level per iteration, so the loads of one point hide the latency of the others.
+  const int count = points.len;
+  const int taskCount = (count + BspBatchTaskSize - 1) / BspBatchTaskSize;
+  parallelFor(taskCount, threadCount,
+        [&](int task)
+        {
+          const int end = std::min(count, (task + 1) * BspBatchTaskSize);
+          for(int first = task * BspBatchTaskSize; first < end; first += BspPointGroupSize)
+          {
+            const int groupSize = std::min(BspPointGroupSize, end - first);
+
+            int curr[BspPointGroupSize];
+            for(int i = 0; i < groupSize; ++i)
+              curr[i] = bsp.root();
+
+            bool descending = true;
+            while(descending)
+            {
+              descending = false;
+              for(int i = 0; i < groupSize; ++i)
+              {
+                const int node = curr[i];
+                if(node < 0)
+                  continue;
+
+                const Vec2 p = points[first + i];
+                const float proj = bsp.normalX[node] * p.x + bsp.normalY[node] * p.y - bsp.dist[node];
+                curr[i] = proj >= BspEpsilon ? bsp.posChild[node] : bsp.negChild[node];
+                descending = true;
+              }
+            }
+
+            for(int i = 0; i < groupSize; ++i)
+              solid[first + i] = curr[i] == BspSolidLeaf;
+          }
+        });
 }
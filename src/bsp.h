@@ -2,6 +2,7 @@
 
 #include "core/geom.h"
 
+#include <cstdint>
 #include <memory>
 #include <vector>
 
@@ -29,4 +30,108 @@ struct BspNode
   std::vector<BspFace> coincident;
 };
 
+enum class BspCandidates
+{
+  // Every face of a node is evaluated as its splitter: O(n^2) per node.
+  All,
+
+  // Only 'candidateCount' faces, evenly spread over the faces of the node.
+  Sampled,
+
+  // Only 'candidateCount' faces, drawn at random (reproducibly, from 'seed').
+  Random,
+};
+
+struct BspBuildOptions
+{
+  BspCandidates candidates = BspCandidates::All;
+  int candidateCount = 32;
+  uint64_t seed = 0;
+
+  // A splitter scores the size of its smallest side, minus 'splitPenalty' for each face it splits:
+  // above 0, balanced trees are traded for less faces (and nodes).
+  float splitPenalty = 0.0f;
+
+  // Above 1, the candidates of big nodes are scored in parallel (0: one thread per hardware thread).
+  // The tree is the same.
+  int threadCount = 1;
+};
+
+struct BspBuildReport
+{
+  int depth = 0; // the root has depth 1
+  int nodeCount = 0;
+  int splitCount = 0; // number of faces split in two
+  double buildTime = 0; // in seconds
+};
+
 std::unique_ptr<BspNode> createBspTree(const Polygon2f& polygon);
+std::unique_ptr<BspNode> createBspTree(
+      const Polygon2f& polygon, const BspBuildOptions& options, BspBuildReport* report = nullptr);
+
+// A missing positive child is an empty leaf, a missing negative child a solid leaf.
+// In the compiled form, children refer either to a node, or to one of these leaves:
+const int BspEmptyLeaf = -1;
+const int BspSolidLeaf = -2;
+
+// Non-owning view of a compiled tree, e.g on baked data (see baked.h): the queries only need this.
+struct CompiledBspView
+{
+  span<const float> normalX;
+  span<const float> normalY;
+  span<const float> dist;
+  span<const int> posChild;
+  span<const int> negChild;
+
+  // node 0, or BspEmptyLeaf if there are no nodes
+  int root() const { return dist.len == 0 ? BspEmptyLeaf : 0; }
+};
+
+// Compact layout of the tree, for queries.
+// Nodes are stored depth-first in a single array, with their planes split
+// in separate arrays (structure of arrays).
+struct CompiledBsp
+{
+  std::vector<float> normalX;
+  std::vector<float> normalY;
+  std::vector<float> dist;
+  std::vector<int> posChild;
+  std::vector<int> negChild;
+
+  int root() const { return dist.empty() ? BspEmptyLeaf : 0; }
+
+  operator CompiledBspView() const
+  {
+    return {{normalX.size(), normalX.data()}, {normalY.size(), normalY.data()}, {dist.size(), dist.data()},
+          {posChild.size(), posChild.data()}, {negChild.size(), negChild.data()}};
+  }
+};
+
+CompiledBsp compileBsp(const BspNode* root);
+
+struct BspHit
+{
+  float fraction = 1; // part of the segment before entering solid space (1 if it doesn't)
+  Vec2 normal{}; // of the plane hit (zero if there's no hit, or if the segment starts in solid space)
+};
+
+// First entry of the segment [a;b] into solid space.
+// Stackless: each time the segment leaves an empty leaf, the tree is descended again from the root,
+// for the remaining part of the segment. Nothing is allocated, and the depth of the tree isn't limited.
+BspHit raycast(const CompiledBspView& bsp, Vec2 a, Vec2 b);
+
+// Points on a plane (up to BspEpsilon) are on its negative side.
+bool isSolid(const CompiledBspView& bsp, Vec2 p);
+
+struct BspRay
+{
+  Vec2 a, b; // the segment [a;b]
+};
+
+// Batched queries, e.g for visibility checks: same results as the single queries,
+// with 'hits[i]' for 'rays[i]', and 'solid[i]' set to 1 if 'points[i]' is in solid space, 0 otherwise.
+// The rays are reordered along a Z-order curve (by their start), so that close rays, which visit mostly
+// the same nodes, run one after the other. The queries are spread on 'threadCount' threads
+// (see parallel.h: 0 means one per hardware thread).
+void raycast(const CompiledBspView& bsp, span<const BspRay> rays, span<BspHit> hits, int threadCount = 1);
+void isSolid(const CompiledBspView& bsp, span<const Vec2> points, span<uint8_t> solid, int threadCount = 1);
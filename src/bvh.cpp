@@ -1,8 +1,14 @@
 #include "bvh.h"
 
+#include "core/arena.h"
 #include "core/sandbox.h"
 
 #include <algorithm>
+#include <cstdint>
+#include <memory>
+
+#include "morton.h"
+#include "parallel.h"
 
 namespace
 {
@@ -19,10 +25,43 @@ BoundingBox computeBoundingBox(span<const BoundingBox> allObjects, span<const in
   return r;
 }
 
-void subdivide(int nodeIdx, span<const BoundingBox> allObjects, std::vector<BvhNode>& nodes)
+float halfPerimeter(const BoundingBox& box)
 {
-  auto node = &nodes[nodeIdx];
-  Vec2 size = node->boundaries.max - node->boundaries.min;
+  const auto size = box.max - box.min;
+  return size.x + size.y;
+}
+
+Vec2 center(const BoundingBox& box) { return (box.min + box.max) * 0.5f; }
+
+float coord(Vec2 v, int axis) { return axis == 0 ? v.x : v.y; }
+
+// During the build, each node refers to a range of a single shared index array,
+// and only the leaves get their own list of objects.
+struct ObjectRange
+{
+  int begin;
+  int end;
+  int depth;
+};
+
+struct BuildContext
+{
+  span<const BoundingBox> objects;
+  const BvhBuildOptions& options;
+  span<int> order;
+  span<const uint32_t> mortonCodes; // per object, Morton splitter only
+};
+
+struct Split
+{
+  int middle; // number of objects going to the first child, 0 if the node should stay a leaf
+  Vec2 cuttingNormal;
+  Vec2 linePos; // for visualization
+};
+
+Split splitAtMedian(const BoundingBox& boundaries, span<const BoundingBox> allObjects, span<int> objects)
+{
+  Vec2 size = boundaries.max - boundaries.min;
   Vec2 cuttingNormal;
 
   if(size.x > size.y)
@@ -39,70 +78,523 @@ void subdivide(int nodeIdx, span<const BoundingBox> allObjects, std::vector<BvhN
     return centerA * cuttingNormal < centerB * cuttingNormal;
   };
 
-  std::sort(node->objects.begin(), node->objects.end(), byDistanceToCuttingPlane);
+  std::sort(objects.begin(), objects.end(), byDistanceToCuttingPlane);
+
+  const int middle = objects.len / 2;
+
+  return {middle, cuttingNormal, allObjects[objects[middle]].min};
+}
+
+Split splitWithBinnedSah(
+      const BoundingBox& boundaries, span<const BoundingBox> allObjects, span<int> objects, const BvhBuildOptions& options)
+{
+  // objects are binned by their center
+  BoundingBox centerBounds;
+  for(auto i : objects)
+    centerBounds.add(center(allObjects[i]));
+
+  struct Bin
+  {
+    BoundingBox bounds;
+    int count = 0;
+  };
+
+  const int binCount = std::max(options.binCount, 2);
+
+  auto binIndex = [&](int obj, int axis)
+  {
+    const float lo = coord(centerBounds.min, axis);
+    const float extent = coord(centerBounds.max, axis) - lo;
+    const int i = int((coord(center(allObjects[obj]), axis) - lo) * binCount / extent);
+    return std::min(i, binCount - 1);
+  };
+
+  ScratchScope scratch;
+  ScratchVector<Bin> bins(binCount);
+  ScratchVector<float> rightCost(binCount);
+  ScratchVector<int> rightCount(binCount);
+
+  // cost of keeping the node as a leaf
+  float bestCost = objects.len;
+  int bestAxis = -1;
+  int bestBin = 0;
+
+  const float parentArea = halfPerimeter(boundaries);
+
+  for(int axis = 0; axis < 2; ++axis)
+  {
+    if(!(coord(centerBounds.max, axis) > coord(centerBounds.min, axis)))
+      continue;
+
+    for(auto& bin : bins)
+      bin = {};
+
+    for(auto i : objects)
+    {
+      auto& bin = bins[binIndex(i, axis)];
+      bin.bounds.add(allObjects[i].min);
+      bin.bounds.add(allObjects[i].max);
+      bin.count++;
+    }
+
+    // split 'k' puts bins [0, k) in the first child, and [k, binCount) in the second one
+    {
+      BoundingBox bounds;
+      int count = 0;
+      for(int k = binCount - 1; k > 0; --k)
+      {
+        if(bins[k].count)
+        {
+          bounds.add(bins[k].bounds.min);
+          bounds.add(bins[k].bounds.max);
+          count += bins[k].count;
+        }
+
+        rightCost[k] = halfPerimeter(bounds) * count;
+        rightCount[k] = count;
+      }
+    }
+
+    BoundingBox bounds;
+    int count = 0;
+    for(int k = 1; k < binCount; ++k)
+    {
+      // (empty bins have an empty bounding box: they don't contribute)
+      if(bins[k - 1].count)
+      {
+        bounds.add(bins[k - 1].bounds.min);
+        bounds.add(bins[k - 1].bounds.max);
+        count += bins[k - 1].count;
+      }
+
+      if(count == 0 || rightCount[k] == 0)
+        continue;
+
+      const float cost = options.traversalCost + (halfPerimeter(bounds) * count + rightCost[k]) / parentArea;
+      if(cost < bestCost)
+      {
+        bestCost = cost;
+        bestAxis = axis;
+        bestBin = k;
+      }
+    }
+  }
+
+  if(bestAxis < 0)
+    return {0, {}, {}};
+
+  auto isInFirstChild = [&](int obj) { return binIndex(obj, bestAxis) < bestBin; };
+  const int middle = std::partition(objects.begin(), objects.end(), isInFirstChild) - objects.begin();
+
+  const Vec2 cuttingNormal = bestAxis == 0 ? Vec2(1, 0) : Vec2(0, 1);
+  const float lo = coord(centerBounds.min, bestAxis);
+  const float splitPos = lo + (coord(centerBounds.max, bestAxis) - lo) * bestBin / binCount;
+
+  return {middle, cuttingNormal, cuttingNormal * splitPos};
+}
+
+void computeMortonCodes(span<const BoundingBox> allObjects, span<uint32_t> codes, int threadCount)
+{
+  ScratchVector<Vec2> centers(allObjects.len);
+  for(int i = 0; i < (int)allObjects.len; ++i)
+    centers[i] = center(allObjects[i]);
+
+  ::computeMortonCodes(span<const Vec2>(centers.size(), centers.data()), codes, threadCount);
+}
+
+// 'objects' must be sorted by Morton code. Splits at the highest bit which differs inside the range,
+// which is like splitting the (quadtree-like) cell containing the objects.
+Split splitAtMortonBit(span<const BoundingBox> allObjects, span<const uint32_t> codes, span<int> objects)
+{
+  const uint32_t first = codes[objects[0]];
+  const uint32_t last = codes[objects[objects.len - 1]];
+
+  if(first == last)
+    return {0, {}, {}};
+
+  int bit = 31;
+  while(!(((first ^ last) >> bit) & 1))
+    --bit;
+
+  // all the objects share the higher bits: those with this bit cleared come first
+  auto hasBitCleared = [&](int obj) { return !((codes[obj] >> bit) & 1); };
+  const int middle = std::partition_point(objects.begin(), objects.end(), hasBitCleared) - objects.begin();
+
+  const Vec2 cuttingNormal = (bit & 1) ? Vec2(0, 1) : Vec2(1, 0);
+  return {middle, cuttingNormal, center(allObjects[objects[middle]])};
+}
+
+// Returns false if the node should stay a leaf
+bool subdivide(int nodeIdx, const BuildContext& ctx, std::vector<BvhNode>& nodes, ScratchVector<ObjectRange>& ranges)
+{
+  auto allObjects = ctx.objects;
+  auto order = ctx.order;
+  auto& options = ctx.options;
+
+  auto node = &nodes[nodeIdx];
+  const auto range = ranges[nodeIdx];
+  span<int> objects{size_t(range.end - range.begin), order.ptr + range.begin};
+
+  // Past this depth, median splits are forced: each of them halves the object count,
+  // which keeps the depth under BvhMaxDepth.
+  const int maxDepth = BvhMaxDepth - 32;
+
+  Split split{};
+  if(range.depth >= maxDepth)
+    split = splitAtMedian(node->boundaries, allObjects, objects);
+  else
+  {
+    switch(options.splitter)
+    {
+    case BvhSplitter::Median:
+      split = splitAtMedian(node->boundaries, allObjects, objects);
+      break;
+    case BvhSplitter::BinnedSah:
+      split = splitWithBinnedSah(node->boundaries, allObjects, objects, options);
+      break;
+    case BvhSplitter::Morton:
+      split = splitAtMortonBit(allObjects, ctx.mortonCodes, objects);
+
+      // all the codes are equal: objects are too close to be separated by their codes
+      if(split.middle == 0)
+        split = splitAtMedian(node->boundaries, allObjects, objects);
+      break;
+    }
+  }
 
-  const int middle = node->objects.size() / 2;
+  if(split.middle == 0)
+    return false;
 
   {
-    auto linePos = allObjects[node->objects[middle]].min;
-    auto cuttingDir = rotateLeft(cuttingNormal);
-    sandbox_line(linePos - cuttingDir * 100, linePos + cuttingDir * 100, Green);
+    auto cuttingDir = rotateLeft(split.cuttingNormal);
+    sandbox_line(split.linePos - cuttingDir * 100, split.linePos + cuttingDir * 100, Green);
     sandbox_rect(node->boundaries.min, node->boundaries.max - node->boundaries.min, Red);
     sandbox_breakpoint();
   }
 
-  node->children[0] = nodes.size();
-  nodes.push_back({});
-  auto& child0 = nodes.back();
-  child0.objects.assign(node->objects.begin(), node->objects.begin() + middle);
-  child0.boundaries = computeBoundingBox(allObjects, child0.objects);
+  const ObjectRange childRanges[2] = {
+        {range.begin, range.begin + split.middle, range.depth + 1},
+        {range.begin + split.middle, range.end, range.depth + 1},
+  };
 
-  node->children[1] = nodes.size();
-  nodes.push_back({});
-  auto& child1 = nodes.back();
-  child1.objects.assign(node->objects.begin() + middle, node->objects.end());
-  child1.boundaries = computeBoundingBox(allObjects, child1.objects);
+  for(int k = 0; k < 2; ++k)
+  {
+    // ('node' is invalidated by the insertion, if the array wasn't reserved)
+    nodes[nodeIdx].children[k] = nodes.size();
+    nodes.push_back({});
+    ranges.push_back(childRanges[k]);
 
-  node->objects.clear();
+    const auto childRange = childRanges[k];
+    auto& child = nodes.back();
+    child.boundaries = computeBoundingBox(
+          allObjects, span<const int>{size_t(childRange.end - childRange.begin), order.ptr + childRange.begin});
+  }
 
   {
-    auto a = &nodes[node->children[0]];
-    auto b = &nodes[node->children[1]];
+    auto a = &nodes[nodes[nodeIdx].children[0]];
+    auto b = &nodes[nodes[nodeIdx].children[1]];
     sandbox_rect(a->boundaries.min, a->boundaries.max - a->boundaries.min, Green);
     sandbox_rect(b->boundaries.min, b->boundaries.max - b->boundaries.min, Green);
     sandbox_breakpoint();
   }
+
+  return true;
 }
+
+// Subdivides the nodes of the subtree 'root', until reaching the leaves.
+// When 'deferred' isn't null, nodes having less than 'deferBelow' objects are appended to it
+// instead of being subdivided.
+void buildSubtree(int root, const BuildContext& ctx, std::vector<BvhNode>& nodes, ScratchVector<ObjectRange>& ranges,
+      int deferBelow, ScratchVector<int>* deferred)
+{
+  ScratchVector<int> stack;
+  stack.push_back(root);
+
+  while(stack.size())
+  {
+    auto curr = stack.back();
+    stack.pop_back();
+
+    const auto range = ranges[curr];
+    const int count = range.end - range.begin;
+
+    if(count <= ctx.options.maxLeafSize)
+      continue;
+
+    if(deferred && count < deferBelow)
+    {
+      deferred->push_back(curr);
+      continue;
+    }
+
+    if(!subdivide(curr, ctx, nodes, ranges))
+      continue;
+
+    stack.push_back(nodes[curr].children[1]);
+    stack.push_back(nodes[curr].children[0]);
+  }
 }
 
-std::vector<BvhNode> computeBoundingVolumeHierarchy(span<const BoundingBox> objects)
+// Builds the structure of the hierarchy: on return, the objects of each node are the range
+// 'ranges[node]' of 'order', and only 'boundaries' and 'children' are filled in 'nodes'.
+void buildHierarchy(span<const BoundingBox> objects, const BvhBuildOptions& options, span<int> order,
+      std::vector<BvhNode>& nodes, ScratchVector<ObjectRange>& ranges)
 {
-  std::vector<BvhNode> nodes;
+  const int threadCount = resolveThreadCount(options.threadCount);
+
   nodes.reserve(objects.len * 2);
+  ranges.reserve(objects.len * 2);
 
-  nodes.push_back({});
-  auto& rootNode = nodes.back();
   for(int i = 0; i < (int)objects.len; ++i)
-    rootNode.objects.push_back(i);
-  rootNode.boundaries = computeBoundingBox(objects, rootNode.objects);
+    order[i] = i;
+
+  ScratchVector<uint32_t> mortonCodes;
+  if(options.splitter == BvhSplitter::Morton)
+  {
+    mortonCodes.resize(objects.len);
+    computeMortonCodes(objects, mortonCodes, threadCount);
+    sortByMortonCode(order, mortonCodes, threadCount);
+  }
+
+  const BuildContext ctx{objects, options, order, mortonCodes};
+
+  nodes.push_back({});
+  ranges.push_back({0, (int)objects.len, 0});
+  nodes.back().boundaries = computeBoundingBox(objects, span<const int>{order.len, order.ptr});
+
+  if(threadCount <= 1)
+  {
+    buildSubtree(0, ctx, nodes, ranges, 0, nullptr);
+    return;
+  }
+
+  // Build the top of the tree, then the subtrees below it in parallel: they cover disjoint
+  // ranges of 'order', but get their own nodes, grafted at the end.
+  ScratchVector<int> deferred;
+  const int deferBelow = std::max<int>(objects.len / (threadCount * 8), 1024);
+  buildSubtree(0, ctx, nodes, ranges, deferBelow, &deferred);
+
+  struct Subtree
+  {
+    std::vector<BvhNode> nodes;
+    ScratchVector<ObjectRange> ranges;
+  };
+
+  // (allocated by the workers: their scratch containers must not use the arena of this thread)
+  std::vector<std::unique_ptr<Subtree>> subtrees(deferred.size());
+
+  parallelFor(deferred.size(), threadCount,
+        [&](int k)
+        {
+          subtrees[k] = std::make_unique<Subtree>();
+          auto& subtree = *subtrees[k];
+          const auto range = ranges[deferred[k]];
+          subtree.nodes.reserve((range.end - range.begin) * 2);
+          subtree.ranges.reserve((range.end - range.begin) * 2);
+          subtree.nodes.push_back(nodes[deferred[k]]);
+          subtree.ranges.push_back(ranges[deferred[k]]);
+          buildSubtree(0, ctx, subtree.nodes, subtree.ranges, 0, nullptr);
+        });
+
+  for(int k = 0; k < (int)deferred.size(); ++k)
+  {
+    auto& subtree = *subtrees[k];
+
+    // the subtree root replaces the deferred node, the other nodes are appended
+    const int root = deferred[k];
+    const int base = nodes.size() - 1;
+    auto toGlobal = [&](int i) { return i == 0 ? root : base + i; };
+
+    for(int i = 0; i < (int)subtree.nodes.size(); ++i)
+    {
+      auto& node = subtree.nodes[i];
+      if(node.children[0])
+      {
+        node.children[0] = toGlobal(node.children[0]);
+        node.children[1] = toGlobal(node.children[1]);
+      }
+
+      if(i == 0)
+      {
+        nodes[root] = std::move(node);
+      }
+      else
+      {
+        nodes.push_back(std::move(node));
+        ranges.push_back(subtree.ranges[i]);
+      }
+    }
+  }
+}
+
+// Emits the nodes in depth-first order, so the first child of each inner node directly follows it.
+// 'leafObjects(node)' gives the range of flat object indices of a leaf.
+template<typename LeafObjects>
+void flatten(span<const BvhNode> nodes, std::vector<FlatBvhNode>& flat, LeafObjects leafObjects)
+{
+  if(nodes.len == 0)
+    return;
+
+  struct Pending
+  {
+    int node;
+    int parent; // the flat node whose second child this is, or -1
+  };
 
-  std::vector<int> stack;
-  stack.push_back(0);
+  flat.reserve(nodes.len);
+
+  ScratchVector<Pending> stack;
+  stack.push_back({0, -1});
 
   while(stack.size())
   {
-    auto curr = stack.back();
+    const auto curr = stack.back();
     stack.pop_back();
 
-    if(nodes[curr].objects.size() <= 2)
-      continue;
+    const int flatIdx = flat.size();
+    if(curr.parent >= 0)
+      flat[curr.parent].offset = flatIdx;
 
-    subdivide(curr, objects, nodes);
+    auto& node = nodes[curr.node];
+    flat.push_back({});
+    flat.back().boundaries = node.boundaries;
 
-    stack.push_back(nodes[curr].children[1]);
-    stack.push_back(nodes[curr].children[0]);
+    if(node.children[0] == 0)
+    {
+      const auto range = leafObjects(curr.node);
+      flat.back().offset = range.begin;
+      flat.back().count = range.end - range.begin;
+    }
+    else
+    {
+      stack.push_back({node.children[1], flatIdx});
+      stack.push_back({node.children[0], -1});
+    }
+  }
+}
+}
+
+std::vector<BvhNode> computeBoundingVolumeHierarchy(span<const BoundingBox> objects)
+{
+  return computeBoundingVolumeHierarchy(objects, BvhBuildOptions());
+}
+
+std::vector<BvhNode> computeBoundingVolumeHierarchy(span<const BoundingBox> objects, const BvhBuildOptions& options)
+{
+  std::vector<BvhNode> nodes;
+  ScratchVector<int> order(objects.len);
+  ScratchVector<ObjectRange> ranges;
+
+  buildHierarchy(objects, options, order, nodes, ranges);
+
+  for(int i = 0; i < (int)nodes.size(); ++i)
+  {
+    if(nodes[i].children[0] == 0)
+      nodes[i].objects.assign(order.begin() + ranges[i].begin, order.begin() + ranges[i].end);
   }
 
   nodes.shrink_to_fit();
   return nodes;
 }
+
+FlatBvh computeFlatBvh(span<const BoundingBox> objects, const BvhBuildOptions& options)
+{
+  FlatBvh r;
+
+  if(objects.len == 0)
+    return r;
+
+  ScratchScope scratch;
+  std::vector<BvhNode> nodes;
+  ScratchVector<ObjectRange> ranges;
+
+  // leaves are contiguous ranges of 'order': it becomes the object array
+  r.objects.resize(objects.len);
+  buildHierarchy(objects, options, r.objects, nodes, ranges);
+
+  flatten(span<const BvhNode>(nodes), r.nodes, [&](int i) { return ranges[i]; });
+
+  return r;
+}
+
+FlatBvh flattenBvh(span<const BvhNode> nodes)
+{
+  FlatBvh r;
+
+  if(nodes.len == 0 || (nodes[0].children[0] == 0 && nodes[0].objects.empty()))
+    return r;
+
+  flatten(nodes, r.nodes,
+        [&](int i)
+        {
+          const int begin = r.objects.size();
+          r.objects.insert(r.objects.end(), nodes[i].objects.begin(), nodes[i].objects.end());
+          return ObjectRange{begin, (int)r.objects.size(), 0};
+        });
+
+  return r;
+}
+
+void refitBvh(span<BvhNode> nodes, span<const BoundingBox> objects)
+{
+  for(int i = (int)nodes.len - 1; i >= 0; --i)
+  {
+    auto& node = nodes[i];
+
+    if(node.children[0] == 0)
+    {
+      node.boundaries = computeBoundingBox(objects, node.objects);
+    }
+    else
+    {
+      assert(node.children[0] > i && node.children[1] > i);
+      node.boundaries = BoundingBox();
+      for(auto child : node.children)
+      {
+        node.boundaries.add(nodes[child].boundaries.min);
+        node.boundaries.add(nodes[child].boundaries.max);
+      }
+    }
+  }
+}
+
+void refitBvh(FlatBvh& bvh, span<const BoundingBox> objects)
+{
+  // depth-first order: children always come after their parent
+  for(int i = (int)bvh.nodes.size() - 1; i >= 0; --i)
+  {
+    auto& node = bvh.nodes[i];
+
+    if(node.isLeaf())
+    {
+      node.boundaries = computeBoundingBox(
+            objects, span<const int>{size_t(node.count), bvh.objects.data() + node.offset});
+    }
+    else
+    {
+      const auto& a = bvh.nodes[i + 1].boundaries;
+      const auto& b = bvh.nodes[node.offset].boundaries;
+      node.boundaries = a;
+      node.boundaries.add(b.min);
+      node.boundaries.add(b.max);
+    }
+  }
+}
+
+float computeBvhCost(span<const BvhNode> nodes, float traversalCost)
+{
+  if(nodes.len == 0)
+    return 0;
+
+  const float rootArea = halfPerimeter(nodes[0].boundaries);
+
+  float cost = 0;
+  for(auto& node : nodes)
+  {
+    const float probability = rootArea > 0 ? halfPerimeter(node.boundaries) / rootArea : 1.0f;
+    const bool isLeaf = node.children[0] == 0;
+    cost += probability * (isLeaf ? node.objects.size() : traversalCost);
+  }
+
+  return cost;
+}
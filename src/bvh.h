@@ -1,10 +1,15 @@
 #pragma once
 
 #include "core/geom.h"
+#include "core/simd.h"
 
+#include <cassert>
+#include <cmath>
+#include <utility>
 #include <vector>
 
 #include "bounding_box.h"
+#include "ray_boxes.h" // safeInverse, intersectSlabs4
 
 // output
 struct BvhNode
@@ -14,4 +19,597 @@ struct BvhNode
   std::vector<int> objects; // leaf node
 };
 
+enum class BvhSplitter
+{
+  // Sorts the objects along the longest axis, and splits them in two halves.
+  Median,
+
+  // Surface area heuristic, evaluated on a fixed number of bins per axis:
+  // picks the split minimizing the expected cost of a query (see 'computeBvhCost').
+  // Builds in O(n log n), and gives better trees for unevenly distributed objects.
+  BinnedSah,
+
+  // Linear BVH: the objects are sorted once by the Morton code of their center (radix sort),
+  // then each node is split at the highest bit differing among its codes.
+  // The fastest to build, at the expense of tree quality.
+  Morton,
+};
+
+struct BvhBuildOptions
+{
+  BvhSplitter splitter = BvhSplitter::Median;
+
+  // Nodes with at most 'maxLeafSize' objects aren't split.
+  // With BinnedSah, bigger nodes may also become leaves, when splitting them isn't worth it.
+  int maxLeafSize = 2;
+
+  // BinnedSah only
+  int binCount = 16;
+
+  // cost of traversing a node, relative to the cost of testing one object
+  float traversalCost = 1.0f;
+
+  // Above 1, the Morton codes are computed and sorted in parallel, and the subtrees
+  // below the top of the tree are built in parallel (0: one thread per hardware thread).
+  // The tree is the same (its nodes may be stored in another order), but the parallel parts
+  // aren't visualized.
+  int threadCount = 1;
+};
+
 std::vector<BvhNode> computeBoundingVolumeHierarchy(span<const BoundingBox> objects);
+std::vector<BvhNode> computeBoundingVolumeHierarchy(span<const BoundingBox> objects, const BvhBuildOptions& options);
+
+// The builders never go deeper than this (the root has depth 0)
+const int BvhMaxDepth = 64;
+
+// Compact layout of the hierarchy, for queries.
+// Nodes are stored depth-first: the first child of an inner node directly follows it,
+// and the objects of all the leaves are stored contiguously in a single array.
+struct alignas(32) FlatBvhNode
+{
+  BoundingBox boundaries;
+  int offset; // leaf: index of its first object in FlatBvh::objects. Inner node: index of the second child.
+  int count; // leaf: number of objects. Inner node: 0.
+
+  bool isLeaf() const { return count > 0; }
+};
+
+static_assert(sizeof(FlatBvhNode) == 32);
+
+// Non-owning view of a flat hierarchy, e.g on baked data (see baked.h): the queries only need this.
+struct FlatBvhView
+{
+  span<const FlatBvhNode> nodes;
+  span<const int> objects;
+};
+
+struct FlatBvh
+{
+  std::vector<FlatBvhNode> nodes; // empty if there are no objects
+  std::vector<int> objects;
+
+  operator FlatBvhView() const { return {{nodes.size(), nodes.data()}, {objects.size(), objects.data()}}; }
+};
+
+FlatBvh computeFlatBvh(span<const BoundingBox> objects, const BvhBuildOptions& options = {});
+FlatBvh flattenBvh(span<const BvhNode> nodes);
+
+// Recomputes the bounds of the nodes bottom-up, after the objects moved, in O(n).
+// The structure of the tree is kept: this is much cheaper than rebuilding it, but the tree
+// degrades when the objects move far from their initial neighbours (see DynamicBvh).
+// The children of each node must be stored after it, as done by the builders.
+void refitBvh(span<BvhNode> nodes, span<const BoundingBox> objects);
+void refitBvh(FlatBvh& bvh, span<const BoundingBox> objects);
+
+// Depth-first traversal, without allocations.
+// 'enterNode(const FlatBvhNode&)' returns false to skip the node and its subtree,
+// 'visitLeaf(span<const int> objects)' is called for each entered leaf.
+template<typename EnterNode, typename VisitLeaf>
+void traverse(const FlatBvhView& bvh, EnterNode&& enterNode, VisitLeaf&& visitLeaf)
+{
+  if(bvh.nodes.len == 0)
+    return;
+
+  int stack[BvhMaxDepth];
+  int stackSize = 0;
+  int curr = 0;
+
+  while(true)
+  {
+    const auto& node = bvh.nodes[curr];
+
+    if(enterNode(node))
+    {
+      if(!node.isLeaf())
+      {
+        assert(stackSize < BvhMaxDepth);
+        stack[stackSize++] = node.offset;
+        curr = curr + 1;
+        continue;
+      }
+
+      visitLeaf(span<const int>{size_t(node.count), bvh.objects.ptr + node.offset});
+    }
+
+    if(stackSize == 0)
+      break;
+
+    curr = stack[--stackSize];
+  }
+}
+
+// Expected cost of a query going through the hierarchy, with the surface area heuristic:
+// the probability of a node being visited is its surface area relative to the root's
+// (in 2D: the perimeter, as for a random line crossing a convex shape).
+// Each visited inner node costs 'traversalCost', each visited leaf the number of its objects.
+// For the same objects, lower is better.
+float computeBvhCost(span<const BvhNode> nodes, float traversalCost = 1.0f);
+
+struct BvhHit
+{
+  int object = -1; // -1 if nothing was hit
+  float t = INFINITY; // the hit point is 'origin + dir * t'
+};
+
+// Distance along the ray (origin, 1 / invDir) to the entry of 'box', clipped to [0; maxT].
+// Returns INFINITY if the ray misses the box over this interval.
+inline float rayBoxEntry(Vec2 origin, Vec2 invDir, float maxT, const BoundingBox& box)
+{
+  const float tx1 = (box.min.x - origin.x) * invDir.x;
+  const float tx2 = (box.max.x - origin.x) * invDir.x;
+  const float ty1 = (box.min.y - origin.y) * invDir.y;
+  const float ty2 = (box.max.y - origin.y) * invDir.y;
+
+  const float tNear = std::fmax(0.0f, std::fmax(std::fmin(tx1, tx2), std::fmin(ty1, ty2)));
+  const float tFar = std::fmin(maxT, std::fmin(std::fmax(tx1, tx2), std::fmax(ty1, ty2)));
+
+  return tNear <= tFar ? tNear : INFINITY;
+}
+
+// Closest hit along the ray 'origin + dir * t', for t in [0; maxT].
+// 'intersectObject(int object, float maxT)' returns the 't' of the first intersection
+// of the ray with 'object', or any value >= maxT (e.g INFINITY) if there's none before 'maxT'.
+// Children are visited nearest first, and subtrees farther than the closest hit so far are skipped.
+template<typename IntersectObject>
+BvhHit raycast(const FlatBvhView& bvh, Vec2 origin, Vec2 dir, float maxT, IntersectObject&& intersectObject)
+{
+  BvhHit hit;
+  hit.t = maxT;
+
+  if(bvh.nodes.len == 0)
+    return {};
+
+  const Vec2 invDir = safeInverse(dir);
+
+  struct Pending
+  {
+    int node;
+    float tEntry;
+  };
+
+  Pending stack[BvhMaxDepth];
+  int stackSize = 0;
+
+  int curr = 0;
+  if(rayBoxEntry(origin, invDir, hit.t, bvh.nodes[0].boundaries) == INFINITY)
+    return {};
+
+  while(true)
+  {
+    const auto& node = bvh.nodes[curr];
+
+    if(node.isLeaf())
+    {
+      for(int i = node.offset; i < node.offset + node.count; ++i)
+      {
+        const int object = bvh.objects[i];
+        const float t = intersectObject(object, hit.t);
+        if(t < hit.t)
+        {
+          hit.t = t;
+          hit.object = object;
+        }
+      }
+    }
+    else
+    {
+      int first = curr + 1;
+      int second = node.offset;
+      float tFirst = rayBoxEntry(origin, invDir, hit.t, bvh.nodes[first].boundaries);
+      float tSecond = rayBoxEntry(origin, invDir, hit.t, bvh.nodes[second].boundaries);
+
+      if(tSecond < tFirst)
+      {
+        std::swap(first, second);
+        std::swap(tFirst, tSecond);
+      }
+
+      if(tFirst != INFINITY)
+      {
+        if(tSecond != INFINITY)
+        {
+          assert(stackSize < BvhMaxDepth);
+          stack[stackSize++] = {second, tSecond};
+        }
+
+        curr = first;
+        continue;
+      }
+    }
+
+    // pop the next subtree that could still contain a closer hit
+    while(stackSize > 0 && stack[stackSize - 1].tEntry > hit.t)
+      --stackSize;
+
+    if(stackSize == 0)
+      break;
+
+    curr = stack[--stackSize].node;
+  }
+
+  if(hit.object < 0)
+    return {};
+
+  return hit;
+}
+
+// Closest hits of 4 rays at once: the node tests are done for the 4 rays together (see simd.h),
+// so this is faster than 4 calls to 'raycast' when the rays are coherent (e.g, from the same origin
+// and in close directions).
+// 'intersectObject(int object, int ray, float maxT)' has the same meaning as for 'raycast',
+// for the ray 'origins[ray] + dirs[ray] * t'.
+template<typename IntersectObject>
+void raycast4(const FlatBvhView& bvh, const Vec2 origins[4], const Vec2 dirs[4], float maxT,
+      IntersectObject&& intersectObject, BvhHit hits[4])
+{
+  float tMax[4];
+  float ox[4], oy[4], idx[4], idy[4];
+  Vec2 meanDir{};
+
+  for(int i = 0; i < 4; ++i)
+  {
+    hits[i] = {};
+    tMax[i] = maxT;
+    ox[i] = origins[i].x;
+    oy[i] = origins[i].y;
+    idx[i] = safeInverse(dirs[i].x);
+    idy[i] = safeInverse(dirs[i].y);
+    meanDir = meanDir + dirs[i];
+  }
+
+  if(bvh.nodes.len == 0)
+    return;
+
+  const Float4 originX = load4(ox);
+  const Float4 originY = load4(oy);
+  const Float4 invDirX = load4(idx);
+  const Float4 invDirY = load4(idy);
+  const Float4 zero = splat4(0);
+
+  // bitmask of the rays entering 'box' before their closest hit so far
+  auto enteringRays = [&](const BoundingBox& box)
+  {
+    Float4 tNear, tFar;
+    return intersectSlabs4(splat4(box.min.x), splat4(box.min.y), splat4(box.max.x), splat4(box.max.y), originX,
+          originY, invDirX, invDirY, zero, load4(tMax), tNear, tFar);
+  };
+
+  int stack[BvhMaxDepth];
+  int stackSize = 0;
+  int curr = 0;
+
+  while(true)
+  {
+    const auto& node = bvh.nodes[curr];
+    const int mask = enteringRays(node.boundaries);
+
+    if(mask)
+    {
+      if(node.isLeaf())
+      {
+        for(int i = node.offset; i < node.offset + node.count; ++i)
+        {
+          const int object = bvh.objects[i];
+          for(int ray = 0; ray < 4; ++ray)
+          {
+            if(!(mask & (1 << ray)))
+              continue;
+
+            const float t = intersectObject(object, ray, tMax[ray]);
+            if(t < tMax[ray])
+            {
+              tMax[ray] = t;
+              hits[ray] = {object, t};
+            }
+          }
+        }
+      }
+      else
+      {
+        // visit first the child whose center comes first along the mean direction
+        int first = curr + 1;
+        int second = node.offset;
+
+        const auto& a = bvh.nodes[first].boundaries;
+        const auto& b = bvh.nodes[second].boundaries;
+        if((b.min + b.max - a.min - a.max) * meanDir < 0)
+          std::swap(first, second);
+
+        assert(stackSize < BvhMaxDepth);
+        stack[stackSize++] = second;
+        curr = first;
+        continue;
+      }
+    }
+
+    if(stackSize == 0)
+      break;
+
+    curr = stack[--stackSize];
+  }
+}
+
+// Queries. 'objects' are the boxes the hierarchy was built from (or refitted to).
+// Nothing is allocated: the results are given to a callback, or written to a span.
+
+// Calls 'visit(int object)' for each object whose box overlaps 'box'.
+template<typename Visit>
+void queryOverlaps(const FlatBvhView& bvh, span<const BoundingBox> objects, const BoundingBox& box, Visit&& visit)
+{
+  traverse(
+        bvh, [&](const FlatBvhNode& node) { return overlaps(node.boundaries, box); },
+        [&](span<const int> leaf)
+        {
+          for(auto object : leaf)
+          {
+            if(overlaps(objects[object], box))
+              visit(object);
+          }
+        });
+}
+
+// Same, writing the objects to 'result'. Returns the number of overlapping objects,
+// which can be greater than 'result.len': the objects beyond it are dropped.
+inline int queryOverlaps(const FlatBvhView& bvh, span<const BoundingBox> objects, const BoundingBox& box, span<int> result)
+{
+  int count = 0;
+  queryOverlaps(bvh, objects, box,
+        [&](int object)
+        {
+          if(count < (int)result.len)
+            result[count] = object;
+          ++count;
+        });
+  return count;
+}
+
+// Calls 'visit(int object)' for each object whose box contains 'point'.
+template<typename Visit>
+void queryPoint(const FlatBvhView& bvh, span<const BoundingBox> objects, Vec2 point, Visit&& visit)
+{
+  traverse(
+        bvh, [&](const FlatBvhNode& node) { return contains(node.boundaries, point); },
+        [&](span<const int> leaf)
+        {
+          for(auto object : leaf)
+          {
+            if(contains(objects[object], point))
+              visit(object);
+          }
+        });
+}
+
+// Simultaneous traversal of two hierarchies, descending first into the biggest node of each pair.
+// With 'self' (a and b being the same hierarchy), each pair of objects is visited once.
+template<typename Visit>
+void visitOverlappingPairs(const FlatBvhView& a, span<const BoundingBox> objectsA, const FlatBvhView& b,
+      span<const BoundingBox> objectsB, bool self, Visit&& visit)
+{
+  if(a.nodes.len == 0 || b.nodes.len == 0)
+    return;
+
+  struct Pair
+  {
+    int a;
+    int b;
+  };
+
+  // Each expansion along the current path leaves at most two pairs on the stack
+  // (a self pair has three children pairs), the path being at most 2 * BvhMaxDepth long.
+  Pair stack[4 * BvhMaxDepth + 1];
+  int stackSize = 0;
+  stack[stackSize++] = {0, 0};
+
+  while(stackSize > 0)
+  {
+    const auto curr = stack[--stackSize];
+    const auto& nodeA = a.nodes[curr.a];
+    const auto& nodeB = b.nodes[curr.b];
+
+    if(self && curr.a == curr.b)
+    {
+      if(nodeA.isLeaf())
+      {
+        for(int i = nodeA.offset; i < nodeA.offset + nodeA.count; ++i)
+        {
+          for(int j = i + 1; j < nodeA.offset + nodeA.count; ++j)
+          {
+            if(overlaps(objectsA[a.objects[i]], objectsA[a.objects[j]]))
+              visit(a.objects[i], a.objects[j]);
+          }
+        }
+      }
+      else
+      {
+        assert(stackSize + 3 <= 4 * BvhMaxDepth + 1);
+        stack[stackSize++] = {curr.a + 1, nodeA.offset};
+        stack[stackSize++] = {nodeA.offset, nodeA.offset};
+        stack[stackSize++] = {curr.a + 1, curr.a + 1};
+      }
+      continue;
+    }
+
+    if(!overlaps(nodeA.boundaries, nodeB.boundaries))
+      continue;
+
+    if(nodeA.isLeaf() && nodeB.isLeaf())
+    {
+      for(int i = nodeA.offset; i < nodeA.offset + nodeA.count; ++i)
+      {
+        for(int j = nodeB.offset; j < nodeB.offset + nodeB.count; ++j)
+        {
+          if(overlaps(objectsA[a.objects[i]], objectsB[b.objects[j]]))
+            visit(a.objects[i], b.objects[j]);
+        }
+      }
+      continue;
+    }
+
+    const auto sizeA = nodeA.boundaries.max - nodeA.boundaries.min;
+    const auto sizeB = nodeB.boundaries.max - nodeB.boundaries.min;
+    const bool descendA = nodeB.isLeaf() || (!nodeA.isLeaf() && sizeA.x + sizeA.y >= sizeB.x + sizeB.y);
+
+    assert(stackSize + 2 <= 4 * BvhMaxDepth + 1);
+
+    if(descendA)
+    {
+      stack[stackSize++] = {nodeA.offset, curr.b};
+      stack[stackSize++] = {curr.a + 1, curr.b};
+    }
+    else
+    {
+      stack[stackSize++] = {curr.a, nodeB.offset};
+      stack[stackSize++] = {curr.a, curr.b + 1};
+    }
+  }
+}
+
+// Calls 'visit(int objectA, int objectB)' for each pair of overlapping objects, one from each hierarchy.
+template<typename Visit>
+void queryPairs(const FlatBvhView& a, span<const BoundingBox> objectsA, const FlatBvhView& b, span<const BoundingBox> objectsB,
+      Visit&& visit)
+{
+  visitOverlappingPairs(a, objectsA, b, objectsB, false, visit);
+}
+
+// Calls 'visit(int object1, int object2)' once for each pair of overlapping objects of the hierarchy.
+template<typename Visit>
+void querySelfPairs(const FlatBvhView& bvh, span<const BoundingBox> objects, Visit&& visit)
+{
+  visitOverlappingPairs(bvh, objects, bvh, objects, true, visit);
+}
+
+struct BvhNeighbour
+{
+  int object = -1;
+  float distance = INFINITY;
+};
+
+// distance from 'point' to 'box' (0 if the point is inside)
+inline float boxDistance(const BoundingBox& box, Vec2 point)
+{
+  const float dx = std::fmax(0.0f, std::fmax(box.min.x - point.x, point.x - box.max.x));
+  const float dy = std::fmax(0.0f, std::fmax(box.min.y - point.y, point.y - box.max.y));
+  return std::sqrt(dx * dx + dy * dy);
+}
+
+// Finds the 'result.len' objects closest to 'point', closer than 'maxDistance'.
+// 'distanceToObject(int object)' returns the distance from 'point' to the object,
+// which must not be less than the distance to its box (see 'boxDistance').
+// 'result' is sorted by increasing distance. Returns the number of objects found.
+// Children are visited nearest first, and subtrees farther than the current k-th neighbour are skipped.
+template<typename DistanceToObject>
+int findNearest(const FlatBvhView& bvh, Vec2 point, span<BvhNeighbour> result, DistanceToObject&& distanceToObject,
+      float maxDistance = INFINITY)
+{
+  if(bvh.nodes.len == 0 || result.len == 0)
+    return 0;
+
+  int count = 0;
+
+  // objects must be closer than this to be part of the result
+  auto radius = [&]() { return count == (int)result.len ? result[count - 1].distance : maxDistance; };
+
+  struct Pending
+  {
+    int node;
+    float distance;
+  };
+
+  Pending stack[BvhMaxDepth];
+  int stackSize = 0;
+
+  int curr = 0;
+  if(boxDistance(bvh.nodes[0].boundaries, point) >= maxDistance)
+    return 0;
+
+  while(true)
+  {
+    const auto& node = bvh.nodes[curr];
+
+    if(node.isLeaf())
+    {
+      for(int i = node.offset; i < node.offset + node.count; ++i)
+      {
+        const int object = bvh.objects[i];
+        const float distance = distanceToObject(object);
+        if(distance >= radius())
+          continue;
+
+        // insertion into the sorted result, dropping the farthest one if it's full
+        int k = count < (int)result.len ? count++ : count - 1;
+        while(k > 0 && result[k - 1].distance > distance)
+        {
+          result[k] = result[k - 1];
+          --k;
+        }
+
+        result[k] = {object, distance};
+      }
+    }
+    else
+    {
+      int first = curr + 1;
+      int second = node.offset;
+      float dFirst = boxDistance(bvh.nodes[first].boundaries, point);
+      float dSecond = boxDistance(bvh.nodes[second].boundaries, point);
+
+      if(dSecond < dFirst)
+      {
+        std::swap(first, second);
+        std::swap(dFirst, dSecond);
+      }
+
+      if(dFirst < radius())
+      {
+        if(dSecond < radius())
+        {
+          assert(stackSize < BvhMaxDepth);
+          stack[stackSize++] = {second, dSecond};
+        }
+
+        curr = first;
+        continue;
+      }
+    }
+
+    // pop the next subtree that could still contain a closer object
+    while(stackSize > 0 && stack[stackSize - 1].distance >= radius())
+      --stackSize;
+
+    if(stackSize == 0)
+      break;
+
+    curr = stack[--stackSize].node;
+  }
+
+  return count;
+}
+
+// Same, with the distance to the boxes of the objects.
+inline int findNearest(const FlatBvhView& bvh, span<const BoundingBox> objects, Vec2 point, span<BvhNeighbour> result,
+      float maxDistance = INFINITY)
+{
+  return findNearest(
+        bvh, point, result, [&](int object) { return boxDistance(objects[object], point); }, maxDistance);
+}
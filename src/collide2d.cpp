@@ -5,8 +5,14 @@
 // License, or (at your option) any later version.
 #include "collide2d.h"
 
+#include "core/simd.h"
+
+#include <algorithm>
+#include <cassert>
 #include <cmath>
 
+#include "parallel.h"
+
 struct Collision
 {
   float depth = 0; // penetration depth.
@@ -58,17 +64,21 @@ static Range projectBoxOnAxis(Vec2 boxCenter, Vec2 boxHalfSize, Vec2 N)
   return Range{boxMin, boxMax};
 }
 
+static const float THICKNESS = 0.1;
+
+// both shapes fit in this box, around their center (segments are considered thick for the box shape)
+static const float REACH = RADIUS + THICKNESS;
+
 static Range projectSegmentOnAxis(Segment seg, Vec2 N)
 {
-  const float THICKNESS = 0.1;
-
   auto segMin = min(seg.a * N, seg.b * N) - THICKNESS;
   auto segMax = max(seg.a * N, seg.b * N) + THICKNESS;
 
   return Range{segMin, segMax};
 }
 
-static Collision collideBoxWithSegment(Vec2 center, Segment seg)
+// 'segNormal' is the unit normal of the segment
+static Collision collideBoxWithSegmentNormal(Vec2 center, Segment seg, Vec2 segNormal)
 {
   auto const boxHalfSize = Vec2(RADIUS, RADIUS);
 
@@ -77,7 +87,7 @@ static Collision collideBoxWithSegment(Vec2 center, Segment seg)
 
   axes[axeCount++] = Vec2(1, 0); // X axis
   axes[axeCount++] = Vec2(0, 1); // Y axis
-  axes[axeCount++] = rotateLeft(normalize(seg.b - seg.a)); // segment normal
+  axes[axeCount++] = segNormal;
 
   // vector going from seg.b to box center
   if((center - seg.b) * (seg.b - seg.a) > 0)
@@ -113,6 +123,11 @@ static Collision collideBoxWithSegment(Vec2 center, Segment seg)
   return r;
 }
 
+static Collision collideBoxWithSegment(Vec2 center, Segment seg)
+{
+  return collideBoxWithSegmentNormal(center, seg, rotateLeft(normalize(seg.b - seg.a)));
+}
+
 static Collision collideWithSegments(Vec2 pos, Shape shape, span<Segment> segments)
 {
   Collision deepest;
@@ -129,8 +144,168 @@ static Collision collideWithSegments(Vec2 pos, Shape shape, span<Segment> segmen
   return deepest;
 }
 
+static Collision collideWithSegments(Vec2 pos, Shape shape, span<Segment> segments, const SegmentIndex& index)
+{
+  Collision deepest;
+
+  BoundingBox box;
+  box.add(pos - Vec2(REACH, REACH));
+  box.add(pos + Vec2(REACH, REACH));
+
+  auto collide = shape == Circle ? collideCircleWithSegment : collideBoxWithSegment;
+
+  queryOverlaps(index.bvh, index.boxes, box,
+        [&](int i)
+        {
+          auto const collision = collide(pos, segments[i]);
+
+          if(collision.depth > deepest.depth)
+            deepest = collision;
+        });
+
+  return deepest;
+}
+
+// Calls 'f(segment)' for each segment listed in the cells overlapping the box [min;max].
+// A segment crossing several of these cells is visited several times.
+template<typename F>
+static void forEachSegmentInBox(const SegmentGrid& grid, Vec2 min, Vec2 max, F f)
+{
+  if(grid.width == 0)
+    return;
+
+  auto cellCoord = [&](float v, int size) { return std::clamp(int(std::floor(v / grid.cellSize)), 0, size - 1); };
+
+  const int x0 = cellCoord(min.x - grid.origin.x, grid.width);
+  const int y0 = cellCoord(min.y - grid.origin.y, grid.height);
+  const int x1 = cellCoord(max.x - grid.origin.x, grid.width);
+  const int y1 = cellCoord(max.y - grid.origin.y, grid.height);
+
+  for(int y = y0; y <= y1; ++y)
+  {
+    for(int x = x0; x <= x1; ++x)
+    {
+      const int cell = x + y * grid.width;
+      for(int k = grid.cellStart[cell]; k < grid.cellStart[cell + 1]; ++k)
+        f(grid.cellSegments[k]);
+    }
+  }
+}
+
+static Collision collideWithSegments(Vec2 pos, Shape shape, span<Segment> segments, const SegmentGrid& grid)
+{
+  Collision deepest;
+
+  auto collide = shape == Circle ? collideCircleWithSegment : collideBoxWithSegment;
+
+  // testing a segment twice doesn't change the result
+  forEachSegmentInBox(grid, pos - Vec2(REACH, REACH), pos + Vec2(REACH, REACH),
+        [&](int i)
+        {
+          auto const collision = collide(pos, segments[i]);
+
+          if(collision.depth > deepest.depth)
+            deepest = collision;
+        });
+
+  return deepest;
+}
+
+// Calls 'f(cell)' for each cell of 'grid' crossed by 'seg'
+template<typename F>
+static void forEachCell(const SegmentGrid& grid, Segment seg, F f)
+{
+  const Vec2 a = seg.a - grid.origin;
+  const Vec2 b = seg.b - grid.origin;
+
+  auto cellCoord = [&](float v, int size) { return std::clamp(int(std::floor(v / grid.cellSize)), 0, size - 1); };
+
+  const int x0 = cellCoord(min(a.x, b.x), grid.width);
+  const int y0 = cellCoord(min(a.y, b.y), grid.height);
+  const int x1 = cellCoord(max(a.x, b.x), grid.width);
+  const int y1 = cellCoord(max(a.y, b.y), grid.height);
+
+  // among the cells of the bounding box of the segment, skip those on one side of its line
+  // (slightly enlarged, so segments on the border of a cell are in both)
+  const Vec2 N = rotateLeft(b - a);
+  const float halfSize = grid.cellSize * 0.5f;
+  const float extent = (std::abs(N.x) + std::abs(N.y)) * halfSize * 1.001f;
+
+  for(int y = y0; y <= y1; ++y)
+  {
+    for(int x = x0; x <= x1; ++x)
+    {
+      const Vec2 center = Vec2(x * grid.cellSize + halfSize, y * grid.cellSize + halfSize);
+      if(std::abs((center - a) * N) <= extent)
+        f(x + y * grid.width);
+    }
+  }
+}
+
+SegmentGrid gridSegments(span<const Segment> segments, float cellSize)
+{
+  SegmentGrid r;
+
+  if(segments.len == 0)
+    return r;
+
+  BoundingBox bounds;
+  for(auto& seg : segments)
+  {
+    bounds.add(seg.a);
+    bounds.add(seg.b);
+  }
+
+  const Vec2 size = bounds.max - bounds.min;
+
+  if(cellSize <= 0)
+    cellSize = 2 * REACH;
+
+  const float maxCellCount = 1024 + 4.0f * segments.len;
+  if((size.x / cellSize + 1) * (size.y / cellSize + 1) > maxCellCount)
+    cellSize = std::max(size.x, size.y) / std::floor(std::sqrt(maxCellCount) - 1);
+
+  r.origin = bounds.min;
+  r.cellSize = cellSize;
+  r.width = int(size.x / cellSize) + 1;
+  r.height = int(size.y / cellSize) + 1;
+
+  // count the segments of each cell, then fill the cells
+  r.cellStart.assign(r.width * r.height + 1, 0);
+  for(auto& seg : segments)
+    forEachCell(r, seg, [&](int cell) { r.cellStart[cell + 1]++; });
+
+  for(int i = 0; i < r.width * r.height; ++i)
+    r.cellStart[i + 1] += r.cellStart[i];
+
+  std::vector<int> fill(r.cellStart.begin(), r.cellStart.end() - 1);
+  r.cellSegments.resize(r.cellStart.back());
+  for(int i = 0; i < (int)segments.len; ++i)
+    forEachCell(r, segments[i], [&](int cell) { r.cellSegments[fill[cell]++] = i; });
+
+  return r;
+}
+
+SegmentIndex indexSegments(span<const Segment> segments)
+{
+  SegmentIndex r;
+
+  r.boxes.reserve(segments.len);
+  for(auto& seg : segments)
+  {
+    BoundingBox box;
+    box.add(seg.a);
+    box.add(seg.b);
+    r.boxes.push_back(box);
+  }
+
+  r.bvh = computeFlatBvh(r.boxes);
+  return r;
+}
+
 // discrete collision detection
-void slideMove(Vec2& pos, Shape shape, Vec2 delta, span<Segment> segments)
+template<typename CollideWithSegments>
+static void moveAndFixup(Vec2& pos, Vec2 delta, CollideWithSegments collideWithSegments)
 {
   // move to new position ...
   pos += delta;
@@ -138,7 +313,7 @@ void slideMove(Vec2& pos, Shape shape, Vec2 delta, span<Segment> segments)
   // ... then fix it, if needed
   for(int i = 0; i < 5; ++i)
   {
-    auto const collision = collideWithSegments(pos, shape, segments);
+    auto const collision = collideWithSegments(pos);
 
     if(collision.depth == 0)
       break;
@@ -147,3 +322,404 @@ void slideMove(Vec2& pos, Shape shape, Vec2 delta, span<Segment> segments)
     pos += collision.N * collision.depth;
   }
 }
+
+void slideMove(Vec2& pos, Shape shape, Vec2 delta, span<Segment> segments)
+{
+  moveAndFixup(pos, delta, [&](Vec2 p) { return collideWithSegments(p, shape, segments); });
+}
+
+void slideMove(Vec2& pos, Shape shape, Vec2 delta, span<Segment> segments, const SegmentIndex& index)
+{
+  moveAndFixup(pos, delta, [&](Vec2 p) { return collideWithSegments(p, shape, segments, index); });
+}
+
+void slideMove(Vec2& pos, Shape shape, Vec2 delta, span<Segment> segments, const SegmentGrid& grid)
+{
+  moveAndFixup(pos, delta, [&](Vec2 p) { return collideWithSegments(p, shape, segments, grid); });
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// batched discrete collision detection
+
+PackedSegments packSegments(span<const Segment> segments, float cellSize)
+{
+  PackedSegments r;
+  r.grid = gridSegments(segments, cellSize);
+
+  const int count = r.grid.cellSegments.size();
+  const int paddedCount = (count + 3) & ~3;
+
+  for(auto array : {&r.ax, &r.ay, &r.bx, &r.by, &r.tx, &r.ty, &r.nx, &r.ny, &r.length})
+    array->assign(paddedCount, 0);
+
+  for(int k = 0; k < count; ++k)
+  {
+    auto const seg = segments[r.grid.cellSegments[k]];
+    auto const length = magnitude(seg.b - seg.a);
+    auto const T = length > 0 ? normalize(seg.b - seg.a) : Vec2{}; // the normal must be the one of 'collideBoxWithSegment'
+    auto const N = rotateLeft(T);
+
+    r.ax[k] = seg.a.x;
+    r.ay[k] = seg.a.y;
+    r.bx[k] = seg.b.x;
+    r.by[k] = seg.b.y;
+    r.tx[k] = T.x;
+    r.ty[k] = T.y;
+    r.nx[k] = N.x;
+    r.ny[k] = N.y;
+    r.length[k] = length;
+  }
+
+  return r;
+}
+
+// Distance kept between the SIMD filter of circles and RADIUS. The filter doesn't compute the closest point
+// the way 'closestPointOnSegment' does, so it may be off by a few ulps of the segment length:
+// candidates at up to RADIUS + margin go through the exact test.
+static const float CircleFilterMargin = 1e-2f;
+
+// Tests the entries [begin; end[ of a cell, 4 at a time: the first part of the test
+// (distance to the segment for circles, bounding boxes for boxes) rejects most of them,
+// and the full test, the one 'slideMove' does, is only done for the others: the results are the same.
+static void collideWithPackedSegments(Vec2 pos, Shape shape, const PackedSegments& s, int begin, int end, Collision& deepest)
+{
+  const Float4 posX = splat4(pos.x);
+  const Float4 posY = splat4(pos.y);
+
+  for(int k = begin; k < end; k += 4)
+  {
+    const int laneMask = end - k >= 4 ? 0xF : (1 << (end - k)) - 1;
+
+    const Float4 ax = load4(&s.ax[k]);
+    const Float4 ay = load4(&s.ay[k]);
+
+    if(shape == Circle)
+    {
+      // closest point of the segment
+      const Float4 relX = posX - ax;
+      const Float4 relY = posY - ay;
+      const Float4 tx = load4(&s.tx[k]);
+      const Float4 ty = load4(&s.ty[k]);
+      const Float4 along = max4(splat4(0), min4(relX * tx + relY * ty, load4(&s.length[k])));
+      const Float4 deltaX = relX - tx * along;
+      const Float4 deltaY = relY - ty * along;
+      const Float4 dist2 = deltaX * deltaX + deltaY * deltaY;
+
+      const float reach = RADIUS + CircleFilterMargin;
+      const int mask = lessEqualMask(dist2, splat4(reach * reach)) & laneMask;
+      if(!mask)
+        continue;
+
+      for(int lane = 0; lane < 4; ++lane)
+      {
+        if(!(mask & (1 << lane)))
+          continue;
+
+        const int i = k + lane;
+        auto const seg = Segment{{s.ax[i], s.ay[i]}, {s.bx[i], s.by[i]}};
+        auto const collision = collideCircleWithSegment(pos, seg);
+
+        if(collision.depth > deepest.depth)
+          deepest = collision;
+      }
+    }
+    else
+    {
+      // separated along X or Y
+      const Float4 bx = load4(&s.bx[k]);
+      const Float4 by = load4(&s.by[k]);
+      const Float4 reach = splat4(REACH);
+
+      int mask = laneMask;
+      mask &= lessEqualMask(min4(ax, bx), posX + reach) & lessEqualMask(posX - reach, max4(ax, bx));
+      mask &= lessEqualMask(min4(ay, by), posY + reach) & lessEqualMask(posY - reach, max4(ay, by));
+
+      for(int lane = 0; lane < 4; ++lane)
+      {
+        if(!(mask & (1 << lane)))
+          continue;
+
+        const int i = k + lane;
+        auto const seg = Segment{{s.ax[i], s.ay[i]}, {s.bx[i], s.by[i]}};
+        auto const collision = collideBoxWithSegmentNormal(pos, seg, Vec2(s.nx[i], s.ny[i]));
+
+        if(collision.depth > deepest.depth)
+          deepest = collision;
+      }
+    }
+  }
+}
+
+static Collision collideWithPackedSegments(Vec2 pos, Shape shape, const PackedSegments& segments)
+{
+  Collision deepest;
+
+  auto const& grid = segments.grid;
+  if(grid.width == 0)
+    return deepest;
+
+  auto cellCoord = [&](float v, int size) { return std::clamp(int(std::floor(v / grid.cellSize)), 0, size - 1); };
+
+  const int x0 = cellCoord(pos.x - REACH - grid.origin.x, grid.width);
+  const int y0 = cellCoord(pos.y - REACH - grid.origin.y, grid.height);
+  const int x1 = cellCoord(pos.x + REACH - grid.origin.x, grid.width);
+  const int y1 = cellCoord(pos.y + REACH - grid.origin.y, grid.height);
+
+  for(int y = y0; y <= y1; ++y)
+  {
+    for(int x = x0; x <= x1; ++x)
+    {
+      const int cell = x + y * grid.width;
+      collideWithPackedSegments(pos, shape, segments, grid.cellStart[cell], grid.cellStart[cell + 1], deepest);
+    }
+  }
+
+  return deepest;
+}
+
+void slideMoves(span<Vec2> positions, span<const Vec2> deltas, span<const Shape> shapes, const PackedSegments& segments,
+      int threadCount)
+{
+  assert(deltas.len == positions.len && shapes.len == positions.len);
+
+  const int count = positions.len;
+  const int groupSize = 64;
+
+  parallelFor((count + groupSize - 1) / groupSize, threadCount,
+        [&](int group)
+        {
+          for(int i = group * groupSize; i < std::min(count, (group + 1) * groupSize); ++i)
+          {
+            const Shape shape = shapes[i];
+            moveAndFixup(positions[i], deltas[i], [&](Vec2 p) { return collideWithPackedSegments(p, shape, segments); });
+          }
+        });
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// continuous collision detection
+
+struct Impact
+{
+  float t = 1.0f / 0.0f; // fraction of the move before the contact
+  Vec2 N; // contact normal. Pointing towards the moving object.
+};
+
+// distance kept between the moving shape and the segments
+static const float SKIN = 0.001;
+
+// the circle moving from 'pos' to 'pos+delta', against the segment inflated by RADIUS (a capsule)
+static Impact sweepCircleAgainstSegment(Vec2 pos, Vec2 delta, Segment seg)
+{
+  Impact r;
+
+  auto const tangent = seg.b - seg.a;
+  auto const length2 = tangent * tangent;
+
+  // against the side facing the circle
+  if(length2 > 0)
+  {
+    auto N = normalize(rotateLeft(tangent));
+    auto dist = (pos - seg.a) * N;
+
+    if(dist < 0)
+    {
+      N = N * -1.0;
+      dist = -dist;
+    }
+
+    auto const approachSpeed = -(delta * N);
+
+    if(approachSpeed > 0)
+    {
+      auto const t = std::max(0.0f, (dist - RADIUS) / approachSpeed);
+      auto const along = (pos + delta * t - seg.a) * tangent;
+
+      if(t <= 1 && along >= 0 && along <= length2)
+        r = Impact{t, N};
+    }
+  }
+
+  // against the ends
+  for(auto end : {seg.a, seg.b})
+  {
+    auto const rel = pos - end;
+    auto const b = rel * delta;
+
+    if(b >= 0)
+      continue; // moving away
+
+    auto const a = delta * delta;
+    auto const c = rel * rel - RADIUS * RADIUS;
+
+    float t = 0;
+
+    if(c > 0)
+    {
+      auto const discriminant = b * b - a * c;
+      if(discriminant < 0)
+        continue;
+
+      t = (-b - std::sqrt(discriminant)) / a;
+    }
+
+    if(t < r.t && t <= 1)
+      r = Impact{t, normalize(rel + delta * t)};
+  }
+
+  return r;
+}
+
+// the box moving from 'pos' to 'pos+delta', against the thick segment:
+// the same axes as the discrete test, each one giving the range of time the projections overlap.
+static Impact sweepBoxAgainstSegment(Vec2 pos, Vec2 delta, Segment seg)
+{
+  Vec2 axes[3];
+  int axeCount = 0;
+
+  axes[axeCount++] = Vec2(1, 0); // X axis
+  axes[axeCount++] = Vec2(0, 1); // Y axis
+
+  if(seg.a.x != seg.b.x || seg.a.y != seg.b.y)
+    axes[axeCount++] = rotateLeft(normalize(seg.b - seg.a)); // segment normal
+
+  float tEnter = -1.0f / 0.0f;
+  float tExit = 1.0f / 0.0f;
+  Vec2 N{};
+
+  for(int i = 0; i < axeCount; ++i)
+  {
+    auto const axis = axes[i];
+
+    auto const boxRadius = RADIUS * (std::abs(axis.x) + std::abs(axis.y));
+    auto const segRange = projectSegmentOnAxis(seg, axis);
+    auto const min = segRange.min - boxRadius;
+    auto const max = segRange.max + boxRadius;
+
+    auto const center = pos * axis;
+    auto const speed = delta * axis;
+
+    if(speed == 0)
+    {
+      if(center < min || center > max)
+        return {}; // never overlapping on this axis
+      continue;
+    }
+
+    auto t0 = (min - center) / speed;
+    auto t1 = (max - center) / speed;
+    auto normal = axis * -1.0;
+
+    if(speed < 0)
+    {
+      std::swap(t0, t1);
+      normal = axis;
+    }
+
+    if(t0 > tEnter)
+    {
+      tEnter = t0;
+      N = normal;
+    }
+
+    tExit = std::min(tExit, t1);
+  }
+
+  if(tEnter > tExit || tEnter > 1 || tExit < 0 || (N.x == 0 && N.y == 0))
+    return {};
+
+  return Impact{std::max(0.0f, tEnter), N};
+}
+
+// box containing the shape during the whole move
+static BoundingBox sweptBox(Vec2 pos, Vec2 delta)
+{
+  BoundingBox box;
+  box.add(pos - Vec2(REACH, REACH));
+  box.add(pos + Vec2(REACH, REACH));
+  box.add(pos + delta - Vec2(REACH, REACH));
+  box.add(pos + delta + Vec2(REACH, REACH));
+  return box;
+}
+
+// 'forEachSegment(pos, delta, f)' calls 'f(i)' for (at least) each segment index 'i'
+// the shape might reach while moving from 'pos' to 'pos+delta'.
+template<typename ForEachSegment>
+static void sweepAndSlide(Vec2& pos, Shape shape, Vec2 delta, span<Segment> segments, ForEachSegment forEachSegment)
+{
+  auto sweep = shape == Circle ? sweepCircleAgainstSegment : sweepBoxAgainstSegment;
+
+  Vec2 previousN{};
+
+  for(int i = 0; i < 4; ++i)
+  {
+    auto const length = magnitude(delta);
+    if(length < SKIN)
+      break;
+
+    // on ties, the first segment wins, so the result doesn't depend on the broadphase
+    Impact first;
+    int firstSegment = 0;
+    auto const box = sweptBox(pos, delta);
+    forEachSegment(pos, delta,
+          [&](int i)
+          {
+            auto const seg = segments[i];
+            if(min(seg.a.x, seg.b.x) > box.max.x || max(seg.a.x, seg.b.x) < box.min.x ||
+                  min(seg.a.y, seg.b.y) > box.max.y || max(seg.a.y, seg.b.y) < box.min.y)
+              return;
+
+            auto const impact = sweep(pos, delta, seg);
+            if(impact.t < first.t || (impact.t == first.t && i < firstSegment))
+            {
+              first = impact;
+              firstSegment = i;
+            }
+          });
+
+    if(first.t > 1)
+    {
+      pos += delta;
+      break;
+    }
+
+    // stop at SKIN from the surface (even when grazing it) ...
+    auto const t = std::max(0.0f, first.t - SKIN / -(delta * first.N));
+    pos += delta * t;
+
+    // ... then slide along the surface with the rest of the move
+    delta = delta * (1 - t);
+    delta = delta - first.N * (delta * first.N);
+
+    // sliding back into the previous surface: stuck in a corner
+    if(delta * previousN < 0)
+      break;
+
+    previousN = first.N;
+  }
+}
+
+void sweepMove(Vec2& pos, Shape shape, Vec2 delta, span<Segment> segments)
+{
+  sweepAndSlide(pos, shape, delta, segments,
+        [&](Vec2, Vec2, auto f)
+        {
+          for(int i = 0; i < (int)segments.len; ++i)
+            f(i);
+        });
+}
+
+void sweepMove(Vec2& pos, Shape shape, Vec2 delta, span<Segment> segments, const SegmentIndex& index)
+{
+  sweepAndSlide(pos, shape, delta, segments, [&](Vec2 p, Vec2 d, auto f) { queryOverlaps(index.bvh, index.boxes, sweptBox(p, d), f); });
+}
+
+void sweepMove(Vec2& pos, Shape shape, Vec2 delta, span<Segment> segments, const SegmentGrid& grid)
+{
+  sweepAndSlide(pos, shape, delta, segments,
+        [&](Vec2 p, Vec2 d, auto f)
+        {
+          auto const box = sweptBox(p, d);
+          forEachSegmentInBox(grid, box.min, box.max, f);
+        });
+}
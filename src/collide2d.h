@@ -2,6 +2,10 @@
 
 #include "core/geom.h"
 
+#include <vector>
+
+#include "bvh.h"
+
 struct Segment
 {
   Vec2 a, b;
@@ -18,4 +22,70 @@ enum Shape
 // Collides with 'segments', and slides along them on collision.
 void slideMove(Vec2& pos, Shape shape, Vec2 delta, span<Segment> segments);
 
+// Broadphase for 'slideMove': a BVH of the bounding boxes of the segments
+struct SegmentIndex
+{
+  std::vector<BoundingBox> boxes;
+  FlatBvh bvh;
+};
+
+SegmentIndex indexSegments(span<const Segment> segments);
+
+// Same, only testing the segments close to the shape ('index' must be built from 'segments').
+void slideMove(Vec2& pos, Shape shape, Vec2 delta, span<Segment> segments, const SegmentIndex& index);
+
+// Broadphase for 'slideMove': a uniform grid over the segments, each cell listing the segments crossing it.
+// Cheaper to query than the BVH when the segments are short compared to the cells (e.g walls made of tiles),
+// but a long segment is listed in every cell it crosses.
+struct SegmentGrid
+{
+  Vec2 origin{}; // corner of the cell (0, 0)
+  float cellSize = 1;
+  int width = 0; // in cells
+  int height = 0;
+
+  // the segments crossing the cell (x, y) are 'cellSegments[cellStart[i]]' to 'cellSegments[cellStart[i + 1] - 1]',
+  // with i = x + y * width
+  std::vector<int> cellStart;
+  std::vector<int> cellSegments;
+};
+
+// 'cellSize' defaults to the size of the area tested at each step of 'slideMove', so each test looks
+// at 4 cells at most. It's increased if needed, to keep the number of cells proportional to the number of segments.
+SegmentGrid gridSegments(span<const Segment> segments, float cellSize = 0);
+
+// Same, only testing the segments close to the shape ('grid' must be built from 'segments').
+void slideMove(Vec2& pos, Shape shape, Vec2 delta, span<Segment> segments, const SegmentGrid& grid);
+
+// Segments prepared for 'slideMoves': a grid (see above) whose cells store their own copy of their segments,
+// with the unit tangent and normal of each one, in contiguous arrays (structure of arrays),
+// so a cell can be tested 4 segments at a time.
+struct PackedSegments
+{
+  SegmentGrid grid;
+
+  // one entry per element of 'grid.cellSegments', plus padding to a multiple of 4
+  std::vector<float> ax, ay, bx, by;
+  std::vector<float> tx, ty; // unit tangent (zero if the segment is a point)
+  std::vector<float> nx, ny; // unit normal, to the left of the tangent
+  std::vector<float> length;
+};
+
+PackedSegments packSegments(span<const Segment> segments, float cellSize = 0);
+
+// Moves many shapes at once, each one as 'slideMove' would (the shapes don't collide with each other):
+// 'positions[i]' is moved by 'deltas[i]'.
+// The shapes are split in groups, distributed on 'threadCount' threads (see parallel.h: 0 means one per
+// hardware thread).
+void slideMoves(span<Vec2> positions, span<const Vec2> deltas, span<const Shape> shapes, const PackedSegments& segments,
+      int threadCount = 1);
+
+// Continuous versions: sweep the shape along 'delta', stop just before the first segment hit,
+// and slide along it with the rest of the move (up to 4 times).
+// Unlike 'slideMove', thin segments can't be crossed, whatever the speed.
+// The shape must start out of the segments (e.g at a position given by a previous 'sweepMove').
+void sweepMove(Vec2& pos, Shape shape, Vec2 delta, span<Segment> segments);
+void sweepMove(Vec2& pos, Shape shape, Vec2 delta, span<Segment> segments, const SegmentIndex& index);
+void sweepMove(Vec2& pos, Shape shape, Vec2 delta, span<Segment> segments, const SegmentGrid& grid);
+
 static auto const RADIUS = 0.8f;
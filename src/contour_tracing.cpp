@@ -0,0 +1,250 @@
+#include "contour_tracing.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+#include "parallel.h"
+#include "simplify_polyline.h"
+
+namespace
+{
+// The squares of the marching: the square (x, y) has the cell centers around the point (x, y) as corners,
+// for x in [0; width] and y in [0; height].
+// Corner bits: 1 bottom-left, 2 bottom-right, 4 top-right, 8 top-left (set cell).
+// Sides: 0 bottom, 1 right, 2 top, 3 left.
+enum Side
+{
+  Bottom,
+  Right,
+  Top,
+  Left,
+};
+
+// exitSide[case][entrySide]: the contour going in a square by a side leaves it by this one (-1: not crossed).
+// The two saddles (5, 10) get two segments, keeping the corners apart.
+const int8_t exitSide[16][4] = {
+      {-1, -1, -1, -1}, // 0
+      {Left, -1, -1, -1}, // 1: bottom-left
+      {-1, Bottom, -1, -1}, // 2: bottom-right
+      {-1, Left, -1, -1}, // 3: bottom
+      {-1, -1, Right, -1}, // 4: top-right
+      {Left, -1, Right, -1}, // 5: bottom-left and top-right
+      {-1, -1, Bottom, -1}, // 6: right
+      {-1, -1, Left, -1}, // 7: all but top-left
+      {-1, -1, -1, Top}, // 8: top-left
+      {Top, -1, -1, -1}, // 9: left
+      {-1, Bottom, -1, Top}, // 10: bottom-right and top-left
+      {-1, Top, -1, -1}, // 11: all but top-right
+      {-1, -1, -1, Right}, // 12: top
+      {Right, -1, -1, -1}, // 13: all but bottom-right
+      {-1, -1, -1, Bottom}, // 14: all but bottom-left
+      {-1, -1, -1, -1}, // 15
+};
+
+const int sideDx[4] = {0, 1, 0, -1};
+const int sideDy[4] = {-1, 0, 1, 0};
+
+int squareCase(const BitGrid& mask, int x, int y)
+{
+  return mask.test(x - 1, y - 1) | mask.test(x, y - 1) << 1 | mask.test(x, y) << 2 | mask.test(x - 1, y) << 3;
+}
+
+Vec2 sidePoint(int x, int y, int side) { return Vec2(x + sideDx[side] * 0.5f, y + sideDy[side] * 0.5f); }
+
+// A contour part crossing the border of a band: it goes in at 'entryKey' and out at 'exitKey'.
+// The keys identify the horizontal sides between two rows of squares: row * stride + x.
+struct Chain
+{
+  int first, count;
+  int entryKey, exitKey;
+};
+
+// Squares of the rows [y0; y1[
+struct Band
+{
+  int y0, y1;
+  Contours loops; // entirely inside of the band
+  std::vector<Vec2> chainVertices;
+  std::vector<Chain> chains;
+};
+
+struct Tracer
+{
+  const BitGrid& mask;
+  const int stride; // squares by row
+  std::vector<uint8_t>& visited; // by square, one bit by entry side
+
+  // Follows the contour from the side 'entry' of the square (x, y), appending the points to 'out',
+  // until it's back to an already visited side or leaves the band. Returns the key of the side it left by, or -1.
+  int trace(const Band& band, int x, int y, int entry, std::vector<Vec2>& out) const
+  {
+    out.push_back(sidePoint(x, y, entry));
+
+    while(true)
+    {
+      visited[y * stride + x] |= 1 << entry;
+
+      const int exit = exitSide[squareCase(mask, x, y)][entry];
+      out.push_back(sidePoint(x, y, exit));
+
+      const int nextX = x + sideDx[exit];
+      const int nextY = y + sideDy[exit];
+      if(nextY < band.y0)
+        return y * stride + x;
+      if(nextY >= band.y1)
+        return nextY * stride + x;
+
+      x = nextX;
+      y = nextY;
+      entry = (exit + 2) % 4;
+      if(visited[y * stride + x] & (1 << entry))
+        return -1;
+    }
+  }
+};
+
+void traceBand(const Tracer& tracer, Band& band, int width, int height)
+{
+  // the parts going in from the other bands first: they aren't loops
+  for(int x = 0; x <= width; ++x)
+  {
+    const int rows[] = {band.y0, band.y1 - 1};
+    const int entries[] = {Bottom, Top};
+    for(int k = 0; k < 2; ++k)
+    {
+      const int y = rows[k];
+      const int entry = entries[k];
+      if((entry == Bottom && y == 0) || (entry == Top && y == height))
+        continue;
+      if(exitSide[squareCase(tracer.mask, x, y)][entry] < 0 || (tracer.visited[y * tracer.stride + x] & (1 << entry)))
+        continue;
+
+      Chain chain;
+      chain.first = band.chainVertices.size();
+      chain.entryKey = (entry == Bottom ? y : y + 1) * tracer.stride + x;
+      chain.exitKey = tracer.trace(band, x, y, entry, band.chainVertices);
+      chain.count = int(band.chainVertices.size()) - chain.first;
+      band.chains.push_back(chain);
+    }
+  }
+
+  for(int y = band.y0; y < band.y1; ++y)
+  {
+    for(int x = 0; x <= width; ++x)
+    {
+      const int c = squareCase(tracer.mask, x, y);
+      if(c == 0 || c == 15)
+        continue;
+
+      for(int entry = 0; entry < 4; ++entry)
+      {
+        if(exitSide[c][entry] < 0 || (tracer.visited[y * tracer.stride + x] & (1 << entry)))
+          continue;
+
+        tracer.trace(band, x, y, entry, band.loops.vertices);
+        band.loops.vertices.pop_back(); // back to the first point
+        band.loops.start.push_back(band.loops.vertices.size());
+      }
+    }
+  }
+}
+
+void append(Contours& contours, span<const Vec2> contour)
+{
+  contours.vertices.insert(contours.vertices.end(), contour.begin(), contour.end());
+  contours.start.push_back(contours.vertices.size());
+}
+}
+
+Contours extractContours(const BitGrid& mask, const ContourOptions& options)
+{
+  const int width = mask.width;
+  const int height = mask.height;
+  const int stride = width + 1;
+  const int rows = height + 1;
+
+  std::vector<uint8_t> visited(size_t(stride) * rows);
+  Tracer tracer{mask, stride, visited};
+
+  // the bands only write the 'visited' bits of their own squares
+  const int bandHeight = std::max(1, options.bandHeight);
+  std::vector<Band> bands((rows + bandHeight - 1) / bandHeight);
+  for(int i = 0; i < (int)bands.size(); ++i)
+  {
+    bands[i].y0 = i * bandHeight;
+    bands[i].y1 = std::min(rows, (i + 1) * bandHeight);
+  }
+
+  parallelFor(bands.size(), options.threadCount, [&](int i) { traceBand(tracer, bands[i], width, height); });
+
+  Contours contours;
+  for(auto& band : bands)
+  {
+    for(int i = 0; i < band.loops.size(); ++i)
+      append(contours, band.loops.contour(i));
+  }
+
+  // seams: each chain is followed by the one going in by the side it left by
+  struct ChainRef
+  {
+    int band, chain;
+  };
+
+  std::vector<ChainRef> chains;
+  for(int b = 0; b < (int)bands.size(); ++b)
+  {
+    for(int c = 0; c < (int)bands[b].chains.size(); ++c)
+      chains.push_back({b, c});
+  }
+
+  auto chainOf = [&](ChainRef ref) -> const Chain& { return bands[ref.band].chains[ref.chain]; };
+  std::sort(chains.begin(), chains.end(),
+        [&](ChainRef a, ChainRef b) { return chainOf(a).entryKey < chainOf(b).entryKey; });
+
+  std::vector<uint8_t> used(chains.size());
+  for(int i = 0; i < (int)chains.size(); ++i)
+  {
+    if(used[i])
+      continue;
+
+    int k = i;
+    do
+    {
+      used[k] = 1;
+      const Chain& chain = chainOf(chains[k]);
+      const Vec2* points = bands[chains[k].band].chainVertices.data() + chain.first;
+
+      // the first point is the last one of the previous chain
+      contours.vertices.insert(contours.vertices.end(), points + 1, points + chain.count);
+
+      auto next = std::lower_bound(chains.begin(), chains.end(), chain.exitKey,
+            [&](ChainRef ref, int key) { return chainOf(ref).entryKey < key; });
+      k = int(next - chains.begin());
+    } while(k != i);
+
+    contours.start.push_back(contours.vertices.size());
+  }
+
+  if(options.simplifyTolerance < 0)
+    return contours;
+
+  // the first vertex is both ends of the polyline
+  std::vector<std::vector<Vec2>> simplified(contours.size());
+  parallelFor(contours.size(), options.threadCount,
+        [&](int i)
+        {
+          const auto contour = contours.contour(i);
+          std::vector<Vec2> closed(contour.begin(), contour.end());
+          closed.push_back(contour[0]);
+
+          for(int k : simplifyPolyline_DouglasPeucker(closed, options.simplifyTolerance))
+            simplified[i].push_back(closed[k]);
+          simplified[i].pop_back();
+        });
+
+  Contours result;
+  for(auto& contour : simplified)
+    append(result, contour);
+  return result;
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+// Contour extraction from masks (e.g collision meshes from images), with marching squares.
+
+#include "core/geom.h"
+
+#include <vector>
+
+#include "bit_grid.h"
+
+struct ContourOptions
+{
+  // Douglas-Peucker tolerance, in cells. Zero only removes aligned vertices, negative keeps them all.
+  float simplifyTolerance = -1;
+
+  // the grid is cut into bands of this many rows, traced independently then stitched together
+  int bandHeight = 256;
+
+  // 0: one per hardware thread
+  int threadCount = 1;
+};
+
+// Closed polygons, stored one after the other: the contour i is vertices[start[i]] ... vertices[start[i + 1] - 1].
+// The first vertex isn't repeated at the end.
+struct Contours
+{
+  std::vector<Vec2> vertices;
+  std::vector<int> start = {0};
+
+  int size() const { return int(start.size()) - 1; }
+  span<const Vec2> contour(int i) const { return {size_t(start[i + 1] - start[i]), vertices.data() + start[i]}; }
+};
+
+// The borders between set and clear cells, with the set cells on the left: outer borders are
+// counter-clockwise, holes clockwise. Outside of the grid is clear.
+// The samples are the cell centers, so the vertices are at the middle of cell sides, and corners are cut.
+// Cells only touching by a corner are separate.
+// Each segment is found from a case table, and linked to the next one through the side they share:
+// no search, O(cells).
+Contours extractContours(const BitGrid& mask, const ContourOptions& options);
@@ -0,0 +1,491 @@
+#include "convex_csg.h"
+
+#include <algorithm>
+#include <cmath>
+#include <utility>
+#include <vector>
+
+namespace
+{
+// fragments smaller than this are slivers left by rounding: they're dropped
+constexpr auto minArea = 1e-4f;
+
+// consecutive vertices closer than this are welded
+constexpr auto weldDistance = 1e-5f;
+
+// vertices of two fragments closer than this are the same
+constexpr auto sharedDistance = 1e-4f;
+
+// an overlap thinner than this doesn't count
+constexpr auto separationTolerance = 1e-5f;
+
+// the relative error between two areas, for them to be the same
+constexpr auto areaTolerance = 1e-4;
+
+double doubleArea(span<const Vec2> polygon)
+{
+  double r = 0;
+  for(int i = 0; i < (int)polygon.len; ++i)
+  {
+    const Vec2 a = polygon[i];
+    const Vec2 b = polygon[(i + 1) % polygon.len];
+    r += double(a.x) * b.y - double(a.y) * b.x;
+  }
+  return r;
+}
+
+Plane flipped(Plane plane) { return {-plane.normal, -plane.dist}; }
+
+Plane edgePlane(Vec2 a, Vec2 b)
+{
+  const auto N = normalize(-rotateLeft(b - a));
+  return {N, dotProduct(N, a)};
+}
+
+// Closes the polygon being appended to 'set' since 'first': returns false,
+// and removes it, if it's degenerate.
+bool finishPolygon(ConvexSet& set, size_t first)
+{
+  // the last vertex is welded to the first one
+  while(set.vertices.size() - first > 1 && magnitude(set.vertices.back() - set.vertices[first]) <= weldDistance)
+  {
+    set.vertices.pop_back();
+    set.planes.pop_back();
+  }
+
+  const int count = set.vertices.size() - first;
+  if(count < 3 || doubleArea({size_t(count), set.vertices.data() + first}) < 2 * minArea)
+  {
+    set.vertices.resize(first);
+    set.planes.resize(first);
+    return false;
+  }
+
+  BoundingBox box;
+  for(size_t i = first; i < set.vertices.size(); ++i)
+    box.add(set.vertices[i]);
+
+  set.start.push_back(set.vertices.size());
+  set.boxes.push_back(box);
+  return true;
+}
+
+// Appends to 'set' the part of the polygon 'i' of 'source' behind 'cut'.
+// Returns false if there's nothing left.
+bool addClipped(ConvexSet& set, const ConvexSet& source, int i, Plane cut)
+{
+  const auto vertices = source.verticesOf(i);
+  const auto planes = source.planesOf(i);
+  const int n = vertices.len;
+  const size_t first = set.vertices.size();
+
+  auto emit = [&](Vec2 v, Plane plane)
+  {
+    if(set.vertices.size() > first && magnitude(v - set.vertices.back()) <= weldDistance)
+    {
+      // the previous edge is negligible: the one from 'v' starts there instead
+      set.planes.back() = plane;
+      return;
+    }
+
+    set.vertices.push_back(v);
+    set.planes.push_back(plane);
+  };
+
+  for(int k = 0; k < n; ++k)
+  {
+    const Vec2 a = vertices[k];
+    const Vec2 b = vertices[(k + 1) % n];
+    const float da = dotProduct(a, cut.normal) - cut.dist;
+    const float db = dotProduct(b, cut.normal) - cut.dist;
+
+    if(da <= 0)
+      emit(a, planes[k]);
+
+    // the edge goes out: the cut follows. Or it comes back in.
+    if((da <= 0) != (db <= 0))
+      emit(a + (b - a) * (da / (da - db)), da <= 0 ? cut : planes[k]);
+  }
+
+  return finishPolygon(set, first);
+}
+
+// Whether some plane of one polygon has the other one entirely in front of it
+bool areSeparated(const ConvexSet& a, int i, const ConvexSet& b, int j)
+{
+  auto isSeparatingPlane = [](Plane plane, span<const Vec2> vertices)
+  {
+    for(auto v : vertices)
+    {
+      if(dotProduct(v, plane.normal) - plane.dist < -separationTolerance)
+        return false;
+    }
+    return true;
+  };
+
+  for(auto plane : a.planesOf(i))
+  {
+    if(isSeparatingPlane(plane, b.verticesOf(j)))
+      return true;
+  }
+
+  for(auto plane : b.planesOf(j))
+  {
+    if(isSeparatingPlane(plane, a.verticesOf(i)))
+      return true;
+  }
+
+  return false;
+}
+
+// Sweep and prune along x: the boxes sorted by min.x, and the running maximum of their max.x,
+// so the first one which can reach a box is found by binary search.
+void buildBroadphase(const ConvexSet& set, ConvexCsgBuffers& buffers)
+{
+  auto& sorted = buffers.sorted;
+  sorted.resize(set.size());
+  for(int i = 0; i < set.size(); ++i)
+    sorted[i] = i;
+
+  std::sort(sorted.begin(), sorted.end(), [&](int a, int b) { return set.boxes[a].min.x < set.boxes[b].min.x; });
+
+  buffers.maxX.resize(sorted.size());
+  float maxX = -1.0 / 0.0;
+  for(int i = 0; i < (int)sorted.size(); ++i)
+  {
+    maxX = std::max(maxX, set.boxes[sorted[i]].max.x);
+    buffers.maxX[i] = maxX;
+  }
+}
+
+void findCandidates(const ConvexSet& set, const BoundingBox& box, ConvexCsgBuffers& buffers)
+{
+  buffers.candidates.clear();
+
+  const auto& sorted = buffers.sorted;
+  int k = std::lower_bound(buffers.maxX.begin(), buffers.maxX.end(), box.min.x) - buffers.maxX.begin();
+  for(; k < (int)sorted.size() && set.boxes[sorted[k]].min.x <= box.max.x; ++k)
+  {
+    if(overlaps(set.boxes[sorted[k]], box))
+      buffers.candidates.push_back(sorted[k]);
+  }
+}
+
+void subtractInto(const ConvexSet& a, const ConvexSet& b, ConvexSet& result, ConvexCsgBuffers& buffers)
+{
+  buildBroadphase(b, buffers);
+
+  ConvexSet& work = buffers.pieces[0];
+  ConvexSet& next = buffers.pieces[1];
+
+  // the part still inside of the subtrahend, cut plane after plane
+  ConvexSet& inside = buffers.inside[0];
+  ConvexSet& insideNext = buffers.inside[1];
+
+  for(int i = 0; i < a.size(); ++i)
+  {
+    findCandidates(b, a.boxes[i], buffers);
+
+    if(buffers.candidates.empty())
+    {
+      result.addFrom(a, i);
+      continue;
+    }
+
+    work.clear();
+    work.addFrom(a, i);
+
+    for(auto c : buffers.candidates)
+    {
+      next.clear();
+
+      for(int w = 0; w < work.size(); ++w)
+      {
+        if(!overlaps(work.boxes[w], b.boxes[c]) || areSeparated(work, w, b, c))
+        {
+          next.addFrom(work, w);
+          continue;
+        }
+
+        inside.clear();
+        inside.addFrom(work, w);
+
+        for(auto plane : b.planesOf(c))
+        {
+          // what's in front of the plane is outside of 'c': it's kept
+          addClipped(next, inside, 0, flipped(plane));
+
+          insideNext.clear();
+          if(!addClipped(insideNext, inside, 0, plane))
+            break;
+
+          std::swap(inside, insideNext);
+        }
+      }
+
+      std::swap(work, next);
+    }
+
+    for(int w = 0; w < work.size(); ++w)
+      result.addFrom(work, w);
+  }
+}
+
+int countSharedVertices(span<const Vec2> a, span<const Vec2> b)
+{
+  int count = 0;
+  for(auto u : a)
+  {
+    for(auto v : b)
+    {
+      if(magnitude(u - v) <= sharedDistance)
+      {
+        ++count;
+        break;
+      }
+    }
+  }
+  return count;
+}
+
+// Convex hull of 'points' (monotone chain), counter-clockwise
+void convexHull(std::vector<Vec2>& points, std::vector<Vec2>& hull)
+{
+  std::sort(points.begin(), points.end(), [](Vec2 a, Vec2 b) { return a.x < b.x || (a.x == b.x && a.y < b.y); });
+
+  auto cross = [](Vec2 o, Vec2 a, Vec2 b)
+  { return double(a.x - o.x) * double(b.y - o.y) - double(a.y - o.y) * double(b.x - o.x); };
+
+  hull.clear();
+
+  // lower chain, then upper chain
+  for(int pass = 0; pass < 2; ++pass)
+  {
+    const size_t chainStart = hull.size();
+    for(auto p : points)
+    {
+      while(hull.size() >= chainStart + 2 && cross(hull[hull.size() - 2], hull.back(), p) <= 0)
+        hull.pop_back();
+      hull.push_back(p);
+    }
+
+    hull.pop_back(); // it starts the other chain
+    std::reverse(points.begin(), points.end());
+  }
+}
+}
+
+void ConvexSet::clear()
+{
+  vertices.clear();
+  planes.clear();
+  start.resize(1);
+  boxes.clear();
+}
+
+void ConvexSet::addHalfPlanes(span<const Plane> halfPlanes)
+{
+  // Clipped from a huge box, in double precision: the corners of the box are too far
+  // for float intersections to be accurate. The box planes stay only if unbounded.
+  struct Corner
+  {
+    double x, y;
+    int plane; // of the edge from this corner, -1 for the box
+  };
+
+  const double far = 1e7;
+  std::vector<Corner> corners = {{-far, -far, -1}, {far, -far, -1}, {far, far, -1}, {-far, far, -1}};
+  std::vector<Corner> clipped;
+
+  for(int p = 0; p < (int)halfPlanes.len && corners.size(); ++p)
+  {
+    const Plane cut = halfPlanes[p];
+    auto distance = [&](const Corner& c) { return c.x * cut.normal.x + c.y * cut.normal.y - cut.dist; };
+
+    clipped.clear();
+    for(int k = 0; k < (int)corners.size(); ++k)
+    {
+      const Corner& a = corners[k];
+      const Corner& b = corners[(k + 1) % corners.size()];
+      const double da = distance(a);
+      const double db = distance(b);
+
+      if(da <= 0)
+        clipped.push_back(a);
+
+      if((da <= 0) != (db <= 0))
+      {
+        const double t = da / (da - db);
+        clipped.push_back({a.x + (b.x - a.x) * t, a.y + (b.y - a.y) * t, da <= 0 ? p : a.plane});
+      }
+    }
+
+    std::swap(corners, clipped);
+  }
+
+  const size_t first = vertices.size();
+  for(int k = 0; k < (int)corners.size(); ++k)
+  {
+    const Vec2 v{float(corners[k].x), float(corners[k].y)};
+    const auto& next = corners[(k + 1) % corners.size()];
+    const Plane plane =
+          corners[k].plane >= 0 ? halfPlanes[corners[k].plane] : edgePlane(v, Vec2{float(next.x), float(next.y)});
+
+    if(vertices.size() > first && magnitude(v - vertices.back()) <= weldDistance)
+    {
+      planes.back() = plane;
+      continue;
+    }
+
+    vertices.push_back(v);
+    planes.push_back(plane);
+  }
+
+  finishPolygon(*this, first);
+}
+
+void ConvexSet::addPolygon(span<const Vec2> polygon)
+{
+  const size_t first = vertices.size();
+  for(auto v : polygon)
+  {
+    if(vertices.size() > first && magnitude(v - vertices.back()) <= weldDistance)
+      continue;
+
+    vertices.push_back(v);
+  }
+
+  // the last vertex could still be welded to the first one
+  while(vertices.size() - first > 1 && magnitude(vertices.back() - vertices[first]) <= weldDistance)
+    vertices.pop_back();
+
+  for(size_t k = first; k < vertices.size(); ++k)
+    planes.push_back(edgePlane(vertices[k], vertices[k + 1 < vertices.size() ? k + 1 : first]));
+
+  finishPolygon(*this, first);
+}
+
+void ConvexSet::addFrom(const ConvexSet& other, int i)
+{
+  vertices.insert(vertices.end(), other.vertices.begin() + other.start[i], other.vertices.begin() + other.start[i + 1]);
+  planes.insert(planes.end(), other.planes.begin() + other.start[i], other.planes.begin() + other.start[i + 1]);
+  start.push_back(vertices.size());
+  boxes.push_back(other.boxes[i]);
+}
+
+void subtract(const ConvexSet& a, const ConvexSet& b, ConvexSet& result, ConvexCsgBuffers& buffers)
+{
+  result.clear();
+  subtractInto(a, b, result, buffers);
+}
+
+void intersect(const ConvexSet& a, const ConvexSet& b, ConvexSet& result, ConvexCsgBuffers& buffers)
+{
+  result.clear();
+  buildBroadphase(b, buffers);
+
+  ConvexSet& inside = buffers.inside[0];
+  ConvexSet& insideNext = buffers.inside[1];
+
+  for(int i = 0; i < a.size(); ++i)
+  {
+    findCandidates(b, a.boxes[i], buffers);
+
+    for(auto c : buffers.candidates)
+    {
+      if(areSeparated(a, i, b, c))
+        continue;
+
+      inside.clear();
+      inside.addFrom(a, i);
+
+      bool empty = false;
+      for(auto plane : b.planesOf(c))
+      {
+        insideNext.clear();
+        if(!addClipped(insideNext, inside, 0, plane))
+        {
+          empty = true;
+          break;
+        }
+
+        std::swap(inside, insideNext);
+      }
+
+      if(!empty)
+        result.addFrom(inside, 0);
+    }
+  }
+}
+
+void unite(const ConvexSet& a, const ConvexSet& b, ConvexSet& result, ConvexCsgBuffers& buffers)
+{
+  result.clear();
+
+  for(int i = 0; i < a.size(); ++i)
+    result.addFrom(a, i);
+
+  subtractInto(b, a, result, buffers);
+}
+
+void mergeFragments(ConvexSet& set, ConvexCsgBuffers& buffers)
+{
+  ConvexSet& merged = buffers.pieces[0];
+  ConvexSet& current = buffers.inside[0];
+
+  bool changed = true;
+  while(changed)
+  {
+    changed = false;
+
+    buildBroadphase(set, buffers);
+    buffers.removed.assign(set.size(), 0);
+    merged.clear();
+
+    for(int i = 0; i < set.size(); ++i)
+    {
+      if(buffers.removed[i])
+        continue;
+
+      current.clear();
+      current.addFrom(set, i);
+      double currentArea = doubleArea(current.verticesOf(0));
+
+      findCandidates(set, set.boxes[i], buffers);
+      for(auto j : buffers.candidates)
+      {
+        if(j <= i || buffers.removed[j])
+          continue;
+
+        // the union can only be convex if they share the two ends of an edge
+        const auto other = set.verticesOf(j);
+        if(countSharedVertices(current.verticesOf(0), other) < 2)
+          continue;
+
+        // the fragments are disjoint: their union is convex if it fills their hull
+        auto& points = buffers.points;
+        points.clear();
+        points.insert(points.end(), current.vertices.begin(), current.vertices.end());
+        points.insert(points.end(), other.begin(), other.end());
+
+        convexHull(points, buffers.hull);
+
+        const double otherArea = doubleArea(other);
+        const double hullArea = doubleArea(buffers.hull);
+        if(hullArea > (currentArea + otherArea) * (1 + areaTolerance))
+          continue;
+
+        current.clear();
+        current.addPolygon(buffers.hull);
+        currentArea = hullArea;
+        buffers.removed[j] = 1;
+        changed = true;
+      }
+
+      if(current.size())
+        merged.addFrom(current, 0);
+    }
+
+    std::swap(set, merged);
+  }
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+// Boolean operations over sets of convex polygons (e.g destructible geometry).
+// The result of each operation is a set of disjoint convex fragments.
+
+#include "core/geom.h"
+
+#include <cstdint>
+#include <vector>
+
+#include "bounding_box.h"
+#include "split_polygon.h" // Plane
+
+// Many convex polygons, stored one after the other.
+// The polygon i is vertices[start[i]] ... vertices[start[i + 1] - 1], counter-clockwise.
+// planes[k] holds its edge from vertices[k] to the next vertex: the polygon is behind all its planes.
+struct ConvexSet
+{
+  std::vector<Vec2> vertices;
+  std::vector<Plane> planes;
+  std::vector<int> start = {0};
+  std::vector<BoundingBox> boxes;
+
+  int size() const { return int(boxes.size()); }
+
+  span<const Vec2> verticesOf(int i) const { return {size_t(start[i + 1] - start[i]), vertices.data() + start[i]}; }
+  span<const Plane> planesOf(int i) const { return {size_t(start[i + 1] - start[i]), planes.data() + start[i]}; }
+
+  void clear();
+
+  // The intersection of the half-planes behind 'halfPlanes', which must be bounded.
+  // Nothing is added if it's empty.
+  void addHalfPlanes(span<const Plane> halfPlanes);
+
+  // A counter-clockwise convex polygon
+  void addPolygon(span<const Vec2> polygon);
+
+  // The polygon i of 'other', as is
+  void addFrom(const ConvexSet& other, int i);
+};
+
+// Temporary storage of the operations: keeping it from one call to the next avoids most allocations.
+struct ConvexCsgBuffers
+{
+  ConvexSet pieces[2];
+  ConvexSet inside[2]; // the part of a polygon still inside of the one cutting it
+  std::vector<int> sorted; // broadphase: the polygons of a set, by increasing box.min.x
+  std::vector<float> maxX; // broadphase: the highest box.max.x up to each position in 'sorted'
+  std::vector<int> candidates;
+  std::vector<Vec2> points;
+  std::vector<Vec2> hull;
+  std::vector<uint8_t> removed; // by polygon, when merging
+};
+
+// The parts of 'a' outside of all the polygons of 'b'. 'result' is overwritten.
+// Only the pairs whose boxes overlap are cut, and each cut stops as soon as nothing is left inside.
+void subtract(const ConvexSet& a, const ConvexSet& b, ConvexSet& result, ConvexCsgBuffers& buffers);
+
+// The parts of 'a' inside a polygon of 'b' (one fragment per overlapping pair,
+// so 'b' should be disjoint for the fragments to be). 'result' is overwritten.
+void intersect(const ConvexSet& a, const ConvexSet& b, ConvexSet& result, ConvexCsgBuffers& buffers);
+
+// 'a', then the parts of 'b' outside of 'a'. 'result' is overwritten.
+void unite(const ConvexSet& a, const ConvexSet& b, ConvexSet& result, ConvexCsgBuffers& buffers);
+
+// Replaces the pairs of fragments whose union is convex by that union, until there's none left.
+// Keeps the piece count from growing with each cut.
+void mergeFragments(ConvexSet& set, ConvexCsgBuffers& buffers);
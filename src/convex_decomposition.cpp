@@ -0,0 +1,616 @@
+#include "convex_decomposition.h"
+
+#include "core/sandbox.h"
+#include "core/zones.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#include "predicates.h"
+#include "triangulate_polygon.h"
+
+namespace
+{
+// same tolerance as split_polygon.cpp
+constexpr auto epsilon = 0.01f;
+
+// at most this many cutting planes are tried for each piece
+const int MaxCandidatePlanes = 16;
+
+struct Line
+{
+  Vec2 normal; // to the outside of the face it comes from
+  float dist;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+// Recursive cuts
+
+struct Piece
+{
+  int first; // in 'faces'
+  int count;
+  int reflexCount;
+
+  bool contains(int face) const { return face >= first && face < first + count; }
+};
+
+struct Splitter
+{
+  // shared by all the pieces
+  std::vector<Vec2> vertices;
+  std::vector<Face> faces; // with the interior on their left
+  std::vector<uint8_t> reflex; // by face: the vertex it arrives at is reflex
+
+  // by vertex, only meaningful for the piece being cut
+  std::vector<int> outFace;
+  std::vector<int> inDegree;
+  std::vector<int> outDegree;
+  std::vector<uint8_t> touched; // on the cut
+
+  std::vector<int> touchedVertices;
+  std::vector<int> onLine;
+  std::vector<int> cutVertices; // by face of the piece being cut, -1 if it doesn't cross the line
+  std::vector<int> orphans;
+  std::vector<Face> sideFaces;
+  std::vector<uint8_t> sideReflex;
+  std::vector<uint8_t> emitted;
+
+  int addVertex(Vec2 v)
+  {
+    vertices.push_back(v);
+    outFace.push_back(-1);
+    inDegree.push_back(0);
+    outDegree.push_back(0);
+    touched.push_back(0);
+    return int(vertices.size()) - 1;
+  }
+
+  // 'b' is reflex between the faces (a, b) and (b, c), if c is outside of (a, b), with some tolerance
+  bool isReflex(int a, int b, int c) const
+  {
+    const Vec2 T = vertices[b] - vertices[a];
+    const float length = magnitude(T);
+    if(length == 0)
+      return false;
+
+    const Vec2 N = rotateLeft(T) * (1.0f / length); // to the inside
+    return dotProduct(vertices[c] - vertices[b], N) < -epsilon;
+  }
+
+  void linkFaces(int first, int count)
+  {
+    for(int i = first; i < first + count; ++i)
+      outFace[faces[i].a] = i;
+  }
+
+  Piece addPiece(span<const Face> pieceFaces, span<const uint8_t> pieceReflex)
+  {
+    Piece piece{int(faces.size()), int(pieceFaces.len), 0};
+    faces.insert(faces.end(), pieceFaces.begin(), pieceFaces.end());
+    reflex.insert(reflex.end(), pieceReflex.begin(), pieceReflex.end());
+
+    for(auto r : pieceReflex)
+      piece.reflexCount += r;
+
+    return piece;
+  }
+
+  Piece addInput(const Polygon2f& polygon)
+  {
+    // the faces follow the loops, with the interior on their left
+    PolygonRings rings;
+    toRings(polygon, rings);
+    if(rings.signedArea() < 0)
+      rings.reverse();
+
+    for(auto v : polygon.vertices)
+      addVertex(v);
+
+    sideFaces.clear();
+    sideReflex.clear();
+    for(int k = 0; k < rings.size(); ++k)
+    {
+      const int next = rings.next[k];
+      sideFaces.push_back({rings.vertexOf[k], rings.vertexOf[next]});
+      sideReflex.push_back(isReflex(rings.vertexOf[k], rings.vertexOf[next], rings.vertexOf[rings.next[next]]));
+    }
+
+    return addPiece(sideFaces, sideReflex);
+  }
+
+  bool isSingleLoop(const Piece& piece)
+  {
+    linkFaces(piece.first, piece.count);
+
+    int length = 0;
+    int f = piece.first;
+    do
+    {
+      f = outFace[faces[f].b];
+      ++length;
+    } while(f != piece.first && piece.contains(f) && length <= piece.count);
+
+    return length == piece.count;
+  }
+
+  // the number of vertices of the piece on the least populated side of 'line'
+  int splitScore(const Piece& piece, Line line) const
+  {
+    // the vertices on the line are on both sides: they don't make a side less empty
+    int frontCount = 0;
+    int backCount = 0;
+    for(int g = piece.first; g < piece.first + piece.count; ++g)
+    {
+      const float d = dotProduct(vertices[faces[g].a], line.normal) - line.dist;
+      if(d > epsilon)
+        frontCount++;
+      else if(d < -epsilon)
+        backCount++;
+    }
+
+    return std::min(frontCount, backCount);
+  }
+
+  // The line of the face which splits the vertices of the piece the most evenly.
+  // Only the faces arriving at a reflex vertex are tried: cutting there makes it convex.
+  // If none of them splits the piece (e.g a spike, whose short face has all the piece in front of it),
+  // every face is tried, then the bisector of each reflex vertex.
+  // Returns false if no line splits the piece.
+  bool chooseCuttingLine(const Piece& piece, Line& bestLine)
+  {
+    int bestScore = 0;
+    auto tryLine = [&](Line line)
+    {
+      const int score = splitScore(piece, line);
+      if(score > bestScore)
+      {
+        bestScore = score;
+        bestLine = line;
+      }
+    };
+
+    auto faceLine = [&](int f, Line& line)
+    {
+      const Vec2 a = vertices[faces[f].a];
+      const Vec2 b = vertices[faces[f].b];
+      if(magnitude(b - a) == 0)
+        return false;
+
+      const auto N = normalize(-rotateLeft(b - a));
+      line = Line{N, dotProduct(N, a)};
+      return true;
+    };
+
+    const int candidateCount = piece.reflexCount ? piece.reflexCount : piece.count;
+    const int stride = std::max(1, candidateCount / MaxCandidatePlanes);
+
+    int candidate = 0;
+    Line line;
+    for(int f = piece.first; f < piece.first + piece.count; ++f)
+    {
+      if(piece.reflexCount && !reflex[f])
+        continue;
+
+      if(candidate++ % stride)
+        continue;
+
+      if(faceLine(f, line))
+        tryLine(line);
+    }
+
+    if(bestScore > 0 || piece.reflexCount == 0)
+      return bestScore > 0;
+
+    for(int f = piece.first; f < piece.first + piece.count; ++f)
+    {
+      if(faceLine(f, line))
+        tryLine(line);
+    }
+
+    if(bestScore > 0)
+      return true;
+
+    // both sides of the bisector have an angle of less than 180 degrees at the vertex
+    linkFaces(piece.first, piece.count);
+    for(int f = piece.first; f < piece.first + piece.count; ++f)
+    {
+      const int next = outFace[faces[f].b];
+      if(!reflex[f] || !piece.contains(next))
+        continue;
+
+      const Vec2 b = vertices[faces[f].b];
+      const Vec2 toA = vertices[faces[f].a] - b;
+      const Vec2 toC = vertices[faces[next].b] - b;
+      if(magnitude(toA) == 0 || magnitude(toC) == 0)
+        continue;
+
+      auto bisector = normalize(toA) + normalize(toC);
+      bisector = magnitude(bisector) > 0 ? bisector : rotateLeft(toC);
+
+      const auto N = normalize(rotateLeft(bisector));
+      tryLine(Line{N, dotProduct(N, b)});
+    }
+
+    return bestScore > 0;
+  }
+
+  void touch(int v)
+  {
+    if(!touched[v])
+    {
+      touched[v] = 1;
+      touchedVertices.push_back(v);
+    }
+  }
+
+  // 'side' is 1 for the front (where the normal points to), -1 for the back
+  void addSideFace(int side, int sideOfFace, int a, int b, int f)
+  {
+    if(side != sideOfFace)
+      return;
+
+    sideFaces.push_back({a, b});
+    sideReflex.push_back(f >= 0 ? reflex[f] : 0);
+  }
+
+  // Builds one side of the cut: the faces (or parts of faces) on that side,
+  // then the faces along the line, linking the ends of the cut two by two.
+  Piece buildSide(const Piece& piece, Line line, int side, span<const int> cutVertices)
+  {
+    sideFaces.clear();
+    sideReflex.clear();
+
+    auto distance = [&](int v) { return dotProduct(vertices[v], line.normal) - line.dist; };
+    auto sideOf = [&](float d) { return d > epsilon ? 1 : d < -epsilon ? -1 : 0; };
+
+    for(int i = 0; i < piece.count; ++i)
+    {
+      const int f = piece.first + i;
+      const auto face = faces[f];
+      const int sa = sideOf(distance(face.a));
+      const int sb = sideOf(distance(face.b));
+
+      if(sa == 0 && sb == 0)
+        continue; // along the line: added back when closing
+
+      if(sa >= 0 && sb >= 0)
+        addSideFace(side, 1, face.a, face.b, f);
+      else if(sa <= 0 && sb <= 0)
+        addSideFace(side, -1, face.a, face.b, f);
+      else
+      {
+        // the face is crossing the line: the cut vertex stays at the same place on it
+        // for both sides, and the direction of the face doesn't change
+        const int cut = cutVertices[i];
+        addSideFace(side, sa, face.a, cut, -1);
+        addSideFace(side, sb, cut, face.b, f);
+      }
+    }
+
+    // In a side, every vertex has one face arriving and one face leaving, except the ends of the cut
+    for(auto& face : sideFaces)
+    {
+      if(touched[face.a])
+        outDegree[face.a]++;
+      if(touched[face.b])
+        inDegree[face.b]++;
+    }
+
+    orphans.clear();
+    for(auto v : touchedVertices)
+    {
+      if(inDegree[v] != outDegree[v])
+        orphans.push_back(v);
+    }
+
+    // the interior is on the left of the new faces
+    const auto T = rotateLeft(line.normal) * float(-side);
+    auto byTangentCoord = [&](int a, int b) { return dotProduct(vertices[a], T) < dotProduct(vertices[b], T); };
+    std::sort(orphans.begin(), orphans.end(), byTangentCoord);
+
+    for(int i = 0; i + 1 < (int)orphans.size(); i += 2)
+    {
+      int a = orphans[i];
+      int b = orphans[i + 1];
+      if(outDegree[a] > inDegree[a])
+        std::swap(a, b);
+
+      sideFaces.push_back({a, b});
+      sideReflex.push_back(0);
+    }
+
+    // the vertices on the cut have new faces around them
+    for(int i = 0; i < (int)sideFaces.size(); ++i)
+    {
+      if(touched[sideFaces[i].a])
+        outFace[sideFaces[i].a] = i;
+    }
+
+    for(int i = 0; i < (int)sideFaces.size(); ++i)
+    {
+      const auto face = sideFaces[i];
+      if(!touched[face.b])
+        continue;
+
+      const int next = outFace[face.b];
+      sideReflex[i] = next >= 0 && isReflex(face.a, face.b, sideFaces[next].b);
+    }
+
+    for(auto v : touchedVertices)
+    {
+      inDegree[v] = 0;
+      outDegree[v] = 0;
+      outFace[v] = -1;
+    }
+
+    return addPiece(sideFaces, sideReflex);
+  }
+
+  void cut(const Piece& piece, Line line, Piece& front, Piece& back)
+  {
+    auto distance = [&](int v) { return dotProduct(vertices[v], line.normal) - line.dist; };
+
+    // the vertices on the line
+    touchedVertices.clear();
+    for(int i = 0; i < piece.count; ++i)
+    {
+      const int v = faces[piece.first + i].a;
+      if(std::abs(distance(v)) <= epsilon)
+        touch(v);
+    }
+
+    // sorted along the line, to find the one a face crosses at, if any
+    const auto T = rotateLeft(line.normal);
+    auto tangentCoord = [&](int v) { return dotProduct(vertices[v], T); };
+    onLine = touchedVertices;
+    std::sort(onLine.begin(), onLine.end(), [&](int a, int b) { return tangentCoord(a) < tangentCoord(b); });
+
+    auto findOnLine = [&](Vec2 p)
+    {
+      const float t = dotProduct(p, T);
+      auto i = std::lower_bound(onLine.begin(), onLine.end(), t - epsilon,
+            [&](int v, float value) { return tangentCoord(v) < value; });
+
+      for(; i != onLine.end() && tangentCoord(*i) <= t + epsilon; ++i)
+      {
+        if(magnitude(vertices[*i] - p) <= epsilon)
+          return *i;
+      }
+
+      return -1;
+    };
+
+    // the new vertices where faces cross the line, unless it's at a vertex already there
+    // (when the boundary of the piece touches itself along a previous cut)
+    cutVertices.assign(piece.count, -1);
+    for(int i = 0; i < piece.count; ++i)
+    {
+      const auto face = faces[piece.first + i];
+      const float da = distance(face.a);
+      const float db = distance(face.b);
+
+      if((da > epsilon && db < -epsilon) || (da < -epsilon && db > epsilon))
+      {
+        const Vec2 a = vertices[face.a];
+        const Vec2 b = vertices[face.b];
+        const Vec2 p = a + (b - a) * (da / (da - db));
+
+        cutVertices[i] = findOnLine(p);
+        if(cutVertices[i] < 0)
+        {
+          cutVertices[i] = addVertex(p);
+          touch(cutVertices[i]);
+        }
+      }
+    }
+
+    front = buildSide(piece, line, 1, cutVertices);
+    back = buildSide(piece, line, -1, cutVertices);
+
+    for(auto v : touchedVertices)
+      touched[v] = 0;
+  }
+
+  void drawPiece(const Piece& piece, Color color)
+  {
+    for(int f = piece.first; f < piece.first + piece.count; ++f)
+      sandbox_line(vertices[faces[f].a], vertices[faces[f].b], color);
+  }
+
+  // Each loop of the piece is a convex polygon (a piece which couldn't be cut has more than one loop)
+  void appendLoops(const Piece& piece, ConvexDecomposition& r)
+  {
+    linkFaces(piece.first, piece.count);
+
+    emitted.assign(piece.count, 0);
+    for(int i = 0; i < piece.count; ++i)
+    {
+      const size_t start = r.indices.size();
+      for(int f = piece.first + i; piece.contains(f) && !emitted[f - piece.first]; f = outFace[faces[f].b])
+      {
+        emitted[f - piece.first] = 1;
+        r.indices.push_back(faces[f].a);
+      }
+
+      if(r.indices.size() - start < 3)
+        r.indices.resize(start); // degenerate
+      else
+        r.pieceStart.push_back(r.indices.size());
+    }
+  }
+};
+}
+
+ConvexDecomposition decomposeToConvex_Split(const Polygon2f& polygon)
+{
+  ConvexDecomposition r;
+  r.pieceStart.push_back(0);
+
+  if(polygon.faces.empty())
+  {
+    r.vertices = polygon.vertices;
+    return r;
+  }
+
+  Splitter splitter;
+
+  std::vector<Piece> stack;
+  stack.push_back(splitter.addInput(polygon));
+
+  while(stack.size())
+  {
+    const Piece piece = stack.back();
+    stack.pop_back();
+
+    if(piece.count == 0)
+      continue;
+
+    Line line{};
+    if((piece.reflexCount == 0 && splitter.isSingleLoop(piece)) || !splitter.chooseCuttingLine(piece, line))
+    {
+      // A reflex piece which no line splits has all its vertices within the tolerance of a line through
+      // each reflex vertex: it's a sliver thinner than the tolerance, dropped like the degenerate loops.
+      if(piece.reflexCount == 0)
+        splitter.appendLoops(piece, r);
+      else
+        sandbox_count("convexDecomposition: dropped slivers", 1);
+
+      continue;
+    }
+
+    Piece front, back;
+    splitter.cut(piece, line, front, back);
+
+    {
+      const auto T = rotateLeft(line.normal);
+      const auto p = line.normal * line.dist;
+      sandbox_line(p + T * 1000, p - T * 1000, Yellow);
+      splitter.drawPiece(front, Red);
+      splitter.drawPiece(back, Green);
+      sandbox_breakpoint();
+    }
+
+    stack.push_back(front);
+    stack.push_back(back);
+  }
+
+  r.vertices = std::move(splitter.vertices);
+  return r;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Hertel-Mehlhorn
+
+ConvexDecomposition decomposeToConvex_HertelMehlhorn(const Polygon2f& polygon)
+{
+  ConvexDecomposition r;
+  r.vertices = polygon.vertices;
+  r.pieceStart.push_back(0);
+
+  const auto mesh = triangulatePolygon_Monotone(polygon);
+  const auto& triangles = mesh.triangles;
+  const int halfEdgeCount = triangles.size() * 3;
+
+  // The half-edge 3t + i goes from triangles[t].vertices[i] to the next vertex.
+  // The pieces are cycles of half-edges, starting as the triangles.
+  std::vector<int> next(halfEdgeCount);
+  std::vector<int> prev(halfEdgeCount);
+  std::vector<bool> removed(halfEdgeCount);
+
+  auto origin = [&](int h) { return triangles[h / 3].vertices[h % 3]; };
+  auto destination = [&](int h) { return triangles[h / 3].vertices[(h % 3 + 1) % 3]; };
+  auto position = [&](int v) { return r.vertices[v]; };
+
+  for(int h = 0; h < halfEdgeCount; ++h)
+  {
+    next[h] = h - h % 3 + (h + 1) % 3;
+    prev[next[h]] = h;
+  }
+
+  auto twinOf = [&](int h)
+  {
+    const int t = triangles[h / 3].neighbours[h % 3];
+    if(t < 0)
+      return -1;
+
+    for(int i = 0; i < 3; ++i)
+    {
+      if(triangles[t].vertices[i] == destination(h))
+        return 3 * t + i;
+    }
+
+    return -1;
+  };
+
+  int removedCount = 0;
+  for(int h = 0; h < halfEdgeCount; ++h)
+  {
+    const int twin = twinOf(h);
+    if(twin < h)
+      continue;
+
+    // without the diagonal, the angles at both of its ends must stay convex
+    const int u = origin(h);
+    const int v = destination(h);
+    const bool convexAtU = orient2d(position(origin(prev[h])), position(u), position(destination(next[twin]))) >= 0;
+    const bool convexAtV = orient2d(position(origin(prev[twin])), position(v), position(destination(next[h]))) >= 0;
+
+    if(!convexAtU || !convexAtV)
+      continue;
+
+    next[prev[h]] = next[twin];
+    prev[next[twin]] = prev[h];
+    next[prev[twin]] = next[h];
+    prev[next[h]] = prev[twin];
+    removed[h] = removed[twin] = true;
+    ++removedCount;
+
+    sandbox_line(position(u), position(v), Red);
+  }
+
+  sandbox_breakpoint();
+
+  std::vector<bool> visited(halfEdgeCount);
+  for(int h = 0; h < halfEdgeCount; ++h)
+  {
+    if(removed[h] || visited[h])
+      continue;
+
+    for(int e = h; !visited[e]; e = next[e])
+    {
+      visited[e] = true;
+      r.indices.push_back(origin(e));
+    }
+
+    r.pieceStart.push_back(r.indices.size());
+  }
+
+  sandbox_count("removedDiagonals", removedCount);
+
+  return r;
+}
+
+std::vector<Polygon2f> toPolygons(const ConvexDecomposition& decomposition)
+{
+  std::vector<Polygon2f> r;
+
+  for(int i = 0; i + 1 < (int)decomposition.pieceStart.size(); ++i)
+  {
+    const int first = decomposition.pieceStart[i];
+    const int count = decomposition.pieceStart[i + 1] - first;
+
+    Polygon2f poly;
+    for(int k = 0; k < count; ++k)
+    {
+      poly.vertices.push_back(decomposition.vertices[decomposition.indices[first + k]]);
+      poly.faces.push_back({k, (k + 1) % count});
+    }
+
+    r.push_back(std::move(poly));
+  }
+
+  return r;
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+// Decomposition of a polygon into convex pieces.
+// The polygon is one or more loops of faces (see triangulate_polygon.h), in either orientation.
+
+#include "core/geom.h"
+
+#include <vector>
+
+#include "polygon.h"
+
+// The pieces share their vertices: those of the polygon, then the ones created by the cuts.
+// The piece i is the counter-clockwise loop indices[pieceStart[i]] ... indices[pieceStart[i + 1] - 1].
+struct ConvexDecomposition
+{
+  std::vector<Vec2> vertices;
+  std::vector<int> indices;
+  std::vector<int> pieceStart;
+};
+
+// Recursively cuts the polygon along the lines of its faces, through its reflex vertices, until all
+// the pieces are convex. Each piece is a range of faces, and knows which of its vertices are reflex:
+// only the vertices on a cut are checked again. When no face line splits a piece, the bisectors of its
+// reflex vertices are tried. Reflex pieces thinner than the tolerance, which no line splits, are dropped.
+ConvexDecomposition decomposeToConvex_Split(const Polygon2f& polygon);
+
+// Hertel-Mehlhorn: triangulates the polygon, then removes each diagonal which isn't needed
+// for both of its pieces to stay convex. No new vertex, and at most 4 times the optimal number of pieces.
+ConvexDecomposition decomposeToConvex_HertelMehlhorn(const Polygon2f& polygon);
+
+// Each piece, as a polygon of its own
+std::vector<Polygon2f> toPolygons(const ConvexDecomposition& decomposition);
@@ -1,75 +1,75 @@
 #include "algorithm_app.h"
 
+#include <atomic>
 #include <cassert>
 #include <chrono>
-#include <string>
+#include <condition_variable>
+#include <cstdio>
+#include <functional>
+#include <mutex>
+#include <thread>
 
+#include "allocations.h"
 #include "fiber.h"
+#include "frame_history.h"
+#include "profiling.h"
 #include "sandbox.h"
+#include "spsc_queue.h"
+#include "zones.h"
+
+bool gRunAlgorithmsInBackground = false;
 
 namespace
 {
 Vec3 to3d(Vec2 v) { return {v.x, v.y, 0}; }
 
-int64_t getSteadyClockMs()
+struct Visualizer : IVisualizer
 {
-  using namespace std::chrono;
-  auto elapsedTime = steady_clock::now().time_since_epoch();
-  return duration_cast<milliseconds>(elapsedTime).count();
-}
+  Visualizer(size_t historyMemoryCap = FrameHistory::DefaultMemoryCap)
+      : m_history(historyMemoryCap)
+  {
+  }
 
-int64_t getSteadyClockUs()
-{
-  using namespace std::chrono;
-  auto elapsedTime = steady_clock::now().time_since_epoch();
-  return duration_cast<microseconds>(elapsedTime).count();
-}
+  bool m_insideAlgorithmExecute = false;
+  FrameHistory m_history; // all the frames, including the one we're building
+  int m_shownFrame = -1; // the frame we're currently showing (-1: none)
 
-struct Visualizer : IVisualizer
-{
-  struct VisualLine
+  // Fast-forward: while 'm_discard' is set, primitives are dropped and breakpoints don't stop.
+  // 'm_stopAt' tells, for a given step number, whether fast-forwarding must stop there.
+  int m_stepCount = 0; // number of breakpoints reached since the beginning of the execution
+  bool m_discard = false;
+  std::function<bool(int)> m_stopAt;
+
+  void rect(Vec2 a, Vec2 b, Color color)
   {
-    Vec3 a, b;
-    Color color;
-  };
+    if(!m_discard)
+      m_history.rect(a, b, color);
+  }
 
-  struct VisualRect
+  void circle(Vec2 center, float radius, Color color)
   {
-    Vec2 a, b;
-    Color color;
-  };
+    if(!m_discard)
+      m_history.circle(center, radius, color);
+  }
 
-  struct VisualCircle
+  void text(Vec2 pos, const char* text, Color color)
   {
-    Vec2 center;
-    float radius;
-    Color color;
-  };
+    if(!m_discard)
+      m_history.text(pos, text, color);
+  }
 
-  struct VisualText
+  void line(Vec2 a, Vec2 b, Color c) override
   {
-    Vec2 pos;
-    std::string text;
-    Color color;
-  };
+    if(!m_discard)
+      m_history.line(to3d(a), to3d(b), c);
+  }
 
-  struct ScreenState
+  void line(Vec3 a, Vec3 b, Color c) override
   {
-    std::vector<VisualLine> lines;
-    std::vector<VisualRect> rects;
-    std::vector<VisualCircle> circles;
-    std::vector<VisualText> texts;
-  };
+    if(!m_discard)
+      m_history.line(a, b, c);
+  }
 
-  bool m_insideAlgorithmExecute = false;
-  ScreenState m_screen; // the frame we're building
-  ScreenState m_frontScreen; // the frame we're currently showing
-
-  void rect(Vec2 a, Vec2 b, Color color) { m_screen.rects.push_back({a, b, color}); }
-  void circle(Vec2 center, float radius, Color color) { m_screen.circles.push_back({center, radius, color}); }
-  void text(Vec2 pos, const char* text, Color color) { m_screen.texts.push_back({pos, text, color}); }
-  void line(Vec2 a, Vec2 b, Color c) override { m_screen.lines.push_back({to3d(a), to3d(b), c}); }
-  void line(Vec3 a, Vec3 b, Color c) override { m_screen.lines.push_back({a, b, c}); }
   void printf(const char* fmt, va_list args)
   {
     char buffer[4096]{};
@@ -81,45 +81,144 @@ struct Visualizer : IVisualizer
   void step() override
   {
     assert(m_insideAlgorithmExecute);
-    m_frontScreen = std::move(m_screen);
+    ++m_stepCount;
+
+    if(m_discard)
+    {
+      // only start capturing again for the step we must stop at
+      m_discard = !m_stopAt(m_stepCount + 1);
+      return;
+    }
+
+    // when fast-forwarding, we just captured the requested step
+    m_stopAt = nullptr;
+
+    m_history.commit();
+    m_shownFrame = m_history.frameCount() - 1;
     Fiber::yield();
   }
 
+  // Resumes execution without capturing any step, until 'stopAt(step)' returns true
+  // (this step is then captured and shown, as with normal stepping) or until the algorithm finishes.
+  void fastForward(std::function<bool(int)> stopAt)
+  {
+    m_stopAt = std::move(stopAt);
+    m_discard = !m_stopAt(m_stepCount + 1);
+  }
+
   void flush(IDrawer* drawer)
   {
-    for(auto& line : m_frontScreen.lines)
-      drawer->line(line.a, line.b, line.color);
+    if(m_shownFrame >= m_history.firstFrame() && m_shownFrame < m_history.frameCount())
+      m_history.replay(m_shownFrame, drawer);
+  }
+};
 
-    for(auto& rect : m_frontScreen.rects)
-      drawer->rect(rect.a, rect.b, rect.color);
+// Appends the primitives it receives to the frame being built in 'history'
+struct HistoryWriter : IDrawer
+{
+  explicit HistoryWriter(FrameHistory& history)
+      : m_history(history)
+  {
+  }
 
-    for(auto& circle : m_frontScreen.circles)
-      drawer->circle(circle.center, circle.radius, circle.color);
+  void line(Vec2 a, Vec2 b, Color c) override { m_history.line(to3d(a), to3d(b), c); }
+  void rect(Vec2 a, Vec2 b, Color c) override { m_history.rect(a, b, c); }
+  void circle(Vec2 center, float radius, Color c) override { m_history.circle(center, radius, c); }
+  void text(Vec2 pos, const char* text, Color c) override { m_history.text(pos, text, c); }
+  void line(Vec3 a, Vec3 b, Color c) override { m_history.line(a, b, c); }
+
+  FrameHistory& m_history;
+};
 
-    for(auto& text : m_frontScreen.texts)
-      drawer->text(text.pos, text.text.c_str(), text.color);
+enum class Command
+{
+  Step, // up to the next breakpoint
+  FastForward, // up to 'FastForwardStepCount' breakpoints later
+  RunToEnd,
+};
+
+// Background execution (see 'gRunAlgorithmsInBackground'): the fiber is only ever resumed
+// from the worker thread, which captures the steps in its own visualizer, then publishes each one,
+// once complete, through a lock-free queue. The UI thread never waits for the worker: 'draw' takes
+// whatever has been published. The worker only sleeps on the mutex when it has nothing to do.
+struct Worker
+{
+  explicit Worker(size_t historyMemoryCap)
+      : visu(historyMemoryCap)
+      , historyMemoryCap(historyMemoryCap)
+  {
   }
+
+  Visualizer visu;
+  const size_t historyMemoryCap;
+  std::thread thread;
+
+  std::mutex mutex;
+  std::condition_variable wakeUp;
+  Command command{};
+  bool hasCommand = false;
+  std::atomic<bool> quit{false};
+
+  // Set by the UI thread: the current run stops at the next breakpoint.
+  // An algorithm without breakpoints can't be stopped.
+  std::atomic<bool> cancel{false};
+
+  std::atomic<int> progress{0}; // breakpoints reached since the beginning of the execution
+  std::atomic<int> completedCommands{0};
+  std::atomic<bool> finished{false};
+
+  SpscQueue<std::unique_ptr<FrameHistory>, 16> frames; // to the UI thread, one captured step each
+  SpscQueue<std::unique_ptr<FrameHistory>, 16> recycled; // back to the worker, once replayed
 };
 
 struct AlgorithmApp : IApp
 {
-  AlgorithmApp(std::unique_ptr<AbstractAlgorithm> algo)
+  AlgorithmApp(std::unique_ptr<AbstractAlgorithm> algo, size_t historyMemoryCap)
       : m_algo(std::move(algo))
+      , m_background(gRunAlgorithmsInBackground)
+      , m_historyMemoryCap(historyMemoryCap)
+      , m_visuForAlgo(historyMemoryCap)
   {
     m_algo->init();
   }
 
+  ~AlgorithmApp()
+  {
+    if(m_worker)
+    {
+      m_worker->cancel = true;
+      {
+        std::unique_lock<std::mutex> lock(m_worker->mutex);
+        m_worker->quit = true;
+      }
+      m_worker->wakeUp.notify_one();
+      m_worker->thread.join();
+    }
+  }
+
   std::unique_ptr<AbstractAlgorithm> m_algo;
+  const bool m_background;
+  const size_t m_historyMemoryCap;
 
   void draw(IDrawer* drawer) override
   {
-    m_visuForFrame = {};
+    if(m_worker)
+      receiveSteps();
 
-    gVisualizer = &m_visuForFrame;
-    m_algo->display();
-    gVisualizer = gNullVisualizer;
+    // input and output only change from 'keydown' (or from the worker): 'display' is only called again after that
+    if(m_displayedVersion != m_version && !running())
+    {
+      m_visuForFrame.m_history.clear();
+
+      gVisualizer = &m_visuForFrame;
+      m_algo->display();
+      gVisualizer = gNullVisualizer;
 
-    m_visuForFrame.m_frontScreen = std::move(m_visuForFrame.m_screen);
+      m_visuForFrame.m_history.commit();
+      m_visuForFrame.m_shownFrame = 0;
+
+      m_displayedVersion = m_version;
+    }
 
     m_visuForFrame.flush(drawer);
     m_visuForAlgo.flush(drawer);
@@ -129,45 +228,275 @@ struct AlgorithmApp : IApp
 
   void executeFromFiber()
   {
+    auto& visu = *m_fiberVisu;
+
     // clear visualization
-    m_visuForAlgo.m_screen = {};
-    m_visuForAlgo.m_insideAlgorithmExecute = true;
+    visu.m_history.clear();
+    visu.m_shownFrame = -1;
+    visu.m_stepCount = 0;
+    visu.m_insideAlgorithmExecute = true;
 
     m_algo->execute();
 
-    // clear last step's visualisation
-    m_visuForAlgo.m_insideAlgorithmExecute = false;
-    m_visuForAlgo.m_frontScreen = {};
+    // hide last step's visualisation (it stays in the history)
+    visu.m_insideAlgorithmExecute = false;
+    visu.m_shownFrame = -1;
   }
 
   void processEvent(InputEvent inputEvent) override
   {
     if(inputEvent.pressed)
+    {
       keydown(inputEvent.key);
+      ++m_version;
+    }
   }
 
+  // while the worker runs, new steps can show up at any time
+  int contentVersion() override { return running() ? -1 : m_version; }
+
+  int m_version = 0;
+  int m_displayedVersion = -1;
+
   void keydown(Key key)
   {
+    if(running())
+    {
+      // the worker owns the algorithm until it stops: the keys running it stop it instead, at its next step
+      if(key == Key::Space || key == Key::Right || key == Key::Return || key == Key::PageDown)
+        m_worker->cancel = true;
+      return;
+    }
+
     if(key == Key::Home)
     {
       runProfiling();
     }
-    else if(key == Key::Space || key == Key::Return)
+    else if(key == Key::End)
     {
-      gVisualizer = &m_visuForAlgo;
+      runSweep();
+    }
+    else if(key == Key::Left)
+    {
+      // scrub backward through the recorded steps
+      auto& visu = m_visuForAlgo;
+      if(visu.m_shownFrame < 0)
+        visu.m_shownFrame = visu.m_history.frameCount() - 1;
+      else if(visu.m_shownFrame > visu.m_history.firstFrame())
+        visu.m_shownFrame--;
+    }
+    else if(key == Key::Right && m_visuForAlgo.m_shownFrame >= 0 &&
+          m_visuForAlgo.m_shownFrame + 1 < m_visuForAlgo.m_history.frameCount())
+    {
+      // scrub forward through the recorded steps
+      m_visuForAlgo.m_shownFrame++;
+    }
+    else if(key == Key::Space || key == Key::Right)
+    {
+      run(Command::Step);
+    }
+    else if(key == Key::Return)
+    {
+      // run to completion: the final state is shown by 'display'
+      run(Command::RunToEnd);
+    }
+    else if(key == Key::PageDown)
+    {
+      run(Command::FastForward);
+    }
+  }
+
+  static constexpr int FastForwardStepCount = 100;
 
-      if(!m_fiber)
-        m_fiber = std::make_unique<Fiber>(staticExecute, this);
+  void run(Command command)
+  {
+    if(m_background)
+    {
+      send(command);
+    }
+    else
+    {
+      aim(m_visuForAlgo, command, [](int) { return false; });
+      resume(m_visuForAlgo);
+    }
+  }
 
-      if(key == Key::Return)
+  // Sets how far the next 'resume' goes: 'stop(step)' can end a fast-forward early
+  static void aim(Visualizer& visu, Command command, std::function<bool(int)> stop)
+  {
+    if(command == Command::RunToEnd)
+    {
+      visu.fastForward(stop);
+    }
+    else if(command == Command::FastForward)
+    {
+      const int target = visu.m_stepCount + FastForwardStepCount;
+      visu.fastForward([stop, target](int step) { return stop(step) || step >= target; });
+    }
+  }
+
+  // Runs the fiber until its next captured step, or until it finishes. 'visu' captures the steps:
+  // it must be the same from one call to the next, as must the calling thread.
+  void resume(Visualizer& visu)
+  {
+    gVisualizer = &visu;
+
+    if(!m_fiber)
+    {
+      m_fiberVisu = &visu;
+      m_fiber = std::make_unique<Fiber>(staticExecute, this);
+    }
+
+    // the scratch arena installed by 'execute' must not leak out of the fiber
+    gArena = m_fiberArena;
+    m_fiber->resume();
+    m_fiberArena = gArena;
+    gArena = nullptr;
+
+    gVisualizer = gNullVisualizer;
+
+    if(m_fiber->finished())
+      visu.m_discard = false;
+  }
+
+  // UI thread side of the background execution
+  bool running() const { return m_sentCommands != m_completedCommands; }
+
+  void send(Command command)
+  {
+    if(!m_worker)
+    {
+      // the steps will come from the worker, as 'executeFromFiber' would have captured them here
+      m_visuForAlgo.m_history.clear();
+      m_visuForAlgo.m_shownFrame = -1;
+
+      m_worker = std::make_unique<Worker>(m_historyMemoryCap);
+      m_worker->thread = std::thread([this]() { workerLoop(); });
+    }
+
+    m_worker->cancel = false;
+    {
+      std::unique_lock<std::mutex> lock(m_worker->mutex);
+      m_worker->command = command;
+      m_worker->hasCommand = true;
+    }
+    m_worker->wakeUp.notify_one();
+
+    ++m_sentCommands;
+    m_lastProgressReport = std::chrono::steady_clock::now();
+    m_progressReported = false;
+  }
+
+  // Takes the steps published by the worker, and reports its progress on long runs
+  void receiveSteps()
+  {
+    auto& worker = *m_worker;
+
+    // read before the queue: all the steps of the completed commands are in it
+    const int completedCommands = worker.completedCommands.load(std::memory_order_acquire);
+
+    std::unique_ptr<FrameHistory> frame;
+    while(worker.frames.pop(frame))
+    {
+      auto& visu = m_visuForAlgo;
+      HistoryWriter writer(visu.m_history);
+      frame->replay(frame->frameCount() - 1, &writer);
+      visu.m_history.commit();
+      visu.m_shownFrame = visu.m_history.frameCount() - 1;
+
+      frame->clear();
+      worker.recycled.push(std::move(frame)); // dropped if the worker has enough of them
+      ++m_version;
+    }
+
+    const int progress = worker.progress.load(std::memory_order_relaxed);
+
+    if(completedCommands != m_completedCommands)
+    {
+      m_completedCommands = completedCommands;
+
+      // hide last step's visualisation (it stays in the history)
+      if(worker.finished)
+        m_visuForAlgo.m_shownFrame = -1;
+
+      if(m_progressReported)
+        printf("\rRunning: %d steps - %s\n", progress, worker.finished ? "finished" : "stopped");
+
+      ++m_version;
+    }
+    else if(running())
+    {
+      const auto now = std::chrono::steady_clock::now();
+      if(now - m_lastProgressReport > std::chrono::milliseconds(500))
+      {
+        printf("\rRunning: %d steps (press Space to stop) ", progress);
+        m_lastProgressReport = now;
+        m_progressReported = true;
+      }
+    }
+
+    fflush(stdout);
+  }
+
+  // Worker thread side
+  void workerLoop()
+  {
+    auto& worker = *m_worker;
+
+    while(true)
+    {
+      Command command;
       {
-        while(!m_fiber->finished())
-          m_fiber->resume();
+        std::unique_lock<std::mutex> lock(worker.mutex);
+        worker.wakeUp.wait(lock, [&]() { return worker.quit || worker.hasCommand; });
+        if(worker.quit)
+          return;
+
+        command = worker.command;
+        worker.hasCommand = false;
       }
-      else
-        m_fiber->resume();
 
-      gVisualizer = gNullVisualizer;
+      execute(command);
+      worker.completedCommands.fetch_add(1, std::memory_order_release);
+    }
+  }
+
+  void execute(Command command)
+  {
+    auto& worker = *m_worker;
+    auto& visu = worker.visu;
+
+    aim(visu, command,
+          [&worker](int step)
+          {
+            worker.progress.store(step, std::memory_order_relaxed);
+            return worker.cancel.load();
+          });
+
+    resume(visu);
+
+    worker.progress.store(visu.m_stepCount, std::memory_order_relaxed);
+    worker.finished = m_fiber->finished();
+
+    if(visu.m_history.frameCount() == 0)
+      return;
+
+    // publish the captured step
+    std::unique_ptr<FrameHistory> frame;
+    if(!worker.recycled.pop(frame))
+      frame = std::make_unique<FrameHistory>(worker.historyMemoryCap);
+
+    HistoryWriter writer(*frame);
+    visu.m_history.replay(visu.m_history.frameCount() - 1, &writer);
+    frame->commit();
+    visu.m_history.clear();
+
+    // the UI thread is behind: let it catch up
+    while(!worker.frames.push(std::move(frame)))
+    {
+      if(worker.quit)
+        return;
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
     }
   }
 
@@ -176,36 +505,74 @@ struct AlgorithmApp : IApp
     printf("Profiling ...\n");
     fflush(stdout);
 
-    const int N = 8000;
-    const auto t0 = getSteadyClockMs();
-    int64_t processingTotalUs = 0;
-    for(int k = 0; k < N; ++k)
-    {
-      fprintf(stderr, "\r%d/%d", k + 1, N);
-      srand(k);
-      m_algo->init();
+    ZoneRecorder zones;
+    const auto r = profileAlgorithm(m_algo.get(), 8000, true, &zones);
+
+    printf("Processed %d instances in %.2fs (%.2f ms/instance)\n", r.instances, r.totalMs / 1000.0,
+          r.totalMs / r.instances);
+    printf("Input generation: %.3f ms/instance\n", r.generationUs / 1000.0);
+    printf("      Processing: %.3f ms/instance (median: %.3f ms, p99: %.3f ms)\n", r.meanUs / 1000.0,
+          r.medianUs / 1000.0, r.p99Us / 1000.0);
+    if(AllocationTrackingEnabled)
+      printf("     Allocations: %.1f/instance, %.1f KiB/instance (peak live: %.1f KiB)\n", r.allocationCount,
+            r.allocatedBytes / 1024.0, r.peakLiveBytes / 1024.0);
+    zones.printBreakdown(stdout, r.instances);
+
+    const auto p = profileAlgorithmParallel(m_algo.get(), 8000, 0);
+    printf("      Throughput: %.0f instances/s (%d threads)\n", p.instancesPerSecond, p.threads);
+  }
+
+  void runSweep()
+  {
+    printf("Profiling at increasing input sizes ...\n");
+    fflush(stdout);
 
-      const auto us0 = getSteadyClockUs();
-      m_algo->execute();
-      const auto us1 = getSteadyClockUs();
+    const auto r = profileAlgorithmSweep(m_algo.get(), 10, 1000000, 2.0);
 
-      processingTotalUs += (us1 - us0);
+    if(r.points.empty())
+    {
+      printf("This algorithm has no sized input generator: 'generateInput(int size)'\n");
+    }
+    else
+    {
+      printf("%12s %10s %14s %10s %10s\n", "size", "instances", "median (us)", "exponent", "RSS (MiB)");
+      for(auto& p : r.points)
+        printf("%12d %10d %14.3f %10.2f %10.1f\n", p.size, p.instances, p.medianUs, p.localExponent, p.peakRssMiB);
+      printf("Fitted exponent: time ~ N^%.2f%s\n", r.exponent, r.truncated ? " (stopped early: too slow)" : "");
     }
-    fprintf(stderr, " - OK\n");
-    fflush(stderr);
 
-    const auto t1 = getSteadyClockMs();
-    printf("Processed %d instances in %.2fs (%.2f ms/instance)\n", N, (t1 - t0) / 1000.0, (t1 - t0) / (N * 1.0));
-    printf("Input generation: %.3f ms/instance\n", ((t1 - t0) - processingTotalUs / 1000.0) / N);
-    printf("      Processing: %.3f ms/instance\n", processingTotalUs / 1000.0 / N);
+    // restore an input of the usual size
+    m_algo->init();
   }
 
   std::unique_ptr<Fiber> m_fiber;
+  Arena* m_fiberArena = nullptr;
+  Visualizer* m_fiberVisu = nullptr; // the one capturing the steps of the fiber
 
   Visualizer m_visuForAlgo;
   Visualizer m_visuForFrame;
+
+  std::unique_ptr<Worker> m_worker;
+  int m_sentCommands = 0;
+  int m_completedCommands = 0; // as seen from the UI thread
+  std::chrono::steady_clock::time_point m_lastProgressReport;
+  bool m_progressReported = false;
 };
 
 }
 
-IApp* createAlgorithmApp(std::unique_ptr<AbstractAlgorithm> algo) { return new AlgorithmApp(std::move(algo)); }
+IApp* createAlgorithmApp(std::unique_ptr<AbstractAlgorithm> algo)
+{
+  return new AlgorithmApp(std::move(algo), FrameHistory::DefaultMemoryCap);
+}
+
+IApp* createAlgorithmApp(std::unique_ptr<AbstractAlgorithm> algo, size_t historyMemoryCap)
+{
+  return new AlgorithmApp(std::move(algo), historyMemoryCap);
+}
+
+AbstractAlgorithm* getAlgorithm(IApp* app)
+{
+  auto algoApp = dynamic_cast<AlgorithmApp*>(app);
+  return algoApp ? algoApp->m_algo.get() : nullptr;
+}
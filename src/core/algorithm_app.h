@@ -1,8 +1,14 @@
 #pragma once
 
+#include <cstddef>
 #include <memory>
+#include <string>
+#include <type_traits>
 
 #include "app.h"
+#include "arena.h"
+#include "corpus.h"
+
 // Example algorithm :
 // struct MyAlgorithm
 // {
@@ -11,6 +17,16 @@
 // static void drawInput(const std::vector<Vec2>& input);
 // static void drawOutput(const std::vector<Edge>& output);
 // };
+//
+// Optionally, for scaling sweeps (see 'profileAlgorithmSweep'),
+// an input generator producing about 'size' elements:
+// static std::vector<Vec2> generateInput(int size);
+//
+// Optionally, to profile on real data, a loader of dataset files (see datasets.h),
+// throwing on malformed files:
+// static std::vector<Vec2> loadDataset(const std::string& path);
+//
+// Inputs can be stored in corpora (see corpus.h) when their type has an InputCodec.
 
 template<typename>
 struct FuncTraits;
@@ -34,12 +50,50 @@ struct FuncTraits<ReturnTypeP(ArgTypeP)>
   using InputType = typename RemoveRef<ArgTypeP>::type;
 };
 
+// Tells whether 'AlgoDef' provides 'generateInput(int size)'
+template<typename AlgoDef, typename = void>
+struct HasSizedInput : std::false_type
+{
+};
+
+template<typename AlgoDef>
+struct HasSizedInput<AlgoDef, decltype((void)AlgoDef::generateInput(0))> : std::true_type
+{
+};
+
+// Tells whether 'AlgoDef' provides 'loadDataset(const std::string& path)'
+template<typename AlgoDef, typename = void>
+struct HasDatasetLoader : std::false_type
+{
+};
+
+template<typename AlgoDef>
+struct HasDatasetLoader<AlgoDef, decltype((void)AlgoDef::loadDataset(std::string()))> : std::true_type
+{
+};
+
 struct AbstractAlgorithm
 {
   virtual ~AbstractAlgorithm() = default;
   virtual void display() = 0;
   virtual void init() = 0;
   virtual void execute() = 0;
+
+  // Generates an input of about 'size' elements.
+  // Returns false (and does nothing) if the algorithm only has a fixed-size input.
+  virtual bool init(int size) = 0;
+
+  // Loads the input from a dataset file.
+  // Returns false (and does nothing) if the algorithm has no dataset loader.
+  virtual bool loadDataset(const std::string& path) = 0;
+
+  // Appends the current input to 'writer', as a new record, or loads it from 'record'.
+  // Both return false (and do nothing) if the input type can't be stored in a corpus.
+  virtual bool saveInput(CorpusWriter& writer) const = 0;
+  virtual bool loadInput(const CorpusRecord& record) = 0;
+
+  // creates a new, independent instance of the same algorithm
+  virtual std::unique_ptr<AbstractAlgorithm> createNew() const = 0;
 };
 
 template<typename AlgoDef>
@@ -51,10 +105,87 @@ struct ConcreteAlgorithm : public AbstractAlgorithm
 
   InputType m_input;
   OutputType m_output;
+  Arena m_arena;
 
   void display() override { AlgoDef::display(m_input, m_output); }
   void init() override { m_input = AlgoDef::generateInput(); }
-  void execute() override { m_output = AlgoDef::execute(m_input); }
+  bool init(int size) override
+  {
+    if constexpr(HasSizedInput<AlgoDef>::value)
+    {
+      m_input = AlgoDef::generateInput(size);
+      return true;
+    }
+    else
+    {
+      (void)size;
+      return false;
+    }
+  }
+  bool loadDataset(const std::string& path) override
+  {
+    if constexpr(HasDatasetLoader<AlgoDef>::value)
+    {
+      m_input = AlgoDef::loadDataset(path);
+      return true;
+    }
+    else
+    {
+      (void)path;
+      return false;
+    }
+  }
+  bool saveInput(CorpusWriter& writer) const override
+  {
+    if constexpr(HasInputCodec<InputType>::value)
+    {
+      writer.beginRecord();
+      InputCodec<InputType>::write(writer, m_input);
+      return true;
+    }
+    else
+    {
+      (void)writer;
+      return false;
+    }
+  }
+  bool loadInput(const CorpusRecord& record) override
+  {
+    if constexpr(HasInputCodec<InputType>::value)
+    {
+      CorpusReader reader{record};
+      InputCodec<InputType>::read(reader, m_input);
+      return true;
+    }
+    else
+    {
+      (void)record;
+      return false;
+    }
+  }
+  void execute() override
+  {
+    // scratch allocations reuse the memory of the previous execution
+    m_arena.reset();
+    ArenaScope arenaScope(m_arena);
+    m_output = AlgoDef::execute(m_input);
+  }
+  std::unique_ptr<AbstractAlgorithm> createNew() const override
+  {
+    return std::make_unique<ConcreteAlgorithm<AlgoDef>>();
+  }
 };
 
+// When set, the algorithm apps created afterwards run the algorithm on a worker thread: the window
+// keeps being drawn during long runs, while the steps show up as they're reached. Pressing a key
+// that runs the algorithm stops it instead, at its next breakpoint.
+// When not set (the default), the algorithm runs on the calling thread, in 'processEvent'.
+extern bool gRunAlgorithmsInBackground;
+
 IApp* createAlgorithmApp(std::unique_ptr<AbstractAlgorithm> algo);
+
+// 'historyMemoryCap' bounds the memory used to record the execution steps (for scrubbing)
+IApp* createAlgorithmApp(std::unique_ptr<AbstractAlgorithm> algo, size_t historyMemoryCap);
+
+// Returns the algorithm driven by 'app', or nullptr if 'app' isn't an algorithm app.
+AbstractAlgorithm* getAlgorithm(IApp* app);
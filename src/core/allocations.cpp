@@ -0,0 +1,70 @@
+#include "allocations.h"
+
+#include <cstdlib>
+#include <new>
+
+thread_local AllocationStats* gAllocationStats;
+
+#if !defined(ALLOCATION_TRACKING_DISABLED) && !defined(_WIN32)
+
+#include <malloc.h> // malloc_usable_size
+
+namespace
+{
+void* allocate(size_t size, size_t alignment)
+{
+  if(size == 0)
+    size = 1;
+
+  // aligned_alloc wants a multiple of the alignment
+  if(alignment)
+    size = (size + alignment - 1) / alignment * alignment;
+
+  while(true)
+  {
+    void* p = alignment ? aligned_alloc(alignment, size) : malloc(size);
+
+    if(p)
+    {
+      if(auto stats = gAllocationStats)
+      {
+        const int64_t blockSize = malloc_usable_size(p);
+        stats->count++;
+        stats->bytes += blockSize;
+        stats->liveBytes += blockSize;
+        if(stats->liveBytes > stats->peakLiveBytes)
+          stats->peakLiveBytes = stats->liveBytes;
+      }
+
+      return p;
+    }
+
+    auto handler = std::get_new_handler();
+    if(!handler)
+      throw std::bad_alloc();
+    handler();
+  }
+}
+
+void release(void* p)
+{
+  if(!p)
+    return;
+
+  if(auto stats = gAllocationStats)
+    stats->liveBytes -= malloc_usable_size(p);
+
+  free(p);
+}
+}
+
+// The array and nothrow forms call these ones
+void* operator new(size_t size) { return allocate(size, 0); }
+void* operator new(size_t size, std::align_val_t alignment) { return allocate(size, size_t(alignment)); }
+
+void operator delete(void* p) noexcept { release(p); }
+void operator delete(void* p, size_t) noexcept { release(p); }
+void operator delete(void* p, std::align_val_t) noexcept { release(p); }
+void operator delete(void* p, size_t, std::align_val_t) noexcept { release(p); }
+
+#endif
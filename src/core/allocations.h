@@ -0,0 +1,30 @@
+#pragma once
+
+// Heap traffic accounting: the global operator new/delete are replaced (see allocations.cpp),
+// and count the allocations of the calling thread while an AllocationStats is installed on it
+// (the profiler does it around 'execute'). Otherwise, the hooks cost a thread-local load and a branch.
+//
+// Sizes are the ones of the blocks given by malloc (which rounds the requested sizes up).
+// Building with ALLOCATION_TRACKING_DISABLED keeps the default operator new/delete.
+
+#include <cstdint>
+
+#if defined(ALLOCATION_TRACKING_DISABLED) || defined(_WIN32)
+constexpr bool AllocationTrackingEnabled = false;
+#else
+constexpr bool AllocationTrackingEnabled = true;
+#endif
+
+struct AllocationStats
+{
+  int64_t count = 0; // calls to operator new
+  int64_t bytes = 0; // allocated, freed or not
+
+  // allocated minus freed since the stats were installed (it goes negative when older memory is freed),
+  // and its highest value
+  int64_t liveBytes = 0;
+  int64_t peakLiveBytes = 0;
+};
+
+// The stats of the calling thread (nullptr: nothing is counted)
+extern thread_local AllocationStats* gAllocationStats;
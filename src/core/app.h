@@ -32,6 +32,10 @@ struct IApp
   virtual void tick(){};
   virtual void draw(IDrawer*){};
   virtual void processEvent(InputEvent){};
+
+  // Changes each time what 'draw' produces changes, so unchanged frames don't need to be redrawn.
+  // A negative value means "unknown" (e.g animated apps): the app is then redrawn every frame.
+  virtual int contentVersion() { return -1; }
 };
 
 typedef IApp* CreationFunc();
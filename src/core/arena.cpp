@@ -0,0 +1,130 @@
+#include "arena.h"
+
+#include <cassert>
+#include <cstdint>
+
+thread_local Arena* gArena;
+
+namespace
+{
+char* allocateChunk(size_t size) { return (char*)::operator new(size); }
+void freeChunk(char* data) { ::operator delete(data); }
+
+// offset of the first address >= 'base + offset' having the requested alignment
+size_t alignOffset(const char* base, size_t offset, size_t alignment)
+{
+  const auto address = (uintptr_t)(base + offset);
+  const auto aligned = (address + alignment - 1) & ~(uintptr_t)(alignment - 1);
+  return offset + (aligned - address);
+}
+}
+
+Arena::Arena(size_t initialCapacity)
+    : m_initialCapacity(initialCapacity)
+{
+  assert(initialCapacity > 0);
+}
+
+Arena::~Arena()
+{
+  for(auto& chunk : m_chunks)
+    freeChunk(chunk.data);
+}
+
+void* Arena::allocate(size_t size, size_t alignment)
+{
+  assert((alignment & (alignment - 1)) == 0);
+
+  if(m_chunks.empty())
+    return allocateFromNextChunk(size, alignment);
+
+  const auto& chunk = m_chunks[m_current];
+  const size_t begin = alignOffset(chunk.data, m_offset, alignment);
+
+  if(begin + size > chunk.size)
+    return allocateFromNextChunk(size, alignment);
+
+  m_offset = begin + size;
+  return chunk.data + begin;
+}
+
+void* Arena::allocateFromNextChunk(size_t size, size_t alignment)
+{
+  // chunks left over from a previous rewind are reused, if they're large enough
+  while(m_current + 1 < m_chunks.size())
+  {
+    ++m_current;
+    m_offset = 0;
+
+    const auto& chunk = m_chunks[m_current];
+    const size_t begin = alignOffset(chunk.data, 0, alignment);
+    if(begin + size <= chunk.size)
+    {
+      m_offset = begin + size;
+      return chunk.data + begin;
+    }
+  }
+
+  // geometric growth, so the number of chunks stays logarithmic
+  size_t newSize = m_chunks.empty() ? m_initialCapacity : m_chunks.back().size * 2;
+  while(newSize < size + alignment)
+    newSize *= 2;
+
+  m_chunks.push_back({allocateChunk(newSize), newSize});
+  m_current = m_chunks.size() - 1;
+
+  const auto& chunk = m_chunks.back();
+  const size_t begin = alignOffset(chunk.data, 0, alignment);
+  m_offset = begin + size;
+  return chunk.data + begin;
+}
+
+void Arena::deallocate(void* p, size_t size)
+{
+  if(m_chunks.empty())
+    return;
+
+  const auto& chunk = m_chunks[m_current];
+  if((char*)p + size == chunk.data + m_offset)
+    m_offset -= size;
+}
+
+void Arena::rewind(Marker marker)
+{
+  assert(marker.chunk < m_current || (marker.chunk == m_current && marker.offset <= m_offset));
+  m_current = marker.chunk;
+  m_offset = marker.offset;
+}
+
+void Arena::reset()
+{
+  if(m_chunks.size() > 1)
+  {
+    const size_t total = capacity();
+
+    for(auto& chunk : m_chunks)
+      freeChunk(chunk.data);
+
+    m_chunks.clear();
+    m_chunks.push_back({allocateChunk(total), total});
+  }
+
+  m_current = 0;
+  m_offset = 0;
+}
+
+size_t Arena::bytesUsed() const
+{
+  size_t r = m_offset;
+  for(size_t i = 0; i < m_current; ++i)
+    r += m_chunks[i].size;
+  return r;
+}
+
+size_t Arena::capacity() const
+{
+  size_t r = 0;
+  for(auto& chunk : m_chunks)
+    r += chunk.size;
+  return r;
+}
@@ -0,0 +1,168 @@
+#pragma once
+
+// Monotonic allocator for the scratch memory of algorithms.
+//
+//   std::vector<Edge> compute(...)
+//   {
+//     for(...)
+//     {
+//       ScratchScope scratch; // everything allocated below is released at the end of the iteration
+//       ScratchVector<Edge> edges;
+//       ...
+//     }
+//   }
+//
+// Allocations made through 'ArenaAllocator' go to the arena installed on the calling
+// thread (ConcreteAlgorithm::execute installs one, and resets it before each execution),
+// and fall back to the heap when there's none. Once the arena has grown to the working set
+// of the algorithm, repeated executions don't touch malloc anymore.
+//
+// Arena memory doesn't outlive the execution: outputs must use regular containers.
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+class Arena
+{
+  public:
+  // nothing is allocated until the first allocation
+  explicit Arena(size_t initialCapacity = 64 * 1024);
+  ~Arena();
+
+  Arena(const Arena&) = delete;
+  Arena& operator=(const Arena&) = delete;
+
+  void* allocate(size_t size, size_t alignment);
+
+  // Only the most recent allocation is actually given back (this makes vector growth cheap),
+  // the others are reclaimed by 'rewind' or 'reset'.
+  void deallocate(void* p, size_t size);
+
+  struct Marker
+  {
+    size_t chunk;
+    size_t offset;
+  };
+
+  Marker mark() const { return {m_current, m_offset}; }
+
+  // releases everything allocated since 'marker' was taken
+  void rewind(Marker marker);
+
+  // Releases everything. If several chunks were needed, they're replaced
+  // by a single one, large enough to hold all of them.
+  void reset();
+
+  size_t bytesUsed() const;
+  size_t capacity() const;
+
+  private:
+  struct Chunk
+  {
+    char* data;
+    size_t size;
+  };
+
+  void* allocateFromNextChunk(size_t size, size_t alignment);
+
+  const size_t m_initialCapacity;
+  std::vector<Chunk> m_chunks;
+  size_t m_current = 0;
+  size_t m_offset = 0;
+};
+
+// The arena of the calling thread (nullptr: scratch allocations go to the heap)
+extern thread_local Arena* gArena;
+
+// Installs 'arena' on the calling thread, for the lifetime of the scope
+struct ArenaScope
+{
+  ArenaScope(Arena& arena)
+      : m_previous(gArena)
+  {
+    gArena = &arena;
+  }
+
+  ~ArenaScope() { gArena = m_previous; }
+
+  ArenaScope(const ArenaScope&) = delete;
+  ArenaScope& operator=(const ArenaScope&) = delete;
+
+  Arena* const m_previous;
+};
+
+// Releases, at the end of the scope, everything allocated on the current arena during the scope.
+// The containers using it must be declared after the ScratchScope, and the containers
+// of enclosing scopes must not grow while it's open.
+struct ScratchScope
+{
+  ScratchScope()
+      : m_arena(gArena)
+  {
+    if(m_arena)
+      m_marker = m_arena->mark();
+  }
+
+  ~ScratchScope()
+  {
+    if(m_arena)
+      m_arena->rewind(m_marker);
+  }
+
+  ScratchScope(const ScratchScope&) = delete;
+  ScratchScope& operator=(const ScratchScope&) = delete;
+
+  Arena* const m_arena;
+  Arena::Marker m_marker{};
+};
+
+// Standard allocator taking its memory from the arena current at construction time
+template<typename T>
+struct ArenaAllocator
+{
+  using value_type = T;
+
+  ArenaAllocator()
+      : arena(gArena)
+  {
+  }
+
+  template<typename U>
+  ArenaAllocator(const ArenaAllocator<U>& other)
+      : arena(other.arena)
+  {
+  }
+
+  T* allocate(size_t n)
+  {
+    if(arena)
+      return (T*)arena->allocate(n * sizeof(T), alignof(T));
+    return std::allocator<T>().allocate(n);
+  }
+
+  void deallocate(T* p, size_t n)
+  {
+    if(arena)
+      arena->deallocate(p, n * sizeof(T));
+    else
+      std::allocator<T>().deallocate(p, n);
+  }
+
+  template<typename U>
+  friend bool operator==(const ArenaAllocator& a, const ArenaAllocator<U>& b)
+  {
+    return a.arena == b.arena;
+  }
+
+  template<typename U>
+  friend bool operator!=(const ArenaAllocator& a, const ArenaAllocator<U>& b)
+  {
+    return a.arena != b.arena;
+  }
+
+  Arena* arena;
+};
+
+template<typename T>
+using ScratchVector = std::vector<T, ArenaAllocator<T>>;
@@ -0,0 +1,263 @@
+#include "corpus.h"
+
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// File layout (every part is aligned on 16 bytes):
+//   FileHeader
+//   uint64_t recordOffsets[recordCount + 1] (from the start of the file, the last one is the end of the file)
+//   records: RecordHeader, then for each array: ArrayHeader, then the values
+namespace
+{
+const char Magic[8] = {'G', 'S', 'C', 'O', 'R', 'P', 'U', 'S'};
+const uint32_t Version = 1;
+const size_t Alignment = 16;
+
+struct FileHeader
+{
+  char magic[8];
+  uint32_t version;
+  uint32_t recordCount;
+};
+
+struct RecordHeader
+{
+  uint32_t arrayCount;
+  uint32_t reserved[3];
+};
+
+struct ArrayHeader
+{
+  uint32_t elementSize;
+  uint32_t reserved;
+  uint64_t count;
+};
+
+static_assert(sizeof(FileHeader) == Alignment, "");
+static_assert(sizeof(RecordHeader) == Alignment, "");
+static_assert(sizeof(ArrayHeader) == Alignment, "");
+
+size_t alignUp(size_t n) { return (n + Alignment - 1) & ~(Alignment - 1); }
+
+size_t offsetTableSize(size_t recordCount) { return alignUp((recordCount + 1) * sizeof(uint64_t)); }
+
+template<typename T>
+void append(std::vector<uint8_t>& bytes, const T& value)
+{
+  auto p = (const uint8_t*)&value;
+  bytes.insert(bytes.end(), p, p + sizeof(T));
+}
+
+void pad(std::vector<uint8_t>& bytes) { bytes.resize(alignUp(bytes.size()), 0); }
+}
+
+int CorpusRecord::arrayCount() const
+{
+  RecordHeader header;
+  memcpy(&header, m_data, sizeof header);
+  return header.arrayCount;
+}
+
+const void* CorpusRecord::findArray(int i, size_t elementSize, size_t& count) const
+{
+  if(i < 0 || i >= arrayCount())
+    throw std::runtime_error("Corpus: the record has no array " + std::to_string(i));
+
+  size_t offset = sizeof(RecordHeader);
+  for(int k = 0;; ++k)
+  {
+    ArrayHeader header;
+    if(offset + sizeof header > m_size)
+      throw std::runtime_error("Corpus: truncated record");
+    memcpy(&header, m_data + offset, sizeof header);
+    offset += sizeof header;
+
+    // checked before multiplying: a corrupt count can't wrap around
+    if(header.elementSize == 0 || header.count > (m_size - offset) / header.elementSize)
+      throw std::runtime_error("Corpus: truncated record");
+
+    if(k == i)
+    {
+      if(header.elementSize != elementSize)
+        throw std::runtime_error("Corpus: the array " + std::to_string(i) + " holds values of "
+              + std::to_string(header.elementSize) + " bytes, expected " + std::to_string(elementSize));
+
+      count = header.count;
+      return m_data + offset;
+    }
+
+    offset += alignUp(header.count * header.elementSize);
+  }
+}
+
+void CorpusWriter::beginRecord()
+{
+  m_recordOffsets.push_back(m_records.size());
+  append(m_records, RecordHeader{});
+}
+
+void CorpusWriter::addArray(const void* values, size_t elementSize, size_t count)
+{
+  if(m_recordOffsets.empty())
+    throw std::logic_error("CorpusWriter: no record started");
+
+  RecordHeader record;
+  memcpy(&record, &m_records[m_recordOffsets.back()], sizeof record);
+  record.arrayCount++;
+  memcpy(&m_records[m_recordOffsets.back()], &record, sizeof record);
+
+  append(m_records, ArrayHeader{uint32_t(elementSize), 0, count});
+  auto p = (const uint8_t*)values;
+  m_records.insert(m_records.end(), p, p + elementSize * count);
+  pad(m_records);
+}
+
+std::vector<uint8_t> CorpusWriter::finish() const
+{
+  const size_t recordsStart = sizeof(FileHeader) + offsetTableSize(m_recordOffsets.size());
+
+  std::vector<uint8_t> bytes;
+  bytes.reserve(recordsStart + m_records.size());
+
+  FileHeader header;
+  memcpy(header.magic, Magic, sizeof Magic);
+  header.version = Version;
+  header.recordCount = m_recordOffsets.size();
+  append(bytes, header);
+
+  for(auto offset : m_recordOffsets)
+    append(bytes, uint64_t(recordsStart + offset));
+  append(bytes, uint64_t(recordsStart + m_records.size()));
+  pad(bytes);
+
+  bytes.insert(bytes.end(), m_records.begin(), m_records.end());
+  return bytes;
+}
+
+void CorpusWriter::save(const std::string& path) const
+{
+  const auto bytes = finish();
+
+  FILE* fp = fopen(path.c_str(), "wb");
+  if(!fp)
+    throw std::runtime_error("Can't open '" + path + "' for writing");
+
+  const bool ok = fwrite(bytes.data(), 1, bytes.size(), fp) == bytes.size();
+  if(fclose(fp) != 0 || !ok)
+    throw std::runtime_error("Can't write '" + path + "'");
+}
+
+Corpus::Corpus(const std::string& path)
+{
+#ifndef _WIN32
+  const int fd = open(path.c_str(), O_RDONLY);
+  if(fd < 0)
+    throw std::runtime_error("Can't open '" + path + "'");
+
+  struct stat info;
+  if(fstat(fd, &info) != 0 || info.st_size == 0)
+  {
+    close(fd);
+    throw std::runtime_error("Can't read '" + path + "'");
+  }
+
+  void* p = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+
+  if(p == MAP_FAILED)
+    throw std::runtime_error("Can't map '" + path + "'");
+
+  m_data = (const uint8_t*)p;
+  m_size = info.st_size;
+  m_mapped = true;
+#else
+  FILE* fp = fopen(path.c_str(), "rb");
+  if(!fp)
+    throw std::runtime_error("Can't open '" + path + "'");
+
+  uint8_t block[65536];
+  size_t n;
+  while((n = fread(block, 1, sizeof block, fp)) > 0)
+    m_buffer.insert(m_buffer.end(), block, block + n);
+  fclose(fp);
+
+  m_data = m_buffer.data();
+  m_size = m_buffer.size();
+#endif
+
+  try
+  {
+    validate();
+  }
+  catch(const std::exception& e)
+  {
+#ifndef _WIN32
+    munmap((void*)m_data, m_size);
+#endif
+    throw std::runtime_error("'" + path + "': " + e.what());
+  }
+}
+
+Corpus::Corpus(std::vector<uint8_t> data)
+    : m_buffer(std::move(data))
+{
+  m_data = m_buffer.data();
+  m_size = m_buffer.size();
+  validate();
+}
+
+Corpus::~Corpus()
+{
+#ifndef _WIN32
+  if(m_mapped)
+    munmap((void*)m_data, m_size);
+#endif
+}
+
+void Corpus::validate()
+{
+  FileHeader header;
+  if(m_size < sizeof header)
+    throw std::runtime_error("not a corpus");
+
+  memcpy(&header, m_data, sizeof header);
+  if(memcmp(header.magic, Magic, sizeof Magic) != 0)
+    throw std::runtime_error("not a corpus");
+
+  if(header.version != Version)
+    throw std::runtime_error("unsupported corpus version " + std::to_string(header.version));
+
+  if(sizeof header + offsetTableSize(header.recordCount) > m_size)
+    throw std::runtime_error("truncated corpus");
+
+  // the records follow each other, each one at least a header
+  uint64_t prev = sizeof header + offsetTableSize(header.recordCount);
+  for(uint32_t i = 0; i <= header.recordCount; ++i)
+  {
+    uint64_t offset;
+    memcpy(&offset, m_data + sizeof header + i * sizeof offset, sizeof offset);
+
+    const uint64_t minOffset = i == 0 ? prev : prev + sizeof(RecordHeader);
+    if(offset < minOffset || offset > m_size || offset % Alignment)
+      throw std::runtime_error("corrupt corpus");
+
+    prev = offset;
+  }
+
+  m_recordCount = header.recordCount;
+}
+
+CorpusRecord Corpus::operator[](int i) const
+{
+  uint64_t offsets[2];
+  memcpy(offsets, m_data + sizeof(FileHeader) + i * sizeof(uint64_t), sizeof offsets);
+  return {m_data + offsets[0], size_t(offsets[1] - offsets[0])};
+}
@@ -0,0 +1,169 @@
+#pragma once
+
+// Input corpora: sets of inputs generated (or loaded from datasets) once, stored in a binary file,
+// then memory-mapped for profiling, so the timed loop never generates nor parses anything.
+//
+// A corpus is a list of records, one per input. A record is a list of arrays of trivially
+// copyable values (e.g the vertices, then the faces of a polygon), stored in native byte order,
+// each one aligned on 16 bytes: once mapped, they're used in place.
+//
+// How an input type is split into arrays is given by InputCodec (see below).
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include "geom.h"
+
+// One input of a corpus: a view on the corpus storage
+class CorpusRecord
+{
+  public:
+  CorpusRecord(const uint8_t* data, size_t size)
+      : m_data(data)
+      , m_size(size)
+  {
+  }
+
+  int arrayCount() const;
+
+  // Throws if there's no array 'i', or if its elements aren't the size of T
+  template<typename T>
+  span<const T> array(int i) const
+  {
+    static_assert(std::is_trivially_copyable<T>::value, "corpus values must be trivially copyable");
+    size_t count;
+    const void* values = findArray(i, sizeof(T), count);
+    return {count, (const T*)values};
+  }
+
+  private:
+  const void* findArray(int i, size_t elementSize, size_t& count) const;
+
+  const uint8_t* m_data;
+  size_t m_size;
+};
+
+// Builds a corpus in memory, record by record
+class CorpusWriter
+{
+  public:
+  // starts a new record: the next arrays are added to it
+  void beginRecord();
+
+  template<typename T>
+  void add(span<const T> values)
+  {
+    static_assert(std::is_trivially_copyable<T>::value, "corpus values must be trivially copyable");
+    addArray(values.ptr, sizeof(T), values.len);
+  }
+
+  int recordCount() const { return int(m_recordOffsets.size()); }
+
+  // The file contents
+  std::vector<uint8_t> finish() const;
+
+  // Throws on I/O errors
+  void save(const std::string& path) const;
+
+  private:
+  void addArray(const void* values, size_t elementSize, size_t count);
+
+  std::vector<uint8_t> m_records;
+  std::vector<uint64_t> m_recordOffsets; // in 'm_records'
+};
+
+// A read-only corpus
+class Corpus
+{
+  public:
+  // Maps the file (throws if it can't be opened, or isn't a valid corpus)
+  explicit Corpus(const std::string& path);
+
+  // Uses 'data' (as returned by CorpusWriter::finish)
+  explicit Corpus(std::vector<uint8_t> data);
+
+  ~Corpus();
+
+  Corpus(const Corpus&) = delete;
+  Corpus& operator=(const Corpus&) = delete;
+
+  int size() const { return m_recordCount; }
+  CorpusRecord operator[](int i) const;
+
+  private:
+  void validate();
+
+  std::vector<uint8_t> m_buffer; // when not mapped
+  const uint8_t* m_data = nullptr;
+  size_t m_size = 0;
+  bool m_mapped = false;
+  int m_recordCount = 0;
+};
+
+// Reads the arrays of a record, in the order they were written
+struct CorpusReader
+{
+  CorpusRecord record;
+  int next = 0;
+
+  template<typename T>
+  span<const T> read()
+  {
+    return record.array<T>(next++);
+  }
+};
+
+// Splits an input type into arrays, and back:
+//
+//   static void write(CorpusWriter& writer, const T& value);
+//   static void read(CorpusReader& reader, T& value);
+//
+// Trivially copyable types, and vectors of them, are supported as is. Other input types
+// must specialize it (see datasets.h), or they can't be stored in a corpus.
+template<typename T, typename = void>
+struct InputCodec;
+
+template<typename T>
+struct InputCodec<T, std::enable_if_t<std::is_trivially_copyable<T>::value>>
+{
+  static void write(CorpusWriter& writer, const T& value) { writer.add(span<const T>(1, &value)); }
+
+  static void read(CorpusReader& reader, T& value)
+  {
+    auto values = reader.read<T>();
+    if(values.len != 1)
+      throw std::runtime_error("Corpus: expected a single value");
+    memcpy((void*)&value, values.ptr, sizeof(T));
+  }
+};
+
+template<typename T>
+struct InputCodec<std::vector<T>, std::enable_if_t<std::is_trivially_copyable<T>::value>>
+{
+  static void write(CorpusWriter& writer, const std::vector<T>& values)
+  {
+    writer.add(span<const T>(values.size(), values.data()));
+  }
+
+  static void read(CorpusReader& reader, std::vector<T>& values)
+  {
+    auto array = reader.read<T>();
+    values.assign(array.begin(), array.end());
+  }
+};
+
+// Tells whether 'T' can be stored in a corpus
+template<typename T, typename = void>
+struct HasInputCodec : std::false_type
+{
+};
+
+template<typename T>
+struct HasInputCodec<T, decltype((void)sizeof(InputCodec<T>))> : std::true_type
+{
+};
@@ -25,4 +25,32 @@ struct IDrawer
   virtual void text(Vec2 pos, const char* text, Color color = White) = 0;
 
   virtual void line(Vec3 a, Vec3 b, Color color = White) = 0;
+
+  // Wireframe hexahedron, e.g an AABB or a frustum cluster. The corner i maps to the corner
+  // (i & 1, (i >> 1) & 1, (i >> 2) & 1) of the unit cube: the edges join the corners whose indices differ by one bit.
+  // By default, drawn as its 12 edges.
+  virtual void box(const Vec3 (&corners)[8], Color color = White)
+  {
+    for(int i = 0; i < 8; ++i)
+      for(int bit = 1; bit < 8; bit <<= 1)
+        if(!(i & bit))
+          line(corners[i], corners[i | bit], color);
+  }
+
+  void box(Vec3 min, Vec3 max, Color color = White)
+  {
+    Vec3 corners[8];
+    for(int i = 0; i < 8; ++i)
+      corners[i] = {i & 1 ? max.x : min.x, i & 2 ? max.y : min.y, i & 4 ? max.z : min.z};
+    box(corners, color);
+  }
+
+  // The part of the XY plane that ends up on screen, when the drawer knows it:
+  // primitives entirely outside of it can be skipped before being submitted.
+  virtual bool visibleArea(Vec2& min, Vec2& max) const
+  {
+    (void)min;
+    (void)max;
+    return false;
+  }
 };
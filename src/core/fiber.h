@@ -1,11 +1,14 @@
 #pragma once
 #include <cstdint>
-#include <vector>
 
 class Fiber
 {
   public:
   Fiber(void (*func)(void*), void* userParam);
+  ~Fiber();
+
+  Fiber(const Fiber&) = delete;
+  Fiber& operator=(const Fiber&) = delete;
 
   void resume();
   bool finished() const { return m_finished; };
@@ -19,10 +22,9 @@ class Fiber
   void* const m_userParam;
 
   // Execution state
-  std::vector<uint8_t> m_stack;
   bool m_finished = false;
 
-  // OS-specific metadata
+  // OS-specific metadata (including the stack)
   struct Priv;
   Priv* priv;
   alignas(void*) uint8_t privBuffer[4096];
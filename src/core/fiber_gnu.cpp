@@ -1,16 +1,199 @@
 #include <cassert>
-#include <ucontext.h>
+#include <cstddef>
+#include <mutex>
+#include <new>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <vector>
 
 #include "fiber.h"
 
+#if defined(__x86_64__) || defined(__aarch64__)
+#define FIBER_ASM_SWITCH 1
+#else
+#include <ucontext.h>
+#endif
+
 static thread_local Fiber* ThisFiber;
 
+namespace
+{
+const size_t StackSize = 1024 * 1024;
+
+// Stacks are expensive to create (mmap+mprotect), so they're recycled.
+// Each stack is preceded by an inaccessible guard page, so overflows crash
+// immediately instead of silently corrupting memory.
+struct StackPool
+{
+  // returns the lowest usable address of a StackSize-bytes stack
+  uint8_t* acquire()
+  {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      if(!freeStacks.empty())
+      {
+        auto r = freeStacks.back();
+        freeStacks.pop_back();
+        return r;
+      }
+    }
+
+    const size_t pageSize = sysconf(_SC_PAGESIZE);
+    void* base = mmap(nullptr, pageSize + StackSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if(base == MAP_FAILED)
+      throw std::runtime_error("Can't allocate fiber stack");
+
+    if(mprotect(base, pageSize, PROT_NONE) != 0)
+    {
+      munmap(base, pageSize + StackSize);
+      throw std::runtime_error("Can't protect fiber stack guard page");
+    }
+
+    return (uint8_t*)base + pageSize;
+  }
+
+  void release(uint8_t* stack)
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    freeStacks.push_back(stack);
+  }
+
+  std::mutex mutex;
+  std::vector<uint8_t*> freeStacks;
+};
+
+// never destroyed: fibers might outlive static destruction
+StackPool& stackPool()
+{
+  static auto pool = new StackPool;
+  return *pool;
+}
+}
+
+#ifdef FIBER_ASM_SWITCH
+
+// Saves the callee-saved registers on the current stack, stores the stack pointer to '*saveSp',
+// then switches to 'loadSp' and restores the registers saved there.
+// Unlike swapcontext, this doesn't save/restore the signal mask: no syscall.
+extern "C" void geomsandbox_switchContext(void** saveSp, void* loadSp);
+
+#if defined(__x86_64__)
+asm(R"(
+.text
+.p2align 4
+.globl geomsandbox_switchContext
+.hidden geomsandbox_switchContext
+.type geomsandbox_switchContext, @function
+geomsandbox_switchContext:
+  pushq %rbp
+  pushq %rbx
+  pushq %r12
+  pushq %r13
+  pushq %r14
+  pushq %r15
+  subq $8, %rsp
+  stmxcsr (%rsp)
+  fnstcw 4(%rsp)
+  movq %rsp, (%rdi)
+  movq %rsi, %rsp
+  ldmxcsr (%rsp)
+  fldcw 4(%rsp)
+  addq $8, %rsp
+  popq %r15
+  popq %r14
+  popq %r13
+  popq %r12
+  popq %rbx
+  popq %rbp
+  ret
+.size geomsandbox_switchContext, .-geomsandbox_switchContext
+)");
+
+// Builds the initial frame, as if 'entry' had been switched away from
+static void* initStack(uint8_t* stackTop, void (*entry)())
+{
+  auto top = (uint64_t*)((uintptr_t)stackTop & ~uintptr_t(15));
+
+  *--top = 0; // fake return address of 'entry': keeps the ABI alignment
+  *--top = (uintptr_t)entry;
+  for(int i = 0; i < 6; ++i)
+    *--top = 0; // rbp, rbx, r12-r15
+
+  *--top = 0x037F'00001F80; // default x87 control word, default MXCSR
+
+  return top;
+}
+#elif defined(__aarch64__)
+asm(R"(
+.text
+.p2align 4
+.globl geomsandbox_switchContext
+.hidden geomsandbox_switchContext
+.type geomsandbox_switchContext, %function
+geomsandbox_switchContext:
+  sub sp, sp, #176
+  stp x19, x20, [sp, #0]
+  stp x21, x22, [sp, #16]
+  stp x23, x24, [sp, #32]
+  stp x25, x26, [sp, #48]
+  stp x27, x28, [sp, #64]
+  stp x29, x30, [sp, #80]
+  stp d8, d9, [sp, #96]
+  stp d10, d11, [sp, #112]
+  stp d12, d13, [sp, #128]
+  stp d14, d15, [sp, #144]
+  mov x9, sp
+  str x9, [x0]
+  mov sp, x1
+  ldp x19, x20, [sp, #0]
+  ldp x21, x22, [sp, #16]
+  ldp x23, x24, [sp, #32]
+  ldp x25, x26, [sp, #48]
+  ldp x27, x28, [sp, #64]
+  ldp x29, x30, [sp, #80]
+  ldp d8, d9, [sp, #96]
+  ldp d10, d11, [sp, #112]
+  ldp d12, d13, [sp, #128]
+  ldp d14, d15, [sp, #144]
+  add sp, sp, #176
+  ret
+.size geomsandbox_switchContext, .-geomsandbox_switchContext
+)");
+
+// Builds the initial frame, as if 'entry' had been switched away from
+static void* initStack(uint8_t* stackTop, void (*entry)())
+{
+  auto top = (uint64_t*)((uintptr_t)stackTop & ~uintptr_t(15));
+
+  top -= 22;
+  for(int i = 0; i < 22; ++i)
+    top[i] = 0;
+
+  top[11] = (uintptr_t)entry; // x30 (lr)
+
+  return top;
+}
+#endif
+
+struct Fiber::Priv
+{
+  uint8_t* stack;
+  void* mainSp;
+  void* clientSp;
+};
+
+#else
+
 struct Fiber::Priv
 {
+  uint8_t* stack;
   ucontext_t main;
   ucontext_t client;
 };
 
+#endif
+
 void Fiber::launcherFunc()
 {
   ThisFiber->m_func(ThisFiber->m_userParam);
@@ -24,14 +207,25 @@ Fiber::Fiber(void (*func)(void*), void* userParam)
 {
   static_assert(sizeof(Fiber::Priv) < sizeof(Fiber::privBuffer));
 
-  m_stack.resize(1024 * 1024);
   priv = new(privBuffer) Fiber::Priv;
+  priv->stack = stackPool().acquire();
 
+#ifdef FIBER_ASM_SWITCH
+  priv->clientSp = initStack(priv->stack + StackSize, launcherFunc);
+#else
   getcontext(&priv->client);
-  priv->client.uc_stack.ss_sp = m_stack.data();
-  priv->client.uc_stack.ss_size = m_stack.size();
+  priv->client.uc_stack.ss_sp = priv->stack;
+  priv->client.uc_stack.ss_size = StackSize;
 
   makecontext(&priv->client, launcherFunc, 0);
+#endif
+}
+
+Fiber::~Fiber()
+{
+  // an unfinished fiber is simply abandoned: its stack frames are discarded without unwinding
+  stackPool().release(priv->stack);
+  priv->~Priv();
 }
 
 void Fiber::resume()
@@ -41,12 +235,20 @@ void Fiber::resume()
 
   assert(ThisFiber == nullptr);
   ThisFiber = this;
+#ifdef FIBER_ASM_SWITCH
+  geomsandbox_switchContext(&priv->mainSp, priv->clientSp);
+#else
   swapcontext(&priv->main, &priv->client);
+#endif
 }
 
 void Fiber::yield()
 {
   auto pThis = ThisFiber;
   ThisFiber = nullptr;
+#ifdef FIBER_ASM_SWITCH
+  geomsandbox_switchContext(&pThis->priv->clientSp, pThis->priv->mainSp);
+#else
   swapcontext(&pThis->priv->client, &pThis->priv->main);
+#endif
 }
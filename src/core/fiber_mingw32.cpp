@@ -1,4 +1,5 @@
 #include <cassert>
+#include <vector>
 #include <windows.h>
 #include <winnt.h>
 
@@ -10,6 +11,7 @@ struct Fiber::Priv
 {
   CONTEXT client{};
   CONTEXT main{};
+  std::vector<uint8_t> stack;
 };
 
 void Fiber::launcherFunc()
@@ -25,13 +27,13 @@ Fiber::Fiber(void (*func)(void*), void* userParam)
 {
   static_assert(sizeof(Fiber::Priv) < sizeof(Fiber::privBuffer));
 
-  m_stack.resize(1024 * 1024);
   priv = new(privBuffer) Fiber::Priv;
+  priv->stack.resize(1024 * 1024);
 
   priv->client.ContextFlags = CONTEXT_FULL;
   RtlCaptureContext(&priv->client);
 
-  uint64_t rsp = (uintptr_t)m_stack.back();
+  uint64_t rsp = (uintptr_t)priv->stack.back();
 
   rsp = rsp - rsp % 8;
 
@@ -39,6 +41,8 @@ Fiber::Fiber(void (*func)(void*), void* userParam)
   priv->client.Rsp = rsp;
 }
 
+Fiber::~Fiber() { priv->~Priv(); }
+
 void Fiber::resume()
 {
   if(m_finished)
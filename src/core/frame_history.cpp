@@ -0,0 +1,276 @@
+#include "frame_history.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+
+namespace
+{
+uint32_t packColor(Color c)
+{
+  auto toByte = [](float v)
+  {
+    v = v < 0 ? 0 : (v > 1 ? 1 : v);
+    return uint32_t(v * 255.0f + 0.5f);
+  };
+
+  return toByte(c.r) | (toByte(c.g) << 8) | (toByte(c.b) << 16) | (toByte(c.a) << 24);
+}
+
+Color unpackColor(uint32_t c)
+{
+  const float k = 1.0f / 255.0f;
+  return {(c & 0xff) * k, ((c >> 8) & 0xff) * k, ((c >> 16) & 0xff) * k, ((c >> 24) & 0xff) * k};
+}
+
+// FNV-1a
+size_t hashString(const char* text)
+{
+  uint32_t h = 2166136261u;
+  while(*text)
+    h = (h ^ (unsigned char)*text++) * 16777619u;
+  return h;
+}
+
+template<typename T>
+void eraseFront(std::vector<T>& v, uint32_t count)
+{
+  v.erase(v.begin(), v.begin() + count);
+}
+}
+
+FrameHistory::Bounds FrameHistory::bounds(const PackedLine& line)
+{
+  return {{min(line.a.x, line.b.x), min(line.a.y, line.b.y)}, {max(line.a.x, line.b.x), max(line.a.y, line.b.y)}};
+}
+
+FrameHistory::Bounds FrameHistory::bounds(const PackedRect& rect)
+{
+  // 'b' is the size, possibly negative
+  const Vec2 c = rect.a + rect.b;
+  return {{min(rect.a.x, c.x), min(rect.a.y, c.y)}, {max(rect.a.x, c.x), max(rect.a.y, c.y)}};
+}
+
+FrameHistory::Bounds FrameHistory::bounds(const PackedCircle& circle)
+{
+  const float r = fabs(circle.radius);
+  return {circle.center - Vec2(r, r), circle.center + Vec2(r, r)};
+}
+
+template<typename T>
+void FrameHistory::addToRun(std::vector<Bounds>& runs, uint32_t count, const T& item)
+{
+  const Bounds b = bounds(item);
+
+  if((count - 1) % RunSize == 0)
+  {
+    runs.push_back(b);
+    return;
+  }
+
+  auto& run = runs.back();
+  run.min = {min(run.min.x, b.min.x), min(run.min.y, b.min.y)};
+  run.max = {max(run.max.x, b.max.x), max(run.max.y, b.max.y)};
+}
+
+template<typename T>
+void FrameHistory::rebuildRuns(std::vector<Bounds>& runs, const std::vector<T>& items)
+{
+  runs.clear();
+  for(size_t i = 0; i < items.size(); ++i)
+    addToRun(runs, uint32_t(i + 1), items[i]);
+}
+
+FrameHistory::FrameHistory(size_t memoryCap)
+    : m_memoryCap(memoryCap)
+{
+}
+
+void FrameHistory::line(Vec3 a, Vec3 b, Color color)
+{
+  m_lines.push_back({a, b, packColor(color)});
+  addToRun(m_lineRuns, m_lines.size(), m_lines.back());
+}
+
+void FrameHistory::rect(Vec2 a, Vec2 b, Color color)
+{
+  m_rects.push_back({a, b, packColor(color)});
+  addToRun(m_rectRuns, m_rects.size(), m_rects.back());
+}
+
+void FrameHistory::circle(Vec2 center, float radius, Color color)
+{
+  m_circles.push_back({center, radius, packColor(color)});
+  addToRun(m_circleRuns, m_circles.size(), m_circles.back());
+}
+
+void FrameHistory::text(Vec2 pos, const char* text, Color color)
+{
+  m_texts.push_back({pos, intern(text), packColor(color)});
+}
+
+void FrameHistory::commit()
+{
+  m_frames.push_back({uint32_t(m_lines.size()), uint32_t(m_rects.size()), uint32_t(m_circles.size()),
+        uint32_t(m_texts.size())});
+
+  if(memoryUsage() > m_memoryCap)
+    dropOldestFrames();
+}
+
+void FrameHistory::clear()
+{
+  m_lines.clear();
+  m_rects.clear();
+  m_circles.clear();
+  m_texts.clear();
+  m_lineRuns.clear();
+  m_rectRuns.clear();
+  m_circleRuns.clear();
+  m_strings.clear();
+  std::fill(m_stringTable.begin(), m_stringTable.end(), 0);
+  m_stringCount = 0;
+  m_frames.clear();
+  m_droppedFrames = 0;
+}
+
+void FrameHistory::replay(int frame, IDrawer* drawer) const
+{
+  assert(frame >= firstFrame() && frame < frameCount());
+
+  const int i = frame - m_droppedFrames;
+  const Frame begin = i > 0 ? m_frames[i - 1] : Frame{};
+  const Frame end = m_frames[i];
+
+  Bounds view;
+  const bool culling = drawer->visibleArea(view.min, view.max);
+
+  // calls 'draw(k)' for the primitives [first;last[ of the runs overlapping the view
+  auto forVisible = [&](const std::vector<Bounds>& runs, uint32_t first, uint32_t last, auto draw)
+  {
+    for(uint32_t k = first; k < last;)
+    {
+      const Bounds& run = runs[k / RunSize];
+      const uint32_t runEnd = std::min(last, (k / RunSize + 1) * RunSize);
+
+      if(culling && (run.max.x < view.min.x || run.min.x > view.max.x || run.max.y < view.min.y ||
+                          run.min.y > view.max.y))
+      {
+        k = runEnd;
+        continue;
+      }
+
+      for(; k < runEnd; ++k)
+        draw(k);
+    }
+  };
+
+  forVisible(m_lineRuns, begin.lines, end.lines,
+        [&](uint32_t k) { drawer->line(m_lines[k].a, m_lines[k].b, unpackColor(m_lines[k].color)); });
+
+  forVisible(m_rectRuns, begin.rects, end.rects,
+        [&](uint32_t k) { drawer->rect(m_rects[k].a, m_rects[k].b, unpackColor(m_rects[k].color)); });
+
+  forVisible(m_circleRuns, begin.circles, end.circles,
+        [&](uint32_t k)
+        { drawer->circle(m_circles[k].center, m_circles[k].radius, unpackColor(m_circles[k].color)); });
+
+  for(uint32_t k = begin.texts; k < end.texts; ++k)
+    drawer->text(m_texts[k].pos, &m_strings[m_texts[k].offset], unpackColor(m_texts[k].color));
+}
+
+size_t FrameHistory::memoryUsage() const
+{
+  return m_lines.size() * sizeof(PackedLine) + m_rects.size() * sizeof(PackedRect) +
+        m_circles.size() * sizeof(PackedCircle) + m_texts.size() * sizeof(PackedText) + m_strings.size() +
+        m_stringTable.size() * sizeof(uint32_t) +
+        (m_lineRuns.size() + m_rectRuns.size() + m_circleRuns.size()) * sizeof(Bounds) +
+        m_frames.size() * sizeof(Frame);
+}
+
+uint32_t FrameHistory::intern(const char* text)
+{
+  if(2 * (m_stringCount + 1) > m_stringTable.size())
+    growStringTable();
+
+  const size_t mask = m_stringTable.size() - 1;
+  for(size_t slot = hashString(text) & mask;; slot = (slot + 1) & mask)
+  {
+    const uint32_t entry = m_stringTable[slot];
+
+    if(entry == 0)
+    {
+      const auto offset = uint32_t(m_strings.size());
+      m_strings.insert(m_strings.end(), text, text + strlen(text) + 1);
+      m_stringTable[slot] = offset + 1;
+      m_stringCount++;
+      return offset;
+    }
+
+    if(strcmp(&m_strings[entry - 1], text) == 0)
+      return entry - 1;
+  }
+}
+
+void FrameHistory::growStringTable()
+{
+  std::vector<uint32_t> entries;
+  entries.swap(m_stringTable);
+
+  m_stringTable.assign(std::max<size_t>(64, entries.size() * 2), 0);
+
+  const size_t mask = m_stringTable.size() - 1;
+  for(auto entry : entries)
+  {
+    if(entry == 0)
+      continue;
+
+    size_t slot = hashString(&m_strings[entry - 1]) & mask;
+    while(m_stringTable[slot] != 0)
+      slot = (slot + 1) & mask;
+    m_stringTable[slot] = entry;
+  }
+}
+
+// Drops the oldest half of the frames (always keeping the newest one).
+// Amortized, this keeps the cost of recording linear in the recorded size.
+void FrameHistory::dropOldestFrames()
+{
+  const int dropCount = int(m_frames.size()) / 2;
+  if(dropCount == 0)
+    return;
+
+  const Frame cut = m_frames[dropCount - 1];
+
+  eraseFront(m_lines, cut.lines);
+  eraseFront(m_rects, cut.rects);
+  eraseFront(m_circles, cut.circles);
+  eraseFront(m_texts, cut.texts);
+  eraseFront(m_frames, dropCount);
+
+  // the runs start at multiples of RunSize: they must be computed again
+  rebuildRuns(m_lineRuns, m_lines);
+  rebuildRuns(m_rectRuns, m_rects);
+  rebuildRuns(m_circleRuns, m_circles);
+
+  for(auto& f : m_frames)
+  {
+    f.lines -= cut.lines;
+    f.rects -= cut.rects;
+    f.circles -= cut.circles;
+    f.texts -= cut.texts;
+  }
+
+  m_droppedFrames += dropCount;
+
+  // re-intern the texts still referenced, so the string pool doesn't grow forever
+  // (copied, not swapped: both pools keep their capacity)
+  m_oldStrings.assign(m_strings.begin(), m_strings.end());
+  m_strings.clear();
+  std::fill(m_stringTable.begin(), m_stringTable.end(), 0);
+  m_stringCount = 0;
+
+  for(auto& t : m_texts)
+    t.offset = intern(&m_oldStrings[t.offset]);
+}
@@ -0,0 +1,129 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "drawer.h"
+
+// Records the primitives submitted during each step of an algorithm,
+// so the execution can be scrubbed forward/backward without rerunning it.
+//
+// All the frames share the same packed buffers (positions + RGBA8 colors,
+// interned texts), whose capacity is kept across clears: once warmed up,
+// recording a frame doesn't allocate.
+// When the memory cap is exceeded, the oldest frames are dropped.
+//
+// The bounds of each run of consecutive lines, rects and circles are kept along,
+// so replaying a frame to a drawer that only shows part of the plane skips whole
+// runs at once (see IDrawer::visibleArea). Runs don't reorder anything: algorithms
+// mostly draw neighbouring primitives one after the other, and the drawing order is kept.
+class FrameHistory
+{
+  public:
+  static constexpr size_t DefaultMemoryCap = 256 * 1024 * 1024;
+
+  explicit FrameHistory(size_t memoryCap = DefaultMemoryCap);
+
+  // add primitives to the frame being built
+  void line(Vec3 a, Vec3 b, Color color);
+  void rect(Vec2 a, Vec2 b, Color color);
+  void circle(Vec2 center, float radius, Color color);
+  void text(Vec2 pos, const char* text, Color color);
+
+  // closes the frame being built, and starts a new one
+  void commit();
+
+  // discards all the frames, keeping the allocated memory
+  void clear();
+
+  // Frames are numbered from 0 since the last clear.
+  // Only the frames in [firstFrame(), frameCount()[ are still available.
+  int frameCount() const { return m_droppedFrames + int(m_frames.size()); }
+  int firstFrame() const { return m_droppedFrames; }
+
+  // submits the primitives of a recorded frame to 'drawer'
+  void replay(int frame, IDrawer* drawer) const;
+
+  size_t memoryUsage() const;
+
+  private:
+  struct PackedLine
+  {
+    Vec3 a, b;
+    uint32_t color;
+  };
+
+  struct PackedRect
+  {
+    Vec2 a, b;
+    uint32_t color;
+  };
+
+  struct PackedCircle
+  {
+    Vec2 center;
+    float radius;
+    uint32_t color;
+  };
+
+  struct PackedText
+  {
+    Vec2 pos;
+    uint32_t offset; // in m_strings
+    uint32_t color;
+  };
+
+  // end offsets of a frame in each array (the frame begins where the previous one ends)
+  struct Frame
+  {
+    uint32_t lines, rects, circles, texts;
+  };
+
+  struct Bounds
+  {
+    Vec2 min, max;
+  };
+
+  // primitives per run: the runs of an array start at multiples of it
+  static constexpr uint32_t RunSize = 64;
+
+  static Bounds bounds(const PackedLine& line);
+  static Bounds bounds(const PackedRect& rect);
+  static Bounds bounds(const PackedCircle& circle);
+
+  // to call after appending 'item' to its array, whose size is now 'count'
+  template<typename T>
+  static void addToRun(std::vector<Bounds>& runs, uint32_t count, const T& item);
+
+  template<typename T>
+  static void rebuildRuns(std::vector<Bounds>& runs, const std::vector<T>& items);
+
+  uint32_t intern(const char* text);
+  void growStringTable();
+  void dropOldestFrames();
+
+  const size_t m_memoryCap;
+
+  std::vector<PackedLine> m_lines;
+  std::vector<PackedRect> m_rects;
+  std::vector<PackedCircle> m_circles;
+  std::vector<PackedText> m_texts;
+
+  std::vector<Bounds> m_lineRuns;
+  std::vector<Bounds> m_rectRuns;
+  std::vector<Bounds> m_circleRuns;
+
+  // zero-terminated strings, each one stored once
+  std::vector<char> m_strings;
+
+  // open addressing, hashed on the string: each slot holds an offset in m_strings plus one (0 is empty).
+  // The size is a power of two, at least twice the number of strings.
+  std::vector<uint32_t> m_stringTable;
+  uint32_t m_stringCount = 0;
+
+  std::vector<char> m_oldStrings; // scratch pool for 'dropOldestFrames'
+
+  std::vector<Frame> m_frames;
+  int m_droppedFrames = 0;
+};
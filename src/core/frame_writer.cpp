@@ -0,0 +1,117 @@
+#include "frame_writer.h"
+
+#include <cstdio>
+
+namespace
+{
+void put16(FILE* fp, uint16_t val)
+{
+  fputc(val & 0xff, fp);
+  fputc(val >> 8, fp);
+}
+
+void put32(FILE* fp, uint32_t val)
+{
+  put16(fp, val & 0xffff);
+  put16(fp, val >> 16);
+}
+}
+
+bool saveBmp(const char* path, int width, int height, const uint8_t* pixels)
+{
+  FILE* fp = fopen(path, "wb");
+  if(!fp)
+    return false;
+
+  const uint32_t headerSize = 14 + 40;
+  const uint32_t imageSize = width * height * 4;
+
+  // file header
+  fputc('B', fp);
+  fputc('M', fp);
+  put32(fp, headerSize + imageSize);
+  put32(fp, 0);
+  put32(fp, headerSize);
+
+  // info header (BITMAPINFOHEADER): positive height means bottom row first, like OpenGL
+  put32(fp, 40);
+  put32(fp, width);
+  put32(fp, height);
+  put16(fp, 1); // planes
+  put16(fp, 32); // bits per pixel
+  put32(fp, 0); // BI_RGB
+  put32(fp, imageSize);
+  put32(fp, 2835); // 72 DPI
+  put32(fp, 2835);
+  put32(fp, 0);
+  put32(fp, 0);
+
+  // BMP wants BGRA
+  std::vector<uint8_t> row(width * 4);
+  for(int y = 0; y < height; ++y)
+  {
+    const uint8_t* src = pixels + y * width * 4;
+    for(int x = 0; x < width; ++x)
+    {
+      row[x * 4 + 0] = src[x * 4 + 2];
+      row[x * 4 + 1] = src[x * 4 + 1];
+      row[x * 4 + 2] = src[x * 4 + 0];
+      row[x * 4 + 3] = src[x * 4 + 3];
+    }
+    fwrite(row.data(), 1, row.size(), fp);
+  }
+
+  const bool ok = !ferror(fp);
+  fclose(fp);
+  return ok;
+}
+
+FrameWriter::FrameWriter()
+    : m_thread(&FrameWriter::threadFunc, this)
+{
+}
+
+FrameWriter::~FrameWriter()
+{
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_quit = true;
+  }
+  m_jobAdded.notify_one();
+  m_thread.join();
+}
+
+void FrameWriter::write(std::string path, int width, int height, std::vector<uint8_t> pixels)
+{
+  {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_jobRemoved.wait(lock, [this]() { return m_jobs.size() < MaxPendingJobs; });
+    m_jobs.push_back({std::move(path), width, height, std::move(pixels)});
+  }
+  m_jobAdded.notify_one();
+}
+
+void FrameWriter::threadFunc()
+{
+  while(true)
+  {
+    Job job;
+
+    {
+      std::unique_lock<std::mutex> lock(m_mutex);
+      m_jobAdded.wait(lock, [this]() { return m_quit || !m_jobs.empty(); });
+
+      if(m_jobs.empty())
+        return; // quitting, and nothing left to write
+
+      job = std::move(m_jobs.front());
+      m_jobs.pop_front();
+    }
+    m_jobRemoved.notify_one();
+
+    if(saveBmp(job.path.c_str(), job.width, job.height, job.pixels.data()))
+      fprintf(stderr, "Saved: %s\n", job.path.c_str());
+    else
+      fprintf(stderr, "Can't save: %s\n", job.path.c_str());
+  }
+}
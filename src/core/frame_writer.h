@@ -0,0 +1,47 @@
+#pragma once
+
+// Writes captured frames to disk from a background thread,
+// so saving screenshots and frame sequences doesn't stall the main loop.
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+class FrameWriter
+{
+  public:
+  FrameWriter();
+  ~FrameWriter(); // writes all the pending frames
+
+  // Queues a frame to be saved as a BMP file.
+  // 'pixels' holds RGBA rows, bottom row first (as returned by glReadPixels).
+  // Blocks if too many frames are already waiting, to bound memory usage.
+  void write(std::string path, int width, int height, std::vector<uint8_t> pixels);
+
+  private:
+  struct Job
+  {
+    std::string path;
+    int width;
+    int height;
+    std::vector<uint8_t> pixels;
+  };
+
+  void threadFunc();
+
+  static constexpr size_t MaxPendingJobs = 64;
+
+  std::mutex m_mutex;
+  std::condition_variable m_jobAdded;
+  std::condition_variable m_jobRemoved;
+  std::deque<Job> m_jobs;
+  bool m_quit = false;
+  std::thread m_thread; // must be constructed last
+};
+
+// Saves RGBA pixels (bottom row first) as a 32-bit BMP file. Returns false on failure.
+bool saveBmp(const char* path, int width, int height, const uint8_t* pixels);
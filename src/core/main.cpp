@@ -7,14 +7,19 @@
 ///////////////////////////////////////////////////////////////////////////////
 // Entry point
 
+#include <algorithm>
+#include <cstring>
 #include <map>
 #include <memory>
 #include <stdexcept>
+#include <string>
 #include <vector>
 
+#include "algorithm_app.h"
 #include "app.h"
 #include "drawer.h"
 #include "font.h"
+#include "frame_writer.h"
 #include "geom.h"
 #include "matrix4.h"
 
@@ -43,6 +48,8 @@ Vec2 g_ScreenSize{};
 bool gMustReset = false;
 bool gMustQuit = false;
 bool gMustScreenShot = false;
+bool gMustToggleRecording = false;
+bool gMustRedraw = true; // the window contents were lost (exposed, resized)
 
 template<typename T>
 T lerp(T a, T b, float alpha)
@@ -135,18 +142,26 @@ int createWhiteTexture()
   return texture;
 }
 
-struct Vertex
+// RGBA8, as expected by the 'color' vertex attribute
+uint32_t packColor(Color c)
 {
-  float x, y, z;
-  float u, v;
-  float r, g, b, a;
-};
+  auto toByte = [](float v)
+  {
+    v = v < 0 ? 0 : (v > 1 ? 1 : v);
+    return uint32_t(v * 255.0f + 0.5f);
+  };
+
+  return toByte(c.r) | (toByte(c.g) << 8) | (toByte(c.b) << 16) | (toByte(c.a) << 24);
+}
 
 enum
 {
   attrib_position,
   attrib_color,
   attrib_uv,
+  attrib_instance0,
+  attrib_instance1,
+  attrib_corner0, // to attrib_corner0 + 7
 };
 
 static const char* vertex_shader = R"(#version 130
@@ -164,6 +179,68 @@ void main()
 }
 )";
 
+// one instance per circle, expanded from a cached unit circle
+static const char* circle_vertex_shader = R"(#version 130
+uniform mat4x4 mvp;
+in vec2 pos;
+in vec3 center_radius;
+in vec4 color;
+out vec4 v_color;
+out vec2 v_uv;
+void main()
+{
+    v_color = color;
+    v_uv = vec2(0, 0);
+    gl_Position = mvp * vec4(center_radius.xy + pos * center_radius.z, 0, 1);
+}
+)";
+
+// one instance per character, expanded from a cached unit quad
+static const char* glyph_vertex_shader = R"(#version 130
+uniform mat4x4 mvp;
+in vec2 pos;
+in vec4 rect;
+in float glyph;
+in vec4 color;
+out vec4 v_color;
+out vec2 v_uv;
+void main()
+{
+    float col = mod(glyph, 16.0);
+    float row = floor(glyph / 16.0);
+    v_color = color;
+    v_uv = vec2((col + pos.x) / 16.0, (row + 1.0 - pos.y) / 8.0);
+    gl_Position = mvp * vec4(rect.xy + pos * rect.zw, 1, 1);
+}
+)";
+
+// one instance per box, expanded from the cached edges of the unit cube ('pos.x' is the corner index):
+// the corners are picked by trilinear interpolation, whose weights are all 0 or 1
+static const char* box_vertex_shader = R"(#version 130
+uniform mat4x4 mvp;
+in vec2 pos;
+in vec3 corner0;
+in vec3 corner1;
+in vec3 corner2;
+in vec3 corner3;
+in vec3 corner4;
+in vec3 corner5;
+in vec3 corner6;
+in vec3 corner7;
+in vec4 color;
+out vec4 v_color;
+out vec2 v_uv;
+void main()
+{
+    vec3 t = vec3(mod(pos.x, 2.0), mod(floor(pos.x / 2.0), 2.0), floor(pos.x / 4.0));
+    vec3 face0 = mix(mix(corner0, corner1, t.x), mix(corner2, corner3, t.x), t.y);
+    vec3 face1 = mix(mix(corner4, corner5, t.x), mix(corner6, corner7, t.x), t.y);
+    v_color = color;
+    v_uv = vec2(0, 0);
+    gl_Position = mvp * vec4(mix(face0, face1, t.z), 1);
+}
+)";
+
 static const char* fragment_shader = R"(#version 130
 uniform sampler2D diffuse;
 in vec4 v_color;
@@ -190,10 +267,10 @@ int createShaderStage(int type, const char* code)
   return vs;
 }
 
-int createShaderProgram()
+int createShaderProgram(const char* vsCode, const char* fsCode)
 {
-  auto vs = createShaderStage(GL_VERTEX_SHADER, vertex_shader);
-  auto fs = createShaderStage(GL_FRAGMENT_SHADER, fragment_shader);
+  auto vs = createShaderStage(GL_VERTEX_SHADER, vsCode);
+  auto fs = createShaderStage(GL_FRAGMENT_SHADER, fsCode);
 
   auto program = glCreateProgram();
   glAttachShader(program, vs);
@@ -202,6 +279,17 @@ int createShaderProgram()
   glBindAttribLocation(program, attrib_position, "pos");
   glBindAttribLocation(program, attrib_color, "color");
   glBindAttribLocation(program, attrib_uv, "uv");
+  glBindAttribLocation(program, attrib_instance0, "center_radius");
+  glBindAttribLocation(program, attrib_instance0, "rect");
+  glBindAttribLocation(program, attrib_instance1, "glyph");
+
+  for(int i = 0; i < 8; ++i)
+  {
+    char name[16];
+    snprintf(name, sizeof name, "corner%d", i);
+    glBindAttribLocation(program, attrib_corner0 + i, name);
+  }
+
   glLinkProgram(program);
 
   glDeleteShader(vs);
@@ -210,53 +298,312 @@ int createShaderProgram()
   return program;
 }
 
+// Lines are untextured: they don't carry any UV (see OpenGlDrawer's constructor)
+struct LineVertex
+{
+  float x, y, z;
+  uint32_t color;
+
+  static void setupAttribs()
+  {
+    glEnableVertexAttribArray(attrib_position);
+    glVertexAttribPointer(attrib_position, 3, GL_FLOAT, GL_FALSE, sizeof(LineVertex), (void*)offsetof(LineVertex, x));
+
+    glEnableVertexAttribArray(attrib_color);
+    glVertexAttribPointer(
+          attrib_color, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(LineVertex), (void*)offsetof(LineVertex, color));
+
+    glDisableVertexAttribArray(attrib_uv);
+  }
+};
+
+struct CircleInstance
+{
+  float x, y, radius;
+  uint32_t color;
+
+  static void setupAttribs()
+  {
+    glEnableVertexAttribArray(attrib_instance0);
+    glVertexAttribPointer(
+          attrib_instance0, 3, GL_FLOAT, GL_FALSE, sizeof(CircleInstance), (void*)offsetof(CircleInstance, x));
+    glVertexAttribDivisor(attrib_instance0, 1);
+
+    glEnableVertexAttribArray(attrib_color);
+    glVertexAttribPointer(
+          attrib_color, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(CircleInstance), (void*)offsetof(CircleInstance, color));
+    glVertexAttribDivisor(attrib_color, 1);
+  }
+};
+
+struct GlyphInstance
+{
+  float x, y, w, h;
+  float glyph;
+  uint32_t color;
+
+  static void setupAttribs()
+  {
+    glEnableVertexAttribArray(attrib_instance0);
+    glVertexAttribPointer(
+          attrib_instance0, 4, GL_FLOAT, GL_FALSE, sizeof(GlyphInstance), (void*)offsetof(GlyphInstance, x));
+    glVertexAttribDivisor(attrib_instance0, 1);
+
+    glEnableVertexAttribArray(attrib_instance1);
+    glVertexAttribPointer(
+          attrib_instance1, 1, GL_FLOAT, GL_FALSE, sizeof(GlyphInstance), (void*)offsetof(GlyphInstance, glyph));
+    glVertexAttribDivisor(attrib_instance1, 1);
+
+    glEnableVertexAttribArray(attrib_color);
+    glVertexAttribPointer(
+          attrib_color, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(GlyphInstance), (void*)offsetof(GlyphInstance, color));
+    glVertexAttribDivisor(attrib_color, 1);
+  }
+};
+
+struct BoxInstance
+{
+  Vec3 corners[8];
+  uint32_t color;
+
+  static void setupAttribs()
+  {
+    for(int i = 0; i < 8; ++i)
+    {
+      glEnableVertexAttribArray(attrib_corner0 + i);
+      glVertexAttribPointer(attrib_corner0 + i, 3, GL_FLOAT, GL_FALSE, sizeof(BoxInstance),
+            (void*)(offsetof(BoxInstance, corners) + i * sizeof(Vec3)));
+      glVertexAttribDivisor(attrib_corner0 + i, 1);
+    }
+
+    glEnableVertexAttribArray(attrib_color);
+    glVertexAttribPointer(
+          attrib_color, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(BoxInstance), (void*)offsetof(BoxInstance, color));
+    glVertexAttribDivisor(attrib_color, 1);
+  }
+};
+
+// Vertices are accumulated on the CPU during the frame, then streamed to the GPU
+// in batches of 'batchSize' vertices through a fixed-size VBO.
+// Each batch orphans the previous storage, so the driver can hand us fresh memory
+// instead of stalling until the GPU is done with the previous batch.
+template<typename VertexType>
 struct PrimitiveBuffer
 {
-  PrimitiveBuffer() { glGenBuffers(1, &gpuVbo); }
-  ~PrimitiveBuffer() { glDeleteBuffers(1, &gpuVbo); }
+  PrimitiveBuffer(GLenum type, int batchSize)
+      : type(type)
+      , batchSize(std::max(6, batchSize - batchSize % 6)) // whole lines and triangles only
+  {
+    glGenVertexArrays(1, &vao);
+    glBindVertexArray(vao);
 
-  void write(const Vertex& v) { cpuVbo.push_back(v); }
+    glGenBuffers(1, &gpuVbo);
+    glBindBuffer(GL_ARRAY_BUFFER, gpuVbo);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(VertexType) * this->batchSize, nullptr, GL_STREAM_DRAW);
+
+    VertexType::setupAttribs();
+  }
+
+  ~PrimitiveBuffer()
+  {
+    glDeleteBuffers(1, &gpuVbo);
+    glDeleteVertexArrays(1, &vao);
+  }
+
+  void write(const VertexType& v) { cpuVbo.push_back(v); }
   void draw()
   {
+    if(cpuVbo.empty())
+      return;
+
+    glBindVertexArray(vao);
     glBindBuffer(GL_ARRAY_BUFFER, gpuVbo);
 
+    for(size_t first = 0; first < cpuVbo.size(); first += batchSize)
+    {
+      const size_t count = std::min(cpuVbo.size() - first, batchSize);
+
+      glBufferData(GL_ARRAY_BUFFER, sizeof(VertexType) * batchSize, nullptr, GL_STREAM_DRAW);
+      glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(VertexType) * count, cpuVbo.data() + first);
+      glDrawArrays(type, 0, count);
+    }
+
+    cpuVbo.clear(); // keeps the capacity for the next frame
+  }
+
+  const GLenum type;
+  const size_t batchSize;
+  GLuint vao;
+  GLuint gpuVbo;
+  std::vector<VertexType> cpuVbo;
+};
+
+// Same as PrimitiveBuffer, but streams instance records:
+// each instance draws the vertices [first;first+count[ of a static 2D shape.
+template<typename InstanceType>
+struct InstanceBuffer
+{
+  InstanceBuffer(GLenum type, GLuint shapeVbo, int first, int count, int batchSize)
+      : type(type)
+      , first(first)
+      , count(count)
+      , batchSize(std::max(1, batchSize))
+  {
+    glGenVertexArrays(1, &vao);
+    glBindVertexArray(vao);
+
+    glBindBuffer(GL_ARRAY_BUFFER, shapeVbo);
     glEnableVertexAttribArray(attrib_position);
-    glVertexAttribPointer(attrib_position, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, x));
+    glVertexAttribPointer(attrib_position, 2, GL_FLOAT, GL_FALSE, sizeof(Vec2), nullptr);
 
-    glEnableVertexAttribArray(attrib_color);
-    glVertexAttribPointer(attrib_color, 4, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, r));
+    glGenBuffers(1, &gpuVbo);
+    glBindBuffer(GL_ARRAY_BUFFER, gpuVbo);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(InstanceType) * this->batchSize, nullptr, GL_STREAM_DRAW);
+
+    InstanceType::setupAttribs();
+  }
+
+  ~InstanceBuffer()
+  {
+    glDeleteBuffers(1, &gpuVbo);
+    glDeleteVertexArrays(1, &vao);
+  }
+
+  void write(const InstanceType& v) { cpuVbo.push_back(v); }
+  void draw()
+  {
+    if(cpuVbo.empty())
+      return;
+
+    glBindVertexArray(vao);
+    glBindBuffer(GL_ARRAY_BUFFER, gpuVbo);
 
-    glEnableVertexAttribArray(attrib_uv);
-    glVertexAttribPointer(attrib_uv, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, u));
+    for(size_t i = 0; i < cpuVbo.size(); i += batchSize)
+    {
+      const size_t instanceCount = std::min(cpuVbo.size() - i, batchSize);
 
-    glBufferData(GL_ARRAY_BUFFER, sizeof(Vertex) * cpuVbo.size(), cpuVbo.data(), GL_DYNAMIC_DRAW);
-    glDrawArrays(type, 0, cpuVbo.size());
+      glBufferData(GL_ARRAY_BUFFER, sizeof(InstanceType) * batchSize, nullptr, GL_STREAM_DRAW);
+      glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(InstanceType) * instanceCount, cpuVbo.data() + i);
+      glDrawArraysInstanced(type, first, count, instanceCount);
+    }
 
-    cpuVbo.clear();
+    cpuVbo.clear(); // keeps the capacity for the next frame
   }
 
-  GLuint type;
+  const GLenum type;
+  const int first;
+  const int count;
+  const size_t batchSize;
+  GLuint vao;
   GLuint gpuVbo;
-  std::vector<Vertex> cpuVbo;
+  std::vector<InstanceType> cpuVbo;
+};
+
+// Level-of-details for circles: the segment count depends on the on-screen radius
+static const int circleSegmentCounts[] = {8, 16, 32, 64};
+static const float circleMaxPixelRadius[] = {4, 16, 64, INFINITY};
+static const int circleLodCount = 4;
+
+// all the unit circles, as line lists, followed by a unit quad as a triangle list,
+// then the edges of the unit cube as a line list (each vertex only holds the index of its corner, in x)
+struct StaticShapes
+{
+  StaticShapes()
+  {
+    std::vector<Vec2> vertices;
+
+    for(int lod = 0; lod < circleLodCount; ++lod)
+    {
+      const int N = circleSegmentCounts[lod];
+      circleFirst[lod] = vertices.size();
+
+      for(int i = 0; i < N; ++i)
+      {
+        const auto angle0 = i * 2 * M_PI / N;
+        const auto angle1 = (i + 1) * 2 * M_PI / N;
+        vertices.push_back(Vec2(cos(angle0), sin(angle0)));
+        vertices.push_back(Vec2(cos(angle1), sin(angle1)));
+      }
+
+      circleCount[lod] = N * 2;
+    }
+
+    quadFirst = vertices.size();
+    for(auto corner : {Vec2(0, 0), Vec2(1, 1), Vec2(1, 0), Vec2(0, 0), Vec2(0, 1), Vec2(1, 1)})
+      vertices.push_back(corner);
+    quadCount = 6;
+
+    boxFirst = vertices.size();
+    for(int i = 0; i < 8; ++i)
+    {
+      for(int bit = 1; bit < 8; bit <<= 1)
+      {
+        if(i & bit)
+          continue;
+        vertices.push_back(Vec2(i, 0));
+        vertices.push_back(Vec2(i | bit, 0));
+      }
+    }
+    boxCount = 24;
+
+    glGenBuffers(1, &vbo);
+    glBindBuffer(GL_ARRAY_BUFFER, vbo);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(Vec2) * vertices.size(), vertices.data(), GL_STATIC_DRAW);
+  }
+
+  ~StaticShapes() { glDeleteBuffers(1, &vbo); }
+
+  GLuint vbo;
+  int circleFirst[circleLodCount];
+  int circleCount[circleLodCount];
+  int quadFirst;
+  int quadCount;
+  int boxFirst;
+  int boxCount;
 };
 
 struct OpenGlDrawer : IDrawer
 {
-  OpenGlDrawer()
+  static constexpr int DefaultBatchSize = 6 * 16384;
+
+  OpenGlDrawer(int batchSize = DefaultBatchSize)
+      : m_bufLines(GL_LINES, batchSize)
+      , m_bufPoints(GL_POINTS, batchSize)
+      , m_bufLines3D(GL_LINES, batchSize)
+      , m_bufBlendedLines3D(GL_LINES, batchSize)
+      , m_bufLinesUI(GL_LINES, batchSize)
+      , m_bufCircles{
+              {GL_LINES, m_shapes.vbo, m_shapes.circleFirst[0], m_shapes.circleCount[0], batchSize},
+              {GL_LINES, m_shapes.vbo, m_shapes.circleFirst[1], m_shapes.circleCount[1], batchSize},
+              {GL_LINES, m_shapes.vbo, m_shapes.circleFirst[2], m_shapes.circleCount[2], batchSize},
+              {GL_LINES, m_shapes.vbo, m_shapes.circleFirst[3], m_shapes.circleCount[3], batchSize},
+        }
+      , m_bufGlyphs(GL_TRIANGLES, m_shapes.vbo, m_shapes.quadFirst, m_shapes.quadCount, batchSize)
+      , m_bufGlyphsUI(GL_TRIANGLES, m_shapes.vbo, m_shapes.quadFirst, m_shapes.quadCount, batchSize)
+      , m_bufBoxes(GL_LINES, m_shapes.vbo, m_shapes.boxFirst, m_shapes.boxCount, batchSize)
+      , m_bufBlendedBoxes(GL_LINES, m_shapes.vbo, m_shapes.boxFirst, m_shapes.boxCount, batchSize)
   {
+    static_assert(sizeof(circleSegmentCounts) / sizeof(*circleSegmentCounts) == circleLodCount);
+    static_assert(sizeof(circleMaxPixelRadius) / sizeof(*circleMaxPixelRadius) == circleLodCount);
+
     fontTexture = createFontTexture();
     whiteTexture = createWhiteTexture();
 
-    shaderProgram = createShaderProgram();
-    m_bufLines.type = GL_LINES;
-    m_bufTris.type = GL_TRIANGLES;
-    m_bufLinesUI.type = GL_LINES;
-    m_bufTrisUI.type = GL_TRIANGLES;
+    shaderProgram = createShaderProgram(vertex_shader, fragment_shader);
+    circleShaderProgram = createShaderProgram(circle_vertex_shader, fragment_shader);
+    glyphShaderProgram = createShaderProgram(glyph_vertex_shader, fragment_shader);
+    boxShaderProgram = createShaderProgram(box_vertex_shader, fragment_shader);
+
+    // Line vertices have no UV array: they all sample the (white) texture at this constant UV
+    glVertexAttrib2f(attrib_uv, 0, 0);
   }
 
   ~OpenGlDrawer()
   {
     glDeleteProgram(shaderProgram);
+    glDeleteProgram(circleShaderProgram);
+    glDeleteProgram(glyphShaderProgram);
+    glDeleteProgram(boxShaderProgram);
 
     glDeleteTextures(1, &fontTexture);
     glDeleteTextures(1, &whiteTexture);
@@ -265,14 +612,56 @@ struct OpenGlDrawer : IDrawer
   /////////////////////////////////////////////////////////////////////////////
   // IDrawer implementation
 
-  void line(Vec2 a, Vec2 b, Color color) override { rawLine(m_bufLines, a, b, color); }
-  void line(Vec3 a, Vec3 b, Color color) override { rawLine(m_bufLines, a, b, color); }
+  void line(Vec2 a, Vec2 b, Color color) override
+  {
+    if(isVisible(a, b))
+      rawLine(m_bufLines, a, b, color);
+  }
+
+  void line(Vec3 a, Vec3 b, Color color) override
+  {
+    const Vec3 points[] = {a, b};
+    if(!isInsideFrustum(points))
+      return;
+
+    if(color.a < 1)
+      m_blendedLines3D.push_back({depthOf((a + b) * 0.5), a, b, packColor(color)});
+    else
+      rawLine(m_bufLines3D, a, b, color);
+  }
+
+  using IDrawer::box;
+
+  void box(const Vec3 (&corners)[8], Color color) override
+  {
+    if(!isInsideFrustum(corners))
+      return;
+
+    BoxInstance instance;
+    for(int i = 0; i < 8; ++i)
+      instance.corners[i] = corners[i];
+    instance.color = packColor(color);
+
+    if(color.a < 1)
+      m_blendedBoxes.push_back({depthOf((corners[0] + corners[7]) * 0.5), instance});
+    else
+      m_bufBoxes.write(instance);
+  }
 
   void rect(Vec2 a, Vec2 b, Color color) override
   {
     const auto A = a;
     const auto B = a + b;
 
+    if(!isVisible(A, B))
+      return;
+
+    if(m_culling && fabs(b.x) < m_pixelSize && fabs(b.y) < m_pixelSize)
+    {
+      rawPoint(A + b * 0.5, color);
+      return;
+    }
+
     const auto P0 = Vec2(A.x, A.y);
     const auto P1 = Vec2(B.x, A.y);
     const auto P2 = Vec2(B.x, B.y);
@@ -286,19 +675,29 @@ struct OpenGlDrawer : IDrawer
 
   void circle(Vec2 center, float radius, Color color) override
   {
-    auto const N = 20;
-    Vec2 PREV{};
+    const Vec2 extent(fabs(radius), fabs(radius));
+    if(!isVisible(center - extent, center + extent))
+      return;
 
-    for(int i = 0; i <= N; ++i)
+    // perspective doesn't allow to know the on-screen size here: use a medium LOD
+    int lod = 2;
+
+    if(!g_Camera.perspective)
     {
-      const auto angle = i * 2 * M_PI / N;
-      auto A = center + Vec2(cos(angle), sin(angle)) * radius;
+      const float pixelRadius = fabs(radius) * g_Camera.scale * g_ScreenSize.y * 0.5f;
 
-      if(i > 0)
-        rawLine(m_bufLines, PREV, A, color);
+      if(m_culling && pixelRadius < 0.5f)
+      {
+        rawPoint(center, color);
+        return;
+      }
 
-      PREV = A;
+      lod = 0;
+      while(lod + 1 < circleLodCount && pixelRadius > circleMaxPixelRadius[lod])
+        ++lod;
     }
+
+    m_bufCircles[lod].write({center.x, center.y, radius, packColor(color)});
   }
 
   void text(Vec2 pos, const char* text, Color color) override
@@ -306,28 +705,81 @@ struct OpenGlDrawer : IDrawer
     const auto W = fontSize / g_Camera.scale;
     const auto H = fontSize / g_Camera.scale;
 
-    while(*text)
+    if(m_culling)
     {
-      rawChar(m_bufTris, pos, *text, color, W, H);
-      pos.x += W;
-      ++text;
+      if(H < minTextPixelHeight * m_pixelSize)
+        return;
+
+      if(!isVisible(Vec2(pos.x, pos.y - H), Vec2(pos.x + W * strlen(text), pos.y)))
+        return;
     }
+
+    rawText(m_bufGlyphs, pos, text, color, W, H);
+  }
+
+  bool visibleArea(Vec2& min, Vec2& max) const override
+  {
+    min = m_viewMin;
+    max = m_viewMax;
+    return m_culling;
   }
 
   /////////////////////////////////////////////////////////////////////////////
   // Public API
 
+  // Takes the camera of the frame about to be drawn: world primitives outside of its view are dropped,
+  // the sub-pixel ones are drawn as points, and unreadable texts are skipped.
+  // With a perspective camera, everything is drawn.
+  void beginFrame()
+  {
+    m_culling = !g_Camera.perspective;
+
+    const auto halfHeight = 1.0f / g_Camera.scale;
+    const auto halfWidth = halfHeight * g_ScreenSize.x / g_ScreenSize.y;
+
+    m_viewMin = Vec2(g_Camera.pos.x - halfWidth, g_Camera.pos.y - halfHeight);
+    m_viewMax = Vec2(g_Camera.pos.x + halfWidth, g_Camera.pos.y + halfHeight);
+    m_pixelSize = 2 * halfHeight / g_ScreenSize.y;
+
+    const auto aspectRatio = g_ScreenSize.x / g_ScreenSize.y;
+
+    if(g_Camera.perspective)
+    {
+      const auto zNear = 0.1;
+      const auto zFar = 100;
+
+      const auto V = translate(-1 * g_Camera.pos);
+      const auto P = perspective(M_PI * 0.5, aspectRatio, zNear, zFar);
+
+      m_worldTransform = P * V;
+    }
+    else
+    {
+      const auto scaleX = g_Camera.scale / aspectRatio;
+      const auto scaleY = g_Camera.scale;
+      m_worldTransform = scale(Vec3{scaleX, scaleY, 0}) * translate(-1 * g_Camera.pos);
+    }
+
+    // the clip-space planes -w <= x, y, z <= w, as planes of the world (Gribb-Hartmann).
+    // With the orthographic camera, the near and far ones are always satisfied: Z is dropped.
+    const auto& M = m_worldTransform;
+    for(int axis = 0; axis < 3; ++axis)
+    {
+      for(int side = 0; side < 2; ++side)
+      {
+        const float sign = side ? -1 : 1;
+        for(int k = 0; k < 4; ++k)
+          m_frustumPlanes[axis * 2 + side][k] = M[3][k] + sign * M[axis][k];
+      }
+    }
+  }
+
   void uiText(Vec2 pos, const char* text, Color color)
   {
     const auto W = 16;
     const auto H = 16;
 
-    while(*text)
-    {
-      rawChar(m_bufTrisUI, pos, *text, color, W, H);
-      pos.x += W;
-      ++text;
-    }
+    rawText(m_bufGlyphsUI, pos, text, color, W, H);
   }
 
   void uiRect(Vec2 a, Vec2 b, Color color)
@@ -348,170 +800,349 @@ struct OpenGlDrawer : IDrawer
 
   void flush()
   {
-    const int mvpLoc = glGetUniformLocation(shaderProgram, "mvp");
-    const auto aspectRatio = g_ScreenSize.x / g_ScreenSize.y;
-
     glEnable(GL_BLEND);
     glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
-    glUseProgram(shaderProgram);
-
     // draw world
     {
-      // setup transform
-      {
-        Matrix4f M;
-        if(g_Camera.perspective)
-        {
-          const auto zNear = 0.1;
-          const auto zFar = 100;
-
-          const auto V = translate(-1 * g_Camera.pos);
-          const auto P = perspective(M_PI * 0.5, aspectRatio, zNear, zFar);
-
-          M = P * V;
-        }
-        else
-        {
-          const auto scaleX = g_Camera.scale / aspectRatio;
-          const auto scaleY = g_Camera.scale;
-          M = scale(Vec3{scaleX, scaleY, 0}) * translate(-1 * g_Camera.pos);
-        }
-        M = transpose(M); // make the matrix column-major
-        glUniformMatrix4fv(mvpLoc, 1, GL_FALSE, &M[0][0]);
-      }
+      const auto M = transpose(m_worldTransform); // make the matrix column-major
 
       glBindTexture(GL_TEXTURE_2D, whiteTexture);
+
+      useProgram(shaderProgram, M);
       m_bufLines.draw();
+      m_bufPoints.draw();
+
+      useProgram(circleShaderProgram, M);
+      for(auto& buf : m_bufCircles)
+        buf.draw();
+
+      draw3d(M);
 
       glBindTexture(GL_TEXTURE_2D, fontTexture);
-      m_bufTris.draw();
+
+      useProgram(glyphShaderProgram, M);
+      m_bufGlyphs.draw();
     }
 
     // draw UI
     {
       // setup transform
-      {
-        Matrix4f M;
-        M = translate({-1, -1, 0}) * scale({2.0f / g_ScreenSize.x, 2.0f / g_ScreenSize.y, 1});
-        M = transpose(M); // make the matrix column-major
-        glUniformMatrix4fv(mvpLoc, 1, GL_FALSE, &M[0][0]);
-      }
+      Matrix4f M;
+      M = translate({-1, -1, 0}) * scale({2.0f / g_ScreenSize.x, 2.0f / g_ScreenSize.y, 1});
+      M = transpose(M); // make the matrix column-major
 
       glBindTexture(GL_TEXTURE_2D, whiteTexture);
+
+      useProgram(shaderProgram, M);
       m_bufLinesUI.draw();
 
       glBindTexture(GL_TEXTURE_2D, fontTexture);
-      m_bufTrisUI.draw();
+
+      useProgram(glyphShaderProgram, M);
+      m_bufGlyphsUI.draw();
     }
   }
 
   private:
   static constexpr float fontSize = 0.032;
+  static constexpr float minTextPixelHeight = 5; // the 8x8 glyphs can't be read below
+
+  // conservative: tests the bounding box [min(a, b); max(a, b)]
+  bool isVisible(Vec2 a, Vec2 b) const
+  {
+    if(!m_culling)
+      return true;
+
+    return std::max(a.x, b.x) >= m_viewMin.x && std::min(a.x, b.x) <= m_viewMax.x &&
+          std::max(a.y, b.y) >= m_viewMin.y && std::min(a.y, b.y) <= m_viewMax.y;
+  }
+
+  void rawPoint(Vec2 P, Color color) { m_bufPoints.write({P.x, P.y, 0, packColor(color)}); }
 
-  void rawLine(PrimitiveBuffer& buf, Vec2 A, Vec2 B, Color color)
+  // conservative: false only if all the points are on the outer side of the same plane
+  template<size_t N>
+  bool isInsideFrustum(const Vec3 (&points)[N]) const
   {
-    buf.write({A.x, A.y, 0, /* uv */ 0, 0, color.r, color.g, color.b, color.a});
-    buf.write({B.x, B.y, 0, /* uv */ 0, 0, color.r, color.g, color.b, color.a});
+    for(auto& plane : m_frustumPlanes)
+    {
+      bool allOutside = true;
+      for(auto& p : points)
+        allOutside = allOutside && plane[0] * p.x + plane[1] * p.y + plane[2] * p.z + plane[3] < 0;
+
+      if(allOutside)
+        return false;
+    }
+
+    return true;
   }
 
-  void rawLine(PrimitiveBuffer& buf, Vec3 A, Vec3 B, Color color)
+  // for sorting: grows with the distance to the camera (constant with the orthographic one)
+  float depthOf(Vec3 p) const
   {
-    buf.write({A.x, A.y, A.z, /* uv */ 0, 0, color.r, color.g, color.b, color.a});
-    buf.write({B.x, B.y, B.z, /* uv */ 0, 0, color.r, color.g, color.b, color.a});
+    const auto& w = m_worldTransform[3];
+    return w[0] * p.x + w[1] * p.y + w[2] * p.z + w[3];
   }
 
-  void rawChar(PrimitiveBuffer& buf, Vec2 POS, char c, Color color, float W, float H)
+  // The 3D primitives are depth-tested against each other: the opaque ones first, then the translucent ones,
+  // from back to front, without writing the depth (they'd hide the ones behind them).
+  // The 2D primitives are drawn before, without depth: as before, the ones submitted last end up on top.
+  void draw3d(const Matrix4f& columnMajorMvp)
   {
-    const int cols = 16;
-    const int rows = 8;
+    // keeps the submission order on ties, e.g with the orthographic camera
+    auto backToFront = [](auto& items)
+    {
+      std::stable_sort(items.begin(), items.end(), [](auto& a, auto& b) { return a.depth > b.depth; });
+    };
+
+    backToFront(m_blendedLines3D);
+    for(auto& line : m_blendedLines3D)
+    {
+      m_bufBlendedLines3D.write({line.a.x, line.a.y, line.a.z, line.color});
+      m_bufBlendedLines3D.write({line.b.x, line.b.y, line.b.z, line.color});
+    }
+    m_blendedLines3D.clear();
+
+    backToFront(m_blendedBoxes);
+    for(auto& box : m_blendedBoxes)
+      m_bufBlendedBoxes.write(box.instance);
+    m_blendedBoxes.clear();
+
+    glEnable(GL_DEPTH_TEST);
+    glDepthFunc(GL_LEQUAL);
+
+    useProgram(shaderProgram, columnMajorMvp);
+    m_bufLines3D.draw();
+    useProgram(boxShaderProgram, columnMajorMvp);
+    m_bufBoxes.draw();
+
+    // the translucent lines and boxes can't be interleaved by depth: each batch is sorted on its own
+    glDepthMask(GL_FALSE);
+    useProgram(shaderProgram, columnMajorMvp);
+    m_bufBlendedLines3D.draw();
+    useProgram(boxShaderProgram, columnMajorMvp);
+    m_bufBlendedBoxes.draw();
+    glDepthMask(GL_TRUE);
+
+    glDisable(GL_DEPTH_TEST);
+  }
 
-    const int col = c % cols;
-    const int row = c / cols;
+  static void useProgram(GLuint program, const Matrix4f& columnMajorMvp)
+  {
+    glUseProgram(program);
+    glUniformMatrix4fv(glGetUniformLocation(program, "mvp"), 1, GL_FALSE, &columnMajorMvp[0][0]);
+  }
 
-    const float u0 = (col + 0.0f) / cols;
-    const float u1 = (col + 1.0f) / cols;
-    const float v0 = (row + 1.0f) / rows;
-    const float v1 = (row + 0.0f) / rows;
+  void rawLine(PrimitiveBuffer<LineVertex>& buf, Vec2 A, Vec2 B, Color color)
+  {
+    const auto c = packColor(color);
+    buf.write({A.x, A.y, 0, c});
+    buf.write({B.x, B.y, 0, c});
+  }
 
-    POS.y -= H;
+  void rawLine(PrimitiveBuffer<LineVertex>& buf, Vec3 A, Vec3 B, Color color)
+  {
+    const auto c = packColor(color);
+    buf.write({A.x, A.y, A.z, c});
+    buf.write({B.x, B.y, B.z, c});
+  }
 
-    buf.write({POS.x + 0, POS.y + 0, 1, /* uv */ u0, v0, color.r, color.g, color.b, color.a});
-    buf.write({POS.x + W, POS.y + H, 1, /* uv */ u1, v1, color.r, color.g, color.b, color.a});
-    buf.write({POS.x + W, POS.y + 0, 1, /* uv */ u1, v0, color.r, color.g, color.b, color.a});
+  void rawText(InstanceBuffer<GlyphInstance>& buf, Vec2 pos, const char* text, Color color, float W, float H)
+  {
+    const auto packed = packColor(color);
 
-    buf.write({POS.x + 0, POS.y + 0, 1, /* uv */ u0, v0, color.r, color.g, color.b, color.a});
-    buf.write({POS.x + 0, POS.y + H, 1, /* uv */ u0, v1, color.r, color.g, color.b, color.a});
-    buf.write({POS.x + W, POS.y + H, 1, /* uv */ u1, v1, color.r, color.g, color.b, color.a});
+    while(*text)
+    {
+      const int glyph = (unsigned char)*text % 128;
+      buf.write({pos.x, pos.y - H, W, H, float(glyph), packed});
+      pos.x += W;
+      ++text;
+    }
   }
 
+  StaticShapes m_shapes; // must be constructed before the buffers
+
   GLuint shaderProgram{};
-  PrimitiveBuffer m_bufLines;
-  PrimitiveBuffer m_bufTris;
-  PrimitiveBuffer m_bufLinesUI;
-  PrimitiveBuffer m_bufTrisUI;
+  GLuint circleShaderProgram{};
+  GLuint glyphShaderProgram{};
+  GLuint boxShaderProgram{};
+  PrimitiveBuffer<LineVertex> m_bufLines;
+  PrimitiveBuffer<LineVertex> m_bufPoints;
+  PrimitiveBuffer<LineVertex> m_bufLines3D;
+  PrimitiveBuffer<LineVertex> m_bufBlendedLines3D;
+  PrimitiveBuffer<LineVertex> m_bufLinesUI;
+  InstanceBuffer<CircleInstance> m_bufCircles[circleLodCount];
+  InstanceBuffer<GlyphInstance> m_bufGlyphs;
+  InstanceBuffer<GlyphInstance> m_bufGlyphsUI;
+  InstanceBuffer<BoxInstance> m_bufBoxes;
+  InstanceBuffer<BoxInstance> m_bufBlendedBoxes;
   GLuint fontTexture{};
   GLuint whiteTexture{};
+
+  // view of the current frame (see 'beginFrame')
+  bool m_culling = false;
+  Vec2 m_viewMin;
+  Vec2 m_viewMax;
+  float m_pixelSize = 0; // in world units
+
+  Matrix4f m_worldTransform; // row-major
+  float m_frustumPlanes[6][4]{}; // (a, b, c, d): inside where ax + by + cz + d >= 0
+
+  // translucent 3D primitives, sorted at flush
+  struct BlendedLine
+  {
+    float depth;
+    Vec3 a, b;
+    uint32_t color;
+  };
+
+  struct BlendedBox
+  {
+    float depth;
+    BoxInstance instance;
+  };
+
+  std::vector<BlendedLine> m_blendedLines3D;
+  std::vector<BlendedBox> m_blendedBoxes;
 };
 
-void takeScreenshot()
+// Asynchronous readback of the rendered frames: glReadPixels targets a ring of pixel buffer objects,
+// and the pixels are only fetched once the GPU signals they're ready, a few frames later.
+// The file encoding is done by a background thread.
+struct FrameCapture
 {
-  static int counter;
+  FrameCapture()
+  {
+    for(auto& slot : m_slots)
+      glGenBuffers(1, &slot.pbo);
+  }
 
-  int width = g_ScreenSize.x;
-  int height = g_ScreenSize.y;
+  ~FrameCapture()
+  {
+    finish();
+
+    for(auto& slot : m_slots)
+      glDeleteBuffers(1, &slot.pbo);
+  }
+
+  // Starts reading back the current frame (before the buffers are swapped)
+  void capture(std::string path)
+  {
+    // all slots in flight: wait for the oldest one
+    while(m_pendingCount == RingSize)
+      retireOldest(true);
+
+    auto& slot = m_slots[(m_oldest + m_pendingCount) % RingSize];
+    slot.width = g_ScreenSize.x;
+    slot.height = g_ScreenSize.y;
+    slot.path = std::move(path);
+
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.pbo);
+    glBufferData(GL_PIXEL_PACK_BUFFER, slot.width * slot.height * 4, nullptr, GL_STREAM_READ);
+    glReadPixels(0, 0, slot.width, slot.height, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    m_pendingCount++;
+  }
 
-  SDL_Surface* sshot = SDL_CreateRGBSurface(0, width, height, 32, 0x000000ff, 0x0000ff00, 0x00ff0000, 0xff000000);
+  // Hands the completed readbacks over to the writer, without blocking
+  void poll()
+  {
+    while(m_pendingCount > 0 && retireOldest(false))
+    {
+    }
+  }
 
-  uint8_t* pixels = (uint8_t*)sshot->pixels;
+  // Waits for all the pending readbacks
+  void finish()
+  {
+    while(m_pendingCount > 0)
+      retireOldest(true);
+  }
 
-  glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+  bool recording = false;
+  int sequenceCounter = 0;
+  int frameCounter = 0;
+  int screenshotCounter = 0;
 
-  // reverse upside down
+  private:
+  bool retireOldest(bool wait)
   {
-    const auto rowSize = width * 4;
-    std::vector<uint8_t> rowBuf(rowSize);
+    auto& slot = m_slots[m_oldest];
+
+    const GLuint64 timeout = wait ? 1000000000 : 0;
+    const GLenum status = glClientWaitSync(slot.fence, GL_SYNC_FLUSH_COMMANDS_BIT, timeout);
+    if(status == GL_TIMEOUT_EXPIRED && !wait)
+      return false;
+
+    glDeleteSync(slot.fence);
+    slot.fence = nullptr;
 
-    for(int row = 0; row < height / 2; ++row)
+    const int size = slot.width * slot.height * 4;
+    std::vector<uint8_t> pixels(size);
+
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.pbo);
+    if(auto mapped = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, size, GL_MAP_READ_BIT))
     {
-      const auto rowLo = row;
-      const auto rowHi = height - 1 - row;
-      auto pRowLo = pixels + rowLo * rowSize;
-      auto pRowHi = pixels + rowHi * rowSize;
-      memcpy(rowBuf.data(), pRowLo, rowSize);
-      memcpy(pRowLo, pRowHi, rowSize);
-      memcpy(pRowHi, rowBuf.data(), rowSize);
+      memcpy(pixels.data(), mapped, size);
+      glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+      m_writer.write(std::move(slot.path), slot.width, slot.height, std::move(pixels));
     }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    m_oldest = (m_oldest + 1) % RingSize;
+    m_pendingCount--;
+    return true;
   }
 
-  // save to BMP file
+  struct Slot
   {
-    char filename[256];
-    snprintf(filename, sizeof filename, "screenshot-%03d.bmp", counter++);
-    SDL_SaveBMP(sshot, filename);
-    fprintf(stderr, "Saved screenshot to: %s\n", filename);
-  }
+    GLuint pbo{};
+    GLsync fence{};
+    int width = 0;
+    int height = 0;
+    std::string path;
+  };
 
-  SDL_FreeSurface(sshot);
-}
+  static constexpr int RingSize = 3;
 
-void drawScreen(OpenGlDrawer& drawer, IApp* app, const char* appName)
+  Slot m_slots[RingSize];
+  int m_oldest = 0;
+  int m_pendingCount = 0;
+  FrameWriter m_writer;
+};
+
+void drawScreen(OpenGlDrawer& drawer, FrameCapture& capture, IApp* app, const char* appName)
 {
   glClearColor(0, 0, 0, 0);
-  glClear(GL_COLOR_BUFFER_BIT);
+  glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
+  drawer.beginFrame();
   app->draw(&drawer);
 
   drawer.uiRect({5, 5}, {g_ScreenSize.x - 10, g_ScreenSize.y - 10}, White);
   drawer.uiRect({32, g_ScreenSize.y - 32 + 8}, {800, -32 - 16}, White);
   drawer.uiText({32, g_ScreenSize.y - 32}, appName, White);
+
   drawer.flush();
 
+  char filename[256];
+
+  if(capture.recording)
+  {
+    snprintf(filename, sizeof filename, "capture-%03d-%05d.bmp", capture.sequenceCounter, capture.frameCounter++);
+    capture.capture(filename);
+  }
+
   if(gMustScreenShot)
   {
-    takeScreenshot();
+    snprintf(filename, sizeof filename, "screenshot-%03d.bmp", capture.screenshotCounter++);
+    capture.capture(filename);
     gMustScreenShot = false;
   }
+
+  capture.poll();
 }
 
 Key fromSdlKey(int key)
@@ -591,6 +1222,9 @@ void processOneInputEvent(IApp* app, SDL_Event event)
     case SDLK_F2:
       gMustReset = true;
       return;
+    case SDLK_F11:
+      gMustToggleRecording = true;
+      return;
     case SDLK_F12:
       gMustScreenShot = true;
       return;
@@ -615,6 +1249,8 @@ void processOneInputEvent(IApp* app, SDL_Event event)
       g_ScreenSize = {(float)event.window.data1, (float)event.window.data2};
       glViewport(0, 0, g_ScreenSize.x, g_ScreenSize.y);
     }
+
+    gMustRedraw = true;
   }
   else if(event.type == SDL_MOUSEWHEEL)
   {
@@ -634,25 +1270,19 @@ void processOneInputEvent(IApp* app, SDL_Event event)
   }
 }
 
-void readInput(IApp* app)
+// When 'wait' is set, sleeps until at least one event arrives
+void readInput(IApp* app, bool wait)
 {
   SDL_Event event;
 
-  while(SDL_PollEvent(&event))
+  if(wait && SDL_WaitEvent(&event))
     processOneInputEvent(app, event);
-}
 
-std::map<std::string, CreationFunc*>& Registry()
-{
-  static std::map<std::string, CreationFunc*> registry;
-  return registry;
+  while(SDL_PollEvent(&event))
+    processOneInputEvent(app, event);
 }
 
-int registerApp(const char* name, CreationFunc* func)
-{
-  Registry()[name] = func;
-  return 0;
-}
+std::map<std::string, CreationFunc*>& Registry();
 
 struct SdlMainFrame
 {
@@ -664,10 +1294,12 @@ struct SdlMainFrame
     g_ScreenSize = {1280, 720};
 
     SDL_GL_SetAttribute(SDL_GL_DOUBLEBUFFER, 1);
+    SDL_GL_SetAttribute(SDL_GL_DEPTH_SIZE, 24);
 
     SDL_GL_SetAttribute(SDL_GL_CONTEXT_PROFILE_MASK, SDL_GL_CONTEXT_PROFILE_CORE);
-    SDL_GL_SetAttribute(SDL_GL_CONTEXT_MAJOR_VERSION, 2);
-    SDL_GL_SetAttribute(SDL_GL_CONTEXT_MINOR_VERSION, 0);
+    // 3.3: instanced arrays
+    SDL_GL_SetAttribute(SDL_GL_CONTEXT_MAJOR_VERSION, 3);
+    SDL_GL_SetAttribute(SDL_GL_CONTEXT_MINOR_VERSION, 3);
 
     window = SDL_CreateWindow("Minimal", SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED, g_ScreenSize.x, g_ScreenSize.y,
           SDL_WINDOW_OPENGL | SDL_WINDOW_RESIZABLE);
@@ -719,14 +1351,36 @@ void updateCamera()
 {
   g_Camera.pos = lerp(g_TargetCamera.pos, g_Camera.pos, CAMERA_UPDATE_RATIO);
   g_Camera.scale = lerp(g_TargetCamera.scale, g_Camera.scale, CAMERA_UPDATE_RATIO);
+
+  // the interpolation never exactly reaches the target: snap to it when the difference is invisible
+  const float closeEnough = 0.0001f;
+  if(magnitude(g_TargetCamera.pos - g_Camera.pos) * g_Camera.scale < closeEnough &&
+        fabs(g_TargetCamera.scale - g_Camera.scale) < closeEnough * g_Camera.scale)
+  {
+    g_Camera.pos = g_TargetCamera.pos;
+    g_Camera.scale = g_TargetCamera.scale;
+  }
+}
+
+bool operator==(const Camera& a, const Camera& b)
+{
+  return a.pos == b.pos && a.scale == b.scale && a.perspective == b.perspective;
 }
 
 void safeMain(span<const char*> args)
 {
   std::string appName = "MainMenu";
+  int batchSize = OpenGlDrawer::DefaultBatchSize;
 
-  if(args.len >= 2)
-    appName = args[1];
+  for(size_t i = 1; i < args.len; ++i)
+  {
+    if(strncmp(args[i], "--batch-size=", 13) == 0)
+      batchSize = atoi(args[i] + 13);
+    else if(strcmp(args[i], "--background") == 0)
+      gRunAlgorithmsInBackground = true;
+    else
+      appName = args[i];
+  }
 
   const auto& registry = Registry();
 
@@ -745,27 +1399,70 @@ void safeMain(span<const char*> args)
 
   SdlMainFrame mainFrame(("GeomSandbox: " + appName).c_str());
 
-  OpenGlDrawer drawer;
+  OpenGlDrawer drawer(batchSize);
+  FrameCapture capture;
 
   CreationFunc* const func = i_func->second;
   auto app = std::unique_ptr<IApp>(func());
 
+  // Idle mode: when neither the camera nor the app contents changed since the last frame,
+  // don't redraw, and sleep until the next input event.
+  bool idle = false;
+  int drawnVersion = -1;
+  Camera drawnCamera;
+
   while(!gMustQuit)
   {
-    readInput(app.get());
+    readInput(app.get(), idle);
 
     if(gMustReset)
     {
       app.reset(func());
       gMustReset = false;
+      gMustRedraw = true;
+    }
+
+    if(gMustToggleRecording)
+    {
+      capture.recording = !capture.recording;
+      if(capture.recording)
+      {
+        capture.frameCounter = 0;
+        fprintf(stderr, "Recording frames to capture-%03d-*.bmp\n", capture.sequenceCounter);
+      }
+      else
+      {
+        fprintf(stderr, "Recording stopped (%d frames)\n", capture.frameCounter);
+        capture.sequenceCounter++;
+      }
+      gMustToggleRecording = false;
+      gMustRedraw = true;
     }
 
     updateCamera();
 
     app->tick();
-    drawScreen(drawer, app.get(), appName.c_str());
+
+    const int version = app->contentVersion();
+    const bool cameraMoving = !(g_Camera.pos == g_TargetCamera.pos) || g_Camera.scale != g_TargetCamera.scale;
+
+    idle = version >= 0 && version == drawnVersion && g_Camera == drawnCamera && !cameraMoving && !gMustRedraw &&
+          !gMustScreenShot;
+
+    if(idle)
+    {
+      // about to sleep: don't leave captured frames waiting on the GPU
+      capture.finish();
+      continue;
+    }
+
+    drawScreen(drawer, capture, app.get(), appName.c_str());
 
     mainFrame.flush();
+
+    drawnVersion = version;
+    drawnCamera = g_Camera;
+    gMustRedraw = false;
   }
 }
 
@@ -0,0 +1,402 @@
+// Copyright (C) 2022 - Sebastien Alaiwan
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+
+///////////////////////////////////////////////////////////////////////////////
+// Headless entry point: profiles algorithm apps without a window.
+//
+// Usage: GeomSandboxHeadless.exe [--csv|--json] [--instances=N] [--threads=N] [--zones] [--trace=file.json]
+//                                [--sweep [--max-size=N]] [--corpus=file | --dataset=file...]
+//                                [--save-corpus=file] [appName...]
+// When no app name is given, every registered algorithm app is profiled.
+// '--threads=0' uses one worker per hardware thread.
+// '--zones' prints, on stderr, where the time went, according to SANDBOX_ZONE (see zones.h).
+// '--trace=file.json' writes a Chrome trace (chrome://tracing, ui.perfetto.dev) of a single execution.
+// '--sweep' profiles each app at input sizes growing from 10 to '--max-size' (default: 10^6),
+// and reports the empirical complexity exponent. Apps without 'generateInput(int size)' are skipped.
+// '--corpus=file' takes the inputs from a corpus (see corpus.h) instead of generating them: the instance k
+// uses the record k % recordCount. '--dataset=file' (repeatable) does the same with dataset files,
+// loaded by the app (see datasets.h). Apps whose inputs can't come from there are skipped.
+// '--save-corpus=file' writes the inputs of a single app to a corpus, instead of profiling it:
+// the ones loaded from '--dataset', or '--instances' generated ones (seeded like the profiled ones).
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "../random.h"
+#include "algorithm_app.h"
+#include "app.h"
+#include "corpus.h"
+#include "geom.h"
+#include "profiling.h"
+#include "zones.h"
+
+std::map<std::string, CreationFunc*>& Registry();
+
+namespace
+{
+enum class Format
+{
+  Csv,
+  Json,
+};
+
+struct Options
+{
+  Format format = Format::Csv;
+  int instances = 8000;
+  int threads = 1;
+  bool zones = false;
+  std::string tracePath;
+  bool sweep = false;
+  int maxSize = 1000000;
+  std::string corpusPath;
+  std::vector<std::string> datasetPaths;
+  std::string saveCorpusPath;
+  std::vector<std::string> appNames;
+};
+
+const int SweepMinSize = 10;
+const double SweepMaxSecondsPerSize = 2.0;
+
+Options parseCommandLine(span<const char*> args)
+{
+  Options options;
+
+  for(size_t i = 1; i < args.len; ++i)
+  {
+    const char* arg = args[i];
+
+    if(strcmp(arg, "--csv") == 0)
+      options.format = Format::Csv;
+    else if(strcmp(arg, "--json") == 0)
+      options.format = Format::Json;
+    else if(strncmp(arg, "--instances=", 12) == 0)
+      options.instances = atoi(arg + 12);
+    else if(strncmp(arg, "--threads=", 10) == 0)
+      options.threads = atoi(arg + 10);
+    else if(strcmp(arg, "--zones") == 0)
+      options.zones = true;
+    else if(strncmp(arg, "--trace=", 8) == 0)
+      options.tracePath = arg + 8;
+    else if(strcmp(arg, "--sweep") == 0)
+      options.sweep = true;
+    else if(strncmp(arg, "--max-size=", 11) == 0)
+      options.maxSize = atoi(arg + 11);
+    else if(strncmp(arg, "--corpus=", 9) == 0)
+      options.corpusPath = arg + 9;
+    else if(strncmp(arg, "--dataset=", 10) == 0)
+      options.datasetPaths.push_back(arg + 10);
+    else if(strncmp(arg, "--save-corpus=", 14) == 0)
+      options.saveCorpusPath = arg + 14;
+    else if(arg[0] == '-')
+      throw std::runtime_error("Unknown option: '" + std::string(arg) + "'");
+    else
+      options.appNames.push_back(arg);
+  }
+
+  if(options.instances <= 0)
+    throw std::runtime_error("Instance count must be positive");
+
+  if(options.maxSize < SweepMinSize)
+    throw std::runtime_error("Max size must be at least " + std::to_string(SweepMinSize));
+
+  if(!options.tracePath.empty() && options.appNames.size() != 1)
+    throw std::runtime_error("--trace requires exactly one app name");
+
+  if(!options.corpusPath.empty() && !options.datasetPaths.empty())
+    throw std::runtime_error("--corpus and --dataset can't be used together");
+
+  if(options.sweep && (!options.corpusPath.empty() || !options.datasetPaths.empty()))
+    throw std::runtime_error("--sweep generates its inputs: it can't use --corpus or --dataset");
+
+  if(!options.saveCorpusPath.empty() && (options.appNames.size() != 1 || !options.corpusPath.empty()))
+    throw std::runtime_error("--save-corpus requires exactly one app name, and no --corpus");
+
+  return options;
+}
+
+struct Report
+{
+  std::string appName;
+  ProfilingResult result;
+};
+
+void printCsv(const std::vector<Report>& reports)
+{
+  printf("app,instances,threads,mean_us,median_us,p99_us,generation_us,total_ms,instances_per_sec,"
+         "allocations,allocated_bytes,peak_live_bytes\n");
+  for(auto& r : reports)
+  {
+    printf("%s,%d,%d,%.3f,%.3f,%.3f,%.3f,%.3f,%.1f,%.1f,%.1f,%.0f\n", r.appName.c_str(), r.result.instances,
+          r.result.threads, r.result.meanUs, r.result.medianUs, r.result.p99Us, r.result.generationUs,
+          r.result.totalMs, r.result.instancesPerSecond, r.result.allocationCount, r.result.allocatedBytes,
+          r.result.peakLiveBytes);
+  }
+}
+
+void printJson(const std::vector<Report>& reports)
+{
+  printf("[\n");
+  for(size_t i = 0; i < reports.size(); ++i)
+  {
+    auto& r = reports[i];
+    printf("  {\"app\": \"%s\", \"instances\": %d, \"threads\": %d, \"mean_us\": %.3f, \"median_us\": %.3f, "
+           "\"p99_us\": %.3f, \"generation_us\": %.3f, \"total_ms\": %.3f, \"instances_per_sec\": %.1f, "
+           "\"allocations\": %.1f, \"allocated_bytes\": %.1f, \"peak_live_bytes\": %.0f}%s\n",
+          r.appName.c_str(), r.result.instances, r.result.threads, r.result.meanUs, r.result.medianUs,
+          r.result.p99Us, r.result.generationUs, r.result.totalMs, r.result.instancesPerSecond,
+          r.result.allocationCount, r.result.allocatedBytes, r.result.peakLiveBytes, i + 1 < reports.size() ? "," : "");
+  }
+  printf("]\n");
+}
+
+struct SweepReport
+{
+  std::string appName;
+  SweepResult result;
+};
+
+void printSweepCsv(const std::vector<SweepReport>& reports)
+{
+  printf("app,size,instances,mean_us,median_us,local_exponent,peak_rss_mib,fit_exponent\n");
+  for(auto& r : reports)
+  {
+    for(auto& p : r.result.points)
+    {
+      printf("%s,%d,%d,%.3f,%.3f,%.3f,%.1f,%.3f\n", r.appName.c_str(), p.size, p.instances, p.meanUs, p.medianUs,
+            p.localExponent, p.peakRssMiB, r.result.exponent);
+    }
+  }
+}
+
+void printSweepJson(const std::vector<SweepReport>& reports)
+{
+  printf("[\n");
+  for(size_t i = 0; i < reports.size(); ++i)
+  {
+    auto& r = reports[i];
+    printf("  {\"app\": \"%s\", \"fit_exponent\": %.3f, \"truncated\": %s, \"points\": [\n", r.appName.c_str(),
+          r.result.exponent, r.result.truncated ? "true" : "false");
+    for(size_t k = 0; k < r.result.points.size(); ++k)
+    {
+      auto& p = r.result.points[k];
+      printf("    {\"size\": %d, \"instances\": %d, \"mean_us\": %.3f, \"median_us\": %.3f, "
+             "\"local_exponent\": %.3f, \"peak_rss_mib\": %.1f}%s\n",
+            p.size, p.instances, p.meanUs, p.medianUs, p.localExponent, p.peakRssMiB,
+            k + 1 < r.result.points.size() ? "," : "");
+    }
+    printf("  ]}%s\n", i + 1 < reports.size() ? "," : "");
+  }
+  printf("]\n");
+}
+
+void writeTrace(AbstractAlgorithm* algo, const std::string& path)
+{
+  ZoneRecorder trace;
+  traceAlgorithm(algo, 0, trace);
+
+  FILE* fp = fopen(path.c_str(), "w");
+  if(!fp)
+    throw std::runtime_error("Can't open '" + path + "' for writing");
+
+  trace.writeChromeTrace(fp);
+  fclose(fp);
+
+  fprintf(stderr, "Trace written to '%s'\n", path.c_str());
+}
+
+// The inputs of 'algo' loaded from '--dataset', as an in-memory corpus
+std::unique_ptr<Corpus> loadDatasets(AbstractAlgorithm* algo, const Options& options)
+{
+  CorpusWriter writer;
+  for(auto& path : options.datasetPaths)
+  {
+    if(!algo->loadDataset(path))
+      return nullptr;
+
+    if(!algo->saveInput(writer))
+      throw std::runtime_error("The app's input can't be stored in a corpus");
+  }
+
+  return std::make_unique<Corpus>(writer.finish());
+}
+
+// A corpus may hold the inputs of another app: the first record must fit
+bool acceptsCorpus(AbstractAlgorithm* algo, const Corpus* corpus, std::string& reason)
+{
+  try
+  {
+    if(corpus && algo->loadInput((*corpus)[0]))
+      return true;
+
+    reason = "its inputs can't come from a corpus or dataset";
+  }
+  catch(const std::exception& e)
+  {
+    reason = e.what();
+  }
+
+  return false;
+}
+
+void saveCorpus(AbstractAlgorithm* algo, const Options& options)
+{
+  CorpusWriter writer;
+
+  if(!options.datasetPaths.empty())
+  {
+    auto datasets = loadDatasets(algo, options);
+    if(!datasets)
+      throw std::runtime_error("The app has no dataset loader");
+
+    for(int i = 0; i < datasets->size(); ++i)
+    {
+      algo->loadInput((*datasets)[i]);
+      algo->saveInput(writer);
+    }
+  }
+  else
+  {
+    for(int k = 0; k < options.instances; ++k)
+    {
+      randomSeed(k);
+      algo->init();
+      if(!algo->saveInput(writer))
+        throw std::runtime_error("The app's input can't be stored in a corpus");
+    }
+  }
+
+  writer.save(options.saveCorpusPath);
+
+  fprintf(stderr, "Corpus of %d inputs written to '%s'\n", writer.recordCount(), options.saveCorpusPath.c_str());
+}
+
+void safeMain(span<const char*> args)
+{
+  const Options options = parseCommandLine(args);
+  const auto& registry = Registry();
+
+  std::vector<std::string> appNames = options.appNames;
+
+  if(appNames.empty())
+  {
+    for(auto& pair : registry)
+      appNames.push_back(pair.first);
+  }
+
+  std::vector<Report> reports;
+  std::vector<SweepReport> sweepReports;
+
+  for(auto& appName : appNames)
+  {
+    auto i_func = registry.find(appName);
+
+    if(i_func == registry.end())
+      throw std::runtime_error("Unknown app: '" + appName + "'");
+
+    auto app = std::unique_ptr<IApp>(i_func->second());
+    AbstractAlgorithm* algo = getAlgorithm(app.get());
+
+    if(!algo)
+    {
+      // interactive apps have nothing to profile
+      if(!options.appNames.empty())
+        fprintf(stderr, "Skipping '%s': not an algorithm app\n", appName.c_str());
+      continue;
+    }
+
+    if(!options.saveCorpusPath.empty())
+    {
+      saveCorpus(algo, options);
+      return;
+    }
+
+    std::unique_ptr<Corpus> corpus;
+    if(!options.corpusPath.empty())
+      corpus = std::make_unique<Corpus>(options.corpusPath);
+    else if(!options.datasetPaths.empty())
+      corpus = loadDatasets(algo, options);
+
+    if(corpus && corpus->size() == 0)
+      throw std::runtime_error("The corpus is empty");
+
+    if(!options.corpusPath.empty() || !options.datasetPaths.empty())
+    {
+      std::string reason;
+      if(!acceptsCorpus(algo, corpus.get(), reason))
+      {
+        fprintf(stderr, "Skipping '%s': %s\n", appName.c_str(), reason.c_str());
+        continue;
+      }
+    }
+
+    if(!options.tracePath.empty())
+      writeTrace(algo, options.tracePath);
+
+    if(options.sweep)
+    {
+      fprintf(stderr, "Sweeping %s ...\n", appName.c_str());
+      auto result = profileAlgorithmSweep(algo, SweepMinSize, options.maxSize, SweepMaxSecondsPerSize);
+
+      if(result.points.empty())
+        fprintf(stderr, "Skipping '%s': no sized input generator\n", appName.c_str());
+      else
+        sweepReports.push_back({appName, result});
+
+      continue;
+    }
+
+    fprintf(stderr, "Profiling %s ...\n", appName.c_str());
+
+    ZoneRecorder zones;
+    ZoneRecorder* pZones = options.zones ? &zones : nullptr;
+
+    if(options.threads == 1)
+      reports.push_back({appName, profileAlgorithm(algo, options.instances, false, pZones, corpus.get())});
+    else
+      reports.push_back(
+            {appName, profileAlgorithmParallel(algo, options.instances, options.threads, pZones, corpus.get())});
+
+    if(pZones)
+      zones.printBreakdown(stderr, options.instances);
+  }
+
+  if(options.sweep)
+  {
+    if(options.format == Format::Json)
+      printSweepJson(sweepReports);
+    else
+      printSweepCsv(sweepReports);
+  }
+  else if(options.format == Format::Json)
+    printJson(reports);
+  else
+    printCsv(reports);
+
+  fflush(stdout);
+}
+}
+
+int main(int argc, const char* argv[])
+{
+  try
+  {
+    safeMain({(size_t)argc, argv});
+    return 0;
+  }
+  catch(const std::exception& e)
+  {
+    fprintf(stderr, "Fatal: %s\n", e.what());
+    fflush(stderr);
+    return 1;
+  }
+}
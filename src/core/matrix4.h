@@ -10,6 +10,7 @@
 #include <cmath>
 
 #include "geom.h"
+#include "simd.h"
 
 struct Matrix4f
 {
@@ -31,18 +32,22 @@ struct Matrix4f
 
 inline Matrix4f operator*(Matrix4f const& A, Matrix4f const& B)
 {
-  Matrix4f r{};
-
-  for(int row = 0; row < 4; ++row)
-    for(int col = 0; col < 4; ++col)
-    {
-      double sum = 0;
+  const Float4 b0 = load4(B[0].elements);
+  const Float4 b1 = load4(B[1].elements);
+  const Float4 b2 = load4(B[2].elements);
+  const Float4 b3 = load4(B[3].elements);
 
-      for(int k = 0; k < 4; ++k)
-        sum += A[row][k] * B[k][col];
+  Matrix4f r;
 
-      r[row][col] = sum;
-    }
+  // each row of the result is a linear combination of the rows of B
+  for(int row = 0; row < 4; ++row)
+  {
+    Float4 sum = splat4(A[row][0]) * b0;
+    sum = multiplyAdd(splat4(A[row][1]), b1, sum);
+    sum = multiplyAdd(splat4(A[row][2]), b2, sum);
+    sum = multiplyAdd(splat4(A[row][3]), b3, sum);
+    store4(r[row].elements, sum);
+  }
 
   return r;
 }
@@ -73,17 +78,145 @@ inline Matrix4f scale(Vec3 v)
   return r;
 }
 
-inline Matrix4f transpose(const Matrix4f& m)
+inline Matrix4f rotateX(float angle)
 {
+  const float c = cos(angle);
+  const float s = sin(angle);
+
   Matrix4f r{};
+  r[0][0] = 1;
+  r[1][1] = c;
+  r[1][2] = -s;
+  r[2][1] = s;
+  r[2][2] = c;
+  r[3][3] = 1;
+  return r;
+}
 
-  for(int row = 0; row < 4; ++row)
-    for(int col = 0; col < 4; ++col)
-      r[row][col] = m[col][row];
+inline Matrix4f rotateY(float angle)
+{
+  const float c = cos(angle);
+  const float s = sin(angle);
 
+  Matrix4f r{};
+  r[0][0] = c;
+  r[0][2] = s;
+  r[1][1] = 1;
+  r[2][0] = -s;
+  r[2][2] = c;
+  r[3][3] = 1;
   return r;
 }
 
+inline Matrix4f rotateZ(float angle)
+{
+  const float c = cos(angle);
+  const float s = sin(angle);
+
+  Matrix4f r{};
+  r[0][0] = c;
+  r[0][1] = -s;
+  r[1][0] = s;
+  r[1][1] = c;
+  r[2][2] = 1;
+  r[3][3] = 1;
+  return r;
+}
+
+inline Matrix4f transpose(const Matrix4f& m)
+{
+  Float4 r0 = load4(m[0].elements);
+  Float4 r1 = load4(m[1].elements);
+  Float4 r2 = load4(m[2].elements);
+  Float4 r3 = load4(m[3].elements);
+
+  transpose4(r0, r1, r2, r3);
+
+  Matrix4f r;
+  store4(r[0].elements, r0);
+  store4(r[1].elements, r1);
+  store4(r[2].elements, r2);
+  store4(r[3].elements, r3);
+  return r;
+}
+
+// 'm' must be invertible
+inline Matrix4f inverse(const Matrix4f& m)
+{
+  // cofactor expansion, using the 2x2 sub-determinants of the two upper rows (s)
+  // and of the two lower rows (c)
+  const float s0 = m[0][0] * m[1][1] - m[1][0] * m[0][1];
+  const float s1 = m[0][0] * m[1][2] - m[1][0] * m[0][2];
+  const float s2 = m[0][0] * m[1][3] - m[1][0] * m[0][3];
+  const float s3 = m[0][1] * m[1][2] - m[1][1] * m[0][2];
+  const float s4 = m[0][1] * m[1][3] - m[1][1] * m[0][3];
+  const float s5 = m[0][2] * m[1][3] - m[1][2] * m[0][3];
+
+  const float c5 = m[2][2] * m[3][3] - m[3][2] * m[2][3];
+  const float c4 = m[2][1] * m[3][3] - m[3][1] * m[2][3];
+  const float c3 = m[2][1] * m[3][2] - m[3][1] * m[2][2];
+  const float c2 = m[2][0] * m[3][3] - m[3][0] * m[2][3];
+  const float c1 = m[2][0] * m[3][2] - m[3][0] * m[2][2];
+  const float c0 = m[2][0] * m[3][1] - m[3][0] * m[2][1];
+
+  const float det = s0 * c5 - s1 * c4 + s2 * c3 + s3 * c2 - s4 * c1 + s5 * c0;
+  assert(det != 0);
+
+  const float k = 1.0f / det;
+
+  Matrix4f r;
+  r[0][0] = (m[1][1] * c5 - m[1][2] * c4 + m[1][3] * c3) * k;
+  r[0][1] = (-m[0][1] * c5 + m[0][2] * c4 - m[0][3] * c3) * k;
+  r[0][2] = (m[3][1] * s5 - m[3][2] * s4 + m[3][3] * s3) * k;
+  r[0][3] = (-m[2][1] * s5 + m[2][2] * s4 - m[2][3] * s3) * k;
+
+  r[1][0] = (-m[1][0] * c5 + m[1][2] * c2 - m[1][3] * c1) * k;
+  r[1][1] = (m[0][0] * c5 - m[0][2] * c2 + m[0][3] * c1) * k;
+  r[1][2] = (-m[3][0] * s5 + m[3][2] * s2 - m[3][3] * s1) * k;
+  r[1][3] = (m[2][0] * s5 - m[2][2] * s2 + m[2][3] * s1) * k;
+
+  r[2][0] = (m[1][0] * c4 - m[1][1] * c2 + m[1][3] * c0) * k;
+  r[2][1] = (-m[0][0] * c4 + m[0][1] * c2 - m[0][3] * c0) * k;
+  r[2][2] = (m[3][0] * s4 - m[3][1] * s2 + m[3][3] * s0) * k;
+  r[2][3] = (-m[2][0] * s4 + m[2][1] * s2 - m[2][3] * s0) * k;
+
+  r[3][0] = (-m[1][0] * c3 + m[1][1] * c1 - m[1][2] * c0) * k;
+  r[3][1] = (m[0][0] * c3 - m[0][1] * c1 + m[0][2] * c0) * k;
+  r[3][2] = (-m[3][0] * s3 + m[3][1] * s1 - m[3][2] * s0) * k;
+  r[3][3] = (m[2][0] * s3 - m[2][1] * s1 + m[2][2] * s0) * k;
+
+  return r;
+}
+
+// out[i] = m * in[i] (w = 1), followed by the perspective division.
+// 'in' and 'out' may be the same array.
+inline void transformPoints(const Matrix4f& m, span<const Vec3> in, span<Vec3> out)
+{
+  assert(out.len >= in.len);
+
+  // columns of 'm'
+  Float4 c0 = load4(m[0].elements);
+  Float4 c1 = load4(m[1].elements);
+  Float4 c2 = load4(m[2].elements);
+  Float4 c3 = load4(m[3].elements);
+  transpose4(c0, c1, c2, c3);
+
+  for(size_t i = 0; i < in.len; ++i)
+  {
+    const Vec3 p = in[i];
+
+    Float4 r = multiplyAdd(splat4(p.x), c0, c3);
+    r = multiplyAdd(splat4(p.y), c1, r);
+    r = multiplyAdd(splat4(p.z), c2, r);
+
+    float v[4];
+    store4(v, r);
+
+    const float k = 1.0f / v[3];
+    out[i] = {v[0] * k, v[1] * k, v[2] * k};
+  }
+}
+
 inline Matrix4f perspective(float fovy, float aspect, float zNear, float zFar)
 {
   assert(aspect != 0.0);
@@ -0,0 +1,338 @@
+#include "profiling.h"
+
+#include "../random.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#ifndef _WIN32
+#include <sys/resource.h>
+#endif
+
+#include "algorithm_app.h"
+#include "allocations.h"
+#include "corpus.h"
+#include "zones.h"
+
+namespace
+{
+double getSteadyClockUs()
+{
+  using namespace std::chrono;
+  auto elapsedTime = steady_clock::now().time_since_epoch();
+  return duration_cast<nanoseconds>(elapsedTime).count() / 1000.0;
+}
+
+// nearest-rank percentile, 'sorted' must be non-empty
+double percentile(const std::vector<double>& sorted, double ratio)
+{
+  int rank = int(ratio * sorted.size() + 0.999999);
+  rank = std::max(1, std::min(rank, int(sorted.size())));
+  return sorted[rank - 1];
+}
+
+double getPeakRssMiB()
+{
+#ifdef _WIN32
+  return -1;
+#else
+  rusage usage{};
+  if(getrusage(RUSAGE_SELF, &usage) != 0)
+    return -1;
+  return usage.ru_maxrss / 1024.0; // KiB on Linux
+#endif
+}
+
+// slope of the least-squares line through (x[i], y[i])
+double fitSlope(const std::vector<double>& x, const std::vector<double>& y)
+{
+  const int n = int(x.size());
+  if(n < 2)
+    return 0;
+
+  double meanX = 0;
+  double meanY = 0;
+  for(int i = 0; i < n; ++i)
+  {
+    meanX += x[i] / n;
+    meanY += y[i] / n;
+  }
+
+  double covariance = 0;
+  double variance = 0;
+  for(int i = 0; i < n; ++i)
+  {
+    covariance += (x[i] - meanX) * (y[i] - meanY);
+    variance += (x[i] - meanX) * (x[i] - meanX);
+  }
+
+  return variance > 0 ? covariance / variance : 0;
+}
+
+ProfilingResult summarize(std::vector<double>& processingUs, double generationTotalUs, double totalUs)
+{
+  ProfilingResult r{};
+
+  const int instances = int(processingUs.size());
+
+  double processingTotalUs = 0;
+  for(auto us : processingUs)
+    processingTotalUs += us;
+
+  std::sort(processingUs.begin(), processingUs.end());
+
+  r.instances = instances;
+  r.meanUs = processingTotalUs / instances;
+  r.medianUs = percentile(processingUs, 0.5);
+  r.p99Us = percentile(processingUs, 0.99);
+  r.generationUs = generationTotalUs / instances;
+  r.totalMs = totalUs / 1000.0;
+  r.instancesPerSecond = totalUs > 0 ? instances * 1000000.0 / totalUs : 0;
+
+  return r;
+}
+
+// The executions may draw random numbers too: they're seeded the same way with a corpus
+void prepareInput(AbstractAlgorithm* algo, int k, const Corpus* corpus)
+{
+  randomSeed(k);
+  if(corpus)
+    algo->loadInput((*corpus)[k % corpus->size()]);
+  else
+    algo->init();
+}
+
+void addAllocations(ProfilingResult& r, const std::vector<AllocationStats>& allocations)
+{
+  for(auto& a : allocations)
+  {
+    r.allocationCount += double(a.count) / allocations.size();
+    r.allocatedBytes += double(a.bytes) / allocations.size();
+    r.peakLiveBytes += double(a.peakLiveBytes) / allocations.size();
+  }
+}
+}
+
+ProfilingResult profileAlgorithm(
+      AbstractAlgorithm* algo, int instances, bool showProgress, ZoneRecorder* zones, const Corpus* corpus)
+{
+  if(instances <= 0)
+    return {};
+
+  std::vector<double> processingUs;
+  processingUs.reserve(instances);
+
+  std::vector<AllocationStats> allocations(instances);
+
+  double generationTotalUs = 0;
+
+  const auto t0 = getSteadyClockUs();
+  for(int k = 0; k < instances; ++k)
+  {
+    if(showProgress)
+      fprintf(stderr, "\r%d/%d", k + 1, instances);
+
+    const auto us0 = getSteadyClockUs();
+    prepareInput(algo, k, corpus);
+
+    const auto us1 = getSteadyClockUs();
+    gZoneRecorder = zones;
+    gAllocationStats = &allocations[k];
+    algo->execute();
+    gAllocationStats = nullptr;
+    gZoneRecorder = nullptr;
+    const auto us2 = getSteadyClockUs();
+
+    generationTotalUs += us1 - us0;
+    processingUs.push_back(us2 - us1);
+  }
+  const auto t1 = getSteadyClockUs();
+
+  if(showProgress)
+  {
+    fprintf(stderr, " - OK\n");
+    fflush(stderr);
+  }
+
+  auto r = summarize(processingUs, generationTotalUs, t1 - t0);
+  addAllocations(r, allocations);
+  return r;
+}
+
+ProfilingResult profileAlgorithmParallel(
+      const AbstractAlgorithm* algo, int instances, int threads, ZoneRecorder* zones, const Corpus* corpus)
+{
+  if(instances <= 0)
+    return {};
+
+  if(threads <= 0)
+    threads = std::max(1, int(std::thread::hardware_concurrency()));
+
+  threads = std::min(threads, instances);
+
+  std::atomic<int> nextInstance{0};
+  std::vector<double> processingUs(instances);
+  std::vector<double> generationUs(instances);
+  std::vector<AllocationStats> allocations(instances);
+
+  auto worker = [&](AbstractAlgorithm* myAlgo, ZoneRecorder* myZones)
+  {
+    while(true)
+    {
+      const int k = nextInstance++;
+      if(k >= instances)
+        break;
+
+      const auto us0 = getSteadyClockUs();
+      prepareInput(myAlgo, k, corpus);
+
+      const auto us1 = getSteadyClockUs();
+      gZoneRecorder = myZones;
+      gAllocationStats = &allocations[k];
+      myAlgo->execute();
+      gAllocationStats = nullptr;
+      gZoneRecorder = nullptr;
+      const auto us2 = getSteadyClockUs();
+
+      generationUs[k] = us1 - us0;
+      processingUs[k] = us2 - us1;
+    }
+  };
+
+  std::vector<std::unique_ptr<AbstractAlgorithm>> algos;
+  for(int i = 0; i < threads; ++i)
+    algos.push_back(algo->createNew());
+
+  // one recorder per worker, merged at the end: no contention while running
+  std::vector<ZoneRecorder> workerZones(zones ? threads : 0);
+
+  const auto t0 = getSteadyClockUs();
+  {
+    std::vector<std::thread> workers;
+    for(int i = 0; i < threads; ++i)
+      workers.emplace_back(worker, algos[i].get(), zones ? &workerZones[i] : nullptr);
+
+    for(auto& w : workers)
+      w.join();
+  }
+  const auto t1 = getSteadyClockUs();
+
+  for(auto& z : workerZones)
+    zones->merge(z);
+
+  double generationTotalUs = 0;
+  for(auto us : generationUs)
+    generationTotalUs += us;
+
+  auto r = summarize(processingUs, generationTotalUs, t1 - t0);
+  addAllocations(r, allocations);
+  r.threads = threads;
+  return r;
+}
+
+SweepResult profileAlgorithmSweep(AbstractAlgorithm* algo, int minSize, int maxSize, double maxSecondsPerSize)
+{
+  // each size is repeated until it has been measured for long enough
+  const double MinMeasureUs = 100000;
+  const int MinInstances = 3;
+  const int MaxInstances = 1000;
+
+  // below this, the timer resolution and the call overhead dominate
+  const double MinFittedUs = 1;
+
+  SweepResult r;
+
+  std::vector<double> logSizes;
+  std::vector<double> logTimes;
+
+  int prevSize = 0;
+  for(int step = 0;; ++step)
+  {
+    const int size = int(std::round(minSize * std::pow(10.0, step / 3.0)));
+    if(size > maxSize)
+      break;
+
+    if(size == prevSize)
+      continue;
+
+    std::vector<double> processingUs;
+    double totalUs = 0;
+    bool tooLong = false;
+
+    while(int(processingUs.size()) < MaxInstances)
+    {
+      const auto us0 = getSteadyClockUs();
+      randomSeed(processingUs.size());
+      if(!algo->init(size))
+        return {};
+
+      const auto us1 = getSteadyClockUs();
+      algo->execute();
+      const auto us2 = getSteadyClockUs();
+
+      processingUs.push_back(us2 - us1);
+      totalUs += us2 - us0;
+
+      if(totalUs > maxSecondsPerSize * 1000000.0)
+      {
+        tooLong = true;
+        break;
+      }
+
+      if(int(processingUs.size()) >= MinInstances && totalUs >= MinMeasureUs)
+        break;
+    }
+
+    const auto stats = summarize(processingUs, 0, totalUs);
+
+    SweepPoint point;
+    point.size = size;
+    point.instances = stats.instances;
+    point.meanUs = stats.meanUs;
+    point.medianUs = stats.medianUs;
+    point.peakRssMiB = getPeakRssMiB();
+
+    if(!r.points.empty())
+    {
+      auto& prev = r.points.back();
+      if(prev.medianUs > 0 && point.medianUs > 0)
+        point.localExponent = std::log(point.medianUs / prev.medianUs) / std::log(double(size) / prev.size);
+    }
+
+    if(point.medianUs >= MinFittedUs)
+    {
+      logSizes.push_back(std::log(double(size)));
+      logTimes.push_back(std::log(point.medianUs));
+    }
+
+    r.points.push_back(point);
+    prevSize = size;
+
+    if(tooLong)
+    {
+      r.truncated = true;
+      break;
+    }
+  }
+
+  r.exponent = fitSlope(logSizes, logTimes);
+
+  return r;
+}
+
+void traceAlgorithm(AbstractAlgorithm* algo, int seed, ZoneRecorder& trace)
+{
+  randomSeed(seed);
+  algo->init();
+
+  trace.traceEnabled = true;
+  gZoneRecorder = &trace;
+  algo->execute();
+  gZoneRecorder = nullptr;
+}
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <vector>
+
+struct AbstractAlgorithm;
+class Corpus;
+class ZoneRecorder;
+
+struct ProfilingResult
+{
+  int instances = 0;
+
+  // per-instance processing time, in microseconds
+  double meanUs = 0;
+  double medianUs = 0;
+  double p99Us = 0;
+
+  // per-instance input generation (or loading) time, in microseconds
+  double generationUs = 0;
+
+  // per-instance heap traffic of the executions (see allocations.h), zero when it isn't tracked.
+  // The first execution also pays for growing the scratch arena (see arena.h).
+  double allocationCount = 0;
+  double allocatedBytes = 0;
+  double peakLiveBytes = 0;
+
+  // wall-clock time for the whole run, in milliseconds
+  double totalMs = 0;
+
+  // aggregate throughput over all worker threads
+  int threads = 1;
+  double instancesPerSecond = 0;
+};
+
+// Runs 'instances' times: seed, generate input, execute.
+// Only the execution is accounted in the per-instance statistics.
+// If 'zones' is provided, the zones and counters hit during the executions are accumulated into it.
+// If 'corpus' is provided, the instance k loads the record 'k % corpus->size()' instead of generating
+// its input (see corpus.h): the algorithm must support corpora, and 'corpus' must not be empty.
+ProfilingResult profileAlgorithm(AbstractAlgorithm* algo,
+      int instances,
+      bool showProgress,
+      ZoneRecorder* zones = nullptr,
+      const Corpus* corpus = nullptr);
+
+// Same as above, but spreads the instances over 'threads' workers,
+// each one running its own copy of the algorithm, with its own random generator.
+// 'threads <= 0' means one worker per hardware thread.
+ProfilingResult profileAlgorithmParallel(const AbstractAlgorithm* algo,
+      int instances,
+      int threads,
+      ZoneRecorder* zones = nullptr,
+      const Corpus* corpus = nullptr);
+
+// Runs a single instance, seeded with 'seed', recording every zone and counter event into 'trace'
+void traceAlgorithm(AbstractAlgorithm* algo, int seed, ZoneRecorder& trace);
+
+struct SweepPoint
+{
+  int size = 0; // as requested from 'generateInput(int size)'
+  int instances = 0;
+
+  // per-instance processing time, in microseconds
+  double meanUs = 0;
+  double medianUs = 0;
+
+  // growth rate relative to the previous point: time ~ size^exponent (0 for the first point)
+  double localExponent = 0;
+
+  // high-water mark of the whole process since it started, in MiB (-1: unavailable)
+  double peakRssMiB = -1;
+};
+
+struct SweepResult
+{
+  std::vector<SweepPoint> points;
+
+  // least-squares fit of log(medianUs) against log(size), ignoring points too fast to be measured reliably
+  double exponent = 0;
+
+  // the sweep stopped before 'maxSize' because it was taking too long
+  bool truncated = false;
+};
+
+// Profiles the algorithm at geometrically increasing input sizes, from 'minSize' to 'maxSize'
+// (three sizes per decade), using the algorithm's 'generateInput(int size)'.
+// Stops early when one size takes more than 'maxSecondsPerSize'.
+// Returns an empty result if the algorithm only has a fixed-size input.
+SweepResult profileAlgorithmSweep(AbstractAlgorithm* algo, int minSize, int maxSize, double maxSecondsPerSize);
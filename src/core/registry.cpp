@@ -0,0 +1,16 @@
+#include <map>
+#include <string>
+
+#include "app.h"
+
+std::map<std::string, CreationFunc*>& Registry()
+{
+  static std::map<std::string, CreationFunc*> registry;
+  return registry;
+}
+
+int registerApp(const char* name, CreationFunc* func)
+{
+  Registry()[name] = func;
+  return 0;
+}
@@ -14,7 +14,8 @@ struct IVisualizer : IDrawer
   virtual void step() = 0;
 };
 
-extern IVisualizer* gVisualizer;
+// per-thread, so algorithms can run concurrently (e.g parallel profiling)
+extern thread_local IVisualizer* gVisualizer;
 extern IVisualizer* const gNullVisualizer;
 
 void sandbox_breakpoint();
@@ -23,3 +24,22 @@ void sandbox_rect(Vec2 a, Vec2 b, Color color = White);
 void sandbox_circle(Vec2 center, float radius, Color color = White);
 void sandbox_text(Vec2 pos, const char* text, Color color = White);
 void sandbox_printf(const char* fmt, ...);
+
+// Building with SANDBOX_DISABLED turns every sandbox_* call into a no-op,
+// without evaluating its arguments: algorithms then run at full speed,
+// e.g when shipped in another project.
+// The calls are still type-checked, so they don't rot in this build mode.
+// Use 'if(SandboxEnabled)' to skip visualization-only work (formatting, etc.).
+#ifdef SANDBOX_DISABLED
+constexpr bool SandboxEnabled = false;
+
+#define SANDBOX_NOOP(call) ((void)(false && ((call), true)))
+#define sandbox_breakpoint() SANDBOX_NOOP(sandbox_breakpoint())
+#define sandbox_line(...) SANDBOX_NOOP(sandbox_line(__VA_ARGS__))
+#define sandbox_rect(...) SANDBOX_NOOP(sandbox_rect(__VA_ARGS__))
+#define sandbox_circle(...) SANDBOX_NOOP(sandbox_circle(__VA_ARGS__))
+#define sandbox_text(...) SANDBOX_NOOP(sandbox_text(__VA_ARGS__))
+#define sandbox_printf(...) SANDBOX_NOOP(sandbox_printf(__VA_ARGS__))
+#else
+constexpr bool SandboxEnabled = true;
+#endif
@@ -0,0 +1,172 @@
+#pragma once
+
+// Minimal 4-wide float vector, mapped to SSE2 or NEON when available,
+// with a scalar fallback (which compilers usually auto-vectorize anyway).
+// Comparisons return a bitmask: for lessEqualMask(a, b), bit 'i' is set when a[i] <= b[i].
+
+#if defined(__SSE2__) || defined(_M_X64)
+#define SIMD_SSE2 1
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#define SIMD_NEON 1
+#include <arm_neon.h>
+#endif
+
+struct Float4
+{
+#if defined(SIMD_SSE2)
+  __m128 v;
+#elif defined(SIMD_NEON)
+  float32x4_t v;
+#else
+  float v[4];
+#endif
+};
+
+#if defined(SIMD_SSE2)
+
+inline Float4 load4(const float* p) { return {_mm_loadu_ps(p)}; }
+inline void store4(float* p, Float4 a) { _mm_storeu_ps(p, a.v); }
+inline Float4 splat4(float val) { return {_mm_set1_ps(val)}; }
+inline void transpose4(Float4& r0, Float4& r1, Float4& r2, Float4& r3) { _MM_TRANSPOSE4_PS(r0.v, r1.v, r2.v, r3.v); }
+
+inline Float4 operator+(Float4 a, Float4 b) { return {_mm_add_ps(a.v, b.v)}; }
+inline Float4 operator-(Float4 a, Float4 b) { return {_mm_sub_ps(a.v, b.v)}; }
+inline Float4 operator*(Float4 a, Float4 b) { return {_mm_mul_ps(a.v, b.v)}; }
+inline Float4 operator/(Float4 a, Float4 b) { return {_mm_div_ps(a.v, b.v)}; }
+inline Float4 min4(Float4 a, Float4 b) { return {_mm_min_ps(a.v, b.v)}; }
+inline Float4 max4(Float4 a, Float4 b) { return {_mm_max_ps(a.v, b.v)}; }
+inline int lessEqualMask(Float4 a, Float4 b) { return _mm_movemask_ps(_mm_cmple_ps(a.v, b.v)); }
+
+inline float horizontalMin(Float4 a)
+{
+  __m128 m = _mm_min_ps(a.v, _mm_shuffle_ps(a.v, a.v, _MM_SHUFFLE(1, 0, 3, 2)));
+  m = _mm_min_ps(m, _mm_shuffle_ps(m, m, _MM_SHUFFLE(2, 3, 0, 1)));
+  return _mm_cvtss_f32(m);
+}
+
+inline float horizontalMax(Float4 a)
+{
+  __m128 m = _mm_max_ps(a.v, _mm_shuffle_ps(a.v, a.v, _MM_SHUFFLE(1, 0, 3, 2)));
+  m = _mm_max_ps(m, _mm_shuffle_ps(m, m, _MM_SHUFFLE(2, 3, 0, 1)));
+  return _mm_cvtss_f32(m);
+}
+
+#elif defined(SIMD_NEON)
+
+inline Float4 load4(const float* p) { return {vld1q_f32(p)}; }
+inline void store4(float* p, Float4 a) { vst1q_f32(p, a.v); }
+inline Float4 splat4(float val) { return {vdupq_n_f32(val)}; }
+
+inline void transpose4(Float4& r0, Float4& r1, Float4& r2, Float4& r3)
+{
+  const float32x4x2_t t01 = vtrnq_f32(r0.v, r1.v); // (a0 b0 a2 b2) (a1 b1 a3 b3)
+  const float32x4x2_t t23 = vtrnq_f32(r2.v, r3.v); // (c0 d0 c2 d2) (c1 d1 c3 d3)
+  r0.v = vcombine_f32(vget_low_f32(t01.val[0]), vget_low_f32(t23.val[0]));
+  r1.v = vcombine_f32(vget_low_f32(t01.val[1]), vget_low_f32(t23.val[1]));
+  r2.v = vcombine_f32(vget_high_f32(t01.val[0]), vget_high_f32(t23.val[0]));
+  r3.v = vcombine_f32(vget_high_f32(t01.val[1]), vget_high_f32(t23.val[1]));
+}
+
+inline Float4 operator+(Float4 a, Float4 b) { return {vaddq_f32(a.v, b.v)}; }
+inline Float4 operator-(Float4 a, Float4 b) { return {vsubq_f32(a.v, b.v)}; }
+inline Float4 operator*(Float4 a, Float4 b) { return {vmulq_f32(a.v, b.v)}; }
+
+inline Float4 operator/(Float4 a, Float4 b)
+{
+#if defined(__aarch64__)
+  return {vdivq_f32(a.v, b.v)};
+#else
+  // no division on 32-bit NEON: reciprocal estimate, refined twice
+  float32x4_t r = vrecpeq_f32(b.v);
+  r = vmulq_f32(r, vrecpsq_f32(b.v, r));
+  r = vmulq_f32(r, vrecpsq_f32(b.v, r));
+  return {vmulq_f32(a.v, r)};
+#endif
+}
+
+inline Float4 min4(Float4 a, Float4 b) { return {vminq_f32(a.v, b.v)}; }
+inline Float4 max4(Float4 a, Float4 b) { return {vmaxq_f32(a.v, b.v)}; }
+
+inline int lessEqualMask(Float4 a, Float4 b)
+{
+  const uint32x4_t m = vcleq_f32(a.v, b.v);
+  return (vgetq_lane_u32(m, 0) & 1) | (vgetq_lane_u32(m, 1) & 2) | (vgetq_lane_u32(m, 2) & 4) |
+        (vgetq_lane_u32(m, 3) & 8);
+}
+
+inline float horizontalMin(Float4 a)
+{
+  float32x2_t m = vpmin_f32(vget_low_f32(a.v), vget_high_f32(a.v));
+  return vget_lane_f32(vpmin_f32(m, m), 0);
+}
+
+inline float horizontalMax(Float4 a)
+{
+  float32x2_t m = vpmax_f32(vget_low_f32(a.v), vget_high_f32(a.v));
+  return vget_lane_f32(vpmax_f32(m, m), 0);
+}
+
+#else
+
+inline Float4 load4(const float* p) { return {{p[0], p[1], p[2], p[3]}}; }
+
+inline void store4(float* p, Float4 a)
+{
+  for(int i = 0; i < 4; ++i)
+    p[i] = a.v[i];
+}
+
+inline Float4 splat4(float val) { return {{val, val, val, val}}; }
+
+inline void transpose4(Float4& r0, Float4& r1, Float4& r2, Float4& r3)
+{
+  Float4* rows[] = {&r0, &r1, &r2, &r3};
+  for(int i = 0; i < 4; ++i)
+    for(int j = i + 1; j < 4; ++j)
+    {
+      const float tmp = rows[i]->v[j];
+      rows[i]->v[j] = rows[j]->v[i];
+      rows[j]->v[i] = tmp;
+    }
+}
+
+template<typename Op>
+Float4 scalar4(Float4 a, Float4 b, Op op)
+{
+  return {{op(a.v[0], b.v[0]), op(a.v[1], b.v[1]), op(a.v[2], b.v[2]), op(a.v[3], b.v[3])}};
+}
+
+inline Float4 operator+(Float4 a, Float4 b) { return scalar4(a, b, [](float x, float y) { return x + y; }); }
+inline Float4 operator-(Float4 a, Float4 b) { return scalar4(a, b, [](float x, float y) { return x - y; }); }
+inline Float4 operator*(Float4 a, Float4 b) { return scalar4(a, b, [](float x, float y) { return x * y; }); }
+inline Float4 operator/(Float4 a, Float4 b) { return scalar4(a, b, [](float x, float y) { return x / y; }); }
+inline Float4 min4(Float4 a, Float4 b) { return scalar4(a, b, [](float x, float y) { return x < y ? x : y; }); }
+inline Float4 max4(Float4 a, Float4 b) { return scalar4(a, b, [](float x, float y) { return x > y ? x : y; }); }
+
+inline int lessEqualMask(Float4 a, Float4 b)
+{
+  int mask = 0;
+  for(int i = 0; i < 4; ++i)
+    mask |= (a.v[i] <= b.v[i]) << i;
+  return mask;
+}
+
+inline float horizontalMin(Float4 a)
+{
+  const float m0 = a.v[0] < a.v[1] ? a.v[0] : a.v[1];
+  const float m1 = a.v[2] < a.v[3] ? a.v[2] : a.v[3];
+  return m0 < m1 ? m0 : m1;
+}
+
+inline float horizontalMax(Float4 a)
+{
+  const float m0 = a.v[0] > a.v[1] ? a.v[0] : a.v[1];
+  const float m1 = a.v[2] > a.v[3] ? a.v[2] : a.v[3];
+  return m0 > m1 ? m0 : m1;
+}
+
+#endif
+
+// a * b + c
+inline Float4 multiplyAdd(Float4 a, Float4 b, Float4 c) { return a * b + c; }
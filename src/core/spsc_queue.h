@@ -0,0 +1,44 @@
+#pragma once
+
+// Bounded queue between exactly one producer thread and one consumer thread, without locks:
+// neither side ever waits for the other, 'push' fails when the queue is full, and 'pop' when it's empty.
+
+#include <atomic>
+#include <cstddef>
+#include <utility>
+
+template<typename T, size_t Capacity>
+class SpscQueue
+{
+  public:
+  // producer side: 'value' is only moved from when it gets in
+  bool push(T&& value)
+  {
+    const size_t tail = m_tail.load(std::memory_order_relaxed);
+    if(tail - m_head.load(std::memory_order_acquire) == Capacity)
+      return false;
+
+    m_slots[tail % Capacity] = std::move(value);
+    m_tail.store(tail + 1, std::memory_order_release);
+    return true;
+  }
+
+  // consumer side
+  bool pop(T& value)
+  {
+    const size_t head = m_head.load(std::memory_order_relaxed);
+    if(head == m_tail.load(std::memory_order_acquire))
+      return false;
+
+    value = std::move(m_slots[head % Capacity]);
+    m_head.store(head + 1, std::memory_order_release);
+    return true;
+  }
+
+  private:
+  T m_slots[Capacity];
+
+  // on their own cache lines: each one is written by a single side
+  alignas(64) std::atomic<size_t> m_head{0}; // next slot to pop
+  alignas(64) std::atomic<size_t> m_tail{0}; // next slot to push
+};
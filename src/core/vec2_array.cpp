@@ -0,0 +1,190 @@
+#include "vec2_array.h"
+
+#include <cassert>
+#include <cmath>
+#include <utility>
+
+#include "matrix4.h"
+#include "simd.h"
+
+Vec2Array::Vec2Array(span<const Vec2> points)
+{
+  resize(points.len);
+  for(size_t i = 0; i < points.len; ++i)
+  {
+    x[i] = points[i].x;
+    y[i] = points[i].y;
+  }
+}
+
+namespace
+{
+const float Infinity = INFINITY;
+
+// out[i] = x[i] * cx + y[i] * cy + c
+void linearCombination(const float* x, const float* y, size_t n, float cx, float cy, float c, float* out)
+{
+  const Float4 vcx = splat4(cx);
+  const Float4 vcy = splat4(cy);
+  const Float4 vc = splat4(c);
+
+  size_t i = 0;
+  for(; i + 4 <= n; i += 4)
+    store4(out + i, multiplyAdd(load4(x + i), vcx, multiplyAdd(load4(y + i), vcy, vc)));
+
+  for(; i < n; ++i)
+    out[i] = x[i] * cx + (y[i] * cy + c);
+}
+
+void computeRange(const float* values, size_t n, float& min, float& max)
+{
+  Float4 vmin = splat4(Infinity);
+  Float4 vmax = splat4(-Infinity);
+
+  size_t i = 0;
+  for(; i + 4 <= n; i += 4)
+  {
+    const Float4 v = load4(values + i);
+    vmin = min4(vmin, v);
+    vmax = max4(vmax, v);
+  }
+
+  min = horizontalMin(vmin);
+  max = horizontalMax(vmax);
+
+  for(; i < n; ++i)
+  {
+    min = std::fmin(min, values[i]);
+    max = std::fmax(max, values[i]);
+  }
+}
+}
+
+void computeBounds(const Vec2Array& points, Vec2& min, Vec2& max)
+{
+  computeRange(points.x.data(), points.size(), min.x, max.x);
+  computeRange(points.y.data(), points.size(), min.y, max.y);
+}
+
+void computeBounds(span<const Vec2> points, Vec2& min, Vec2& max)
+{
+  // interleaved: each register holds two points (x0, y0, x1, y1)
+  static_assert(sizeof(Vec2) == 2 * sizeof(float));
+  const float* coords = (const float*)points.ptr;
+  const size_t n = points.len * 2;
+
+  Float4 vmin = splat4(Infinity);
+  Float4 vmax = splat4(-Infinity);
+
+  size_t i = 0;
+  for(; i + 4 <= n; i += 4)
+  {
+    const Float4 v = load4(coords + i);
+    vmin = min4(vmin, v);
+    vmax = max4(vmax, v);
+  }
+
+  float lo[4], hi[4];
+  store4(lo, vmin);
+  store4(hi, vmax);
+
+  min = {std::fmin(lo[0], lo[2]), std::fmin(lo[1], lo[3])};
+  max = {std::fmax(hi[0], hi[2]), std::fmax(hi[1], hi[3])};
+
+  for(; i < n; i += 2)
+  {
+    min = {std::fmin(min.x, coords[i]), std::fmin(min.y, coords[i + 1])};
+    max = {std::fmax(max.x, coords[i]), std::fmax(max.y, coords[i + 1])};
+  }
+}
+
+void dotProducts(const Vec2Array& points, Vec2 dir, float offset, span<float> out)
+{
+  assert(out.len >= points.size());
+  linearCombination(points.x.data(), points.y.data(), points.size(), dir.x, dir.y, -offset, out.ptr);
+}
+
+void signedDistancesToLine(const Vec2Array& points, Vec2 a, Vec2 b, span<float> out)
+{
+  const Vec2 normal = normalize(rotateLeft(b - a));
+  dotProducts(points, normal, normal * a, out);
+}
+
+void orientations(const Vec2Array& points, Vec2 a, Vec2 b, span<float> out)
+{
+  // det2d(b - a, p - a) = (b - a).x * (p.y - a.y) - (b - a).y * (p.x - a.x)
+  const Vec2 n = rotateLeft(b - a);
+  dotProducts(points, n, n * a, out);
+}
+
+float squaredDistancesToSegment(const Vec2Array& points, size_t begin, size_t end, Vec2 a, Vec2 b, span<float> out)
+{
+  assert(end <= points.size() && out.len >= end - begin);
+
+  // the closest point is a + d * t, with t clamped to [0; 1] (0 for a point-like segment)
+  const Vec2 d = b - a;
+  const float lengthSq = d * d;
+  const float invLengthSq = lengthSq > 0 ? 1.0f / lengthSq : 0.0f;
+
+  const float* x = points.x.data() + begin;
+  const float* y = points.y.data() + begin;
+  const size_t n = end - begin;
+
+  const Float4 ax = splat4(a.x);
+  const Float4 ay = splat4(a.y);
+  const Float4 dx = splat4(d.x);
+  const Float4 dy = splat4(d.y);
+  const Float4 invLen = splat4(invLengthSq);
+  const Float4 zero = splat4(0);
+  const Float4 one = splat4(1);
+
+  Float4 vmax = splat4(-Infinity);
+
+  size_t i = 0;
+  for(; i + 4 <= n; i += 4)
+  {
+    const Float4 px = load4(x + i) - ax;
+    const Float4 py = load4(y + i) - ay;
+    const Float4 t = min4(max4((px * dx + py * dy) * invLen, zero), one);
+    const Float4 ex = px - dx * t;
+    const Float4 ey = py - dy * t;
+    const Float4 distSq = ex * ex + ey * ey;
+    store4(out.ptr + i, distSq);
+    vmax = max4(vmax, distSq);
+  }
+
+  float max = horizontalMax(vmax);
+
+  for(; i < n; ++i)
+  {
+    const float px = x[i] - a.x;
+    const float py = y[i] - a.y;
+    const float t = std::fmin(std::fmax((px * d.x + py * d.y) * invLengthSq, 0.0f), 1.0f);
+    const float ex = px - d.x * t;
+    const float ey = py - d.y * t;
+    out[i] = ex * ex + ey * ey;
+    max = std::fmax(max, out[i]);
+  }
+
+  return max;
+}
+
+void transformPoints(const Vec2Array& points, const Matrix4f& m, Vec2Array& out)
+{
+  if(&out == &points)
+  {
+    Vec2Array r;
+    transformPoints(points, m, r);
+    out = std::move(r);
+    return;
+  }
+
+  out.resize(points.size());
+
+  const float* x = points.x.data();
+  const float* y = points.y.data();
+  const size_t n = points.size();
+
+  linearCombination(x, y, n, m[0][0], m[0][1], m[0][3], out.x.data());
+  linearCombination(x, y, n, m[1][0], m[1][1], m[1][3], out.y.data());
+}
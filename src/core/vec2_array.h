@@ -0,0 +1,92 @@
+#pragma once
+
+// Structure-of-arrays storage for 2D points, and data-parallel kernels working on it.
+// The kernels process four points at a time (see simd.h), so algorithms can
+// switch to this layout for the bulk parts of their work (bounds, plane tests ...).
+
+#include <cstddef>
+#include <new>
+#include <vector>
+
+#include "geom.h"
+
+struct Matrix4f;
+
+template<typename T, size_t Alignment = 32>
+struct AlignedAllocator
+{
+  using value_type = T;
+
+  template<typename U>
+  struct rebind
+  {
+    using other = AlignedAllocator<U, Alignment>;
+  };
+
+  AlignedAllocator() = default;
+
+  template<typename U>
+  AlignedAllocator(const AlignedAllocator<U, Alignment>&)
+  {
+  }
+
+  T* allocate(size_t n) { return (T*)::operator new(n * sizeof(T), std::align_val_t(Alignment)); }
+  void deallocate(T* p, size_t) { ::operator delete(p, std::align_val_t(Alignment)); }
+
+  friend bool operator==(const AlignedAllocator&, const AlignedAllocator&) { return true; }
+  friend bool operator!=(const AlignedAllocator&, const AlignedAllocator&) { return false; }
+};
+
+struct Vec2Array
+{
+  std::vector<float, AlignedAllocator<float>> x;
+  std::vector<float, AlignedAllocator<float>> y;
+
+  Vec2Array() = default;
+  explicit Vec2Array(span<const Vec2> points);
+
+  size_t size() const { return x.size(); }
+
+  void resize(size_t n)
+  {
+    x.resize(n);
+    y.resize(n);
+  }
+
+  void push_back(Vec2 p)
+  {
+    x.push_back(p.x);
+    y.push_back(p.y);
+  }
+
+  Vec2 operator[](int i) const { return {x[i], y[i]}; }
+
+  void set(int i, Vec2 p)
+  {
+    x[i] = p.x;
+    y[i] = p.y;
+  }
+};
+
+// Axis-aligned bounds of 'points'.
+// For an empty input, 'min' is +infinity and 'max' is -infinity (like an empty BoundingBox).
+void computeBounds(const Vec2Array& points, Vec2& min, Vec2& max);
+void computeBounds(span<const Vec2> points, Vec2& min, Vec2& max);
+
+// out[i] = points[i] * dir - offset.
+// With a unit 'dir', this is the signed distance to the plane {p | p * dir = offset}.
+void dotProducts(const Vec2Array& points, Vec2 dir, float offset, span<float> out);
+
+// Signed distance from each point to the line (a, b): positive on the left side.
+void signedDistancesToLine(const Vec2Array& points, Vec2 a, Vec2 b, span<float> out);
+
+// out[i] = det2d(b - a, points[i] - a): positive when (a, b, points[i]) is counter-clockwise.
+// Not robust against degenerate configurations.
+void orientations(const Vec2Array& points, Vec2 a, Vec2 b, span<float> out);
+
+// out[i] = squared distance from points[begin + i] to the segment (a, b), for i in [0; end - begin[.
+// Returns the largest one (-infinity for an empty range).
+float squaredDistancesToSegment(const Vec2Array& points, size_t begin, size_t end, Vec2 a, Vec2 b, span<float> out);
+
+// Applies the affine part of 'm' to the points (z = 0, w = 1). 'out' is resized as needed.
+void transformPoints(const Vec2Array& points, const Matrix4f& m, Vec2Array& out);
@@ -0,0 +1,190 @@
+#include "zones.h"
+
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <cstring>
+
+thread_local ZoneRecorder* gZoneRecorder;
+
+namespace
+{
+int64_t getSteadyClockNs()
+{
+  using namespace std::chrono;
+  auto elapsedTime = steady_clock::now().time_since_epoch();
+  return duration_cast<nanoseconds>(elapsedTime).count();
+}
+
+void accumulate(ZoneRecorder::ZoneStats& dst, const ZoneRecorder::ZoneStats& src)
+{
+  dst.calls += src.calls;
+  dst.totalNs += src.totalNs;
+  dst.selfNs += src.selfNs;
+}
+
+void accumulate(ZoneRecorder::CounterStats& dst, const ZoneRecorder::CounterStats& src) { dst.total += src.total; }
+
+// The same literal might have different addresses in different translation units
+template<typename Stats>
+std::vector<Stats> mergeByName(const std::vector<Stats>& entries)
+{
+  std::vector<Stats> r;
+  for(auto& e : entries)
+  {
+    auto sameName = [&](const Stats& s) { return strcmp(s.name, e.name) == 0; };
+    auto i = std::find_if(r.begin(), r.end(), sameName);
+    if(i == r.end())
+      r.push_back(e);
+    else
+      accumulate(*i, e);
+  }
+  return r;
+}
+
+void writeJsonString(FILE* fp, const char* s)
+{
+  fputc('"', fp);
+  for(; *s; ++s)
+  {
+    if(*s == '"' || *s == '\\')
+      fputc('\\', fp);
+    fputc(*s, fp);
+  }
+  fputc('"', fp);
+}
+}
+
+void ZoneRecorder::begin(const char* name) { m_stack.push_back({name, getSteadyClockNs(), 0}); }
+
+void ZoneRecorder::end(const char* name)
+{
+  const int64_t endNs = getSteadyClockNs();
+
+  assert(!m_stack.empty() && m_stack.back().name == name);
+  const OpenZone zone = m_stack.back();
+  m_stack.pop_back();
+
+  const int64_t durationNs = endNs - zone.beginNs;
+
+  if(!m_stack.empty())
+    m_stack.back().childrenNs += durationNs;
+
+  auto& stats = findZone(name);
+  stats.calls++;
+  stats.totalNs += durationNs;
+  stats.selfNs += durationNs - zone.childrenNs;
+
+  if(traceEnabled)
+    m_events.push_back({name, zone.beginNs, durationNs, 0});
+}
+
+void ZoneRecorder::count(const char* name, int64_t delta)
+{
+  auto& stats = findCounter(name);
+  stats.total += delta;
+
+  if(traceEnabled)
+    m_events.push_back({name, getSteadyClockNs(), -1, stats.total});
+}
+
+void ZoneRecorder::merge(const ZoneRecorder& other)
+{
+  for(auto& z : other.m_zones)
+    accumulate(findZone(z.name), z);
+
+  for(auto& c : other.m_counters)
+    accumulate(findCounter(c.name), c);
+}
+
+std::vector<ZoneRecorder::ZoneStats> ZoneRecorder::zones() const
+{
+  auto r = mergeByName(m_zones);
+  std::sort(r.begin(), r.end(), [](const ZoneStats& a, const ZoneStats& b) { return a.selfNs > b.selfNs; });
+  return r;
+}
+
+std::vector<ZoneRecorder::CounterStats> ZoneRecorder::counters() const
+{
+  auto r = mergeByName(m_counters);
+  std::sort(r.begin(), r.end(), [](const CounterStats& a, const CounterStats& b) { return strcmp(a.name, b.name) < 0; });
+  return r;
+}
+
+void ZoneRecorder::printBreakdown(FILE* fp, int instances) const
+{
+  instances = std::max(1, instances);
+
+  const auto allZones = zones();
+  const auto allCounters = counters();
+
+  int64_t totalSelfNs = 0;
+  for(auto& z : allZones)
+    totalSelfNs += z.selfNs;
+
+  if(!allZones.empty())
+  {
+    fprintf(fp, "  %-32s %12s %13s %13s %7s\n", "zone", "calls/inst", "self us/inst", "total us/inst", "self%");
+    for(auto& z : allZones)
+    {
+      fprintf(fp, "  %-32s %12.1f %13.3f %13.3f %6.1f%%\n", z.name, double(z.calls) / instances,
+            z.selfNs / 1000.0 / instances, z.totalNs / 1000.0 / instances,
+            totalSelfNs ? 100.0 * z.selfNs / totalSelfNs : 0.0);
+    }
+  }
+
+  if(!allCounters.empty())
+  {
+    fprintf(fp, "  %-32s %12s\n", "counter", "per inst");
+    for(auto& c : allCounters)
+      fprintf(fp, "  %-32s %12.1f\n", c.name, double(c.total) / instances);
+  }
+}
+
+void ZoneRecorder::writeChromeTrace(FILE* fp) const
+{
+  // zones are recorded when they end: the first event isn't necessarily the earliest
+  int64_t firstNs = m_events.empty() ? 0 : m_events.front().beginNs;
+  for(auto& e : m_events)
+    firstNs = std::min(firstNs, e.beginNs);
+
+  fprintf(fp, "{\"traceEvents\": [\n");
+  for(size_t i = 0; i < m_events.size(); ++i)
+  {
+    auto& e = m_events[i];
+    fprintf(fp, "  {\"name\": ");
+    writeJsonString(fp, e.name);
+
+    const double ts = (e.beginNs - firstNs) / 1000.0;
+
+    if(e.durationNs >= 0)
+      fprintf(fp, ", \"ph\": \"X\", \"ts\": %.3f, \"dur\": %.3f", ts, e.durationNs / 1000.0);
+    else
+      fprintf(fp, ", \"ph\": \"C\", \"ts\": %.3f, \"args\": {\"value\": %lld}", ts, (long long)e.value);
+
+    fprintf(fp, ", \"pid\": 1, \"tid\": 1}%s\n", i + 1 < m_events.size() ? "," : "");
+  }
+  fprintf(fp, "]}\n");
+}
+
+ZoneRecorder::ZoneStats& ZoneRecorder::findZone(const char* name)
+{
+  auto i = m_zoneIndex.find(name);
+  if(i != m_zoneIndex.end())
+    return m_zones[i->second];
+
+  m_zoneIndex[name] = int(m_zones.size());
+  m_zones.push_back({name, 0, 0, 0});
+  return m_zones.back();
+}
+
+ZoneRecorder::CounterStats& ZoneRecorder::findCounter(const char* name)
+{
+  auto i = m_counterIndex.find(name);
+  if(i != m_counterIndex.end())
+    return m_counters[i->second];
+
+  m_counterIndex[name] = int(m_counters.size());
+  m_counters.push_back({name, 0});
+  return m_counters.back();
+}
@@ -0,0 +1,129 @@
+#pragma once
+
+// Scoped timing zones and counters, to see where time goes inside an algorithm:
+//
+//   void subdivide(...)
+//   {
+//     SANDBOX_ZONE("subdivide");
+//     ...
+//     sandbox_count("visitedNodes", 1);
+//   }
+//
+// Nothing is recorded unless a ZoneRecorder is installed on the calling thread
+// (the profiler does it around 'execute'): an inactive zone costs a thread-local
+// load and a branch. Like the rest of the sandbox API, zones and counters compile
+// to nothing with SANDBOX_DISABLED.
+//
+// Names must be string literals: they're stored by pointer.
+
+#include <cstdint>
+#include <cstdio>
+#include <unordered_map>
+#include <vector>
+
+class ZoneRecorder
+{
+  public:
+  struct ZoneStats
+  {
+    const char* name;
+    int64_t calls;
+    int64_t totalNs; // including nested zones
+    int64_t selfNs; // excluding nested zones
+  };
+
+  struct CounterStats
+  {
+    const char* name;
+    int64_t total;
+  };
+
+  // When enabled, every zone/counter event is kept, for trace export
+  bool traceEnabled = false;
+
+  void begin(const char* name);
+  void end(const char* name);
+  void count(const char* name, int64_t delta);
+
+  // accumulates the statistics of 'other' into this one (events aren't merged)
+  void merge(const ZoneRecorder& other);
+
+  // for each name, sorted by decreasing self time
+  std::vector<ZoneStats> zones() const;
+  std::vector<CounterStats> counters() const;
+
+  // 'instances' is used to report per-instance figures
+  void printBreakdown(FILE* fp, int instances) const;
+
+  // writes the recorded events in the Chrome trace format (also loadable by Perfetto)
+  void writeChromeTrace(FILE* fp) const;
+
+  private:
+  struct OpenZone
+  {
+    const char* name;
+    int64_t beginNs;
+    int64_t childrenNs;
+  };
+
+  struct TraceEvent
+  {
+    const char* name;
+    int64_t beginNs;
+    int64_t durationNs; // -1 for counters
+    int64_t value; // counters only
+  };
+
+  ZoneStats& findZone(const char* name);
+  CounterStats& findCounter(const char* name);
+
+  std::unordered_map<const char*, int> m_zoneIndex;
+  std::vector<ZoneStats> m_zones;
+  std::unordered_map<const char*, int> m_counterIndex;
+  std::vector<CounterStats> m_counters;
+
+  std::vector<OpenZone> m_stack;
+  std::vector<TraceEvent> m_events;
+};
+
+// The recorder of the calling thread (nullptr: recording is disabled)
+extern thread_local ZoneRecorder* gZoneRecorder;
+
+struct ZoneScope
+{
+  ZoneScope(const char* name)
+      : m_recorder(gZoneRecorder)
+      , m_name(name)
+  {
+    if(m_recorder)
+      m_recorder->begin(m_name);
+  }
+
+  ~ZoneScope()
+  {
+    if(m_recorder)
+      m_recorder->end(m_name);
+  }
+
+  ZoneScope(const ZoneScope&) = delete;
+  ZoneScope& operator=(const ZoneScope&) = delete;
+
+  ZoneRecorder* const m_recorder;
+  const char* const m_name;
+};
+
+inline void sandbox_count(const char* name, int64_t delta)
+{
+  if(gZoneRecorder)
+    gZoneRecorder->count(name, delta);
+}
+
+#define SANDBOX_ZONE_CONCAT2(a, b) a##b
+#define SANDBOX_ZONE_CONCAT(a, b) SANDBOX_ZONE_CONCAT2(a, b)
+
+#ifdef SANDBOX_DISABLED
+#define SANDBOX_ZONE(name) ((void)0)
+#define sandbox_count(...) ((void)(false && ((sandbox_count(__VA_ARGS__)), true)))
+#else
+#define SANDBOX_ZONE(name) const ZoneScope SANDBOX_ZONE_CONCAT(sandboxZone_, __LINE__)(name)
+#endif
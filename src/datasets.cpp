@@ -0,0 +1,215 @@
+#include "datasets.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+
+namespace
+{
+// Reads the lines of a text file, splitting them into numbers
+class LineReader
+{
+  public:
+  explicit LineReader(const std::string& path)
+      : m_path(path)
+  {
+    m_fp = fopen(path.c_str(), "r");
+    if(!m_fp)
+      throw std::runtime_error("Can't open '" + path + "'");
+  }
+
+  ~LineReader() { fclose(m_fp); }
+
+  LineReader(const LineReader&) = delete;
+  LineReader& operator=(const LineReader&) = delete;
+
+  // The values of the next line, skipping the comments. An empty line gives no value.
+  // Returns false at the end of the file.
+  bool next(std::vector<double>& values)
+  {
+    values.clear();
+
+    while(true)
+    {
+      std::string line;
+      if(!readLine(line))
+        return false;
+
+      ++m_lineNumber;
+      if(line[0] == '#')
+        continue;
+
+      const char* p = line.c_str();
+      while(true)
+      {
+        while(*p == ' ' || *p == '\t' || *p == ',' || *p == '\r' || *p == '\n')
+          ++p;
+
+        if(!*p)
+          return true;
+
+        char* end;
+        values.push_back(strtod(p, &end));
+        if(end == p)
+          fail("not a number: '" + std::string(p, strcspn(p, " \t,\r\n")) + "'");
+        p = end;
+      }
+    }
+  }
+
+  [[noreturn]] void fail(const std::string& message) const
+  {
+    throw std::runtime_error(m_path + ":" + std::to_string(m_lineNumber) + ": " + message);
+  }
+
+  private:
+  // 'line' is never empty: it holds at least the end of line
+  bool readLine(std::string& line)
+  {
+    char buffer[256];
+    while(fgets(buffer, sizeof buffer, m_fp))
+    {
+      line += buffer;
+      if(line.back() == '\n')
+        return true;
+    }
+    if(line.empty())
+      return false;
+    line += '\n';
+    return true;
+  }
+
+  const std::string m_path;
+  FILE* m_fp;
+  int m_lineNumber = 0;
+};
+
+Vec2 toPoint(const LineReader& reader, const std::vector<double>& values)
+{
+  if(values.size() != 2)
+    reader.fail("expected 'x y'");
+  return {float(values[0]), float(values[1])};
+}
+
+int toIndex(const LineReader& reader, double value, int count)
+{
+  if(value < 0 || value >= count || value != int(value))
+    reader.fail("not a node index");
+  return int(value);
+}
+}
+
+std::vector<Vec2> loadPoints(const std::string& path)
+{
+  LineReader reader(path);
+  std::vector<Vec2> points;
+
+  std::vector<double> values;
+  while(reader.next(values))
+  {
+    if(!values.empty())
+      points.push_back(toPoint(reader, values));
+  }
+
+  return points;
+}
+
+Polygon2f loadPolygon(const std::string& path)
+{
+  LineReader reader(path);
+  Polygon2f polygon;
+
+  int ringStart = 0;
+  auto closeRing = [&]()
+  {
+    const int n = int(polygon.vertices.size());
+    if(n - ringStart == 0)
+      return;
+
+    if(n - ringStart < 3)
+      reader.fail("a ring needs at least 3 vertices");
+
+    for(int i = ringStart; i < n; ++i)
+      polygon.faces.push_back({i, i + 1 < n ? i + 1 : ringStart});
+    ringStart = n;
+  };
+
+  std::vector<double> values;
+  while(reader.next(values))
+  {
+    if(values.empty())
+      closeRing();
+    else
+      polygon.vertices.push_back(toPoint(reader, values));
+  }
+  closeRing();
+
+  return polygon;
+}
+
+CsrGraph loadGraph(const std::string& path)
+{
+  LineReader reader(path);
+  CsrGraph graph;
+
+  auto nextLine = [&](std::vector<double>& values)
+  {
+    do
+    {
+      if(!reader.next(values))
+        reader.fail("unexpected end of file");
+    } while(values.empty());
+  };
+
+  std::vector<double> values;
+  nextLine(values);
+  if(values.size() != 2 || values[0] < 0 || values[1] < 0)
+    reader.fail("expected 'nodeCount edgeCount'");
+
+  const int nodeCount = int(values[0]);
+  const int edgeCount = int(values[1]);
+
+  for(int i = 0; i < nodeCount; ++i)
+  {
+    nextLine(values);
+    graph.positions.push_back(toPoint(reader, values));
+  }
+
+  struct Edge
+  {
+    int from, to, cost;
+  };
+
+  std::vector<Edge> edges(edgeCount);
+  for(auto& edge : edges)
+  {
+    nextLine(values);
+    if(values.size() != 2 && values.size() != 3)
+      reader.fail("expected 'from to [cost]'");
+
+    edge.from = toIndex(reader, values[0], nodeCount);
+    edge.to = toIndex(reader, values[1], nodeCount);
+    edge.cost = values.size() == 3 ? int(values[2]) : 1;
+  }
+
+  // counting sort by source node, keeping the order of the file
+  graph.edgeStart.assign(nodeCount + 1, 0);
+  for(auto& edge : edges)
+    ++graph.edgeStart[edge.from + 1];
+
+  for(int i = 0; i < nodeCount; ++i)
+    graph.edgeStart[i + 1] += graph.edgeStart[i];
+
+  std::vector<int> cursor(graph.edgeStart.begin(), graph.edgeStart.end() - 1);
+  graph.edgeTarget.resize(edgeCount);
+  graph.edgeCost.resize(edgeCount);
+  for(auto& edge : edges)
+  {
+    const int k = cursor[edge.from]++;
+    graph.edgeTarget[k] = edge.to;
+    graph.edgeCost[k] = edge.cost;
+  }
+
+  return graph;
+}
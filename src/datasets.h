@@ -0,0 +1,74 @@
+#pragma once
+
+// Loaders of real datasets, to profile the algorithms on production-shaped inputs
+// (see 'loadDataset' in algorithm_app.h), and the corpus codecs of their types (see corpus.h).
+//
+// The files are text, one record per line: '#' starts a comment line, and values are separated
+// by spaces, tabs or commas. The loaders throw (with the file and line) on malformed files.
+
+#include "core/corpus.h"
+#include "core/geom.h"
+
+#include <string>
+#include <vector>
+
+#include "polygon.h"
+
+// Point clouds and polylines: one "x y" line per point, blank lines are ignored
+std::vector<Vec2> loadPoints(const std::string& path);
+
+// Polygons: one "x y" line per vertex, each ring ends at a blank line (or at the end of the file)
+// and is closed. Outer rings must be counter-clockwise, and holes clockwise.
+Polygon2f loadPolygon(const std::string& path);
+
+// Directed graphs, in compressed sparse row form: the edges leaving the node i are the
+// 'edgeStart[i]' to 'edgeStart[i + 1] - 1'
+struct CsrGraph
+{
+  std::vector<Vec2> positions;
+  std::vector<int> edgeStart = {0};
+  std::vector<int> edgeTarget;
+  std::vector<int> edgeCost;
+
+  int nodeCount() const { return int(edgeStart.size()) - 1; }
+};
+
+// A "nodeCount edgeCount" line, then one "x y" line per node, then one "from to [cost]" line
+// per edge (the cost defaults to 1). The edges can come in any order.
+CsrGraph loadGraph(const std::string& path);
+
+template<>
+struct InputCodec<Polygon2f>
+{
+  static void write(CorpusWriter& writer, const Polygon2f& polygon)
+  {
+    InputCodec<std::vector<Vec2>>::write(writer, polygon.vertices);
+    InputCodec<std::vector<Face>>::write(writer, polygon.faces);
+  }
+
+  static void read(CorpusReader& reader, Polygon2f& polygon)
+  {
+    InputCodec<std::vector<Vec2>>::read(reader, polygon.vertices);
+    InputCodec<std::vector<Face>>::read(reader, polygon.faces);
+  }
+};
+
+template<>
+struct InputCodec<CsrGraph>
+{
+  static void write(CorpusWriter& writer, const CsrGraph& graph)
+  {
+    InputCodec<std::vector<Vec2>>::write(writer, graph.positions);
+    InputCodec<std::vector<int>>::write(writer, graph.edgeStart);
+    InputCodec<std::vector<int>>::write(writer, graph.edgeTarget);
+    InputCodec<std::vector<int>>::write(writer, graph.edgeCost);
+  }
+
+  static void read(CorpusReader& reader, CsrGraph& graph)
+  {
+    InputCodec<std::vector<Vec2>>::read(reader, graph.positions);
+    InputCodec<std::vector<int>>::read(reader, graph.edgeStart);
+    InputCodec<std::vector<int>>::read(reader, graph.edgeTarget);
+    InputCodec<std::vector<int>>::read(reader, graph.edgeCost);
+  }
+};
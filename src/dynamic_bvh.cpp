@@ -0,0 +1,391 @@
+#include "dynamic_bvh.h"
+
+#include "core/arena.h"
+
+#include <algorithm>
+#include <cassert>
+
+namespace
+{
+float halfPerimeter(const BoundingBox& box)
+{
+  const auto size = box.max - box.min;
+  return size.x + size.y;
+}
+
+BoundingBox merge(const BoundingBox& a, const BoundingBox& b)
+{
+  BoundingBox r = a;
+  r.add(b.min);
+  r.add(b.max);
+  return r;
+}
+
+bool contains(const BoundingBox& outer, const BoundingBox& inner)
+{
+  return outer.min.x <= inner.min.x && outer.min.y <= inner.min.y && inner.max.x <= outer.max.x &&
+         inner.max.y <= outer.max.y;
+}
+}
+
+DynamicBvh::DynamicBvh(const DynamicBvhOptions& options)
+    : m_options(options)
+{
+}
+
+int DynamicBvh::insert(const BoundingBox& box, int object)
+{
+  const int leaf = allocateNode();
+  const Vec2 margin{m_options.margin, m_options.margin};
+
+  m_nodes[leaf].boundaries.min = box.min - margin;
+  m_nodes[leaf].boundaries.max = box.max + margin;
+  m_nodes[leaf].object = object;
+
+  insertLeaf(leaf);
+  ++m_objectCount;
+
+  return leaf;
+}
+
+void DynamicBvh::remove(int handle)
+{
+  assert(m_nodes[handle].isLeaf());
+
+  removeLeaf(handle);
+  freeNode(handle);
+  --m_objectCount;
+}
+
+bool DynamicBvh::move(int handle, const BoundingBox& box)
+{
+  assert(m_nodes[handle].isLeaf());
+
+  if(contains(m_nodes[handle].boundaries, box))
+    return false;
+
+  const Vec2 margin{m_options.margin, m_options.margin};
+
+  removeLeaf(handle);
+  m_nodes[handle].boundaries.min = box.min - margin;
+  m_nodes[handle].boundaries.max = box.max + margin;
+  insertLeaf(handle);
+
+  return true;
+}
+
+void DynamicBvh::setBox(int handle, const BoundingBox& box)
+{
+  assert(m_nodes[handle].isLeaf());
+  m_nodes[handle].boundaries = box;
+}
+
+void DynamicBvh::refit()
+{
+  if(m_root == Null)
+    return;
+
+  // post-order traversal: each inner node is fitted once both its subtrees are
+  int curr = m_root;
+
+  while(true)
+  {
+    while(!m_nodes[curr].isLeaf())
+      curr = m_nodes[curr].children[0];
+
+    while(true)
+    {
+      const int parent = m_nodes[curr].parent;
+      if(parent == Null)
+        return;
+
+      if(m_nodes[parent].children[0] == curr)
+      {
+        curr = m_nodes[parent].children[1];
+        break;
+      }
+
+      curr = parent;
+
+      if(m_options.rotations)
+        rotate(curr);
+
+      fit(curr);
+    }
+  }
+}
+
+float DynamicBvh::cost(float traversalCost) const
+{
+  if(m_root == Null)
+    return 0;
+
+  const float rootArea = halfPerimeter(m_nodes[m_root].boundaries);
+
+  float cost = 0;
+  traverse(
+        [&](const BoundingBox& box)
+        {
+          const float probability = rootArea > 0 ? halfPerimeter(box) / rootArea : 1.0f;
+          cost += probability * traversalCost;
+          return true;
+        },
+        [&](int leaf)
+        {
+          // the leaf was counted as an inner node
+          const float probability = rootArea > 0 ? halfPerimeter(m_nodes[leaf].boundaries) / rootArea : 1.0f;
+          cost += probability * (1.0f - traversalCost);
+        });
+
+  return cost;
+}
+
+int DynamicBvh::allocateNode()
+{
+  if(m_freeList == Null)
+  {
+    m_nodes.push_back({});
+    return m_nodes.size() - 1;
+  }
+
+  const int index = m_freeList;
+  m_freeList = m_nodes[index].parent;
+  m_nodes[index] = {};
+  return index;
+}
+
+void DynamicBvh::freeNode(int index)
+{
+  m_nodes[index] = {};
+  m_nodes[index].parent = m_freeList;
+  m_freeList = index;
+}
+
+// Descends from the root towards the node whose merging with 'box' costs the least.
+// Creating a new parent at a node enlarges it, and all of its ancestors: the descent stops
+// when going further down can't be cheaper.
+int DynamicBvh::findSibling(const BoundingBox& box) const
+{
+  int curr = m_root;
+
+  while(!m_nodes[curr].isLeaf())
+  {
+    const auto& node = m_nodes[curr];
+    const float area = halfPerimeter(node.boundaries);
+    const float mergedArea = halfPerimeter(merge(node.boundaries, box));
+
+    // cost of making 'box' the sibling of this node
+    const float cost = 2 * mergedArea;
+
+    // the enlargement of this node, paid by any insertion below it
+    const float inheritedCost = 2 * (mergedArea - area);
+
+    float childCosts[2];
+    for(int k = 0; k < 2; ++k)
+    {
+      const auto& child = m_nodes[node.children[k]];
+      const float childMergedArea = halfPerimeter(merge(child.boundaries, box));
+
+      // (for an inner child: only its enlargement, a lower bound of the cost of descending into it)
+      if(child.isLeaf())
+        childCosts[k] = childMergedArea + inheritedCost;
+      else
+        childCosts[k] = childMergedArea - halfPerimeter(child.boundaries) + inheritedCost;
+    }
+
+    if(cost < childCosts[0] && cost < childCosts[1])
+      break;
+
+    curr = childCosts[0] <= childCosts[1] ? node.children[0] : node.children[1];
+  }
+
+  return curr;
+}
+
+void DynamicBvh::insertLeaf(int leaf)
+{
+  if(m_root == Null)
+  {
+    m_root = leaf;
+    m_nodes[leaf].parent = Null;
+    return;
+  }
+
+  const int sibling = findSibling(m_nodes[leaf].boundaries);
+  const int oldParent = m_nodes[sibling].parent;
+
+  // (invalidates the references to the nodes)
+  const int newParent = allocateNode();
+
+  m_nodes[newParent].parent = oldParent;
+  m_nodes[newParent].children[0] = sibling;
+  m_nodes[newParent].children[1] = leaf;
+  m_nodes[sibling].parent = newParent;
+  m_nodes[leaf].parent = newParent;
+
+  if(oldParent == Null)
+    m_root = newParent;
+  else
+  {
+    auto& children = m_nodes[oldParent].children;
+    children[children[0] == sibling ? 0 : 1] = newParent;
+  }
+
+  updateAncestors(newParent);
+}
+
+void DynamicBvh::removeLeaf(int leaf)
+{
+  if(leaf == m_root)
+  {
+    m_root = Null;
+    return;
+  }
+
+  // the sibling takes the place of the parent
+  const int parent = m_nodes[leaf].parent;
+  const int grandParent = m_nodes[parent].parent;
+  const auto& children = m_nodes[parent].children;
+  const int sibling = children[children[0] == leaf ? 1 : 0];
+
+  m_nodes[sibling].parent = grandParent;
+  freeNode(parent);
+
+  if(grandParent == Null)
+  {
+    m_root = sibling;
+    return;
+  }
+
+  auto& grandChildren = m_nodes[grandParent].children;
+  grandChildren[grandChildren[0] == parent ? 0 : 1] = sibling;
+
+  updateAncestors(grandParent);
+}
+
+// refits 'index' and its ancestors, after a modification of the subtree of 'index'
+void DynamicBvh::updateAncestors(int index)
+{
+  while(index != Null)
+  {
+    if(m_options.rotations)
+      rotate(index);
+
+    fit(index);
+    index = m_nodes[index].parent;
+  }
+}
+
+void DynamicBvh::fit(int index)
+{
+  auto& node = m_nodes[index];
+  const auto& a = m_nodes[node.children[0]];
+  const auto& b = m_nodes[node.children[1]];
+
+  node.boundaries = merge(a.boundaries, b.boundaries);
+  node.height = 1 + std::max(a.height, b.height);
+}
+
+// Swaps a child of 'index' with a child of its other child, if this shrinks the latter.
+// The bounds of 'index' don't change (it has the same objects), but the probability
+// of visiting its grandchildren does.
+void DynamicBvh::rotate(int index)
+{
+  const auto& node = m_nodes[index];
+  if(node.isLeaf())
+    return;
+
+  float bestGain = 0;
+  int bestChild = Null; // the child of 'index' going down
+  int bestGrandChild = Null; // the grand child going up
+
+  for(int k = 0; k < 2; ++k)
+  {
+    const int child = node.children[k];
+    const int other = node.children[1 - k];
+    const auto& otherNode = m_nodes[other];
+
+    if(otherNode.isLeaf())
+      continue;
+
+    const float area = halfPerimeter(otherNode.boundaries);
+
+    for(int j = 0; j < 2; ++j)
+    {
+      // 'other' would then contain 'child' and the remaining grandchild
+      const int remaining = otherNode.children[1 - j];
+      const float gain = area - halfPerimeter(merge(m_nodes[child].boundaries, m_nodes[remaining].boundaries));
+
+      if(gain > bestGain)
+      {
+        bestGain = gain;
+        bestChild = child;
+        bestGrandChild = otherNode.children[j];
+      }
+    }
+  }
+
+  if(bestChild == Null)
+    return;
+
+  const int other = m_nodes[bestGrandChild].parent;
+
+  auto& children = m_nodes[index].children;
+  children[children[0] == bestChild ? 0 : 1] = bestGrandChild;
+  m_nodes[bestGrandChild].parent = index;
+
+  auto& otherChildren = m_nodes[other].children;
+  otherChildren[otherChildren[0] == bestGrandChild ? 0 : 1] = bestChild;
+  m_nodes[bestChild].parent = other;
+
+  fit(other);
+}
+
+FlatBvh flattenBvh(const DynamicBvh& bvh)
+{
+  FlatBvh r;
+
+  if(bvh.m_root == DynamicBvh::Null)
+    return r;
+
+  struct Pending
+  {
+    int node;
+    int parent; // the flat node whose second child this is, or -1
+  };
+
+  ScratchScope scratch;
+  ScratchVector<Pending> stack;
+  stack.push_back({bvh.m_root, -1});
+
+  r.nodes.reserve(bvh.m_objectCount * 2 - 1);
+  r.objects.reserve(bvh.m_objectCount);
+
+  while(stack.size())
+  {
+    const auto curr = stack.back();
+    stack.pop_back();
+
+    const int flatIdx = r.nodes.size();
+    if(curr.parent >= 0)
+      r.nodes[curr.parent].offset = flatIdx;
+
+    const auto& node = bvh.m_nodes[curr.node];
+    r.nodes.push_back({});
+    r.nodes.back().boundaries = node.boundaries;
+
+    if(node.isLeaf())
+    {
+      r.nodes.back().offset = r.objects.size();
+      r.nodes.back().count = 1;
+      r.objects.push_back(node.object);
+    }
+    else
+    {
+      stack.push_back({node.children[1], flatIdx});
+      stack.push_back({node.children[0], -1});
+    }
+  }
+
+  return r;
+}
@@ -0,0 +1,141 @@
+#pragma once
+
+// Hierarchy of moving objects, updated in place instead of being rebuilt.
+//
+//   DynamicBvh bvh;
+//   const int handle = bvh.insert(box, object);
+//   ...
+//   bvh.move(handle, newBox); // each frame
+//
+// Each leaf holds a single object, and is referred to by the handle returned by 'insert'
+// (handles stay valid until the object is removed).
+
+#include <vector>
+
+#include "bounding_box.h"
+#include "bvh.h"
+
+struct DynamicBvhOptions
+{
+  // Boxes are stored enlarged by 'margin' on each side: 'move' doesn't touch the tree
+  // as long as the new box stays inside the enlarged one.
+  float margin = 0.0f;
+
+  // After each modification, the children and grandchildren of the modified nodes are swapped
+  // when it lowers the surface area heuristic: this keeps the quality of the tree from degrading
+  // with insertions and refits.
+  bool rotations = true;
+};
+
+class DynamicBvh
+{
+  public:
+  static const int Null = -1;
+
+  explicit DynamicBvh(const DynamicBvhOptions& options = {});
+
+  // Adds 'object': it goes next to the node which enlarges the least the tree (by perimeter),
+  // in O(log n). Returns the handle of its leaf.
+  int insert(const BoundingBox& box, int object);
+
+  void remove(int handle);
+
+  // Moves the object to 'box', reinserting it if it's not contained by its enlarged box anymore.
+  // Returns true if the tree was modified.
+  bool move(int handle, const BoundingBox& box);
+
+  // Replaces the box of the object (not enlarged), without updating the tree: call 'refit'
+  // once all the objects have been updated.
+  void setBox(int handle, const BoundingBox& box);
+
+  // Recomputes the bounds of all the inner nodes, bottom-up, in O(n).
+  // The structure of the tree is kept (except for the rotations), so this is much cheaper
+  // than rebuilding, but the tree degrades when the objects move far from their initial neighbours.
+  void refit();
+
+  int object(int handle) const { return m_nodes[handle].object; }
+  const BoundingBox& box(int handle) const { return m_nodes[handle].boundaries; }
+
+  int size() const { return m_objectCount; }
+  int height() const { return m_root == Null ? 0 : m_nodes[m_root].height; }
+
+  // same as 'computeBvhCost'
+  float cost(float traversalCost = 1.0f) const;
+
+  // Depth-first traversal, without allocations.
+  // 'enterNode(const BoundingBox&)' returns false to skip the node and its subtree,
+  // 'visitLeaf(int handle)' is called for each entered leaf.
+  template<typename EnterNode, typename VisitLeaf>
+  void traverse(EnterNode&& enterNode, VisitLeaf&& visitLeaf) const
+  {
+    // the depth isn't bounded: the parent links are used instead of a stack
+    int curr = m_root;
+
+    while(curr != Null)
+    {
+      const auto& node = m_nodes[curr];
+
+      if(enterNode(node.boundaries))
+      {
+        if(!node.isLeaf())
+        {
+          curr = node.children[0];
+          continue;
+        }
+
+        visitLeaf(curr);
+      }
+
+      // go to the next unvisited second child
+      while(true)
+      {
+        const int parent = m_nodes[curr].parent;
+        if(parent == Null)
+          return;
+
+        if(m_nodes[parent].children[0] == curr)
+        {
+          curr = m_nodes[parent].children[1];
+          break;
+        }
+
+        curr = parent;
+      }
+    }
+  }
+
+  private:
+  struct Node
+  {
+    BoundingBox boundaries;
+    int parent = Null; // in the free list: the next free node
+    int children[2] = {Null, Null};
+    int object = -1; // leaf only
+    int height = 0; // a leaf has height 0
+
+    bool isLeaf() const { return children[0] == Null; }
+  };
+
+  int allocateNode();
+  void freeNode(int index);
+  int findSibling(const BoundingBox& box) const;
+  void insertLeaf(int leaf);
+  void removeLeaf(int leaf);
+  void updateAncestors(int index);
+  void fit(int index);
+  void rotate(int index);
+
+  DynamicBvhOptions m_options;
+  std::vector<Node> m_nodes;
+  int m_root = Null;
+  int m_freeList = Null;
+  int m_objectCount = 0;
+
+  friend FlatBvh flattenBvh(const DynamicBvh& bvh);
+};
+
+// Compact copy of the hierarchy (one object per leaf), e.g for raycasts.
+// The objects of the flat hierarchy are the objects passed to 'insert'.
+// The flat traversals expect a depth below BvhMaxDepth: without rotations, inserting
+// sorted objects can make the tree arbitrarily deep.
+FlatBvh flattenBvh(const DynamicBvh& bvh);
@@ -0,0 +1,231 @@
+#include "light_clusters.h"
+
+#include "core/simd.h"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "parallel.h"
+
+namespace
+{
+// lights per task, when computing the ranges
+const int LightBatch = 256;
+
+float lerp(float a, float b, float r) { return (a * (1.f - r)) + (b * r); }
+
+int lowestBit(int mask)
+{
+  int i = 0;
+  while(!(mask & (1 << i)))
+    ++i;
+  return i;
+}
+
+int highestBit(int mask)
+{
+  int i = 3;
+  while(!(mask & (1 << i)))
+    --i;
+  return i;
+}
+
+// The padded components of 'normals': 'u' is x or y
+void splitComponents(const std::vector<Vec3>& normals, bool useY, std::vector<float>& u, std::vector<float>& z)
+{
+  const int paddedCount = (int(normals.size()) + 3) & ~3;
+  u.assign(paddedCount, 0);
+  z.assign(paddedCount, 0);
+  for(int i = 0; i < (int)normals.size(); ++i)
+  {
+    u[i] = useY ? normals[i].y : normals[i].x;
+    z[i] = normals[i].z;
+  }
+}
+
+// The tightest planes around the sphere: [first; last[ are the slabs it can touch.
+// 'first' is the last plane the sphere is fully in front of (or 0), 'last' is the first one
+// it's fully behind (or 'count'). The padding planes have a null normal: they never count.
+void findPlaneRange(const std::vector<float>& normalU,
+      const std::vector<float>& normalZ,
+      int count,
+      float u,
+      float z,
+      float radius,
+      int& first,
+      int& last)
+{
+  const Float4 centerU = splat4(u);
+  const Float4 centerZ = splat4(z);
+  const Float4 plusRadius = splat4(radius);
+  const Float4 minusRadius = splat4(-radius);
+
+  first = 0;
+  last = count;
+  bool lastFound = false;
+  for(int i = 0; i < (int)normalU.size(); i += 4)
+  {
+    const Float4 dist = multiplyAdd(load4(&normalU[i]), centerU, load4(&normalZ[i]) * centerZ);
+    const int inFront = ~lessEqualMask(dist, plusRadius) & 15;
+    const int behind = ~lessEqualMask(minusRadius, dist) & 15;
+
+    if(inFront)
+      first = i + highestBit(inFront);
+
+    if(behind && !lastFound)
+    {
+      last = i + lowestBit(behind);
+      lastFound = true;
+    }
+  }
+}
+
+int clampSlice(float position, int countZ) { return int(std::max(0.0f, std::min(float(countZ), position))); }
+
+// Calls 'f(light, cluster)' for each cluster of the slice 'z' touched by a light, by increasing light
+template<typename F>
+void forEachLightInSlice(const ClusterGrid& grid, const std::vector<ClusterRange>& ranges, int z, F f)
+{
+  for(int i = 0; i < (int)ranges.size(); ++i)
+  {
+    const ClusterRange& range = ranges[i];
+    if(range.empty() || z < range.z0 || z >= range.z1)
+      continue;
+
+    for(int y = range.y0; y < range.y1; ++y)
+      for(int x = range.x0; x < range.x1; ++x)
+        f(i, grid.clusterIndex(x, y, z));
+  }
+}
+}
+
+void ClusterGrid::build(const ClusterGridOptions& options_)
+{
+  options = options_;
+
+  const float tanHalfFovY = tan(options.fovY / 2);
+  const float far = options.far;
+
+  // pencil of planes on the Y axis
+  const float fhx = far * tanHalfFovY * options.aspectRatio;
+  planesX.resize(options.countX + 1);
+  for(int ix = 0; ix <= options.countX; ++ix)
+  {
+    const auto rx = float(ix) / float(options.countX);
+    Vec3 ray{lerp(-fhx, +fhx, rx), 0, -far};
+    planesX[ix] = normalize(crossProduct(ray, Vec3(0, 1, 0)));
+  }
+
+  // pencil of planes on the X axis
+  const float fhy = far * tanHalfFovY;
+  planesY.resize(options.countY + 1);
+  for(int iy = 0; iy <= options.countY; ++iy)
+  {
+    const auto ry = float(iy) / float(options.countY);
+    Vec3 ray{0, lerp(-fhy, +fhy, ry), -far};
+    planesY[iy] = normalize(crossProduct(ray, Vec3(-1, 0, 0)));
+  }
+
+  sliceDepths.resize(options.countZ + 1);
+  for(int iz = 0; iz <= options.countZ; ++iz)
+  {
+    const auto rz = float(iz) / float(options.countZ);
+    if(options.exponentialZ)
+      sliceDepths[iz] = options.near * std::pow(options.far / options.near, rz);
+    else
+      sliceDepths[iz] = lerp(options.near, options.far, rz);
+  }
+
+  splitComponents(planesX, false, planesXx, planesXz);
+  splitComponents(planesY, true, planesYy, planesYz);
+}
+
+float ClusterGrid::slicePosition(float depth) const
+{
+  if(!options.exponentialZ)
+    return (depth - options.near) * options.countZ / (options.far - options.near);
+
+  if(depth <= 0)
+    return -1.0 / 0.0;
+
+  return std::log(depth / options.near) / std::log(options.far / options.near) * options.countZ;
+}
+
+void computeClusterRanges(const ClusterGrid& grid,
+      span<const LightSphere> lights,
+      span<ClusterRange> ranges,
+      int threadCount)
+{
+  const int n = lights.len;
+  const int countZ = grid.options.countZ;
+
+  parallelFor((n + LightBatch - 1) / LightBatch, threadCount,
+        [&](int batch)
+        {
+          const int end = std::min(n, (batch + 1) * LightBatch);
+          for(int i = batch * LightBatch; i < end; ++i)
+          {
+            const LightSphere& light = lights[i];
+            ClusterRange& range = ranges[i];
+
+            findPlaneRange(grid.planesXx, grid.planesXz, grid.options.countX, light.center.x, light.center.z,
+                  light.radius, range.x0, range.x1);
+            findPlaneRange(grid.planesYy, grid.planesYz, grid.options.countY, light.center.y, light.center.z,
+                  light.radius, range.y0, range.y1);
+
+            const float depth = -light.center.z;
+            range.z0 = clampSlice(std::floor(grid.slicePosition(depth - light.radius)), countZ);
+            range.z1 = clampSlice(std::floor(grid.slicePosition(depth + light.radius)) + 1, countZ);
+          }
+        });
+}
+
+void assignLights(const ClusterGrid& grid,
+      span<const LightSphere> lights,
+      ClusterLightLists& lists,
+      LightAssignmentScratch& scratch,
+      int threadCount)
+{
+  auto& ranges = scratch.ranges;
+  ranges.resize(lights.len);
+  computeClusterRanges(grid, lights, ranges, threadCount);
+
+  // count, then fill: each slice only writes its own clusters
+  lists.start.assign(grid.clusterCount() + 1, 0);
+  parallelFor(grid.options.countZ, threadCount,
+        [&](int z) { forEachLightInSlice(grid, ranges, z, [&](int, int cluster) { ++lists.start[cluster + 1]; }); });
+
+  for(int i = 0; i < grid.clusterCount(); ++i)
+    lists.start[i + 1] += lists.start[i];
+
+  lists.indices.resize(lists.start.back());
+  scratch.cursors.assign(lists.start.begin(), lists.start.end() - 1);
+  parallelFor(grid.options.countZ, threadCount,
+        [&](int z)
+        {
+          forEachLightInSlice(
+                grid, ranges, z, [&](int light, int cluster) { lists.indices[scratch.cursors[cluster]++] = light; });
+        });
+}
+
+void assignLights(const ClusterGrid& grid,
+      span<const LightSphere> lights,
+      ClusterLightMasks& masks,
+      LightAssignmentScratch& scratch,
+      int threadCount)
+{
+  auto& ranges = scratch.ranges;
+  ranges.resize(lights.len);
+  computeClusterRanges(grid, lights, ranges, threadCount);
+
+  masks.wordsPerCluster = (int(lights.len) + 63) / 64;
+  masks.bits.assign(size_t(grid.clusterCount()) * masks.wordsPerCluster, 0);
+  parallelFor(grid.options.countZ, threadCount,
+        [&](int z)
+        {
+          forEachLightInSlice(grid, ranges, z,
+                [&](int light, int cluster)
+                { masks.bits[size_t(cluster) * masks.wordsPerCluster + light / 64] |= uint64_t(1) << (light % 64); });
+        });
+}
@@ -0,0 +1,121 @@
+#pragma once
+
+// Assignment of lights to clusters: the view frustum is split in countX * countY * countZ cells,
+// and each one gets the lights (spheres) touching it.
+// Everything is in view space: the camera is at (0;0;0), looking down -z.
+
+#include "core/geom.h"
+
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+struct ClusterGridOptions
+{
+  int countX = 16;
+  int countY = 8;
+  int countZ = 24;
+
+  float near = 10;
+  float far = 40;
+  float aspectRatio = 16.0 / 9.0;
+  float fovY = M_PI / 3.0;
+
+  // Slices getting deeper with the distance (all of the same depth ratio), instead of the same depth:
+  // the clusters keep about the same shape from the near plane to the far one.
+  bool exponentialZ = false;
+};
+
+struct ClusterGrid
+{
+  ClusterGridOptions options;
+
+  // The normals of the planes splitting the frustum, all through (0;0;0).
+  // The ones of planesX have no y, the ones of planesY have no x.
+  std::vector<Vec3> planesX; // countX + 1
+  std::vector<Vec3> planesY; // countY + 1
+  std::vector<float> sliceDepths; // countZ + 1, from 'near' to 'far'
+
+  // The same normals, by component, padded with zeros to a multiple of 4 (for SIMD)
+  std::vector<float> planesXx, planesXz;
+  std::vector<float> planesYy, planesYz;
+
+  void build(const ClusterGridOptions& options);
+
+  int clusterCount() const { return options.countX * options.countY * options.countZ; }
+  int clusterIndex(int x, int y, int z) const { return (z * options.countY + y) * options.countX + x; }
+
+  // The position of 'depth' (positive, in front of the camera) in slices: 0 at 'near', countZ at 'far'
+  float slicePosition(float depth) const;
+};
+
+struct LightSphere
+{
+  Vec3 center;
+  float radius;
+};
+
+// The clusters [x0; x1[ x [y0; y1[ x [z0; z1[ a light can touch
+struct ClusterRange
+{
+  int x0, x1;
+  int y0, y1;
+  int z0, z1;
+
+  bool empty() const { return x0 >= x1 || y0 >= y1 || z0 >= z1; }
+};
+
+// The lights touching the cluster c are indices[start[c]] ... indices[start[c + 1] - 1], by increasing index
+struct ClusterLightLists
+{
+  std::vector<int> start;
+  std::vector<int> indices;
+
+  span<const int> lightsOf(int cluster) const
+  {
+    return {size_t(start[cluster + 1] - start[cluster]), indices.data() + start[cluster]};
+  }
+};
+
+// One bit per light, 'wordsPerCluster' words per cluster
+struct ClusterLightMasks
+{
+  int wordsPerCluster = 0;
+  std::vector<uint64_t> bits;
+
+  bool contains(int cluster, int light) const
+  {
+    return (bits[size_t(cluster) * wordsPerCluster + light / 64] >> (light % 64)) & 1;
+  }
+};
+
+// Temporary storage of the assignments: keeping it from one call to the next avoids all allocations.
+struct LightAssignmentScratch
+{
+  std::vector<ClusterRange> ranges; // by light
+  std::vector<int> cursors; // by cluster
+};
+
+// Writes the range of each light to 'ranges' (same size as 'lights').
+// Each sphere is tested against four planes at a time. The range is conservative: a corner
+// cluster of the range can be outside the sphere.
+// The lights are split over 'threadCount' threads (0: one per hardware thread).
+void computeClusterRanges(const ClusterGrid& grid,
+      span<const LightSphere> lights,
+      span<ClusterRange> ranges,
+      int threadCount = 1);
+
+// The ranges of all the lights are computed first (the threads split the lights),
+// then the clusters are filled (the threads split the Z slices: each one writes its own clusters).
+// 'lists' / 'masks' is overwritten.
+void assignLights(const ClusterGrid& grid,
+      span<const LightSphere> lights,
+      ClusterLightLists& lists,
+      LightAssignmentScratch& scratch,
+      int threadCount = 1);
+
+void assignLights(const ClusterGrid& grid,
+      span<const LightSphere> lights,
+      ClusterLightMasks& masks,
+      LightAssignmentScratch& scratch,
+      int threadCount = 1);
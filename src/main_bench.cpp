@@ -0,0 +1,418 @@
+// Copyright (C) 2022 - Sebastien Alaiwan
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+
+///////////////////////////////////////////////////////////////////////////////
+// Benchmark entry point: times the library kernels on fixed inputs, to catch performance regressions.
+//
+// Usage: GeomSandboxBench.exe [--repetitions=N] [--warmup=N] [--baseline=file [--threshold=R]]
+//                             [--save-baseline=file] [benchmarkName...]
+// When no benchmark name is given, every benchmark is run.
+// Each benchmark builds its input once, from a fixed seed, then runs '--warmup' untimed
+// repetitions (default: 2), then '--repetitions' timed ones (default: 15).
+// '--baseline=file' compares the medians to the ones stored in 'file', and fails (exit code 1)
+// when one of them is more than '--threshold' times slower (default: 1.25).
+// A missing baseline file is only reported.
+// '--save-baseline=file' stores the medians of this run, for the next comparisons.
+
+#include "core/geom.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <map>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "bounding_box.h"
+#include "bsp.h"
+#include "bvh.h"
+#include "collide2d.h"
+#include "polygon.h"
+#include "random.h"
+#include "random_polygon.h"
+#include "split_polygon.h"
+#include "triangulate_bowyerwatson.h"
+
+namespace
+{
+struct Options
+{
+  int repetitions = 15;
+  int warmup = 2;
+  std::string baselinePath;
+  std::string saveBaselinePath;
+  double threshold = 1.25;
+  std::vector<std::string> names;
+};
+
+Options parseCommandLine(span<const char*> args)
+{
+  Options options;
+
+  for(size_t i = 1; i < args.len; ++i)
+  {
+    const char* arg = args[i];
+
+    if(strncmp(arg, "--repetitions=", 14) == 0)
+      options.repetitions = atoi(arg + 14);
+    else if(strncmp(arg, "--warmup=", 9) == 0)
+      options.warmup = atoi(arg + 9);
+    else if(strncmp(arg, "--baseline=", 11) == 0)
+      options.baselinePath = arg + 11;
+    else if(strncmp(arg, "--save-baseline=", 16) == 0)
+      options.saveBaselinePath = arg + 16;
+    else if(strncmp(arg, "--threshold=", 12) == 0)
+      options.threshold = atof(arg + 12);
+    else if(arg[0] == '-')
+      throw std::runtime_error("Unknown option: '" + std::string(arg) + "'");
+    else
+      options.names.push_back(arg);
+  }
+
+  if(options.repetitions <= 0)
+    throw std::runtime_error("Repetition count must be positive");
+
+  if(options.warmup < 0)
+    throw std::runtime_error("Warmup count can't be negative");
+
+  if(options.threshold < 1)
+    throw std::runtime_error("Threshold must be at least 1");
+
+  return options;
+}
+
+// A benchmark builds its input, and returns the timed part.
+// The timed part returns a value depending on its results, so it can't be optimized out.
+using Kernel = std::function<double()>;
+
+struct Benchmark
+{
+  const char* name;
+  std::function<Kernel()> prepare;
+};
+
+std::vector<BoundingBox> randomBoxes(int count)
+{
+  std::vector<BoundingBox> boxes(count);
+  for(auto& box : boxes)
+  {
+    const Vec2 pos = randomPos({-100, -100}, {100, 100});
+    box.add(pos);
+    box.add(pos + randomPos({0, 0}, {2, 2}));
+  }
+  return boxes;
+}
+
+std::vector<Segment> facesOf(const Polygon2f& polygon)
+{
+  std::vector<Segment> segments;
+  for(auto& face : polygon.faces)
+    segments.push_back({polygon.vertices[face.a], polygon.vertices[face.b]});
+  return segments;
+}
+
+Kernel benchBvh(BvhSplitter splitter)
+{
+  randomSeed(1);
+  auto boxes = randomBoxes(50000);
+
+  BvhBuildOptions options;
+  options.splitter = splitter;
+
+  return [boxes, options]() { return double(computeBoundingVolumeHierarchy(boxes, options).size()); };
+}
+
+Kernel benchBsp()
+{
+  randomSeed(2);
+  auto polygon = createLargeRandomPolygon2f(500);
+
+  return [polygon]()
+  {
+    auto tree = createBspTree(polygon);
+    return double(tree->coincident.size());
+  };
+}
+
+Kernel benchBowyerWatson()
+{
+  randomSeed(3);
+  std::vector<Vec2> points(1000);
+  randomFill(points, {-20, -20}, {20, 20});
+
+  return [points]() { return double(triangulate_BowyerWatson(points).size()); };
+}
+
+Kernel benchSplitPolygon()
+{
+  randomSeed(4);
+  auto polygon = createLargeRandomPolygon2f(20000);
+
+  // the buffers are kept from one split to the next, as the BSP builder would
+  auto buffers = std::make_shared<SplitPolygonBuffers>();
+
+  return [polygon, buffers]()
+  {
+    Polygon2f front, back;
+    double total = 0;
+    for(int k = 0; k < 8; ++k)
+    {
+      const float angle = k * 0.4f;
+      splitPolygonAgainstPlane(polygon, {{std::cos(angle), std::sin(angle)}, 0}, front, back, *buffers);
+      total += front.faces.size() + back.faces.size();
+    }
+    return total;
+  };
+}
+
+// Shapes moving around in a polygon: 'moveCount' moves of random shapes, from random positions
+Kernel benchSlideMove(int faceCount, int moveCount, bool indexed)
+{
+  randomSeed(5);
+  auto segments = facesOf(faceCount ? createLargeRandomPolygon2f(faceCount) : createRandomPolygon2f());
+
+  BoundingBox bounds;
+  for(auto& s : segments)
+    bounds.add(s.a);
+
+  std::vector<Vec2> starts(moveCount);
+  std::vector<Vec2> deltas(moveCount);
+  randomFill(starts, bounds.min, bounds.max);
+  randomFill(deltas, {-1, -1}, {1, 1});
+
+  const auto index = std::make_shared<SegmentIndex>();
+  if(indexed)
+    *index = indexSegments(segments);
+
+  return [segments, starts, deltas, index, indexed]() mutable
+  {
+    double total = 0;
+    for(size_t i = 0; i < starts.size(); ++i)
+    {
+      Vec2 pos = starts[i];
+      const Shape shape = i % 2 ? Box : Circle;
+      if(indexed)
+        slideMove(pos, shape, deltas[i], segments, *index);
+      else
+        slideMove(pos, shape, deltas[i], segments);
+      total += pos.x + pos.y;
+    }
+    return total;
+  };
+}
+
+// The polygons depend on the seed only: each repetition generates the same ones
+Kernel benchRandomPolygon(int faceCount)
+{
+  return [faceCount]()
+  {
+    randomSeed(6);
+    if(faceCount)
+      return double(createLargeRandomPolygon2f(faceCount).faces.size());
+
+    double total = 0;
+    for(int k = 0; k < 50; ++k)
+      total += createRandomPolygon2f().faces.size();
+    return total;
+  };
+}
+
+const Benchmark Benchmarks[] = {
+      {"bvh.median", []() { return benchBvh(BvhSplitter::Median); }},
+      {"bvh.sah", []() { return benchBvh(BvhSplitter::BinnedSah); }},
+      {"bvh.morton", []() { return benchBvh(BvhSplitter::Morton); }},
+      {"bsp", benchBsp},
+      {"bowyerwatson", benchBowyerWatson},
+      {"split_polygon", benchSplitPolygon},
+      {"slide_move", []() { return benchSlideMove(0, 20000, false); }},
+      {"slide_move.bvh", []() { return benchSlideMove(5000, 20000, true); }},
+      {"random_polygon", []() { return benchRandomPolygon(0); }},
+      {"random_polygon.large", []() { return benchRandomPolygon(10000); }},
+};
+
+double getSteadyClockUs()
+{
+  using namespace std::chrono;
+  auto elapsedTime = steady_clock::now().time_since_epoch();
+  return duration_cast<nanoseconds>(elapsedTime).count() / 1000.0;
+}
+
+// nearest-rank percentile, 'sorted' must be non-empty
+double percentile(const std::vector<double>& sorted, double ratio)
+{
+  int rank = int(ratio * sorted.size() + 0.999999);
+  rank = std::max(1, std::min(rank, int(sorted.size())));
+  return sorted[rank - 1];
+}
+
+struct Summary
+{
+  std::string name;
+  double minUs = 0;
+  double medianUs = 0;
+  double meanUs = 0;
+  double stddevUs = 0;
+  double maxUs = 0;
+};
+
+volatile double sink;
+
+Summary run(const Benchmark& benchmark, const Options& options)
+{
+  const Kernel kernel = benchmark.prepare();
+
+  for(int k = 0; k < options.warmup; ++k)
+    sink = kernel();
+
+  std::vector<double> timesUs;
+  for(int k = 0; k < options.repetitions; ++k)
+  {
+    const auto t0 = getSteadyClockUs();
+    sink = kernel();
+    timesUs.push_back(getSteadyClockUs() - t0);
+  }
+
+  std::sort(timesUs.begin(), timesUs.end());
+
+  Summary s;
+  s.name = benchmark.name;
+  s.minUs = timesUs.front();
+  s.maxUs = timesUs.back();
+  s.medianUs = percentile(timesUs, 0.5);
+
+  for(auto t : timesUs)
+    s.meanUs += t;
+  s.meanUs /= timesUs.size();
+
+  for(auto t : timesUs)
+    s.stddevUs += (t - s.meanUs) * (t - s.meanUs);
+  s.stddevUs = std::sqrt(s.stddevUs / timesUs.size());
+
+  return s;
+}
+
+// One 'name median_us' per line, '#' starts a comment line
+std::map<std::string, double> loadBaseline(const std::string& path)
+{
+  std::map<std::string, double> medians;
+
+  FILE* fp = fopen(path.c_str(), "r");
+  if(!fp)
+    return medians;
+
+  char line[256];
+  while(fgets(line, sizeof line, fp))
+  {
+    char name[128];
+    double medianUs;
+    if(line[0] != '#' && sscanf(line, "%127s %lf", name, &medianUs) == 2)
+      medians[name] = medianUs;
+  }
+
+  fclose(fp);
+  return medians;
+}
+
+void saveBaseline(const std::string& path, const std::vector<Summary>& summaries)
+{
+  FILE* fp = fopen(path.c_str(), "w");
+  if(!fp)
+    throw std::runtime_error("Can't open '" + path + "' for writing");
+
+  fprintf(fp, "# benchmark median_us\n");
+  for(auto& s : summaries)
+    fprintf(fp, "%s %.3f\n", s.name.c_str(), s.medianUs);
+
+  fclose(fp);
+
+  fprintf(stderr, "Baseline written to '%s'\n", path.c_str());
+}
+
+// Returns the number of regressions
+int safeMain(span<const char*> args)
+{
+  const Options options = parseCommandLine(args);
+
+  for(auto& name : options.names)
+  {
+    auto matches = [&](const Benchmark& b) { return name == b.name; };
+    if(std::none_of(std::begin(Benchmarks), std::end(Benchmarks), matches))
+      throw std::runtime_error("Unknown benchmark: '" + name + "'");
+  }
+
+  std::map<std::string, double> baseline;
+  if(!options.baselinePath.empty())
+  {
+    baseline = loadBaseline(options.baselinePath);
+    if(baseline.empty())
+      fprintf(stderr, "No baseline in '%s': nothing to compare to\n", options.baselinePath.c_str());
+  }
+
+  std::vector<Summary> summaries;
+  int regressionCount = 0;
+
+  printf("%-22s %12s %12s %12s %12s %12s %12s %8s\n", "benchmark", "min_us", "median_us", "mean_us", "stddev_us",
+        "max_us", "baseline_us", "ratio");
+
+  for(auto& benchmark : Benchmarks)
+  {
+    const auto& names = options.names;
+    if(!names.empty() && std::find(names.begin(), names.end(), benchmark.name) == names.end())
+      continue;
+
+    const Summary s = run(benchmark, options);
+    summaries.push_back(s);
+
+    printf("%-22s %12.1f %12.1f %12.1f %12.1f %12.1f", s.name.c_str(), s.minUs, s.medianUs, s.meanUs, s.stddevUs,
+          s.maxUs);
+
+    auto i_base = baseline.find(s.name);
+    if(i_base == baseline.end())
+    {
+      printf(" %12s %8s\n", "-", "-");
+    }
+    else
+    {
+      // the median: a single slow repetition (e.g preempted) doesn't count as a regression
+      const double ratio = s.medianUs / i_base->second;
+      const bool slower = ratio > options.threshold;
+      printf(" %12.1f %8.3f%s\n", i_base->second, ratio, slower ? "  SLOWER" : "");
+      regressionCount += slower;
+    }
+
+    fflush(stdout);
+  }
+
+  if(!options.saveBaselinePath.empty())
+    saveBaseline(options.saveBaselinePath, summaries);
+
+  if(regressionCount)
+    fprintf(stderr, "%d benchmark(s) more than %.2f times slower than the baseline\n", regressionCount,
+          options.threshold);
+
+  return regressionCount;
+}
+}
+
+int main(int argc, const char* argv[])
+{
+  try
+  {
+    return safeMain({(size_t)argc, argv}) ? 1 : 0;
+  }
+  catch(const std::exception& e)
+  {
+    fprintf(stderr, "Fatal: %s\n", e.what());
+    fflush(stderr);
+    return 1;
+  }
+}
@@ -0,0 +1,329 @@
+// Copyright (C) 2022 - Sebastien Alaiwan
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+
+///////////////////////////////////////////////////////////////////////////////
+// Test entry point: checks that the fast kernels give the same results as the reference ones.
+//
+// Usage: GeomSandboxTests.exe [testName...]
+// When no test name is given, every test is run. Fails (exit code 1) when one of them fails.
+
+#include "core/geom.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <stdexcept>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include "collide2d.h"
+#include "convex_decomposition.h"
+#include "random.h"
+#include "random_polygon.h"
+#include "triangulate_bowyerwatson.h"
+#include "triangulate_flip.h"
+#include "voronoi_fortune.h"
+
+namespace
+{
+// Throws when the check fails
+using Test = void (*)();
+
+// 'slideMoves' must move each shape exactly as 'slideMove' does on the same grid:
+// many random segments, so the shapes touch several of them, through several moves
+void testSlideMoves()
+{
+  for(int seed = 1; seed <= 4; ++seed)
+  {
+    randomSeed(seed);
+
+    std::vector<Segment> segments(3000);
+    for(auto& s : segments)
+    {
+      s.a = randomPos({-100, -100}, {100, 100});
+      s.b = s.a + randomPos({-4, -4}, {4, 4});
+    }
+
+    const int agentCount = 4000;
+    std::vector<Vec2> positions(agentCount);
+    std::vector<Shape> shapes(agentCount);
+    randomFill(positions, {-100, -100}, {100, 100});
+    for(int i = 0; i < agentCount; ++i)
+      shapes[i] = i % 2 ? Box : Circle;
+
+    const auto packed = packSegments(segments);
+
+    std::vector<Vec2> expected = positions;
+    std::vector<Vec2> deltas(agentCount);
+
+    for(int move = 0; move < 8; ++move)
+    {
+      randomFill(deltas, {-1, -1}, {1, 1});
+
+      for(int i = 0; i < agentCount; ++i)
+        slideMove(expected[i], shapes[i], deltas[i], segments, packed.grid);
+
+      slideMoves(positions, deltas, shapes, packed, 4);
+
+      for(int i = 0; i < agentCount; ++i)
+      {
+        if(positions[i] == expected[i])
+          continue;
+
+        char msg[256];
+        snprintf(msg, sizeof msg, "seed %d, move %d: %s %d is at (%.9g, %.9g), expected (%.9g, %.9g)", seed, move,
+              shapes[i] == Circle ? "circle" : "box", i, positions[i].x, positions[i].y, expected[i].x, expected[i].y);
+        throw std::runtime_error(msg);
+      }
+    }
+  }
+}
+
+// sorted, each one from its smallest vertex. Duplicate points may be kept under any of their indices:
+// the vertices are replaced by the first index of their position.
+std::vector<std::pair<int, int>> normalizedEdges(const TriangleMesh& mesh, span<const Vec2> points)
+{
+  std::vector<int> sorted(points.len);
+  for(int i = 0; i < (int)points.len; ++i)
+    sorted[i] = i;
+
+  auto key = [&](int i) { return std::make_tuple(points[i].x, points[i].y, i); };
+  std::sort(sorted.begin(), sorted.end(), [&](int i, int j) { return key(i) < key(j); });
+
+  std::vector<int> firstIndex(points.len);
+  for(int k = 0; k < (int)sorted.size(); ++k)
+    firstIndex[sorted[k]] = k > 0 && points[sorted[k]] == points[sorted[k - 1]] ? firstIndex[sorted[k - 1]] : sorted[k];
+
+  std::vector<std::pair<int, int>> r;
+  for(auto e : computeEdges(mesh))
+  {
+    const int a = firstIndex[e.a];
+    const int b = firstIndex[e.b];
+    r.push_back({std::min(a, b), std::max(a, b)});
+  }
+  std::sort(r.begin(), r.end());
+  return r;
+}
+
+int countHullEdges(const TriangleMesh& mesh)
+{
+  int r = 0;
+  for(auto& t : mesh.triangles)
+    r += std::count(std::begin(t.neighbours), std::end(t.neighbours), -1);
+  return r;
+}
+
+void checkSameTriangulation(const char* input, span<const Vec2> points)
+{
+  auto const expected = triangulateMesh_Flip(points);
+  auto const mesh = triangulateMesh_BowyerWatsonFast(points);
+
+  if(normalizedEdges(mesh, points) == normalizedEdges(expected, points))
+    return;
+
+  char msg[256];
+  snprintf(msg, sizeof msg, "%s, %d points: %d triangles and %d hull edges, expected %d and %d", input, (int)points.len,
+        (int)mesh.triangles.size(), countHullEdges(mesh), (int)expected.triangles.size(), countHullEdges(expected));
+  throw std::runtime_error(msg);
+}
+
+// Without cocircular points, the Delaunay triangulation is unique: both must give the same edges,
+// including the ones of the thin triangles along the hull
+void testBowyerWatsonFast()
+{
+  for(int seed = 1; seed <= 20; ++seed)
+  {
+    randomSeed(seed);
+
+    std::vector<Vec2> points(seed * 500);
+    randomFill(points, {-100, -100}, {100, 100});
+    checkSameTriangulation("uniform", points);
+  }
+
+  // nearly collinear: integer points on the X axis (with duplicates), and one point off it
+  for(int n : {3, 10, 200, 5000})
+  {
+    randomSeed(n);
+
+    std::vector<Vec2> points(n);
+    for(auto& p : points)
+      p = Vec2(randomInt(0, n), 0);
+    points[n / 2] = Vec2(0, 5);
+    checkSameTriangulation("near collinear", points);
+  }
+}
+
+// Each piece must be a counter-clockwise convex loop, with the tolerance of the decomposition:
+// no vertex of a piece more than 0.01 outside of the line of the previous face.
+void checkConvexPieces(const char* decomposition, const ConvexDecomposition& d, int seed, bool reversed)
+{
+  for(int piece = 0; piece + 1 < (int)d.pieceStart.size(); ++piece)
+  {
+    const int first = d.pieceStart[piece];
+    const int count = d.pieceStart[piece + 1] - first;
+    for(int i = 0; i < count; ++i)
+    {
+      const Vec2 a = d.vertices[d.indices[first + i]];
+      const Vec2 b = d.vertices[d.indices[first + (i + 1) % count]];
+      const Vec2 c = d.vertices[d.indices[first + (i + 2) % count]];
+      if(magnitude(b - a) == 0)
+        continue;
+
+      const float inside = dotProduct(c - b, rotateLeft(normalize(b - a)));
+      if(inside >= -0.01f)
+        continue;
+
+      char msg[256];
+      snprintf(msg, sizeof msg, "%s, seed %d%s: piece %d (%d vertices) is reflex at (%g, %g), by %g", decomposition,
+            seed, reversed ? " (reversed)" : "", piece, count, b.x, b.y, -inside);
+      throw std::runtime_error(msg);
+    }
+  }
+}
+
+// large random polygons, in both orientations
+void testConvexDecomposition()
+{
+  for(int seed : {1, 2, 3, 175})
+  {
+    for(bool reversed : {false, true})
+    {
+      randomSeed(seed);
+      auto polygon = createLargeRandomPolygon2f(seed == 175 ? 1075 : 2000);
+      if(reversed)
+      {
+        for(auto& face : polygon.faces)
+          std::swap(face.a, face.b);
+      }
+
+      checkConvexPieces("split", decomposeToConvex_Split(polygon), seed, reversed);
+      checkConvexPieces("hertel-mehlhorn", decomposeToConvex_HertelMehlhorn(polygon), seed, reversed);
+    }
+  }
+}
+
+// The vertices of each edge must be on the bisector of its sites, and an infinite end must be
+// on the side of the edge direction, away from the finite end (see voronoi_fortune.h)
+void checkVoronoiEdges(const char* input, span<const Vec2> sites)
+{
+  auto const diagram = computeVoronoi_Fortune(sites);
+
+  for(int i = 0; i < (int)diagram.edges.size(); ++i)
+  {
+    auto const& e = diagram.edges[i];
+    const Vec2 s0 = sites[e.sites[0]];
+    const Vec2 s1 = sites[e.sites[1]];
+    const Vec2 direction = rotateLeft(s1 - s0);
+
+    const char* error = nullptr;
+    for(auto v : e.vertices)
+    {
+      if(std::abs(magnitude(v - s0) - magnitude(v - s1)) > 1e-3f * (1 + magnitude(v - s0)))
+        error = "vertex not on the bisector";
+    }
+
+    if(e.finite[0] != e.finite[1] && (e.vertices[1] - e.vertices[0]) * direction <= 0)
+      error = "infinite end on the wrong side";
+
+    if(!error)
+      continue;
+
+    char msg[256];
+    snprintf(msg, sizeof msg, "%s, %d sites: edge %d, from (%g, %g) to (%g, %g): %s", input, (int)sites.len, i,
+          e.vertices[0].x, e.vertices[0].y, e.vertices[1].x, e.vertices[1].y, error);
+    throw std::runtime_error(msg);
+  }
+}
+
+// grids, whose first row is on the sweep line at once, and random sites
+void testVoronoiFortune()
+{
+  for(int size : {2, 3, 10, 40})
+  {
+    std::vector<Vec2> sites;
+    for(int y = 0; y < size; ++y)
+      for(int x = 0; x < size + 1; ++x)
+        sites.push_back(Vec2(x * 2, y * 1.5f + (x % 2) * 0.1f));
+
+    checkVoronoiEdges("grid", sites);
+  }
+
+  for(int seed = 1; seed <= 4; ++seed)
+  {
+    randomSeed(seed);
+
+    std::vector<Vec2> sites(1000 * seed);
+    randomFill(sites, {-100, -100}, {100, 100});
+    checkVoronoiEdges("uniform", sites);
+  }
+}
+
+struct NamedTest
+{
+  const char* name;
+  Test run;
+};
+
+const NamedTest Tests[] = {
+      {"slide_moves", testSlideMoves},
+      {"bowyerwatson_fast", testBowyerWatsonFast},
+      {"convex_decomposition", testConvexDecomposition},
+      {"voronoi_fortune", testVoronoiFortune},
+};
+
+int safeMain(span<const char*> args)
+{
+  std::vector<std::string> names(args.ptr + 1, args.ptr + args.len);
+
+  for(auto& name : names)
+  {
+    bool found = false;
+    for(auto& test : Tests)
+      found = found || name == test.name;
+    if(!found)
+      throw std::runtime_error("Unknown test: '" + name + "'");
+  }
+
+  int failures = 0;
+  for(auto& test : Tests)
+  {
+    bool selected = names.empty();
+    for(auto& name : names)
+      selected = selected || name == test.name;
+    if(!selected)
+      continue;
+
+    try
+    {
+      test.run();
+      printf("%-30s ok\n", test.name);
+    }
+    catch(const std::exception& e)
+    {
+      printf("%-30s FAILED: %s\n", test.name, e.what());
+      failures++;
+    }
+    fflush(stdout);
+  }
+
+  return failures;
+}
+}
+
+int main(int argc, const char* argv[])
+{
+  try
+  {
+    return safeMain({(size_t)argc, argv}) ? 1 : 0;
+  }
+  catch(const std::exception& e)
+  {
+    fprintf(stderr, "Fatal: %s\n", e.what());
+    fflush(stderr);
+    return 1;
+  }
+}
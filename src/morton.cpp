@@ -0,0 +1,98 @@
+#include "morton.h"
+
+#include "core/arena.h"
+
+#include <algorithm>
+#include <array>
+
+#include "bounding_box.h"
+#include "parallel.h"
+
+void computeMortonCodes(span<const Vec2> points, span<uint32_t> codes, int threadCount)
+{
+  BoundingBox bounds;
+  for(auto& p : points)
+    bounds.add(p);
+
+  const Vec2 size = bounds.max - bounds.min;
+  const float scaleX = size.x > 0 ? 65535.0f / size.x : 0;
+  const float scaleY = size.y > 0 ? 65535.0f / size.y : 0;
+
+  const int n = points.len;
+  const int chunkSize = 4096;
+  parallelFor((n + chunkSize - 1) / chunkSize, threadCount,
+        [&](int chunk)
+        {
+          for(int i = chunk * chunkSize; i < std::min(n, (chunk + 1) * chunkSize); ++i)
+          {
+            const Vec2 pos = points[i] - bounds.min;
+            codes[i] = mortonCode(uint32_t(pos.x * scaleX), uint32_t(pos.y * scaleY));
+          }
+        });
+}
+
+// LSD radix sort, 8 bits per pass.
+// Each pass counts, then scatters, the chunks of the array in parallel.
+void sortByMortonCode(span<int> order, span<const uint32_t> codes, int threadCount)
+{
+  const int n = order.len;
+
+  ScratchVector<uint32_t> keys(n);
+  ScratchVector<uint32_t> tmpKeys(n);
+  ScratchVector<int> tmpOrder(n);
+
+  for(int i = 0; i < n; ++i)
+    keys[i] = codes[order[i]];
+
+  const int chunkCount = std::max(1, std::min(threadCount, n / 4096));
+  const int chunkSize = (n + chunkCount - 1) / chunkCount;
+  ScratchVector<std::array<int, 256>> offsets(chunkCount);
+
+  uint32_t* srcKeys = keys.data();
+  uint32_t* dstKeys = tmpKeys.data();
+  int* srcOrder = order.ptr;
+  int* dstOrder = tmpOrder.data();
+
+  for(int shift = 0; shift < 32; shift += 8)
+  {
+    parallelFor(chunkCount, threadCount,
+          [&](int chunk)
+          {
+            auto& histogram = offsets[chunk];
+            histogram.fill(0);
+
+            for(int i = chunk * chunkSize; i < std::min(n, (chunk + 1) * chunkSize); ++i)
+              histogram[(srcKeys[i] >> shift) & 0xFF]++;
+          });
+
+    // each chunk writes its elements of a given digit after those of the previous chunks
+    int offset = 0;
+    for(int digit = 0; digit < 256; ++digit)
+    {
+      for(auto& histogram : offsets)
+      {
+        const int count = histogram[digit];
+        histogram[digit] = offset;
+        offset += count;
+      }
+    }
+
+    parallelFor(chunkCount, threadCount,
+          [&](int chunk)
+          {
+            auto& offset = offsets[chunk];
+
+            for(int i = chunk * chunkSize; i < std::min(n, (chunk + 1) * chunkSize); ++i)
+            {
+              const int pos = offset[(srcKeys[i] >> shift) & 0xFF]++;
+              dstKeys[pos] = srcKeys[i];
+              dstOrder[pos] = srcOrder[i];
+            }
+          });
+
+    std::swap(srcKeys, dstKeys);
+    std::swap(srcOrder, dstOrder);
+  }
+
+  // (an even number of passes: the result is back in 'order')
+}
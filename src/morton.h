@@ -0,0 +1,30 @@
+#pragma once
+
+// Morton codes (Z-order curve): sorting 2D points by their code keeps points
+// which are close to each other mostly close in the sorted order.
+
+#include "core/geom.h"
+
+#include <cstdint>
+
+// x in the even bits, y in the odd bits (16 bits each)
+inline uint32_t mortonCode(uint32_t x, uint32_t y)
+{
+  auto spreadBits = [](uint32_t v)
+  {
+    v &= 0xFFFF;
+    v = (v | (v << 8)) & 0x00FF00FF;
+    v = (v | (v << 4)) & 0x0F0F0F0F;
+    v = (v | (v << 2)) & 0x33333333;
+    v = (v | (v << 1)) & 0x55555555;
+    return v;
+  };
+
+  return spreadBits(x) | (spreadBits(y) << 1);
+}
+
+// Codes of 'points', quantized on 16 bits per axis over their bounding box.
+void computeMortonCodes(span<const Vec2> points, span<uint32_t> codes, int threadCount = 1);
+
+// Stable sort of the indices in 'order', by their code: 'codes[order[i]]'.
+void sortByMortonCode(span<int> order, span<const uint32_t> codes, int threadCount = 1);
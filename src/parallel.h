@@ -0,0 +1,56 @@
+#pragma once
+
+// Minimal fork-join helper, for algorithms made of independent tasks.
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+// 0 (or less) means one thread per hardware thread
+inline int resolveThreadCount(int threadCount)
+{
+  if(threadCount <= 0)
+    threadCount = std::max(1, int(std::thread::hardware_concurrency()));
+
+  return threadCount;
+}
+
+// Calls 'task(i)' for each i in [0; taskCount[, from 'threadCount' threads.
+// With a single thread, the tasks are run in order by the calling thread.
+// Otherwise, the calling thread only waits: the tasks can't use its thread-local
+// state (scratch arena, visualizer, zone recorder), and must not touch shared data
+// without synchronization.
+template<typename Task>
+void parallelFor(int taskCount, int threadCount, Task&& task)
+{
+  threadCount = std::min(resolveThreadCount(threadCount), taskCount);
+
+  if(threadCount <= 1)
+  {
+    for(int i = 0; i < taskCount; ++i)
+      task(i);
+    return;
+  }
+
+  std::atomic<int> nextTask{0};
+
+  auto worker = [&]()
+  {
+    while(true)
+    {
+      const int i = nextTask++;
+      if(i >= taskCount)
+        break;
+
+      task(i);
+    }
+  };
+
+  std::vector<std::thread> workers;
+  for(int i = 0; i < threadCount; ++i)
+    workers.emplace_back(worker);
+
+  for(auto& w : workers)
+    w.join();
+}
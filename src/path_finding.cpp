@@ -0,0 +1,488 @@
+#include "path_finding.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring> // memcpy
+#include <vector>
+
+#include "parallel.h"
+
+namespace
+{
+const float Sqrt2 = 1.41421356f;
+
+bool isLess(const PathScratch::Candidate& a, const PathScratch::Candidate& b) { return a.f < b.f; }
+
+float estimate(PathHeuristic heuristic, Vec2 a, Vec2 b)
+{
+  switch(heuristic)
+  {
+  case PathHeuristic::Euclidean:
+    return magnitude(a - b);
+  case PathHeuristic::Manhattan:
+    return fabs(a.x - b.x) + fabs(a.y - b.y);
+  case PathHeuristic::None:
+    break;
+  }
+  return 0;
+}
+
+// Shortest 8-direction distance
+float octile(int x0, int y0, int x1, int y1)
+{
+  const int dx = abs(x1 - x0);
+  const int dy = abs(y1 - y0);
+  return float(std::max(dx, dy) - std::min(dx, dy)) + Sqrt2 * std::min(dx, dy);
+}
+
+int sign(int v) { return (v > 0) - (v < 0); }
+
+// position of the highest set bit, plus one (0 for 0)
+int bitLength(uint32_t v)
+{
+  int n = 0;
+  for(int shift = 16; shift > 0; shift /= 2)
+  {
+    if(v >> shift)
+    {
+      v >>= shift;
+      n += shift;
+    }
+  }
+  return n + int(v);
+}
+
+// for non-negative floats, in the same order
+uint32_t toKey(float cost)
+{
+  uint32_t key;
+  memcpy(&key, &cost, sizeof key);
+  return key;
+}
+
+struct JumpGrid
+{
+  const BitGrid& walls;
+  const GridCell goal;
+
+  bool isFree(int x, int y) const { return walls.contains(x, y) && !walls.get(x, y); }
+  bool isGoal(int x, int y) const { return x == goal.x && y == goal.y; }
+
+  // From (x, y), going straight (dx, dy): the first cell where the path could turn, if any
+  bool jumpStraight(int x, int y, int dx, int dy, GridCell& jump) const
+  {
+    while(isFree(x, y))
+    {
+      // a wall behind a side cell ends: that side cell can't be reached any shorter than from here
+      const bool forced = dx != 0 ? (isFree(x, y - 1) && !isFree(x - dx, y - 1)) || (isFree(x, y + 1) && !isFree(x - dx, y + 1))
+                                  : (isFree(x - 1, y) && !isFree(x - 1, y - dy)) || (isFree(x + 1, y) && !isFree(x + 1, y - dy));
+      if(isGoal(x, y) || forced)
+      {
+        jump = {x, y};
+        return true;
+      }
+
+      x += dx;
+      y += dy;
+    }
+
+    return false;
+  }
+
+  bool jumpDiagonal(int x, int y, int dx, int dy, GridCell& jump) const
+  {
+    GridCell unused;
+    while(isFree(x, y))
+    {
+      if(isGoal(x, y) || jumpStraight(x + dx, y, dx, 0, unused) || jumpStraight(x, y + dy, 0, dy, unused))
+      {
+        jump = {x, y};
+        return true;
+      }
+
+      // no cutting corners
+      if(!isFree(x + dx, y) || !isFree(x, y + dy))
+        return false;
+
+      x += dx;
+      y += dy;
+    }
+
+    return false;
+  }
+
+  bool jumpFrom(int x, int y, int dx, int dy, GridCell& jump) const
+  {
+    if(dx != 0 && dy != 0)
+      return jumpDiagonal(x + dx, y + dy, dx, dy, jump);
+    return jumpStraight(x + dx, y + dy, dx, dy, jump);
+  }
+
+  // The directions worth following from (x, y), reached going (dx, dy) (0, 0 for the start)
+  int directions(int x, int y, int dx, int dy, int (*out)[2]) const
+  {
+    int count = 0;
+    auto add = [&](int ddx, int ddy)
+    {
+      out[count][0] = ddx;
+      out[count][1] = ddy;
+      ++count;
+    };
+
+    if(dx == 0 && dy == 0)
+    {
+      for(int ddy = -1; ddy <= 1; ++ddy)
+      {
+        for(int ddx = -1; ddx <= 1; ++ddx)
+        {
+          if((ddx || ddy) && isFree(x + ddx, y + ddy) && isFree(x + ddx, y) && isFree(x, y + ddy))
+            add(ddx, ddy);
+        }
+      }
+    }
+    else if(dx != 0 && dy != 0)
+    {
+      const bool freeX = isFree(x + dx, y);
+      const bool freeY = isFree(x, y + dy);
+      if(freeY)
+        add(0, dy);
+      if(freeX)
+        add(dx, 0);
+      if(freeX && freeY && isFree(x + dx, y + dy))
+        add(dx, dy);
+    }
+    else
+    {
+      // the sides are always tried: going around a corner needs the straight move first
+      const int sideX = dy, sideY = dx; // a side of the direction
+      const bool freeNext = isFree(x + dx, y + dy);
+      const bool freeA = isFree(x + sideX, y + sideY);
+      const bool freeB = isFree(x - sideX, y - sideY);
+      if(freeNext)
+      {
+        add(dx, dy);
+        if(freeA && isFree(x + dx + sideX, y + dy + sideY))
+          add(dx + sideX, dy + sideY);
+        if(freeB && isFree(x + dx - sideX, y + dy - sideY))
+          add(dx - sideX, dy - sideY);
+      }
+      if(freeA)
+        add(sideX, sideY);
+      if(freeB)
+        add(-sideX, -sideY);
+    }
+
+    return count;
+  }
+};
+}
+
+int PathGraph::addNode(Vec2 pos)
+{
+  positions.push_back(pos);
+  first.push_back(edges.size());
+  return size() - 1;
+}
+
+void PathGraph::addEdge(int from, int to, float cost)
+{
+  edges.push_back({to, cost});
+  first[from + 1] = edges.size();
+}
+
+void RadixHeap::clear()
+{
+  for(auto& bucket : buckets)
+    bucket.clear();
+  last = 0;
+  count = 0;
+}
+
+void RadixHeap::push(uint32_t key, int node)
+{
+  buckets[bitLength(key ^ last)].push_back({key, node});
+  ++count;
+}
+
+RadixHeap::Entry RadixHeap::pop()
+{
+  if(buckets[0].empty())
+  {
+    int i = 1;
+    while(buckets[i].empty())
+      ++i;
+
+    // the smallest key becomes the reference: the others of its bucket now differ from it on lower bits
+    last = buckets[i][0].key;
+    for(auto& entry : buckets[i])
+      last = std::min(last, entry.key);
+
+    for(auto& entry : buckets[i])
+      buckets[bitLength(entry.key ^ last)].push_back(entry);
+    buckets[i].clear();
+  }
+
+  const Entry r = buckets[0].back();
+  buckets[0].pop_back();
+  --count;
+  return r;
+}
+
+void PathScratch::begin(int nodeCount)
+{
+  if((int)cost.size() < nodeCount)
+  {
+    cost.resize(nodeCount);
+    provenance.resize(nodeCount);
+    reached.resize(nodeCount, 0);
+    closed.resize(nodeCount, 0);
+    target.resize(nodeCount, 0);
+  }
+
+  // the marks would be ambiguous once the counter wraps around
+  if(++search == 0)
+  {
+    std::fill(reached.begin(), reached.end(), 0);
+    std::fill(closed.begin(), closed.end(), 0);
+    std::fill(target.begin(), target.end(), 0);
+    search = 1;
+  }
+
+  heap.clear();
+  radix.clear();
+  expandedCount = 0;
+}
+
+void PathScratch::push(int node, float f)
+{
+  heap.push_back({f, node});
+  std::push_heap(heap.begin(), heap.end(), [](const Candidate& a, const Candidate& b) { return isLess(b, a); });
+}
+
+PathScratch::Candidate PathScratch::pop()
+{
+  std::pop_heap(heap.begin(), heap.end(), [](const Candidate& a, const Candidate& b) { return isLess(b, a); });
+  const Candidate r = heap.back();
+  heap.pop_back();
+  return r;
+}
+
+bool findPath(const PathGraph& graph, int start, int goal, PathHeuristic heuristic, PathScratch& scratch,
+      std::vector<int>& path)
+{
+  path.clear();
+  scratch.begin(graph.size());
+
+  const Vec2 goalPos = graph.positions[goal];
+  scratch.cost[start] = 0;
+  scratch.provenance[start] = start;
+  scratch.reached[start] = scratch.search;
+  scratch.push(start, estimate(heuristic, graph.positions[start], goalPos));
+
+  while(scratch.heap.size())
+  {
+    const int node = scratch.pop().node;
+    if(scratch.closed[node] == scratch.search)
+      continue; // outdated
+
+    scratch.closed[node] = scratch.search;
+    ++scratch.expandedCount;
+    if(node == goal)
+      break;
+
+    for(int i = graph.first[node]; i < graph.first[node + 1]; ++i)
+    {
+      const auto& edge = graph.edges[i];
+      const float cost = scratch.cost[node] + edge.cost;
+      if(scratch.reached[edge.to] == scratch.search && scratch.cost[edge.to] <= cost)
+        continue;
+
+      scratch.reached[edge.to] = scratch.search;
+      scratch.cost[edge.to] = cost;
+      scratch.provenance[edge.to] = node;
+      scratch.push(edge.to, cost + estimate(heuristic, graph.positions[edge.to], goalPos));
+    }
+  }
+
+  if(scratch.closed[goal] != scratch.search)
+    return false;
+
+  for(int node = goal; node != start; node = scratch.provenance[node])
+    path.push_back(node);
+  path.push_back(start);
+  std::reverse(path.begin(), path.end());
+  return true;
+}
+
+void findShortestPaths(const PathGraph& graph, span<const int> sources, span<const int> targets, PathScratch& scratch)
+{
+  scratch.begin(graph.size());
+
+  int remainingTargets = 0;
+  for(int node : targets)
+  {
+    if(scratch.target[node] != scratch.search)
+    {
+      scratch.target[node] = scratch.search;
+      ++remainingTargets;
+    }
+  }
+
+  for(int node : sources)
+  {
+    scratch.cost[node] = 0;
+    scratch.provenance[node] = node;
+    scratch.reached[node] = scratch.search;
+    scratch.radix.push(0, node);
+  }
+
+  while(!scratch.radix.empty())
+  {
+    const int node = scratch.radix.pop().node;
+    if(scratch.closed[node] == scratch.search)
+      continue; // outdated
+
+    scratch.closed[node] = scratch.search;
+    ++scratch.expandedCount;
+
+    if(scratch.target[node] == scratch.search && --remainingTargets == 0)
+      break;
+
+    for(int i = graph.first[node]; i < graph.first[node + 1]; ++i)
+    {
+      const auto& edge = graph.edges[i];
+      const float cost = scratch.cost[node] + edge.cost;
+      if(scratch.reached[edge.to] == scratch.search && scratch.cost[edge.to] <= cost)
+        continue;
+
+      scratch.reached[edge.to] = scratch.search;
+      scratch.cost[edge.to] = cost;
+      scratch.provenance[edge.to] = node;
+      scratch.radix.push(toKey(cost), edge.to);
+    }
+  }
+}
+
+bool extractPath(const PathScratch& scratch, int node, std::vector<int>& path)
+{
+  path.clear();
+  if(!scratch.isReached(node))
+    return false;
+
+  while(scratch.provenance[node] != node)
+  {
+    path.push_back(node);
+    node = scratch.provenance[node];
+  }
+  path.push_back(node);
+  std::reverse(path.begin(), path.end());
+  return true;
+}
+
+void computeCostTable(const PathGraph& graph, span<const int> sources, span<const int> targets, int threadCount,
+      std::vector<float>& costs)
+{
+  const int sourceCount = sources.len;
+  const int targetCount = targets.len;
+  costs.resize(size_t(sourceCount) * targetCount);
+
+  // one scratch per thread, each one taking an equal share of the sources
+  threadCount = std::max(1, std::min(resolveThreadCount(threadCount), sourceCount));
+  parallelFor(threadCount, threadCount,
+        [&](int thread)
+        {
+          PathScratch scratch;
+          for(int i = thread; i < sourceCount; i += threadCount)
+          {
+            findShortestPaths(graph, {1, &sources[i]}, targets, scratch);
+
+            for(int j = 0; j < targetCount; ++j)
+            {
+              const int node = targets[j];
+              costs[size_t(i) * targetCount + j] = scratch.isReached(node) ? scratch.cost[node] : 1.0 / 0.0;
+            }
+          }
+        });
+}
+
+bool findGridPath(const BitGrid& walls, GridCell start, GridCell goal, PathScratch& scratch,
+      std::vector<GridCell>& path)
+{
+  path.clear();
+
+  const JumpGrid grid{walls, goal};
+  if(!grid.isFree(start.x, start.y) || !grid.isFree(goal.x, goal.y))
+    return false;
+
+  const int width = walls.width;
+  scratch.begin(width * walls.height);
+
+  auto index = [&](int x, int y) { return y * width + x; };
+  const int startNode = index(start.x, start.y);
+  const int goalNode = index(goal.x, goal.y);
+
+  scratch.cost[startNode] = 0;
+  scratch.provenance[startNode] = startNode;
+  scratch.reached[startNode] = scratch.search;
+  scratch.push(startNode, octile(start.x, start.y, goal.x, goal.y));
+
+  while(scratch.heap.size())
+  {
+    const int node = scratch.pop().node;
+    if(scratch.closed[node] == scratch.search)
+      continue;
+
+    scratch.closed[node] = scratch.search;
+    ++scratch.expandedCount;
+    if(node == goalNode)
+      break;
+
+    const int x = node % width;
+    const int y = node / width;
+    const int parent = scratch.provenance[node];
+    const int dx = sign(x - parent % width);
+    const int dy = sign(y - parent / width);
+
+    int directions[8][2];
+    const int count = grid.directions(x, y, dx, dy, directions);
+    for(int i = 0; i < count; ++i)
+    {
+      GridCell jump;
+      if(!grid.jumpFrom(x, y, directions[i][0], directions[i][1], jump))
+        continue;
+
+      const int next = index(jump.x, jump.y);
+      const float cost = scratch.cost[node] + octile(x, y, jump.x, jump.y);
+      if(scratch.reached[next] == scratch.search && scratch.cost[next] <= cost)
+        continue;
+
+      scratch.reached[next] = scratch.search;
+      scratch.cost[next] = cost;
+      scratch.provenance[next] = node;
+      scratch.push(next, cost + octile(jump.x, jump.y, goal.x, goal.y));
+    }
+  }
+
+  if(scratch.closed[goalNode] != scratch.search)
+    return false;
+
+  // the jump points are on straight lines or diagonals of each other
+  for(int node = goalNode; node != startNode; node = scratch.provenance[node])
+  {
+    const int parent = scratch.provenance[node];
+    int x = node % width;
+    int y = node / width;
+    const int dx = sign(parent % width - x);
+    const int dy = sign(parent / width - y);
+    while(index(x, y) != parent)
+    {
+      path.push_back({x, y});
+      x += dx;
+      y += dy;
+    }
+  }
+  path.push_back(start);
+  std::reverse(path.begin(), path.end());
+  return true;
+}
@@ -0,0 +1,118 @@
+#pragma once
+
+// Shortest paths: A* and Dijkstra on graphs, A* on uniform grids (e.g navigation, road networks).
+
+#include "core/geom.h"
+
+#include <cstdint>
+#include <vector>
+
+#include "bit_grid.h"
+
+// The neighbours of the node i are edges[first[i]] ... edges[first[i + 1] - 1]
+struct PathGraph
+{
+  struct Edge
+  {
+    int to;
+    float cost;
+  };
+
+  std::vector<Vec2> positions; // for the heuristic
+  std::vector<int> first = {0};
+  std::vector<Edge> edges;
+
+  int size() const { return int(positions.size()); }
+
+  // The edges must be added node after node
+  int addNode(Vec2 pos);
+  void addEdge(int from, int to, float cost);
+};
+
+enum class PathHeuristic
+{
+  Euclidean,
+  Manhattan,
+  None, // Dijkstra
+};
+
+// Min-priority queue for keys which never go below the last one popped (as costs, in Dijkstra).
+// Bucket i holds the keys whose highest bit differing from the last key popped is i - 1:
+// each key is only moved to a lower bucket, at most 32 times.
+struct RadixHeap
+{
+  struct Entry
+  {
+    uint32_t key;
+    int node;
+  };
+
+  std::vector<Entry> buckets[33];
+  uint32_t last = 0;
+  int count = 0;
+
+  bool empty() const { return count == 0; }
+  void clear();
+  void push(uint32_t key, int node);
+  Entry pop();
+};
+
+// State of the searches, kept from one query to the next: nothing is allocated once it's big enough.
+// The arrays aren't cleared either: a node only counts as reached (resp. closed) if its mark is the
+// number of the current search.
+struct PathScratch
+{
+  struct Candidate
+  {
+    float f; // cost from the start + heuristic, computed once when pushed
+    int node;
+  };
+
+  std::vector<float> cost;
+  std::vector<int> provenance;
+  std::vector<uint32_t> reached;
+  std::vector<uint32_t> closed;
+  std::vector<Candidate> heap; // binary min-heap, by increasing f
+  RadixHeap radix; // Dijkstra
+  std::vector<uint32_t> target; // Dijkstra: the node is a target of the current search
+  uint32_t search = 0;
+  int expandedCount = 0; // nodes taken out of the heap by the last search, for statistics
+
+  bool isReached(int node) const { return reached[node] == search; }
+
+  void begin(int nodeCount);
+  void push(int node, float f);
+  Candidate pop();
+};
+
+// Cheapest path from 'start' to 'goal', from 'start' to 'goal' included. Returns false if there's none.
+// The heuristic must not overestimate the costs (e.g no edge cheaper than the distance it covers, for Euclidean).
+// A node can be pushed again when a cheaper way is found: the outdated entries are skipped when popped.
+bool findPath(const PathGraph& graph, int start, int goal, PathHeuristic heuristic, PathScratch& scratch,
+      std::vector<int>& path);
+
+// Dijkstra from all the 'sources' at once: each node gets the cost from the nearest one.
+// With 'targets', the search stops as soon as all of them are settled (one-to-many); without, it covers the graph.
+// Then, scratch.cost and scratch.provenance are final for the targets (resp. all the nodes) reached (see isReached).
+// The costs must be non-negative: their float bits then keep their order as integers, for a radix heap.
+void findShortestPaths(const PathGraph& graph, span<const int> sources, span<const int> targets, PathScratch& scratch);
+
+// The path from the source to 'node', as found by the last findShortestPaths. Returns false if 'node' wasn't reached.
+bool extractPath(const PathScratch& scratch, int node, std::vector<int>& path);
+
+// Searches from each source, in parallel (each thread with its own scratch):
+// costs[i * targets.len + j] is the cost from sources[i] to targets[j], or +infinity if there's no path.
+void computeCostTable(const PathGraph& graph, span<const int> sources, span<const int> targets, int threadCount,
+      std::vector<float>& costs);
+
+struct GridCell
+{
+  int x, y;
+};
+
+// A* on a grid where the set cells are walls (outside is walls too), moving in 8 directions:
+// 1 straight, sqrt(2) diagonally, never between two walls touching by a corner, nor along a wall's corner.
+// Jump Point Search: straight runs and diagonals are skipped over until something can branch,
+// so only a few cells go through the heap. 'path' gets every cell of the path.
+bool findGridPath(const BitGrid& walls, GridCell start, GridCell goal, PathScratch& scratch,
+      std::vector<GridCell>& path);
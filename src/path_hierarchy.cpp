@@ -0,0 +1,360 @@
+#include "path_hierarchy.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <vector>
+
+#include "parallel.h"
+
+namespace
+{
+const float Sqrt2 = 1.41421356f;
+
+// runs shorter than this get a single entrance, in their middle
+const int LongEntrance = 6;
+
+bool isFree(const BitGrid& walls, int x, int y) { return walls.contains(x, y) && !walls.get(x, y); }
+
+float octile(GridCell a, GridCell b)
+{
+  const int dx = abs(b.x - a.x);
+  const int dy = abs(b.y - a.y);
+  return float(std::max(dx, dy) - std::min(dx, dy)) + Sqrt2 * std::min(dx, dy);
+}
+
+bool inside(const PathHierarchy::Cluster& cluster, int x, int y)
+{
+  return x >= cluster.x0 && y >= cluster.y0 && x < cluster.x0 + cluster.width && y < cluster.y0 + cluster.height;
+}
+
+int localIndex(const PathHierarchy::Cluster& cluster, GridCell cell)
+{
+  return (cell.y - cluster.y0) * cluster.width + (cell.x - cluster.x0);
+}
+
+// Dijkstra from 'from', without leaving the cluster, and stopping at 'to' if given.
+// The scratch is indexed by localIndex.
+void searchCluster(const BitGrid& walls, const PathHierarchy::Cluster& cluster, GridCell from, PathScratch& scratch,
+      const GridCell* to = nullptr)
+{
+  const int target = to ? localIndex(cluster, *to) : -1;
+
+  scratch.begin(cluster.width * cluster.height);
+
+  const int source = localIndex(cluster, from);
+  scratch.cost[source] = 0;
+  scratch.provenance[source] = source;
+  scratch.reached[source] = scratch.search;
+  scratch.push(source, 0);
+
+  while(scratch.heap.size())
+  {
+    const int node = scratch.pop().node;
+    if(scratch.closed[node] == scratch.search)
+      continue;
+    scratch.closed[node] = scratch.search;
+    if(node == target)
+      break;
+
+    const int x = cluster.x0 + node % cluster.width;
+    const int y = cluster.y0 + node / cluster.width;
+    for(int dy = -1; dy <= 1; ++dy)
+    {
+      for(int dx = -1; dx <= 1; ++dx)
+      {
+        if(!(dx || dy) || !inside(cluster, x + dx, y + dy) || !isFree(walls, x + dx, y + dy))
+          continue;
+        if(!isFree(walls, x + dx, y) || !isFree(walls, x, y + dy))
+          continue; // no cutting corners
+
+        const int next = localIndex(cluster, {x + dx, y + dy});
+        const float cost = scratch.cost[node] + (dx && dy ? Sqrt2 : 1.0f);
+        if(scratch.reached[next] == scratch.search && scratch.cost[next] <= cost)
+          continue;
+
+        scratch.reached[next] = scratch.search;
+        scratch.cost[next] = cost;
+        scratch.provenance[next] = node;
+        scratch.push(next, cost);
+      }
+    }
+  }
+}
+
+float costTo(const PathHierarchy::Cluster& cluster, const PathScratch& scratch, GridCell cell)
+{
+  const int i = localIndex(cluster, cell);
+  return scratch.reached[i] == scratch.search ? scratch.cost[i] : 1.0 / 0.0;
+}
+
+// Appends the cells after 'from' up to 'to', found by the last searchCluster (from 'from')
+void appendClusterPath(const PathHierarchy::Cluster& cluster, const PathScratch& scratch, GridCell to,
+      std::vector<GridCell>& path)
+{
+  const size_t first = path.size();
+  for(int i = localIndex(cluster, to); scratch.provenance[i] != i; i = scratch.provenance[i])
+    path.push_back({cluster.x0 + i % cluster.width, cluster.y0 + i / cluster.width});
+  std::reverse(path.begin() + first, path.end());
+}
+}
+
+void PathHierarchy::build(const BitGrid& walls, int clusterSize_, int threadCount)
+{
+  clusterSize = clusterSize_;
+  clustersX = (walls.width + clusterSize - 1) / clusterSize;
+  clustersY = (walls.height + clusterSize - 1) / clusterSize;
+
+  clusters.assign(clustersX * clustersY, {});
+  for(int cy = 0; cy < clustersY; ++cy)
+  {
+    for(int cx = 0; cx < clustersX; ++cx)
+    {
+      auto& cluster = clusters[cy * clustersX + cx];
+      cluster.x0 = cx * clusterSize;
+      cluster.y0 = cy * clusterSize;
+      cluster.width = std::min(clusterSize, walls.width - cluster.x0);
+      cluster.height = std::min(clusterSize, walls.height - cluster.y0);
+    }
+  }
+
+  nodeAt.assign(size_t(walls.width) * walls.height, -1);
+
+  // each cluster only writes its own cells of 'nodeAt'
+  threadCount = std::max(1, std::min(resolveThreadCount(threadCount), (int)clusters.size()));
+  parallelFor(threadCount, threadCount,
+        [&](int thread)
+        {
+          PathScratch scratch;
+          for(int i = thread; i < (int)clusters.size(); i += threadCount)
+            rebuildCluster(walls, i, scratch);
+        });
+}
+
+void PathHierarchy::update(const BitGrid& walls, int x0, int y0, int x1, int y1)
+{
+  const int cx0 = std::max(0, x0 / clusterSize - 1);
+  const int cy0 = std::max(0, y0 / clusterSize - 1);
+  const int cx1 = std::min(clustersX - 1, x1 / clusterSize + 1);
+  const int cy1 = std::min(clustersY - 1, y1 / clusterSize + 1);
+
+  PathScratch scratch;
+  for(int cy = cy0; cy <= cy1; ++cy)
+  {
+    for(int cx = cx0; cx <= cx1; ++cx)
+      rebuildCluster(walls, cy * clustersX + cx, scratch);
+  }
+}
+
+void PathHierarchy::rebuildCluster(const BitGrid& walls, int index, PathScratch& scratch)
+{
+  auto& cluster = clusters[index];
+
+  for(auto& node : cluster.nodes)
+    nodeAt[node.cell.y * walls.width + node.cell.x] = -1;
+  cluster.nodes.clear();
+
+  auto addEntrance = [&](GridCell cell, GridCell partner)
+  {
+    int& i = nodeAt[cell.y * walls.width + cell.x];
+    if(i < 0)
+    {
+      i = cluster.nodes.size();
+      cluster.nodes.push_back({cell, {}, 0});
+    }
+
+    auto& node = cluster.nodes[i];
+    node.partners[node.partnerCount++] = partner;
+  };
+
+  // Each border is walked from its lowest coordinate: both clusters find the same runs, so the same entrances
+  struct Border
+  {
+    GridCell first; // the first cell of the border, inside of this cluster
+    int stepX, stepY; // along the border
+    int outX, outY; // towards the neighbour cluster
+    int length;
+  };
+
+  const int right = cluster.x0 + cluster.width - 1;
+  const int top = cluster.y0 + cluster.height - 1;
+  const Border borders[] = {
+        {{cluster.x0, cluster.y0}, 1, 0, 0, -1, cluster.width},
+        {{cluster.x0, top}, 1, 0, 0, 1, cluster.width},
+        {{cluster.x0, cluster.y0}, 0, 1, -1, 0, cluster.height},
+        {{right, cluster.y0}, 0, 1, 1, 0, cluster.height},
+  };
+
+  for(auto& border : borders)
+  {
+    auto cellAt = [&](int k) { return GridCell{border.first.x + border.stepX * k, border.first.y + border.stepY * k}; };
+    auto isOpen = [&](int k)
+    {
+      const GridCell c = cellAt(k);
+      return isFree(walls, c.x, c.y) && isFree(walls, c.x + border.outX, c.y + border.outY);
+    };
+
+    int k = 0;
+    while(k < border.length)
+    {
+      if(!isOpen(k))
+      {
+        ++k;
+        continue;
+      }
+
+      const int runStart = k;
+      while(k < border.length && isOpen(k))
+        ++k;
+      const int runEnd = k - 1;
+
+      const int entrances[] = {(runStart + runEnd) / 2, runStart, runEnd};
+      const int count = runEnd - runStart + 1 < LongEntrance ? 1 : 2;
+      for(int e = 0; e < count; ++e)
+      {
+        const GridCell c = cellAt(entrances[count == 1 ? 0 : e + 1]);
+        addEntrance(c, {c.x + border.outX, c.y + border.outY});
+      }
+    }
+  }
+
+  const int n = cluster.nodes.size();
+  cluster.costs.resize(n * n);
+  for(int i = 0; i < n; ++i)
+  {
+    searchCluster(walls, cluster, cluster.nodes[i].cell, scratch);
+    for(int j = 0; j < n; ++j)
+      cluster.costs[i * n + j] = costTo(cluster, scratch, cluster.nodes[j].cell);
+  }
+}
+
+bool findHierarchicalPath(const PathHierarchy& hierarchy, const BitGrid& walls, GridCell start, GridCell goal,
+      HierarchyScratch& scratch, std::vector<GridCell>& path)
+{
+  path.clear();
+  if(!isFree(walls, start.x, start.y) || !isFree(walls, goal.x, goal.y))
+    return false;
+
+  const int startCluster = hierarchy.clusterOf(start);
+  const int goalCluster = hierarchy.clusterOf(goal);
+  const auto& startNodes = hierarchy.clusters[startCluster].nodes;
+  const auto& goalNodes = hierarchy.clusters[goalCluster].nodes;
+
+  // connect the start and the goal to the nodes of their clusters (the moves are symmetric)
+  searchCluster(walls, hierarchy.clusters[goalCluster], goal, scratch.local);
+  scratch.goalCosts.resize(goalNodes.size());
+  for(int i = 0; i < (int)goalNodes.size(); ++i)
+    scratch.goalCosts[i] = costTo(hierarchy.clusters[goalCluster], scratch.local, goalNodes[i].cell);
+
+  searchCluster(walls, hierarchy.clusters[startCluster], start, scratch.local);
+  scratch.startCosts.resize(startNodes.size());
+  for(int i = 0; i < (int)startNodes.size(); ++i)
+    scratch.startCosts[i] = costTo(hierarchy.clusters[startCluster], scratch.local, startNodes[i].cell);
+
+  const float inf = 1.0 / 0.0;
+  const float direct = startCluster == goalCluster ? costTo(hierarchy.clusters[startCluster], scratch.local, goal) : inf;
+
+  // A* on the abstract graph
+  const int capacity = hierarchy.capacity();
+  const int startId = int(hierarchy.clusters.size()) * capacity;
+  const int goalId = startId + 1;
+  auto cellOf = [&](int id)
+  {
+    if(id == startId)
+      return start;
+    if(id == goalId)
+      return goal;
+    return hierarchy.clusters[id / capacity].nodes[id % capacity].cell;
+  };
+
+  auto& search = scratch.abstract;
+  search.begin(goalId + 1);
+
+  auto relax = [&](int from, int to, float edgeCost)
+  {
+    const float cost = search.cost[from] + edgeCost;
+    if(edgeCost == inf || (search.reached[to] == search.search && search.cost[to] <= cost))
+      return;
+
+    search.reached[to] = search.search;
+    search.cost[to] = cost;
+    search.provenance[to] = from;
+    search.push(to, cost + octile(cellOf(to), goal));
+  };
+
+  search.cost[startId] = 0;
+  search.provenance[startId] = startId;
+  search.reached[startId] = search.search;
+  search.push(startId, octile(start, goal));
+
+  while(search.heap.size())
+  {
+    const int id = search.pop().node;
+    if(search.closed[id] == search.search)
+      continue;
+    search.closed[id] = search.search;
+    ++search.expandedCount;
+
+    if(id == goalId)
+      break;
+
+    if(id == startId)
+    {
+      for(int i = 0; i < (int)startNodes.size(); ++i)
+        relax(id, startCluster * capacity + i, scratch.startCosts[i]);
+      relax(id, goalId, direct);
+      continue;
+    }
+
+    const int clusterIndex = id / capacity;
+    const auto& cluster = hierarchy.clusters[clusterIndex];
+    const int n = cluster.nodes.size();
+    const int i = id % capacity;
+
+    for(int j = 0; j < n; ++j)
+    {
+      if(j != i)
+        relax(id, clusterIndex * capacity + j, cluster.costs[i * n + j]);
+    }
+
+    const auto& node = cluster.nodes[i];
+    for(int k = 0; k < node.partnerCount; ++k)
+    {
+      const GridCell partner = node.partners[k];
+      const int partnerCluster = hierarchy.clusterOf(partner);
+      relax(id, partnerCluster * capacity + hierarchy.nodeAt[partner.y * walls.width + partner.x], 1);
+    }
+
+    if(clusterIndex == goalCluster)
+      relax(id, goalId, scratch.goalCosts[i]);
+  }
+
+  if(search.closed[goalId] != search.search)
+    return false;
+
+  auto& ids = scratch.abstractPath;
+  ids.clear();
+  for(int id = goalId; id != startId; id = search.provenance[id])
+    ids.push_back(id);
+  ids.push_back(startId);
+  std::reverse(ids.begin(), ids.end());
+
+  // refine: the path inside of each cluster crossed
+  path.push_back(start);
+  for(int k = 1; k < (int)ids.size(); ++k)
+  {
+    const GridCell from = cellOf(ids[k - 1]);
+    const GridCell to = cellOf(ids[k]);
+    const int fromCluster = hierarchy.clusterOf(from);
+    if(fromCluster != hierarchy.clusterOf(to))
+    {
+      path.push_back(to); // through an entrance
+      continue;
+    }
+
+    const auto& cluster = hierarchy.clusters[fromCluster];
+    searchCluster(walls, cluster, from, scratch.local, &to);
+    appendClusterPath(cluster, scratch.local, to, path);
+  }
+
+  return true;
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+// Hierarchical path finding (HPA*) on grids: long queries are answered on a small abstract graph,
+// then refined cluster by cluster. Same moves as findGridPath (see path_finding.h).
+
+#include <vector>
+
+#include "bit_grid.h"
+#include "path_finding.h"
+
+// The grid is cut into square clusters. Where two neighbour clusters have free cells facing each other
+// along their border, the middle of each run (or both ends of long runs) is an entrance: a node on each side.
+// The costs between the nodes of a cluster, staying inside of it, are precomputed.
+struct PathHierarchy
+{
+  struct Node
+  {
+    GridCell cell;
+    GridCell partners[2]; // the nodes facing it in the neighbour clusters (two for a corner cell)
+    int partnerCount = 0;
+  };
+
+  struct Cluster
+  {
+    int x0, y0, width, height;
+    std::vector<Node> nodes;
+    std::vector<float> costs; // costs[i * nodes.size() + j], +infinity if there's no way inside of the cluster
+  };
+
+  int clusterSize = 0;
+  int clustersX = 0;
+  int clustersY = 0;
+  std::vector<Cluster> clusters;
+  std::vector<int> nodeAt; // by cell: its index in the nodes of its cluster, or -1
+
+  // With several threads, the clusters are built in parallel
+  void build(const BitGrid& walls, int clusterSize, int threadCount = 1);
+
+  // The walls changed in [x0; x1] * [y0; y1]: only the clusters it touches, and their neighbours
+  // (whose entrances along the shared borders may have changed), are rebuilt.
+  void update(const BitGrid& walls, int x0, int y0, int x1, int y1);
+
+  int clusterOf(GridCell cell) const { return (cell.y / clusterSize) * clustersX + cell.x / clusterSize; }
+
+  // the number of abstract nodes a cluster can have: its nodes are numbered cluster * capacity + i
+  int capacity() const { return 4 * clusterSize; }
+
+private:
+  void rebuildCluster(const BitGrid& walls, int index, PathScratch& scratch);
+};
+
+// Per query state: one by thread, the hierarchy itself is only read
+struct HierarchyScratch
+{
+  PathScratch local; // inside of a cluster
+  PathScratch abstract;
+  std::vector<float> startCosts; // from the start to the nodes of its cluster
+  std::vector<float> goalCosts;
+  std::vector<int> abstractPath;
+};
+
+// A path from 'start' to 'goal', both included. Returns false if there's none.
+// The path goes through entrances, so it can be a bit longer than the shortest one.
+bool findHierarchicalPath(const PathHierarchy& hierarchy, const BitGrid& walls, GridCell start, GridCell goal,
+      HierarchyScratch& scratch, std::vector<GridCell>& path);
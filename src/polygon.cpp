@@ -0,0 +1,97 @@
+#include "polygon.h"
+
+#include <algorithm>
+#include <vector>
+
+namespace
+{
+void linkRings(PolygonRings& rings)
+{
+  rings.next.resize(rings.size());
+  rings.prev.resize(rings.size());
+  for(int i = 0; i < rings.ringCount(); ++i)
+  {
+    const int start = rings.ringStart[i];
+    const int end = rings.ringStart[i + 1];
+    for(int k = start; k < end; ++k)
+    {
+      rings.next[k] = k + 1 < end ? k + 1 : start;
+      rings.prev[rings.next[k]] = k;
+    }
+  }
+}
+}
+
+double PolygonRings::signedArea() const
+{
+  double doubleArea = 0;
+  for(int i = 0; i < ringCount(); ++i)
+  {
+    const int start = ringStart[i];
+    const int end = ringStart[i + 1];
+    for(int k = start; k < end; ++k)
+    {
+      const Vec2 a = points[k];
+      const Vec2 b = points[k + 1 < end ? k + 1 : start];
+      doubleArea += double(a.x) * b.y - double(a.y) * b.x;
+    }
+  }
+  return doubleArea / 2;
+}
+
+void PolygonRings::reverse()
+{
+  for(int i = 0; i < ringCount(); ++i)
+  {
+    std::reverse(points.begin() + ringStart[i], points.begin() + ringStart[i + 1]);
+    std::reverse(vertexOf.begin() + ringStart[i], vertexOf.begin() + ringStart[i + 1]);
+  }
+
+  linkRings(*this);
+}
+
+void toRings(const Polygon2f& polygon, PolygonRings& rings)
+{
+  rings.points.clear();
+  rings.vertexOf.clear();
+  rings.ringStart.assign(1, 0);
+
+  // 'next' is used by vertex first, then by position
+  auto& next = rings.next;
+  next.assign(polygon.vertices.size(), -1);
+  for(auto& face : polygon.faces)
+    next[face.a] = face.b;
+
+  std::vector<bool> visited(polygon.vertices.size());
+  for(auto& face : polygon.faces)
+  {
+    if(visited[face.a])
+      continue;
+
+    for(int v = face.a; v >= 0 && !visited[v]; v = next[v])
+    {
+      visited[v] = true;
+      rings.vertexOf.push_back(v);
+      rings.points.push_back(polygon.vertices[v]);
+    }
+
+    rings.ringStart.push_back(rings.size());
+  }
+
+  linkRings(rings);
+}
+
+Polygon2f toPolygon(const PolygonRings& rings)
+{
+  Polygon2f r;
+  r.vertices = rings.points;
+  r.faces.reserve(rings.size());
+  for(int i = 0; i < rings.ringCount(); ++i)
+  {
+    const int start = rings.ringStart[i];
+    const int end = rings.ringStart[i + 1];
+    for(int k = start; k < end; ++k)
+      r.faces.push_back({k, k + 1 < end ? k + 1 : start});
+  }
+  return r;
+}
@@ -18,3 +18,33 @@ struct Polygon2f
 
   float faceLength(int faceIdx) const;
 };
+
+// The same polygon as rings: each loop of faces is a range of positions, in the order of the loop,
+// so the neighbours of a vertex are found in O(1) instead of by scanning the faces.
+// The position k holds the vertex vertexOf[k] of the polygon, at points[k]. next[k] and prev[k]
+// are the positions after and before it in its ring (they can be relinked, e.g to clip ears).
+struct PolygonRings
+{
+  std::vector<Vec2> points;
+  std::vector<int> vertexOf;
+  std::vector<int> next;
+  std::vector<int> prev;
+  std::vector<int> ringStart = {0}; // the ring i is at the positions ringStart[i] ... ringStart[i + 1] - 1
+
+  int size() const { return int(points.size()); }
+  int ringCount() const { return int(ringStart.size()) - 1; }
+
+  // Counter-clockwise rings count as positive, clockwise ones (e.g holes) as negative
+  double signedArea() const;
+
+  // Flips the orientation of all the rings, and links them again
+  void reverse();
+};
+
+// The loops of faces of 'polygon', in the order of their first face. A malformed loop (reaching
+// a vertex without any face leaving it) stops there. 'rings' is overwritten.
+void toRings(const Polygon2f& polygon, PolygonRings& rings);
+
+// A face per position, from the position to the next one in its range. The vertices are ordered
+// by position (the vertices of the polygon used by no face are dropped).
+Polygon2f toPolygon(const PolygonRings& rings);
@@ -0,0 +1,259 @@
+#include "portal_visibility.h"
+
+#include <vector>
+
+#include "parallel.h"
+
+namespace
+{
+using Portal = PortalWorld::Portal;
+
+// Keeps the part of [a; b] on the positive side of 'plane'. False if nothing is left.
+bool clipToHalfPlane(const Plane& plane, Vec2& a, Vec2& b)
+{
+  const float distA = dotProduct(plane.normal, a) - plane.dist;
+  const float distB = dotProduct(plane.normal, b) - plane.dist;
+
+  if(distA <= 0 && distB <= 0)
+    return false;
+
+  const Vec2 intersection = a + (b - a) * (distA / (distA - distB));
+  if(distA < 0)
+    a = intersection;
+  else if(distB < 0)
+    b = intersection;
+
+  return true;
+}
+
+// Positive in front of the portal, where it's seen from
+float facing(const Portal& portal, Vec2 pos) { return dotProduct(rotateLeft(portal.b - portal.a), pos - portal.a); }
+
+// Lines through [s0; s1] can cross the portal from the front: a line only grazing it doesn't count
+bool isFacing(const Portal& portal, Vec2 s0, Vec2 s1) { return facing(portal, s0) > 0 || facing(portal, s1) > 0; }
+
+PortalFrustum computeFrustum(Vec2 origin, Vec2 a, Vec2 b)
+{
+  PortalFrustum r;
+  r.a.normal = normalize(rotateLeft(a - origin));
+  r.b.normal = normalize(rotateLeft(b - origin));
+  r.a.dist = dotProduct(r.a.normal, origin);
+  r.b.dist = dotProduct(r.b.normal, origin);
+
+  if(dotProduct(r.a.normal, b) < r.a.dist)
+  {
+    r.a.normal = r.a.normal * -1;
+    r.a.dist = -r.a.dist;
+  }
+
+  if(dotProduct(r.b.normal, a) < r.b.dist)
+  {
+    r.b.normal = r.b.normal * -1;
+    r.b.dist = -r.b.dist;
+  }
+
+  return r;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Potentially visible set
+
+// The lines through an end of [s0; s1] and an end of [p0; p1], with each segment on its own side.
+// A line going through both segments stays on the side of [p0; p1] beyond it: the positive side.
+int findSeparatingPlanes(Vec2 s0, Vec2 s1, Vec2 p0, Vec2 p1, Plane* planes)
+{
+  const Vec2 s[2] = {s0, s1};
+  const Vec2 p[2] = {p0, p1};
+
+  int count = 0;
+  for(int i = 0; i < 2; ++i)
+  {
+    for(int j = 0; j < 2; ++j)
+    {
+      Plane plane;
+      plane.normal = rotateLeft(p[j] - s[i]);
+      plane.dist = dotProduct(plane.normal, s[i]);
+
+      const float otherS = dotProduct(plane.normal, s[1 - i]) - plane.dist;
+      const float otherP = dotProduct(plane.normal, p[1 - j]) - plane.dist;
+      if(otherS * otherP > 0 || (otherS == 0 && otherP == 0))
+        continue; // not separating, or both segments are on the line
+
+      if(otherS > 0 || otherP < 0)
+      {
+        plane.normal = plane.normal * -1;
+        plane.dist = -plane.dist;
+      }
+
+      planes[count++] = plane;
+    }
+  }
+
+  return count;
+}
+
+struct PvsBuilder
+{
+  const PortalWorld& world;
+  uint64_t* row;
+  Vec2 s0, s1; // the portal the lines leave the source cell through
+
+  void mark(int cell) { row[cell / 64] |= uint64_t(1) << (cell % 64); }
+
+  // 'cell' is behind the (clipped) portal [p0; p1], 'depth' portals away from the source cell
+  void markThrough(Vec2 p0, Vec2 p1, int cell, int depth)
+  {
+    if(depth >= MaxPortalDepth)
+      return;
+
+    Plane separators[4];
+    const int separatorCount = findSeparatingPlanes(s0, s1, p0, p1, separators);
+
+    for(auto& portal : world.portalsOf(cell))
+    {
+      if(portal.destCell == cell || !isFacing(portal, s0, s1))
+        continue;
+
+      Vec2 a = portal.a;
+      Vec2 b = portal.b;
+      bool clipped = false;
+      for(int i = 0; i < separatorCount && !clipped; ++i)
+        clipped = !clipToHalfPlane(separators[i], a, b);
+
+      if(clipped)
+        continue;
+
+      mark(portal.destCell);
+      markThrough(a, b, portal.destCell, depth + 1);
+    }
+  }
+
+  void markFrom(int cell)
+  {
+    static_assert(MaxPortalDepth >= 2, "the first two portals are always crossed");
+    mark(cell);
+
+    for(auto& first : world.portalsOf(cell))
+    {
+      if(first.destCell == cell)
+        continue;
+
+      // any line through the first portal and a portal of the next cell facing it leaves the cell
+      mark(first.destCell);
+      s0 = first.a;
+      s1 = first.b;
+
+      for(auto& second : world.portalsOf(first.destCell))
+      {
+        if(second.destCell == first.destCell || !isFacing(second, s0, s1))
+          continue;
+
+        mark(second.destCell);
+        markThrough(second.a, second.b, second.destCell, 2);
+      }
+    }
+  }
+};
+
+///////////////////////////////////////////////////////////////////////////////
+// Runtime query
+
+struct Frame
+{
+  int cell;
+  int portal; // the next one to look through
+  bool bounded; // the first cell sees everything
+  PortalFrustum frustum;
+};
+}
+
+void PortalWorld::addCell(span<const Portal> cellPortals)
+{
+  portals.insert(portals.end(), cellPortals.begin(), cellPortals.end());
+  start.push_back(int(portals.size()));
+}
+
+PotentiallyVisibleSet computePotentiallyVisibleSet(const PortalWorld& world, int threadCount)
+{
+  PotentiallyVisibleSet pvs;
+  pvs.cellCount = world.cellCount();
+  pvs.wordsPerCell = (pvs.cellCount + 63) / 64;
+  pvs.bits.assign(size_t(pvs.cellCount) * pvs.wordsPerCell, 0);
+
+  // each cell only writes its own row
+  parallelFor(pvs.cellCount, threadCount,
+        [&](int cell)
+        {
+          PvsBuilder builder{world, pvs.bits.data() + size_t(cell) * pvs.wordsPerCell, {}, {}};
+          builder.markFrom(cell);
+        });
+
+  return pvs;
+}
+
+int computeVisibleCells(const PortalWorld& world,
+      const PotentiallyVisibleSet* pvs,
+      int fromCell,
+      Vec2 pos,
+      VisibilityScratch& scratch,
+      span<int> cells,
+      std::vector<PortalFrustum>* frustums)
+{
+  auto& seen = scratch.seen;
+  seen.resize((world.cellCount() + 63) / 64);
+
+  int count = 0;
+  auto see = [&](int cell)
+  {
+    uint64_t& word = seen[cell / 64];
+    const uint64_t bit = uint64_t(1) << (cell % 64);
+    if((word & bit) || count == (int)cells.len)
+      return;
+
+    word |= bit;
+    cells[count++] = cell;
+  };
+
+  Frame stack[MaxPortalDepth + 1];
+  stack[0] = {fromCell, 0, false, {}};
+  see(fromCell);
+
+  // a cell is seen again through each path of portals leading to it: each one sees a different part of it
+  int depth = 0;
+  while(depth >= 0)
+  {
+    Frame& frame = stack[depth];
+    const auto portals = world.portalsOf(frame.cell);
+    if(depth == MaxPortalDepth || frame.portal == (int)portals.len)
+    {
+      --depth;
+      continue;
+    }
+
+    const auto& portal = portals[frame.portal++];
+    if(portal.destCell == frame.cell || facing(portal, pos) < 0)
+      continue;
+
+    if(pvs && !pvs->isVisible(fromCell, portal.destCell))
+      continue;
+
+    Vec2 a = portal.a;
+    Vec2 b = portal.b;
+    if(frame.bounded && !(clipToHalfPlane(frame.frustum.a, a, b) && clipToHalfPlane(frame.frustum.b, a, b)))
+      continue;
+
+    Frame& next = stack[depth + 1];
+    next = {portal.destCell, 0, true, computeFrustum(pos, a, b)};
+    if(frustums)
+      frustums->push_back(next.frustum);
+
+    see(portal.destCell);
+    ++depth;
+  }
+
+  // leave the bits clear for the next query
+  for(int i = 0; i < count; ++i)
+    seen[cells[i] / 64] &= ~(uint64_t(1) << (cells[i] % 64));
+
+  return count;
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+// Visibility through a cells-and-portals decomposition: the cells seen from a point,
+// and the cells which can be seen from somewhere in a cell (its 'potentially visible set').
+
+#include "core/geom.h"
+
+#include <cstdint>
+#include <vector>
+
+#include "split_polygon.h" // Plane
+
+// Portals crossed in a row, at most. Deeper cells are never visible.
+const int MaxPortalDepth = 8;
+
+// The portals of all the cells, one cell after the other.
+// A portal from a to b is only seen from its left side (the inside of its cell).
+struct PortalWorld
+{
+  struct Portal
+  {
+    Vec2 a, b;
+    int destCell;
+  };
+
+  std::vector<Portal> portals;
+  std::vector<int> start = {0}; // the portals of the cell i are portals[start[i]] ... portals[start[i + 1] - 1]
+
+  int cellCount() const { return int(start.size()) - 1; }
+  span<const Portal> portalsOf(int cell) const
+  {
+    return {size_t(start[cell + 1] - start[cell]), portals.data() + start[cell]};
+  }
+
+  void addCell(span<const Portal> cellPortals);
+};
+
+// One bit per pair of cells
+struct PotentiallyVisibleSet
+{
+  int cellCount = 0;
+  int wordsPerCell = 0;
+  std::vector<uint64_t> bits;
+
+  bool isVisible(int fromCell, int cell) const
+  {
+    return (bits[size_t(fromCell) * wordsPerCell + cell / 64] >> (cell % 64)) & 1;
+  }
+};
+
+// For each cell, the cells seen through a sequence of portals by a line leaving the cell:
+// the lines through the first portal and the last one are bounded by their two separating lines,
+// which clip the next portal. Walls are ignored: the set is conservative, never missing a cell
+// computeVisibleCells could return. Meant to be done once, the cells are split over 'threadCount'
+// threads (0: one per hardware thread).
+PotentiallyVisibleSet computePotentiallyVisibleSet(const PortalWorld& world, int threadCount = 1);
+
+// The visible part of the plane behind a portal: the positive side of both planes
+struct PortalFrustum
+{
+  Plane a, b;
+};
+
+// Temporary storage of the queries: keeping it from one call to the next avoids all allocations.
+struct VisibilityScratch
+{
+  std::vector<uint64_t> seen; // one bit per cell, all clear between two queries
+};
+
+// Writes to 'cells' the cells visible from 'pos' (in 'fromCell'), each once, 'fromCell' first,
+// and returns how many there are (at most cells.len).
+// Each portal seen is clipped by the frustum it's seen through, which gives the frustum of
+// the next cell: they're on a stack of MaxPortalDepth entries, not on the call stack.
+// With a 'pvs', the portals leading to a cell it says can't be seen from 'fromCell' are skipped.
+// The frustums go to 'frustums', if not null (e.g for display).
+int computeVisibleCells(const PortalWorld& world,
+      const PotentiallyVisibleSet* pvs,
+      int fromCell,
+      Vec2 pos,
+      VisibilityScratch& scratch,
+      span<int> cells,
+      std::vector<PortalFrustum>* frustums = nullptr);
@@ -0,0 +1,224 @@
+#include "predicates.h"
+
+#include <cassert>
+#include <cmath>
+#include <vector>
+
+namespace
+{
+// Floating-point expansions: a number represented exactly as the sum of non-overlapping doubles,
+// sorted by increasing magnitude (J. R. Shewchuk, "Adaptive Precision Floating-Point Arithmetic
+// and Fast Robust Geometric Predicates", 1997).
+// Only used as a fallback, so simplicity is favored over speed.
+using Expansion = std::vector<double>;
+
+const double Epsilon = std::ldexp(1.0, -53);
+const double OrientErrorBound = (3.0 + 16.0 * Epsilon) * Epsilon;
+const double IncircleErrorBound = (10.0 + 96.0 * Epsilon) * Epsilon;
+
+// x + y = a + b exactly, with x = fl(a + b)
+void twoSum(double a, double b, double& x, double& y)
+{
+  x = a + b;
+  const double bVirtual = x - a;
+  const double aVirtual = x - bVirtual;
+  y = (a - aVirtual) + (b - bVirtual);
+}
+
+// x + y = a * b exactly, with x = fl(a * b)
+void twoProduct(double a, double b, double& x, double& y)
+{
+  x = a * b;
+  y = std::fma(a, b, -x);
+}
+
+Expansion grow(const Expansion& e, double b)
+{
+  Expansion r;
+  r.reserve(e.size() + 1);
+
+  double q = b;
+  for(double component : e)
+  {
+    double h;
+    twoSum(q, component, q, h);
+    if(h != 0)
+      r.push_back(h);
+  }
+
+  if(q != 0)
+    r.push_back(q);
+
+  return r;
+}
+
+Expansion add(Expansion e, const Expansion& f)
+{
+  for(double component : f)
+    e = grow(e, component);
+  return e;
+}
+
+Expansion negate(Expansion e)
+{
+  for(auto& component : e)
+    component = -component;
+  return e;
+}
+
+Expansion subtract(const Expansion& e, const Expansion& f) { return add(e, negate(f)); }
+
+Expansion scale(const Expansion& e, double b)
+{
+  Expansion r;
+  for(double component : e)
+  {
+    double x, y;
+    twoProduct(component, b, x, y);
+    r = grow(grow(r, y), x);
+  }
+  return r;
+}
+
+Expansion multiply(const Expansion& e, const Expansion& f)
+{
+  Expansion r;
+  for(double component : f)
+    r = add(r, scale(e, component));
+  return r;
+}
+
+Expansion difference(double a, double b)
+{
+  double x, y;
+  twoSum(a, -b, x, y);
+
+  Expansion r;
+  if(y != 0)
+    r.push_back(y);
+  if(x != 0)
+    r.push_back(x);
+  return r;
+}
+
+// the most significant component gives the sign
+int sign(const Expansion& e) { return e.empty() ? 0 : (e.back() > 0 ? 1 : -1); }
+
+int sign(double val) { return val > 0 ? 1 : (val < 0 ? -1 : 0); }
+
+int orient2dExact(Vec2 a, Vec2 b, Vec2 c)
+{
+  const auto acx = difference(a.x, c.x);
+  const auto acy = difference(a.y, c.y);
+  const auto bcx = difference(b.x, c.x);
+  const auto bcy = difference(b.y, c.y);
+
+  return sign(subtract(multiply(acx, bcy), multiply(acy, bcx)));
+}
+
+int incircleExact(Vec2 a, Vec2 b, Vec2 c, Vec2 d)
+{
+  const auto adx = difference(a.x, d.x);
+  const auto ady = difference(a.y, d.y);
+  const auto bdx = difference(b.x, d.x);
+  const auto bdy = difference(b.y, d.y);
+  const auto cdx = difference(c.x, d.x);
+  const auto cdy = difference(c.y, d.y);
+
+  const auto alift = add(multiply(adx, adx), multiply(ady, ady));
+  const auto blift = add(multiply(bdx, bdx), multiply(bdy, bdy));
+  const auto clift = add(multiply(cdx, cdx), multiply(cdy, cdy));
+
+  const auto bc = subtract(multiply(bdx, cdy), multiply(cdx, bdy));
+  const auto ca = subtract(multiply(cdx, ady), multiply(adx, cdy));
+  const auto ab = subtract(multiply(adx, bdy), multiply(bdx, ady));
+
+  return sign(add(add(multiply(alift, bc), multiply(blift, ca)), multiply(clift, ab)));
+}
+
+// (a.x - c.x) * (b.y - c.y) - (a.y - c.y) * (b.x - c.x), checked against the error bound
+inline int orient2dFiltered(double acx, double bcy, double acy, double bcx, Vec2 a, Vec2 b, Vec2 c)
+{
+  const double detLeft = acx * bcy;
+  const double detRight = acy * bcx;
+  const double det = detLeft - detRight;
+
+  double detSum;
+
+  if(detLeft > 0)
+  {
+    if(detRight <= 0)
+      return sign(det);
+    detSum = detLeft + detRight;
+  }
+  else if(detLeft < 0)
+  {
+    if(detRight >= 0)
+      return sign(det);
+    detSum = -detLeft - detRight;
+  }
+  else
+  {
+    return sign(det);
+  }
+
+  const double errorBound = OrientErrorBound * detSum;
+  if(det >= errorBound || -det >= errorBound)
+    return sign(det);
+
+  return orient2dExact(a, b, c);
+}
+}
+
+int orient2d(Vec2 a, Vec2 b, Vec2 c)
+{
+  return orient2dFiltered(double(a.x) - c.x, double(b.y) - c.y, double(a.y) - c.y, double(b.x) - c.x, a, b, c);
+}
+
+int incircle(Vec2 a, Vec2 b, Vec2 c, Vec2 d)
+{
+  const double adx = double(a.x) - d.x;
+  const double bdx = double(b.x) - d.x;
+  const double cdx = double(c.x) - d.x;
+  const double ady = double(a.y) - d.y;
+  const double bdy = double(b.y) - d.y;
+  const double cdy = double(c.y) - d.y;
+
+  const double bdxcdy = bdx * cdy;
+  const double cdxbdy = cdx * bdy;
+  const double alift = adx * adx + ady * ady;
+
+  const double cdxady = cdx * ady;
+  const double adxcdy = adx * cdy;
+  const double blift = bdx * bdx + bdy * bdy;
+
+  const double adxbdy = adx * bdy;
+  const double bdxady = bdx * ady;
+  const double clift = cdx * cdx + cdy * cdy;
+
+  const double det = alift * (bdxcdy - cdxbdy) + blift * (cdxady - adxcdy) + clift * (adxbdy - bdxady);
+
+  const double permanent = (std::fabs(bdxcdy) + std::fabs(cdxbdy)) * alift +
+        (std::fabs(cdxady) + std::fabs(adxcdy)) * blift + (std::fabs(adxbdy) + std::fabs(bdxady)) * clift;
+
+  const double errorBound = IncircleErrorBound * permanent;
+  if(det > errorBound || -det > errorBound)
+    return sign(det);
+
+  return incircleExact(a, b, c, d);
+}
+
+void orient2d(Vec2 a, Vec2 b, span<const Vec2> points, span<int> out)
+{
+  assert(out.len >= points.len);
+
+  // orient2d(a, b, p) = orient2d(b, p, a): the anchor stays the same for all points
+  const double bax = double(b.x) - a.x;
+  const double bay = double(b.y) - a.y;
+
+  for(size_t i = 0; i < points.len; ++i)
+  {
+    const Vec2 p = points[i];
+    out[i] = orient2dFiltered(bax, double(p.y) - a.y, bay, double(p.x) - a.x, b, p, a);
+  }
+}
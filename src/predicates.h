@@ -0,0 +1,20 @@
+#pragma once
+
+// Robust geometric predicates.
+// The sign is computed with doubles, and only when the result is too close to zero
+// to be trusted, recomputed exactly with floating-point expansions (Shewchuk's method).
+// This way, the common case stays as fast as a plain determinant, while degenerate
+// configurations (collinear, cocircular points) are always classified correctly.
+
+#include "core/geom.h"
+
+// > 0 if (a, b, c) is counter-clockwise, < 0 if clockwise, 0 if the points are collinear.
+int orient2d(Vec2 a, Vec2 b, Vec2 c);
+
+// For a counter-clockwise triangle (a, b, c):
+// > 0 if 'd' is inside its circumcircle, < 0 if outside, 0 if the four points are cocircular.
+// (signs are reversed for a clockwise triangle)
+int incircle(Vec2 a, Vec2 b, Vec2 c, Vec2 d);
+
+// out[i] = orient2d(a, b, points[i]), for many points against the same edge
+void orient2d(Vec2 a, Vec2 b, span<const Vec2> points, span<int> out);
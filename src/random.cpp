@@ -9,11 +9,62 @@
 
 #include "random.h"
 
-#include <climits> // RAND_MAX
-#include <cstdlib> // rand
+namespace
+{
+uint64_t splitMix64(uint64_t& state)
+{
+  uint64_t z = (state += 0x9E3779B97F4A7C15ull);
+  z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+  z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+  return z ^ (z >> 31);
+}
 
-float randomFloat(float min, float max) { return (rand() / float(RAND_MAX)) * (max - min) + min; }
-int randomInt(int min, int max) { return rand() % (max - min) + min; }
+thread_local RandomGenerator gRandomGenerator;
+}
+
+void RandomGenerator::reseed(uint64_t seed)
+{
+  // spread the seed over the whole state, which must never be all zeroes
+  const uint64_t a = splitMix64(seed);
+  const uint64_t b = splitMix64(seed);
+  s[0] = uint32_t(a);
+  s[1] = uint32_t(a >> 32);
+  s[2] = uint32_t(b);
+  s[3] = uint32_t(b >> 32);
+
+  if((s[0] | s[1] | s[2] | s[3]) == 0)
+    s[0] = 1;
+}
+
+int RandomGenerator::nextInt(int min, int max)
+{
+  if(max <= min)
+    return min;
+
+  // Lemire's multiply-and-reject method
+  const uint32_t range = uint32_t(max) - uint32_t(min);
+  uint64_t m = uint64_t(next()) * range;
+  uint32_t low = uint32_t(m);
+
+  if(low < range)
+  {
+    const uint32_t threshold = -range % range;
+    while(low < threshold)
+    {
+      m = uint64_t(next()) * range;
+      low = uint32_t(m);
+    }
+  }
+
+  return int(uint32_t(min) + uint32_t(m >> 32));
+}
+
+RandomGenerator& defaultRandomGenerator() { return gRandomGenerator; }
+
+void randomSeed(uint64_t seed) { gRandomGenerator.reseed(seed); }
+
+float randomFloat(float min, float max) { return gRandomGenerator.nextFloat() * (max - min) + min; }
+int randomInt(int min, int max) { return gRandomGenerator.nextInt(min, max); }
 
 Vec2 randomPos(Vec2 min, Vec2 max)
 {
@@ -22,3 +73,24 @@ Vec2 randomPos(Vec2 min, Vec2 max)
   r.y = randomFloat(min.y, max.y);
   return r;
 }
+
+void randomFill(span<float> values, float min, float max)
+{
+  RandomGenerator& gen = gRandomGenerator;
+  const float scale = max - min;
+
+  for(auto& v : values)
+    v = gen.nextFloat() * scale + min;
+}
+
+void randomFill(span<Vec2> values, Vec2 min, Vec2 max)
+{
+  RandomGenerator& gen = gRandomGenerator;
+  const Vec2 scale = max - min;
+
+  for(auto& v : values)
+  {
+    v.x = gen.nextFloat() * scale.x + min.x;
+    v.y = gen.nextFloat() * scale.y + min.y;
+  }
+}
@@ -1,8 +1,57 @@
 #pragma once
 
+#include <cstdint>
+
 #include "core/geom.h"
 
+// Small, fast and seedable generator (xoshiro128**).
+// Not suitable for cryptography.
+struct RandomGenerator
+{
+  explicit RandomGenerator(uint64_t seed = 0) { reseed(seed); }
+
+  void reseed(uint64_t seed);
+
+  // uniformly distributed over [0;2^32[
+  uint32_t next()
+  {
+    const uint32_t result = rotl(s[1] * 5, 7) * 9;
+    const uint32_t t = s[1] << 9;
+
+    s[2] ^= s[0];
+    s[3] ^= s[1];
+    s[1] ^= s[2];
+    s[0] ^= s[3];
+
+    s[2] ^= t;
+    s[3] = rotl(s[3], 11);
+
+    return result;
+  }
+
+  // uniformly distributed over [0;1[
+  float nextFloat() { return (next() >> 8) * (1.0f / 16777216.0f); }
+
+  // uniformly distributed over [min;max[, without modulo bias
+  int nextInt(int min, int max);
+
+  private:
+  static uint32_t rotl(uint32_t x, int k) { return (x << k) | (x >> (32 - k)); }
+
+  uint32_t s[4];
+};
+
+// The generator used by the functions below (one instance per thread)
+RandomGenerator& defaultRandomGenerator();
+
+// Reseeds the calling thread's default generator
+void randomSeed(uint64_t seed);
+
 float randomFloat(float min, float max);
 int randomInt(int min, int max);
 
 Vec2 randomPos(Vec2 min, Vec2 max);
+
+// Bulk generation
+void randomFill(span<float> values, float min, float max);
+void randomFill(span<Vec2> values, Vec2 min, Vec2 max);
@@ -10,6 +10,8 @@
 
 #include <array>
 #include <cmath>
+#include <cstdint>
+#include <unordered_map>
 #include <vector>
 
 #include "bounding_box.h"
@@ -168,10 +170,8 @@ Polygon2f createRegularPolygon2f(int N, float radius1, float radius2)
 
 const auto OneMeter = 0.2;
 
-void mutatorInsetAndExtrude(Polygon2f& poly)
+void mutatorInsetAndExtrude(Polygon2f& poly, int faceIdx)
 {
-  const auto faceIdx = randomInt(0, poly.faces.size());
-
   // choose inset polarity so that we enlarge small faces and reduce big ones
   const auto faceLength = poly.faceLength(faceIdx);
   const auto polarity = faceLength >= 5 * OneMeter;
@@ -181,9 +181,8 @@ void mutatorInsetAndExtrude(Polygon2f& poly)
   opInsetAndExtrude(poly, faceIdx, center, 0.2, polarity, OneMeter * randomFloat(10.0f, 40.0f));
 }
 
-void mutatorInsetAndMoveAway(Polygon2f& poly)
+void mutatorInsetAndMoveAway(Polygon2f& poly, int faceIdx)
 {
-  const auto faceIdx = randomInt(0, poly.faces.size());
   const auto faceLength = poly.faceLength(faceIdx);
 
   // don't split small faces
@@ -206,9 +205,19 @@ void mutatorInsetAndMoveAway(Polygon2f& poly)
     opExtrudeFace(poly, face, 3 * amount);
 }
 
-typedef void MutatorFunction(Polygon2f& poly);
+typedef void MutatorFunction(Polygon2f& poly, int faceIdx);
+
+// What a mutation changed: the mutated face (the only existing one which changes),
+// and the faces and vertices appended.
+struct Undo
+{
+  int faceIdx;
+  Face face;
+  int faceCount;
+  int vertexCount;
+};
 
-void mutate(Polygon2f& poly)
+Undo mutate(Polygon2f& poly)
 {
   static const MutatorFunction* mutators[] = {
         &mutatorInsetAndMoveAway,
@@ -216,7 +225,19 @@ void mutate(Polygon2f& poly)
         &mutatorInsetAndExtrude,
   };
 
-  mutators[randomInt(0, 3)](poly);
+  auto mutator = mutators[randomInt(0, 3)];
+  const auto faceIdx = randomInt(0, poly.faces.size());
+
+  const Undo undo{faceIdx, poly.faces[faceIdx], (int)poly.faces.size(), (int)poly.vertices.size()};
+  mutator(poly, faceIdx);
+  return undo;
+}
+
+void revert(Polygon2f& poly, const Undo& undo)
+{
+  poly.faces.resize(undo.faceCount);
+  poly.vertices.resize(undo.vertexCount);
+  poly.faces[undo.faceIdx] = undo.face;
 }
 
 void swap(float& a, float& b)
@@ -283,25 +304,156 @@ float distance(const Polygon2f& poly, int faceIdx1, int faceIdx2)
         {poly.vertices[face1.a], poly.vertices[face1.b]}, {poly.vertices[face2.a], poly.vertices[face2.b]});
 }
 
-bool isValid(const Polygon2f& poly)
+// faces not sharing a vertex must be at least this far apart
+const auto minDistance = 2.0 * OneMeter;
+
+const auto cellSize = 10 * OneMeter;
+
+// The faces, by cell of a uniform grid (unbounded: only the cells in use are stored).
+// A mutation is valid if the faces it changed are far enough from the ones near them.
+struct FaceGrid
 {
-  for(int i = 0; i < (int)poly.faces.size(); ++i)
+  std::unordered_map<uint64_t, std::vector<int>> cells;
+
+  template<typename Visitor>
+  void forEachCell(Vec2 a, Vec2 b, float margin, Visitor visit)
   {
-    for(int j = i + 1; j < (int)poly.faces.size(); ++j)
+    const int x0 = (int)std::floor((std::min(a.x, b.x) - margin) / cellSize);
+    const int x1 = (int)std::floor((std::max(a.x, b.x) + margin) / cellSize);
+    const int y0 = (int)std::floor((std::min(a.y, b.y) - margin) / cellSize);
+    const int y1 = (int)std::floor((std::max(a.y, b.y) + margin) / cellSize);
+
+    for(int y = y0; y <= y1; ++y)
     {
-      const auto face1 = poly.faces[i];
-      const auto face2 = poly.faces[j];
+      for(int x = x0; x <= x1; ++x)
+        visit((uint64_t(uint32_t(x)) << 32) | uint32_t(y));
+    }
+  }
+
+  void insert(const Polygon2f& poly, int faceIdx)
+  {
+    const auto face = poly.faces[faceIdx];
+    forEachCell(poly.vertices[face.a], poly.vertices[face.b], 0, [&](uint64_t key) { cells[key].push_back(faceIdx); });
+  }
+
+  // 'a' and 'b' are where the face was when it was inserted
+  void remove(int faceIdx, Vec2 a, Vec2 b)
+  {
+    forEachCell(a, b, 0,
+          [&](uint64_t key)
+          {
+            auto& cell = cells[key];
+            for(auto& f : cell)
+            {
+              if(f == faceIdx)
+              {
+                f = cell.back();
+                cell.pop_back();
+                break;
+              }
+            }
+          });
+  }
+};
+
+bool areTooClose(const Polygon2f& poly, int faceIdx1, int faceIdx2)
+{
+  const auto face1 = poly.faces[faceIdx1];
+  const auto face2 = poly.faces[faceIdx2];
+
+  if(face1.a == face2.a || face1.a == face2.b || face1.b == face2.a || face1.b == face2.b)
+    return false;
+
+  // most faces in the same cells are far enough apart on an axis
+  const auto a1 = poly.vertices[face1.a];
+  const auto b1 = poly.vertices[face1.b];
+  const auto a2 = poly.vertices[face2.a];
+  const auto b2 = poly.vertices[face2.b];
+  if(std::min(a1.x, b1.x) - std::max(a2.x, b2.x) >= minDistance ||
+        std::min(a2.x, b2.x) - std::max(a1.x, b1.x) >= minDistance ||
+        std::min(a1.y, b1.y) - std::max(a2.y, b2.y) >= minDistance ||
+        std::min(a2.y, b2.y) - std::max(a1.y, b1.y) >= minDistance)
+    return false;
+
+  return distance(poly, faceIdx1, faceIdx2) < minDistance;
+}
+
+// Only the faces changed by the mutation can be too close to another one
+bool isValid(Polygon2f& poly, FaceGrid& grid, const Undo& undo)
+{
+  auto isChanged = [&](int faceIdx) { return faceIdx == undo.faceIdx || faceIdx >= undo.faceCount; };
+
+  auto isValidFace = [&](int faceIdx)
+  {
+    bool valid = true;
+    const auto face = poly.faces[faceIdx];
+    grid.forEachCell(poly.vertices[face.a], poly.vertices[face.b], minDistance,
+          [&](uint64_t key)
+          {
+            auto cell = grid.cells.find(key);
+            if(!valid || cell == grid.cells.end())
+              return;
+
+            for(auto other : cell->second)
+            {
+              // the changed faces aren't in the grid yet (or at their previous place)
+              if(!isChanged(other) && areTooClose(poly, faceIdx, other))
+              {
+                valid = false;
+                return;
+              }
+            }
+          });
+
+    return valid;
+  };
+
+  if(!isValidFace(undo.faceIdx))
+    return false;
 
-      if(face1.a != face2.a && face1.a != face2.b)
-        if(face1.b != face2.a && face1.b != face2.b)
-          if(distance(poly, i, j) < 2.0 * OneMeter)
-            return false;
+  for(int i = undo.faceCount; i < (int)poly.faces.size(); ++i)
+  {
+    if(!isValidFace(i) || areTooClose(poly, i, undo.faceIdx))
+      return false;
+
+    for(int j = i + 1; j < (int)poly.faces.size(); ++j)
+    {
+      if(areTooClose(poly, i, j))
+        return false;
     }
   }
 
   return true;
 }
 
+// Returns true if the mutation was kept
+bool tryMutation(Polygon2f& poly, FaceGrid& grid)
+{
+  const auto undo = mutate(poly);
+
+  if(!isValid(poly, grid, undo))
+  {
+    revert(poly, undo);
+    return false;
+  }
+
+  grid.remove(undo.faceIdx, poly.vertices[undo.face.a], poly.vertices[undo.face.b]);
+  grid.insert(poly, undo.faceIdx);
+
+  for(int i = undo.faceCount; i < (int)poly.faces.size(); ++i)
+    grid.insert(poly, i);
+
+  return true;
+}
+
+FaceGrid createFaceGrid(const Polygon2f& poly)
+{
+  FaceGrid grid;
+  for(int i = 0; i < (int)poly.faces.size(); ++i)
+    grid.insert(poly, i);
+  return grid;
+}
+
 void recenterPolygon(Polygon2f& polygon)
 {
   BoundingBox bbox;
@@ -350,15 +502,11 @@ Polygon2f createRandomPolygon2f()
 
   drawAndStep();
 
+  auto grid = createFaceGrid(r);
+
   for(int k = 0; k < 30; ++k)
   {
-    Polygon2f backup = r;
-
-    mutate(r);
-
-    if(!isValid(r))
-      r = backup;
-    else
+    if(tryMutation(r, grid))
       drawAndStep();
   }
 
@@ -366,3 +514,26 @@ Polygon2f createRandomPolygon2f()
 
   return r;
 }
+
+Polygon2f createLargeRandomPolygon2f(int faceCount)
+{
+  const auto radius1 = randomFloat(5, 10) * OneMeter;
+  const auto radius2 = randomFloat(5, 10) * OneMeter;
+  const auto N = randomInt(3, 8);
+  Polygon2f r = createRegularPolygon2f(N, radius1, radius2);
+
+  auto grid = createFaceGrid(r);
+
+  // as it grows, more mutations fail: give up if too many do
+  const int maxAttempts = 20 * faceCount;
+  for(int k = 0; k < maxAttempts && (int)r.faces.size() < faceCount; ++k)
+    tryMutation(r, grid);
+
+  recenterPolygon(r);
+
+  for(auto face : r.faces)
+    sandbox_line(r.vertices[face.a], r.vertices[face.b]);
+  sandbox_breakpoint();
+
+  return r;
+}
@@ -3,3 +3,8 @@
 #include "polygon.h"
 
 Polygon2f createRandomPolygon2f();
+
+// Same mutations, for stress inputs (10^4 to 10^5 faces): stops at 'faceCount' faces
+// (or a bit more), or when mutations keep failing.
+// Each mutation is only checked against the faces near it, and reverted if it fails.
+Polygon2f createLargeRandomPolygon2f(int faceCount);
@@ -0,0 +1,140 @@
+#include "rasterize_lines.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <vector>
+
+namespace
+{
+int cellOf(float v) { return int(floor(v)); }
+
+// Calls 'visit(x, y)' for each cell of the segment, in order, until it returns false.
+// The step count is known from the end cells, so rounding can't make the walk miss its end.
+template<typename Visit>
+bool walkCells(GridSegment segment, Visit&& visit)
+{
+  const Vec2 a = segment.a;
+  const Vec2 d = segment.b - segment.a;
+
+  int x = cellOf(a.x);
+  int y = cellOf(a.y);
+  const int endX = cellOf(segment.b.x);
+  const int endY = cellOf(segment.b.y);
+  const int stepX = endX > x ? 1 : -1;
+  const int stepY = endY > y ? 1 : -1;
+
+  // segment parameter at the next vertical (resp. horizontal) cell border, and between two of them
+  const float inf = 1.0 / 0.0;
+  const float deltaX = d.x != 0 ? 1 / fabs(d.x) : inf;
+  const float deltaY = d.y != 0 ? 1 / fabs(d.y) : inf;
+  float nextX = d.x != 0 ? (stepX > 0 ? x + 1 - a.x : a.x - x) * deltaX : inf;
+  float nextY = d.y != 0 ? (stepY > 0 ? y + 1 - a.y : a.y - y) * deltaY : inf;
+
+  if(!visit(x, y))
+    return false;
+
+  while(x != endX || y != endY)
+  {
+    const bool moveX = y == endY || (x != endX && nextX < nextY);
+    const bool moveY = x == endX || (y != endY && nextY < nextX);
+
+    if(moveX)
+    {
+      x += stepX;
+      nextX += deltaX;
+    }
+    else if(moveY)
+    {
+      y += stepY;
+      nextY += deltaY;
+    }
+    else
+    {
+      // through a corner: both cells beside it are touched
+      if(!visit(x + stepX, y) || !visit(x, y + stepY))
+        return false;
+
+      x += stepX;
+      y += stepY;
+      nextX += deltaX;
+      nextY += deltaY;
+    }
+
+    if(!visit(x, y))
+      return false;
+  }
+
+  return true;
+}
+
+void rasterizeBresenham(GridSegment segment, BitGrid& grid)
+{
+  int x = cellOf(segment.a.x);
+  int y = cellOf(segment.a.y);
+  const int endX = cellOf(segment.b.x);
+  const int endY = cellOf(segment.b.y);
+
+  // integer error term, on both axes at once
+  const int dx = abs(endX - x);
+  const int dy = -abs(endY - y);
+  const int stepX = x < endX ? 1 : -1;
+  const int stepY = y < endY ? 1 : -1;
+  int error = dx + dy;
+
+  while(true)
+  {
+    if(grid.contains(x, y))
+      grid.set(x, y);
+
+    if(x == endX && y == endY)
+      break;
+
+    const int error2 = 2 * error;
+    if(error2 >= dy)
+    {
+      error += dy;
+      x += stepX;
+    }
+    if(error2 <= dx)
+    {
+      error += dx;
+      y += stepY;
+    }
+  }
+}
+}
+
+void rasterizeLines(span<const GridSegment> segments, BitGrid& grid)
+{
+  for(auto& segment : segments)
+    rasterizeBresenham(segment, grid);
+}
+
+void rasterizeLinesSupercover(span<const GridSegment> segments, BitGrid& grid)
+{
+  for(auto& segment : segments)
+  {
+    walkCells(segment,
+          [&](int x, int y)
+          {
+            if(grid.contains(x, y))
+              grid.set(x, y);
+            return true;
+          });
+  }
+}
+
+bool findFirstBlocked(const BitGrid& occupancy, GridSegment segment, int& x, int& y)
+{
+  return !walkCells(segment,
+        [&](int cellX, int cellY)
+        {
+          if(!occupancy.contains(cellX, cellY) || !occupancy.get(cellX, cellY))
+            return true;
+
+          x = cellX;
+          y = cellY;
+          return false;
+        });
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+// Line rasterization into grids of bits (e.g fog of war, line of sight), for many segments at once.
+// Coordinates are in cells: the cell (x, y) covers [x; x + 1[ * [y; y + 1[.
+
+#include "core/geom.h"
+
+#include "bit_grid.h"
+
+struct GridSegment
+{
+  Vec2 a, b;
+};
+
+// Bresenham: one cell per column (or row, for steep segments), from the cell of 'a' to the cell of 'b'.
+// The cells outside of the grid are skipped.
+void rasterizeLines(span<const GridSegment> segments, BitGrid& grid);
+
+// Supercover: every cell the segment goes through, including both sides of a corner it crosses exactly.
+void rasterizeLinesSupercover(span<const GridSegment> segments, BitGrid& grid);
+
+// Walks the cells of the segment from 'a' (as the supercover does), and stops at the first one set
+// in 'occupancy': returns true, with the cell in (x, y). Returns false if the way is clear.
+// The cells outside of the grid are clear.
+bool findFirstBlocked(const BitGrid& occupancy, GridSegment segment, int& x, int& y);
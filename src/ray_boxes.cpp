@@ -0,0 +1,120 @@
+#include "ray_boxes.h"
+
+#include <bitset>
+#include <cmath>
+
+namespace
+{
+int countBits(int mask) { return int(std::bitset<4>(mask).count()); }
+
+// The last 1 to 3 values of 'values', padded with 'padding'
+Float4 loadTail(const float* values, int count, float padding)
+{
+  float lanes[4] = {padding, padding, padding, padding};
+  for(int i = 0; i < count; ++i)
+    lanes[i] = values[i];
+  return load4(lanes);
+}
+
+void storeTail(float* values, int count, Float4 v)
+{
+  float lanes[4];
+  store4(lanes, v);
+  for(int i = 0; i < count; ++i)
+    values[i] = lanes[i];
+}
+}
+
+BoxArray::BoxArray(span<const BoundingBox> boxes)
+{
+  resize(boxes.len);
+  for(size_t i = 0; i < boxes.len; ++i)
+    set(i, boxes[i]);
+}
+
+int intersectRayBoxes(const BoxArray& boxes,
+      Vec2 origin,
+      Vec2 invDir,
+      float tMin,
+      float tMax,
+      span<float> enter,
+      span<float> leave)
+{
+  const Float4 originX = splat4(origin.x);
+  const Float4 originY = splat4(origin.y);
+  const Float4 invDirX = splat4(invDir.x);
+  const Float4 invDirY = splat4(invDir.y);
+  const Float4 vmin = splat4(tMin);
+  const Float4 vmax = splat4(tMax);
+
+  const int n = boxes.size();
+  int hitCount = 0;
+  Float4 e, l;
+
+  int i = 0;
+  for(; i + 4 <= n; i += 4)
+  {
+    const int mask = intersectSlabs4(load4(&boxes.minX[i]), load4(&boxes.minY[i]), load4(&boxes.maxX[i]),
+          load4(&boxes.maxY[i]), originX, originY, invDirX, invDirY, vmin, vmax, e, l);
+    store4(&enter[i], e);
+    store4(&leave[i], l);
+    hitCount += countBits(mask);
+  }
+
+  // the padding lanes are empty boxes: they can't be hit
+  if(const int rest = n - i)
+  {
+    const float inf = 1.0 / 0.0;
+    const int mask = intersectSlabs4(loadTail(&boxes.minX[i], rest, inf), loadTail(&boxes.minY[i], rest, inf),
+          loadTail(&boxes.maxX[i], rest, -inf), loadTail(&boxes.maxY[i], rest, -inf), originX, originY, invDirX,
+          invDirY, vmin, vmax, e, l);
+    storeTail(&enter[i], rest, e);
+    storeTail(&leave[i], rest, l);
+    hitCount += countBits(mask & ((1 << rest) - 1));
+  }
+
+  return hitCount;
+}
+
+int intersectRaysBox(const Vec2Array& origins,
+      const Vec2Array& invDirs,
+      const BoundingBox& box,
+      float tMin,
+      float tMax,
+      span<float> enter,
+      span<float> leave)
+{
+  const Float4 minX = splat4(box.min.x);
+  const Float4 minY = splat4(box.min.y);
+  const Float4 maxX = splat4(box.max.x);
+  const Float4 maxY = splat4(box.max.y);
+  const Float4 vmin = splat4(tMin);
+  const Float4 vmax = splat4(tMax);
+
+  const int n = origins.size();
+  int hitCount = 0;
+  Float4 e, l;
+
+  int i = 0;
+  for(; i + 4 <= n; i += 4)
+  {
+    const int mask = intersectSlabs4(minX, minY, maxX, maxY, load4(&origins.x[i]), load4(&origins.y[i]),
+          load4(&invDirs.x[i]), load4(&invDirs.y[i]), vmin, vmax, e, l);
+    store4(&enter[i], e);
+    store4(&leave[i], l);
+    hitCount += countBits(mask);
+  }
+
+  // the padding lanes are ignored
+  if(const int rest = n - i)
+  {
+    const int mask = intersectSlabs4(minX, minY, maxX, maxY, loadTail(&origins.x[i], rest, 0),
+          loadTail(&origins.y[i], rest, 0), loadTail(&invDirs.x[i], rest, 1), loadTail(&invDirs.y[i], rest, 1),
+          vmin, vmax, e, l);
+    storeTail(&enter[i], rest, e);
+    storeTail(&leave[i], rest, l);
+    hitCount += countBits(mask & ((1 << rest) - 1));
+  }
+
+  return hitCount;
+}
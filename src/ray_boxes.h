@@ -0,0 +1,112 @@
+#pragma once
+
+// Slab tests of rays against axis-aligned boxes, four at a time (see simd.h):
+// one ray against many boxes, or many rays against one box.
+// A ray is 'origin + dir * t', given by its origin and 'invDir' (the safeInverse of each
+// component of 'dir'), so that the tests only multiply. The entry and exit of each box are
+// computed with min/max only, without branches: the ray misses the box when 'enter > leave'.
+
+#include "core/geom.h"
+#include "core/simd.h"
+#include "core/vec2_array.h"
+
+#include <cmath>
+#include <vector>
+
+#include "bounding_box.h"
+
+// 1 / d, with zero components mapped to a huge value of the same sign
+// (avoids computing 0 * infinity in slab tests)
+inline float safeInverse(float d) { return 1.0f / (std::fabs(d) > 1e-30f ? d : std::copysign(1e-30f, d)); }
+
+inline Vec2 safeInverse(Vec2 d) { return {safeInverse(d.x), safeInverse(d.y)}; }
+
+// Structure-of-arrays storage for boxes
+struct BoxArray
+{
+  std::vector<float, AlignedAllocator<float>> minX, minY;
+  std::vector<float, AlignedAllocator<float>> maxX, maxY;
+
+  BoxArray() = default;
+  explicit BoxArray(span<const BoundingBox> boxes);
+
+  size_t size() const { return minX.size(); }
+
+  void resize(size_t n)
+  {
+    minX.resize(n);
+    minY.resize(n);
+    maxX.resize(n);
+    maxY.resize(n);
+  }
+
+  void push_back(const BoundingBox& box)
+  {
+    minX.push_back(box.min.x);
+    minY.push_back(box.min.y);
+    maxX.push_back(box.max.x);
+    maxY.push_back(box.max.y);
+  }
+
+  BoundingBox operator[](int i) const
+  {
+    BoundingBox box;
+    box.min = {minX[i], minY[i]};
+    box.max = {maxX[i], maxY[i]};
+    return box;
+  }
+
+  void set(int i, const BoundingBox& box)
+  {
+    minX[i] = box.min.x;
+    minY[i] = box.min.y;
+    maxX[i] = box.max.x;
+    maxY[i] = box.max.y;
+  }
+};
+
+// Four slab tests at once: [enter; leave] is the part of [tMin; tMax] where each ray is in its box.
+// Returns the bitmask of the lanes where it isn't empty.
+inline int intersectSlabs4(Float4 minX,
+      Float4 minY,
+      Float4 maxX,
+      Float4 maxY,
+      Float4 originX,
+      Float4 originY,
+      Float4 invDirX,
+      Float4 invDirY,
+      Float4 tMin,
+      Float4 tMax,
+      Float4& enter,
+      Float4& leave)
+{
+  const Float4 tx1 = (minX - originX) * invDirX;
+  const Float4 tx2 = (maxX - originX) * invDirX;
+  const Float4 ty1 = (minY - originY) * invDirY;
+  const Float4 ty2 = (maxY - originY) * invDirY;
+
+  enter = max4(tMin, max4(min4(tx1, tx2), min4(ty1, ty2)));
+  leave = min4(tMax, min4(max4(tx1, tx2), max4(ty1, ty2)));
+
+  return lessEqualMask(enter, leave);
+}
+
+// For each box i, [enter[i]; leave[i]] is the part of [tMin; tMax] where the ray is in the box
+// (tMin = -infinity and tMax = +infinity give the whole line).
+// Returns how many boxes the ray hits, i.e where enter[i] <= leave[i].
+int intersectRayBoxes(const BoxArray& boxes,
+      Vec2 origin,
+      Vec2 invDir,
+      float tMin,
+      float tMax,
+      span<float> enter,
+      span<float> leave);
+
+// For each ray i (origins[i], invDirs[i]), the same against 'box'.
+int intersectRaysBox(const Vec2Array& origins,
+      const Vec2Array& invDirs,
+      const BoundingBox& box,
+      float tMin,
+      float tMax,
+      span<float> enter,
+      span<float> leave);
@@ -0,0 +1,172 @@
+#include "sat.h"
+
+#include <cassert>
+#include <cmath>
+
+namespace
+{
+void addAxis(ConvexShape& shape, Vec2 axis)
+{
+  for(int i = 0; i < shape.axisCount; ++i)
+  {
+    const Vec2 other = shape.axes[i];
+    if(std::abs(other.x * axis.y - other.y * axis.x) < 1.0e-6f)
+      return;
+  }
+
+  shape.axes[shape.axisCount++] = axis;
+}
+
+// Narrows down the move on one axis. Returns false if the shapes are separated along it.
+bool clipOnAxis(Vec2 axis, Vec2 pos, Vec2 delta, const ConvexShape& mover, const ConvexShape& obstacle, SweepHit& hit)
+{
+  // make the move always increase the position along the axis
+  if(axis * delta < 0)
+    axis = axis * -1;
+
+  // projections of the point and the Minkowski sum on the axis
+  const float startPos = pos * axis;
+  const float targetPos = (pos + delta) * axis;
+  const auto projMover = mover.project(axis);
+  const auto projObstacle = obstacle.project(axis);
+  const float min = projObstacle.min + projMover.min;
+  const float max = projObstacle.max + projMover.max;
+
+  if(targetPos < min)
+    return false; // all the axis-projected move is before the obstacle
+
+  if(startPos >= max)
+    return false; // all the axis-projected move is after the obstacle
+
+  if(std::abs(startPos - targetPos) > 0.00001)
+  {
+    const float f = (min - startPos) / (targetPos - startPos);
+    if(f > hit.fraction)
+    {
+      hit.fraction = f;
+      hit.normal = -axis;
+    }
+  }
+
+  return true;
+}
+}
+
+ConvexShape makeBoxShape(Vec2 center, Vec2 halfSize)
+{
+  ConvexShape r;
+  r.isBox = true;
+  r.center = center;
+  r.halfSize = halfSize;
+
+  r.vertexCount = 4;
+  r.vertices[0] = center + Vec2(-halfSize.x, -halfSize.y);
+  r.vertices[1] = center + Vec2(+halfSize.x, -halfSize.y);
+  r.vertices[2] = center + Vec2(+halfSize.x, +halfSize.y);
+  r.vertices[3] = center + Vec2(-halfSize.x, +halfSize.y);
+
+  r.axisCount = 2;
+  r.axes[0] = {1, 0};
+  r.axes[1] = {0, 1};
+  return r;
+}
+
+ConvexShape makePolygonShape(span<const Vec2> vertices)
+{
+  assert(vertices.len > 0 && vertices.len <= ConvexShape::MaxVertices);
+
+  ConvexShape r;
+  r.vertexCount = vertices.len;
+  for(int i = 0; i < r.vertexCount; ++i)
+    r.vertices[i] = vertices[i];
+
+  for(int i = 0; i < r.vertexCount; ++i)
+  {
+    const Vec2 edge = r.vertices[(i + 1) % r.vertexCount] - r.vertices[i];
+    if(edge * edge > 0)
+      addAxis(r, rotateLeft(normalize(edge)));
+  }
+
+  return r;
+}
+
+BoundingBox boundingBox(const ConvexShape& shape)
+{
+  const auto x = shape.project({1, 0});
+  const auto y = shape.project({0, 1});
+
+  BoundingBox r;
+  r.add({x.min, y.min});
+  r.add({x.max, y.max});
+  return r;
+}
+
+SweepHit sweep(Vec2 pos, Vec2 delta, const ConvexShape& mover, const ConvexShape& obstacle)
+{
+  SweepHit hit;
+  hit.fraction = 0;
+
+  for(int i = 0; i < obstacle.axisCount; ++i)
+  {
+    if(!clipOnAxis(obstacle.axes[i], pos, delta, mover, obstacle, hit))
+      return {};
+  }
+
+  for(int i = 0; i < mover.axisCount; ++i)
+  {
+    if(!clipOnAxis(mover.axes[i], pos, delta, mover, obstacle, hit))
+      return {};
+  }
+
+  if(delta * delta > 0)
+  {
+    if(!clipOnAxis(rotateLeft(normalize(delta)), pos, delta, mover, obstacle, hit))
+      return {};
+  }
+
+  return hit;
+}
+
+SweepHit sweep(Vec2 pos, Vec2 delta, const ConvexShape& mover, span<const ConvexShape> obstacles)
+{
+  SweepHit first;
+
+  for(int i = 0; i < (int)obstacles.len; ++i)
+  {
+    auto hit = sweep(pos, delta, mover, obstacles[i]);
+    if(hit.fraction < first.fraction)
+    {
+      first = hit;
+      first.obstacle = i;
+    }
+  }
+
+  return first;
+}
+
+SweepHit sweep(Vec2 pos, Vec2 delta, const ConvexShape& mover, span<const ConvexShape> obstacles,
+      const FlatBvhView& bvh, span<const BoundingBox> obstacleBoxes)
+{
+  // box of the whole move
+  const auto moverBox = boundingBox(mover);
+  BoundingBox box;
+  box.add(pos + moverBox.min);
+  box.add(pos + moverBox.max);
+  box.add(pos + delta + moverBox.min);
+  box.add(pos + delta + moverBox.max);
+
+  SweepHit first;
+
+  queryOverlaps(bvh, obstacleBoxes, box,
+        [&](int i)
+        {
+          auto hit = sweep(pos, delta, mover, obstacles[i]);
+          if(hit.fraction < first.fraction || (hit.fraction == first.fraction && hit.fraction < 1 && i < first.obstacle))
+          {
+            first = hit;
+            first.obstacle = i;
+          }
+        });
+
+  return first;
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+// Continuous collision detection of convex shapes, using the separating axis test.
+// Nothing is allocated: the shapes store their vertices and axes inline.
+
+#include "core/geom.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "bounding_box.h"
+#include "bvh.h"
+
+struct ProjectionOnAxis
+{
+  float min, max;
+};
+
+// Convex polygon, or axis-aligned box (which has a faster projection).
+struct ConvexShape
+{
+  static const int MaxVertices = 16;
+
+  bool isBox = false;
+  Vec2 center{}; // box only
+  Vec2 halfSize{}; // box only
+
+  int vertexCount = 0;
+  Vec2 vertices[MaxVertices];
+
+  // the unit normals of the edges, parallel ones only once
+  int axisCount = 0;
+  Vec2 axes[MaxVertices];
+
+  ProjectionOnAxis project(Vec2 axis) const
+  {
+    if(isBox)
+    {
+      const float c = center * axis;
+      const float extent = std::abs(axis.x) * halfSize.x + std::abs(axis.y) * halfSize.y;
+      return {c - extent, c + extent};
+    }
+
+    ProjectionOnAxis r{vertices[0] * axis, vertices[0] * axis};
+    for(int i = 1; i < vertexCount; ++i)
+    {
+      const float p = vertices[i] * axis;
+      r.min = std::min(r.min, p);
+      r.max = std::max(r.max, p);
+    }
+    return r;
+  }
+};
+
+ConvexShape makeBoxShape(Vec2 center, Vec2 halfSize);
+
+// 'vertices' must be convex, and at most ConvexShape::MaxVertices
+ConvexShape makePolygonShape(span<const Vec2> vertices);
+
+BoundingBox boundingBox(const ConvexShape& shape);
+
+struct SweepHit
+{
+  float fraction = 1; // part of the move done before the contact (1 if there's none)
+  Vec2 normal{}; // unit normal of the obstacle at the contact (zero if there's none)
+  int obstacle = -1;
+};
+
+// Moves 'mover' (relative to 'pos') from 'pos' to 'pos+delta', stops when colliding with 'obstacle'.
+// Instead of sweeping a shape against another, a ray is cast against their Minkowski sum,
+// whose projection on an axis is the sum of their projections.
+SweepHit sweep(Vec2 pos, Vec2 delta, const ConvexShape& mover, const ConvexShape& obstacle);
+
+// Same, against many obstacles: returns the first hit.
+SweepHit sweep(Vec2 pos, Vec2 delta, const ConvexShape& mover, span<const ConvexShape> obstacles);
+
+// Same, only testing the obstacles whose box overlaps the box of the move.
+// 'bvh' must be built from 'obstacleBoxes', the boxes of 'obstacles'.
+SweepHit sweep(Vec2 pos, Vec2 delta, const ConvexShape& mover, span<const ConvexShape> obstacles,
+      const FlatBvhView& bvh, span<const BoundingBox> obstacleBoxes);
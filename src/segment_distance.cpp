@@ -0,0 +1,136 @@
+#include "segment_distance.h"
+
+#include "core/simd.h"
+
+namespace
+{
+// the smallest divisor: below, the division would only give an out-of-range value anyway
+const float Tiny = 1e-30f;
+
+// The same code runs on single floats and on Float4. min4 and max4 keep the first operand on a tie.
+inline float lower(float a, float b) { return a < b ? a : b; }
+inline float upper(float a, float b) { return a > b ? a : b; }
+inline Float4 lower(Float4 a, Float4 b) { return min4(a, b); }
+inline Float4 upper(Float4 a, Float4 b) { return max4(a, b); }
+
+template<typename T>
+T splat(float val);
+
+template<>
+float splat<float>(float val)
+{
+  return val;
+}
+
+template<>
+Float4 splat<Float4>(float val)
+{
+  return splat4(val);
+}
+
+template<typename T>
+struct Point
+{
+  T x, y, z;
+
+  friend Point operator+(Point a, Point b) { return {a.x + b.x, a.y + b.y, a.z + b.z}; }
+  friend Point operator-(Point a, Point b) { return {a.x - b.x, a.y - b.y, a.z - b.z}; }
+  friend Point operator*(Point a, T k) { return {a.x * k, a.y * k, a.z * k}; }
+  friend T dot(Point a, Point b) { return a.x * b.x + a.y * b.y + a.z * b.z; }
+};
+
+template<typename T>
+T clampToUnit(T val)
+{
+  return upper(splat<T>(0), lower(splat<T>(1), val));
+}
+
+template<typename T>
+T solve(Point<T> p0, Point<T> p1, Point<T> q0, Point<T> q1, T& s, T& t)
+{
+  const T tiny = splat<T>(Tiny);
+
+  const Point<T> d1 = p1 - p0;
+  const Point<T> d2 = q1 - q0;
+  const Point<T> r = p0 - q0;
+
+  const T a = dot(d1, d1);
+  const T e = dot(d2, d2);
+  const T b = dot(d1, d2);
+  const T c = dot(d1, r);
+  const T f = dot(d2, r);
+
+  // the closest points of the lines (for parallel lines, the divisor is zero: s ends up at an end)
+  s = clampToUnit((b * f - c * e) / upper(a * e - b * b, tiny));
+
+  // the closest point of [q0; q1] to the point at s, then the closest point of [p0; p1] to it
+  t = clampToUnit((b * s + f) / upper(e, tiny));
+  s = clampToUnit((b * t - c) / upper(a, tiny));
+
+  const Point<T> delta = r + d1 * s - d2 * t;
+  return dot(delta, delta);
+}
+
+Point<Float4> load(const Vec3Array& points, int i)
+{
+  return {load4(&points.x[i]), load4(&points.y[i]), load4(&points.z[i])};
+}
+
+// The last 1 to 3 points, zero-padded
+Point<Float4> loadTail(const Vec3Array& points, int i, int count)
+{
+  float x[4] = {};
+  float y[4] = {};
+  float z[4] = {};
+  for(int k = 0; k < count; ++k)
+  {
+    x[k] = points.x[i + k];
+    y[k] = points.y[i + k];
+    z[k] = points.z[i + k];
+  }
+  return {load4(x), load4(y), load4(z)};
+}
+}
+
+float closestPointsOfSegments(Vec3 p0, Vec3 p1, Vec3 q0, Vec3 q1, float& s, float& t)
+{
+  return solve<float>({p0.x, p0.y, p0.z}, {p1.x, p1.y, p1.z}, {q0.x, q0.y, q0.z}, {q1.x, q1.y, q1.z}, s, t);
+}
+
+void closestPointsOfSegments(const Vec3Array& p0,
+      const Vec3Array& p1,
+      const Vec3Array& q0,
+      const Vec3Array& q1,
+      span<float> s,
+      span<float> t,
+      span<float> distanceSq)
+{
+  const int n = p0.size();
+  Float4 vs, vt;
+
+  int i = 0;
+  for(; i + 4 <= n; i += 4)
+  {
+    store4(&distanceSq[i], solve(load(p0, i), load(p1, i), load(q0, i), load(q1, i), vs, vt));
+    store4(&s[i], vs);
+    store4(&t[i], vt);
+  }
+
+  if(const int rest = n - i)
+  {
+    const Float4 distances =
+          solve(loadTail(p0, i, rest), loadTail(p1, i, rest), loadTail(q0, i, rest), loadTail(q1, i, rest), vs, vt);
+
+    float lanes[3][4];
+    store4(lanes[0], distances);
+    store4(lanes[1], vs);
+    store4(lanes[2], vt);
+
+    for(int k = 0; k < rest; ++k)
+    {
+      distanceSq[i + k] = lanes[0][k];
+      s[i + k] = lanes[1][k];
+      t[i + k] = lanes[2][k];
+    }
+  }
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+// Closest points between 3D segments, e.g for capsule-vs-capsule tests: two capsules overlap
+// when the distance between their segments is below the sum of their radii.
+// The closest points are p0 + (p1 - p0) * s and q0 + (q1 - q0) * t, with s and t in [0; 1].
+
+#include "core/geom.h"
+#include "core/vec2_array.h" // AlignedAllocator
+
+#include <vector>
+
+// Structure-of-arrays storage for 3D points
+struct Vec3Array
+{
+  std::vector<float, AlignedAllocator<float>> x;
+  std::vector<float, AlignedAllocator<float>> y;
+  std::vector<float, AlignedAllocator<float>> z;
+
+  size_t size() const { return x.size(); }
+
+  void resize(size_t n)
+  {
+    x.resize(n);
+    y.resize(n);
+    z.resize(n);
+  }
+
+  void push_back(Vec3 p)
+  {
+    x.push_back(p.x);
+    y.push_back(p.y);
+    z.push_back(p.z);
+  }
+
+  Vec3 operator[](int i) const { return {x[i], y[i], z[i]}; }
+
+  void set(int i, Vec3 p)
+  {
+    x[i] = p.x;
+    y[i] = p.y;
+    z[i] = p.z;
+  }
+};
+
+// The closest points of [p0; p1] and [q0; q1], returns their squared distance.
+// s is first found on the lines, then t from s, clamped, then s again from t, clamped: this stays
+// right when the segments are parallel (the first s can be anything then) or reduced to points.
+// The divisions are by max(divisor, tiny), then clamped: there's no branch, and no NaN.
+float closestPointsOfSegments(Vec3 p0, Vec3 p1, Vec3 q0, Vec3 q1, float& s, float& t);
+
+// The same for many pairs of segments, four at a time (see simd.h), with the same results:
+// the pair i is [p0[i]; p1[i]] and [q0[i]; q1[i]].
+void closestPointsOfSegments(const Vec3Array& p0,
+      const Vec3Array& p1,
+      const Vec3Array& q0,
+      const Vec3Array& q1,
+      span<float> s,
+      span<float> t,
+      span<float> distanceSq);
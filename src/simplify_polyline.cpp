@@ -0,0 +1,376 @@
+#include "simplify_polyline.h"
+
+#include "core/sandbox.h"
+#include "core/vec2_array.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#include "parallel.h"
+
+namespace
+{
+///////////////////////////////////////////////////////////////////////////////
+// Douglas-Peucker
+
+struct Range
+{
+  int first, last;
+};
+
+// the distances are computed by blocks, the farthest vertex is only searched in the blocks going farther
+const int BlockSize = 256;
+
+// ranges shorter than this aren't split before going parallel
+const int MinParallelRange = 4096;
+
+// The vertex of ]first; last[ farthest from the segment (first, last): the first one, on a tie
+int findFarthest(const Vec2Array& points, Range range, float& distanceSq)
+{
+  float block[BlockSize];
+  const Vec2 a = points[range.first];
+  const Vec2 b = points[range.last];
+
+  int farthest = -1;
+  distanceSq = -1;
+  for(int begin = range.first + 1; begin < range.last; begin += BlockSize)
+  {
+    const int end = std::min(begin + BlockSize, range.last);
+    const float blockMax = squaredDistancesToSegment(points, begin, end, a, b, {size_t(BlockSize), block});
+    if(blockMax <= distanceSq)
+      continue;
+
+    for(int i = 0; i < end - begin; ++i)
+    {
+      if(block[i] == blockMax)
+      {
+        farthest = begin + i;
+        break;
+      }
+    }
+
+    distanceSq = blockMax;
+  }
+
+  return farthest;
+}
+
+// Marks in 'keep' the vertex splitting 'range', if any, and returns true
+bool split(const Vec2Array& points, Range range, float toleranceSq, std::vector<uint8_t>& keep, int& farthest)
+{
+  if(range.last - range.first < 2)
+    return false;
+
+  float distanceSq;
+  farthest = findFarthest(points, range, distanceSq);
+
+  sandbox_line(points[range.first], points[range.last], Yellow);
+
+  if(distanceSq <= toleranceSq)
+    return false;
+
+  keep[farthest] = 1;
+  return true;
+}
+
+void simplifyRange(const Vec2Array& points, Range range, float toleranceSq, std::vector<uint8_t>& keep)
+{
+  std::vector<Range> stack;
+  stack.push_back(range);
+
+  while(stack.size())
+  {
+    const Range r = stack.back();
+    stack.pop_back();
+
+    int farthest;
+    if(!split(points, r, toleranceSq, keep, farthest))
+      continue;
+
+    sandbox_circle(points[farthest], 0.2, Green);
+    sandbox_breakpoint();
+
+    stack.push_back({farthest, r.last});
+    stack.push_back({r.first, farthest});
+  }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Visvalingam-Whyatt
+
+float triangleArea(Vec2 a, Vec2 b, Vec2 c)
+{
+  const double cross = double(b.x - a.x) * (c.y - a.y) - double(b.y - a.y) * (c.x - a.x);
+  return float(std::abs(cross) / 2);
+}
+
+// Min-heap of vertices, by area (then by index: the first one wins a tie),
+// with the position of each vertex in it, for updates.
+// The areas are stored in the heap, to compare without an indirection.
+struct AreaHeap
+{
+  struct Entry
+  {
+    float area;
+    int vertex;
+  };
+
+  std::vector<Entry> heap;
+  std::vector<int> position; // by vertex, -1 if not in the heap
+
+  bool empty() const { return heap.empty(); }
+  const Entry& top() const { return heap[0]; }
+
+  // 'entries' becomes the heap, in O(n)
+  void build(std::vector<Entry> entries, int vertexCount)
+  {
+    heap = std::move(entries);
+    position.assign(vertexCount, -1);
+    for(int i = 0; i < (int)heap.size(); ++i)
+      position[heap[i].vertex] = i;
+
+    for(int i = int(heap.size()) / 2 - 1; i >= 0; --i)
+      siftDown(i);
+  }
+
+  void remove(int vertex)
+  {
+    const int i = position[vertex];
+    position[vertex] = -1;
+
+    const Entry last = heap.back();
+    heap.pop_back();
+    if(i == (int)heap.size())
+      return;
+
+    place(i, last);
+    siftUp(i);
+    siftDown(position[last.vertex]);
+  }
+
+  // the area can go either way
+  void update(int vertex, float area)
+  {
+    const int i = position[vertex];
+    heap[i].area = area;
+    siftUp(i);
+    siftDown(position[vertex]);
+  }
+
+private:
+  static bool isLess(const Entry& a, const Entry& b)
+  {
+    return a.area < b.area || (a.area == b.area && a.vertex < b.vertex);
+  }
+
+  void place(int i, Entry entry)
+  {
+    heap[i] = entry;
+    position[entry.vertex] = i;
+  }
+
+  void siftUp(int i)
+  {
+    const Entry entry = heap[i];
+    while(i > 0 && isLess(entry, heap[(i - 1) / 2]))
+    {
+      place(i, heap[(i - 1) / 2]);
+      i = (i - 1) / 2;
+    }
+    place(i, entry);
+  }
+
+  void siftDown(int i)
+  {
+    const Entry entry = heap[i];
+    const int n = heap.size();
+    while(true)
+    {
+      int child = 2 * i + 1;
+      if(child >= n)
+        break;
+      if(child + 1 < n && isLess(heap[child + 1], heap[child]))
+        ++child;
+      if(!isLess(heap[child], entry))
+        break;
+      place(i, heap[child]);
+      i = child;
+    }
+    place(i, entry);
+  }
+};
+
+void simplifyVisvalingam(span<const Vec2> points, const VisvalingamOptions& options, std::vector<int>& kept)
+{
+  const int n = points.len;
+  kept.clear();
+
+  if(n <= 2)
+  {
+    for(int i = 0; i < n; ++i)
+      kept.push_back(i);
+    return;
+  }
+
+  // doubly-linked list of the vertices left
+  std::vector<int> prev(n);
+  std::vector<int> next(n);
+  for(int i = 0; i < n; ++i)
+  {
+    prev[i] = i - 1;
+    next[i] = i + 1;
+  }
+
+  std::vector<AreaHeap::Entry> interior;
+  interior.reserve(n - 2);
+  for(int i = 1; i + 1 < n; ++i)
+    interior.push_back({triangleArea(points[i - 1], points[i], points[i + 1]), i});
+
+  AreaHeap heap;
+  heap.build(std::move(interior), n);
+
+  auto updateArea = [&](int i)
+  {
+    if(prev[i] < 0 || next[i] >= n)
+      return; // an end
+
+    heap.update(i, triangleArea(points[prev[i]], points[i], points[next[i]]));
+  };
+
+  int vertexCount = n;
+  while(vertexCount > 2 && !heap.empty())
+  {
+    const auto top = heap.top();
+    if(top.area >= options.minArea && vertexCount <= options.maxVertexCount)
+      break;
+
+    const int i = top.vertex;
+    heap.remove(i);
+    --vertexCount;
+
+    const int a = prev[i];
+    const int b = next[i];
+    next[a] = b;
+    prev[b] = a;
+    updateArea(a);
+    updateArea(b);
+
+    sandbox_line(points[a], points[b], Green);
+    sandbox_breakpoint();
+  }
+
+  for(int i = 0; i < n; i = next[i])
+    kept.push_back(i);
+}
+}
+
+std::vector<int> simplifyPolyline_DouglasPeucker(span<const Vec2> polyline, float tolerance, int threadCount)
+{
+  const int n = polyline.len;
+  if(n <= 2)
+  {
+    std::vector<int> all(n);
+    for(int i = 0; i < n; ++i)
+      all[i] = i;
+    return all;
+  }
+
+  const Vec2Array points(polyline);
+  const float toleranceSq = tolerance * tolerance;
+
+  std::vector<uint8_t> keep(n);
+  keep[0] = keep[n - 1] = 1;
+
+  std::vector<Range> ranges = {{0, n - 1}};
+  threadCount = resolveThreadCount(threadCount);
+
+  // Split breadth-first until there are enough ranges for all the threads. The split vertices
+  // are only written once: the tasks don't share any byte of 'keep'.
+  if(threadCount > 1)
+  {
+    std::vector<Range> next;
+    while((int)ranges.size() < 4 * threadCount)
+    {
+      bool splitAny = false;
+      next.clear();
+      for(auto r : ranges)
+      {
+        int farthest;
+        if(r.last - r.first < MinParallelRange)
+          next.push_back(r);
+        else if(split(points, r, toleranceSq, keep, farthest))
+        {
+          next.push_back({r.first, farthest});
+          next.push_back({farthest, r.last});
+          splitAny = true;
+        }
+      }
+
+      std::swap(ranges, next);
+      if(!splitAny)
+        break;
+    }
+  }
+
+  parallelFor(ranges.size(), threadCount, [&](int i) { simplifyRange(points, ranges[i], toleranceSq, keep); });
+
+  std::vector<int> kept;
+  for(int i = 0; i < n; ++i)
+  {
+    if(keep[i])
+      kept.push_back(i);
+  }
+  return kept;
+}
+
+std::vector<int> simplifyPolyline_Visvalingam(span<const Vec2> polyline, const VisvalingamOptions& options)
+{
+  std::vector<int> kept;
+  simplifyVisvalingam(polyline, options, kept);
+  return kept;
+}
+
+void VisvalingamStream::push(span<const Vec2> chunk, std::vector<Vec2>& output)
+{
+  if(chunk.len == 0)
+    return;
+
+  // the first vertex is an end: it always stays
+  if(pending.empty())
+    output.push_back(chunk[0]);
+
+  pending.insert(pending.end(), chunk.begin(), chunk.end());
+
+  // small chunks are gathered: each pass removes vertices in a different order than the whole polyline would
+  if((int)pending.size() < MinBatch)
+    return;
+
+  // the last vertex is treated as an end, until the next chunk comes
+  VisvalingamOptions options;
+  options.minArea = minArea;
+  simplifyVisvalingam(pending, options, kept);
+
+  // kept[0] is the last vertex written. The last ones can still be removed later.
+  const int written = std::max(0, int(kept.size()) - 1 - LookBack);
+  for(int i = 1; i <= written; ++i)
+    output.push_back(pending[kept[i]]);
+
+  int k = 0;
+  for(int i = written; i < (int)kept.size(); ++i)
+    pending[k++] = pending[kept[i]];
+  pending.resize(k);
+}
+
+void VisvalingamStream::finish(std::vector<Vec2>& output)
+{
+  VisvalingamOptions options;
+  options.minArea = minArea;
+  simplifyVisvalingam(pending, options, kept);
+
+  for(int i = 1; i < (int)kept.size(); ++i)
+    output.push_back(pending[kept[i]]);
+
+  pending.clear();
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+// Polyline simplification. The ends of the polyline are always kept.
+
+#include "core/geom.h"
+
+#include <climits>
+#include <vector>
+
+// Douglas-Peucker: keeps the vertex farthest from the segment joining the ends, if it's farther
+// than 'tolerance', then does the same on both sides of it.
+// Returns the indices of the vertices kept, in order.
+// The ranges to simplify are on an explicit stack, and the distances computed four vertices
+// at a time (see vec2_array.h). Above 1 thread (0: one per hardware thread), the first splits
+// give independent ranges, simplified in parallel: the result is the same.
+std::vector<int> simplifyPolyline_DouglasPeucker(span<const Vec2> polyline, float tolerance, int threadCount = 1);
+
+// Visvalingam-Whyatt: repeatedly removes the vertex making the smallest triangle with its two
+// neighbours (its 'effective area'), then updates the areas of the neighbours.
+struct VisvalingamOptions
+{
+  // A vertex stays if its effective area is at least this much...
+  float minArea = 0;
+
+  // ...and there are no more than this many vertices left (stopping at 2).
+  int maxVertexCount = INT_MAX;
+};
+
+// Returns the indices of the vertices kept, in order.
+// The vertices are kept in an indexed min-heap by area, and linked to their neighbours:
+// each removal is O(log n), instead of a scan and an erase.
+std::vector<int> simplifyPolyline_Visvalingam(span<const Vec2> polyline, const VisvalingamOptions& options);
+
+// The same, for polylines given a chunk at a time (e.g too big to fit in memory).
+// Only the last vertices (those a removal could still reach) are kept between chunks,
+// so the result can differ a bit from simplifying the whole polyline at once, near the seams.
+// Only 'minArea' applies: the vertex count is only known at the end.
+struct VisvalingamStream
+{
+  float minArea = 0;
+
+  // Appends to 'output' the vertices which are sure to stay
+  void push(span<const Vec2> chunk, std::vector<Vec2>& output);
+
+  // Appends the remaining vertices: the polyline is complete
+  void finish(std::vector<Vec2>& output);
+
+  // Kept vertices not written yet: beyond this count, the oldest ones are written
+  static const int LookBack = 32;
+
+  // Smaller chunks are gathered until there are this many vertices
+  static const int MinBatch = 4096;
+
+  std::vector<Vec2> pending; // the last vertex written (if any), then the ones not written yet
+  std::vector<int> kept;
+};
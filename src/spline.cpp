@@ -0,0 +1,306 @@
+#include "spline.h"
+
+#include "core/simd.h"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+namespace
+{
+// beyond this, pieces are considered flat anyway
+const int MaxSubdivisionDepth = 16;
+
+void locate(const Spline& spline, float u, int& segment, float& t)
+{
+  segment = std::max(0, std::min(spline.segmentCount() - 1, int(floor(u))));
+  t = u - segment;
+}
+
+Vec2 evaluateSegment(const Spline::Segment& s, float t) { return ((s.a * t + s.b) * t + s.c) * t + s.d; }
+
+Vec2 derivative(const Spline::Segment& s, float t) { return (3.0f * s.a * t + 2.0f * s.b) * t + s.c; }
+
+// The length of a segment over [t0; t1]: Gauss-Legendre quadrature of the speed, exact for
+// polynomials up to degree 9 (chords between samples always fall short on bends)
+float arcLength(const Spline::Segment& s, float t0, float t1)
+{
+  static const float nodes[] = {0.0f, -0.5384693101f, 0.5384693101f, -0.9061798459f, 0.9061798459f};
+  static const float weights[] = {0.5688888889f, 0.4786286705f, 0.4786286705f, 0.2369268851f, 0.2369268851f};
+
+  const float half = (t1 - t0) * 0.5f;
+  const float mid = (t0 + t1) * 0.5f;
+
+  float sum = 0;
+  for(int k = 0; k < 5; ++k)
+    sum += weights[k] * magnitude(derivative(s, mid + half * nodes[k]));
+  return sum * half;
+}
+
+// The parameter at 'distance', known to be in the interval i of the arc-length table.
+// The linear interpolation of the table is refined by Newton steps on the arc length,
+// staying within the interval.
+float parameterInInterval(const Spline& spline, int i, float distance)
+{
+  const int n = Spline::LengthSamples;
+  const auto& segment = spline.segments[i / n];
+  const float t0 = float(i % n) / n;
+  const float t1 = float(i % n + 1) / n;
+
+  const float interval = spline.lengths[i + 1] - spline.lengths[i];
+  const float fraction = interval > 0 ? (distance - spline.lengths[i]) / interval : 0;
+  float t = t0 + fraction * (t1 - t0);
+
+  for(int step = 0; step < 2; ++step)
+  {
+    const float error = spline.lengths[i] + arcLength(segment, t0, t) - distance;
+    const float speed = magnitude(derivative(segment, t));
+    if(speed <= 0)
+      break;
+    t = std::max(t0, std::min(t1, t - error / speed));
+  }
+
+  return i / n + t;
+}
+
+float distanceSqToSegment(Vec2 p, Vec2 a, Vec2 b)
+{
+  const Vec2 ab = b - a;
+  const float lengthSq = ab * ab;
+  const float t = lengthSq > 0 ? std::max(0.0f, std::min(1.0f, ((p - a) * ab) / lengthSq)) : 0.0f;
+  const Vec2 delta = a + ab * t - p;
+  return delta * delta;
+}
+
+// Bezier control points of a part of the curve
+struct Bezier
+{
+  Vec2 p[4];
+  int depth;
+};
+
+Bezier toBezier(const Spline::Segment& s)
+{
+  Bezier r;
+  r.p[0] = s.d;
+  r.p[1] = s.d + s.c * (1.0f / 3);
+  r.p[2] = s.d + s.c * (2.0f / 3) + s.b * (1.0f / 3);
+  r.p[3] = s.a + s.b + s.c + s.d;
+  r.depth = 0;
+  return r;
+}
+
+// de Casteljau, at t = 0.5
+void splitBezier(const Bezier& in, Bezier& left, Bezier& right)
+{
+  const Vec2 p01 = (in.p[0] + in.p[1]) * 0.5;
+  const Vec2 p12 = (in.p[1] + in.p[2]) * 0.5;
+  const Vec2 p23 = (in.p[2] + in.p[3]) * 0.5;
+  const Vec2 p012 = (p01 + p12) * 0.5;
+  const Vec2 p123 = (p12 + p23) * 0.5;
+  const Vec2 mid = (p012 + p123) * 0.5;
+
+  left = {{in.p[0], p01, p012, mid}, in.depth + 1};
+  right = {{mid, p123, p23, in.p[3]}, in.depth + 1};
+}
+}
+
+Vec2 Spline::evaluate(float u) const
+{
+  int segment;
+  float t;
+  locate(*this, u, segment, t);
+  return evaluateSegment(segments[segment], t);
+}
+
+void Spline::evaluate(span<const float> params, span<Vec2> out) const
+{
+  const int n = params.len;
+  int i = 0;
+
+  // the parameters can be in different segments: the coefficients are gathered by lane
+  for(; i + 4 <= n; i += 4)
+  {
+    float coefs[8][4];
+    float ts[4];
+    for(int lane = 0; lane < 4; ++lane)
+    {
+      int segment;
+      locate(*this, params[i + lane], segment, ts[lane]);
+      const Segment& s = segments[segment];
+      const float values[8] = {s.a.x, s.a.y, s.b.x, s.b.y, s.c.x, s.c.y, s.d.x, s.d.y};
+      for(int k = 0; k < 8; ++k)
+        coefs[k][lane] = values[k];
+    }
+
+    const Float4 t = load4(ts);
+    Float4 x = load4(coefs[0]);
+    Float4 y = load4(coefs[1]);
+    for(int k = 2; k < 8; k += 2)
+    {
+      x = multiplyAdd(x, t, load4(coefs[k]));
+      y = multiplyAdd(y, t, load4(coefs[k + 1]));
+    }
+
+    float xs[4], ys[4];
+    store4(xs, x);
+    store4(ys, y);
+    for(int lane = 0; lane < 4; ++lane)
+      out[i + lane] = {xs[lane], ys[lane]};
+  }
+
+  for(; i < n; ++i)
+    out[i] = evaluate(params[i]);
+}
+
+float Spline::parameterAt(float distance) const
+{
+  if(lengths.size() < 2)
+    return 0;
+
+  distance = std::max(0.0f, std::min(length(), distance));
+
+  const int last = int(lengths.size()) - 2;
+  const int i = std::min(last, int(std::upper_bound(lengths.begin(), lengths.end(), distance) - lengths.begin()) - 1);
+  return parameterInInterval(*this, i, distance);
+}
+
+Spline createCatmullRomSpline(span<const Vec2> controlPoints, const CatmullRomOptions& options)
+{
+  Spline spline;
+
+  const int N = controlPoints.len;
+  if(N < (options.closed ? 3 : 2))
+    return spline;
+
+  // an open curve is extended by mirroring the points next to its ends
+  auto point = [&](int i) -> Vec2
+  {
+    if(options.closed)
+      return controlPoints[(i + N) % N];
+    if(i < 0)
+      return controlPoints[0] * 2 - controlPoints[1];
+    if(i >= N)
+      return controlPoints[N - 1] * 2 - controlPoints[N - 2];
+    return controlPoints[i];
+  };
+
+  // the pow() of the parameterization is only computed here
+  auto knotInterval = [&](Vec2 a, Vec2 b) { return std::max(1e-6f, powf(magnitude(a - b), options.alpha)); };
+
+  const int segmentCount = options.closed ? N : N - 1;
+  spline.segments.resize(segmentCount);
+  for(int i = 0; i < segmentCount; ++i)
+  {
+    const Vec2 p0 = point(i - 1);
+    const Vec2 p1 = point(i);
+    const Vec2 p2 = point(i + 1);
+    const Vec2 p3 = point(i + 2);
+
+    const float t0 = 0.0f;
+    const float t1 = t0 + knotInterval(p0, p1);
+    const float t2 = t1 + knotInterval(p1, p2);
+    const float t3 = t2 + knotInterval(p2, p3);
+
+    const float tension = options.tension;
+    const Vec2 v0 = tension * (t2 - t1) * ((p1 - p0) / (t1 - t0) - (p2 - p0) / (t2 - t0) + (p2 - p1) / (t2 - t1));
+    const Vec2 v1 = tension * (t2 - t1) * ((p2 - p1) / (t2 - t1) - (p3 - p1) / (t3 - t1) + (p3 - p2) / (t3 - t2));
+
+    // p(t) = at^3 + bt^2 + ct + d, and p'(t) = 3at^2 + 2bt + c, must meet:
+    // | p(0)  = p1      | d             = p1
+    // | p(1)  = p2  =>  | a + b + c + d = p2
+    // | p'(0) = v0      | c             = v0
+    // | p'(1) = v1      | 3a + 2b + c   = v1
+    //
+    // Solving for a,b,c,d:
+    // | a =  2p1 - 2p2 +  v0 + v1
+    // | b = -3p1 + 3p2 - 2v0 - v1
+    // | c = v0
+    // | d = p1
+    auto& s = spline.segments[i];
+    s.a = 2.0f * (p1 - p2) + v0 + v1;
+    s.b = -3.0f * (p1 - p2) - 2 * v0 - v1;
+    s.c = v0;
+    s.d = p1;
+  }
+
+  // arc-length table
+  spline.lengths.resize(segmentCount * Spline::LengthSamples + 1);
+  spline.lengths[0] = 0;
+
+  float total = 0;
+  for(int i = 0; i < segmentCount; ++i)
+  {
+    for(int k = 0; k < Spline::LengthSamples; ++k)
+    {
+      total += arcLength(spline.segments[i], float(k) / Spline::LengthSamples, float(k + 1) / Spline::LengthSamples);
+      spline.lengths[i * Spline::LengthSamples + k + 1] = total;
+    }
+  }
+
+  return spline;
+}
+
+void tessellate(const Spline& spline, float tolerance, std::vector<Vec2>& out)
+{
+  if(spline.segments.empty())
+    return;
+
+  const float toleranceSq = tolerance * tolerance;
+
+  // each segment is turned into Bezier control points: the curve stays within their convex hull,
+  // so a piece whose inner control points are close to its chord is flat enough
+  std::vector<Bezier> stack;
+  out.push_back(spline.segments[0].d);
+  for(auto& segment : spline.segments)
+  {
+    stack.push_back(toBezier(segment));
+    while(stack.size())
+    {
+      const Bezier piece = stack.back();
+      stack.pop_back();
+
+      const bool flat = distanceSqToSegment(piece.p[1], piece.p[0], piece.p[3]) <= toleranceSq &&
+            distanceSqToSegment(piece.p[2], piece.p[0], piece.p[3]) <= toleranceSq;
+
+      if(flat || piece.depth >= MaxSubdivisionDepth)
+      {
+        out.push_back(piece.p[3]);
+        continue;
+      }
+
+      Bezier left, right;
+      splitBezier(piece, left, right);
+      stack.push_back(right);
+      stack.push_back(left);
+    }
+  }
+}
+
+void sampleByDistance(const Spline& spline, float spacing, std::vector<Vec2>& out)
+{
+  if(spline.lengths.size() < 2 || spacing <= 0)
+    return;
+
+  // the end, unless the last regular sample is already on it
+  const int regularCount = int(spline.length() / spacing) + 1;
+  const bool addEnd = spline.length() - (regularCount - 1) * spacing > spacing * 1e-3f;
+  const int count = regularCount + (addEnd ? 1 : 0);
+
+  // the distances increase: the table is walked once, instead of searched for each of them
+  std::vector<float> params(count);
+  const int last = int(spline.lengths.size()) - 2;
+  int i = 0;
+  for(int k = 0; k < count; ++k)
+  {
+    const float distance = std::min(spline.length(), k * spacing);
+    while(i < last && spline.lengths[i + 1] <= distance)
+      ++i;
+
+    params[k] = parameterInInterval(spline, i, distance);
+  }
+
+  const size_t first = out.size();
+  out.resize(first + count);
+  spline.evaluate(params, {size_t(count), out.data() + first});
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+// Piecewise cubic curves (e.g camera and AI paths), with their coefficients computed once.
+// The curve is parameterized by u in [0; segmentCount]: segment floor(u), at t = u - floor(u).
+
+#include "core/geom.h"
+
+#include <vector>
+
+struct CatmullRomOptions
+{
+  // 0: uniform, 0.5: centripetal (no cusp nor self-intersection within a segment), 1: chordal
+  float alpha = 0.5;
+  float tension = 1.0;
+
+  // a closed curve joins the last control point to the first one
+  bool closed = true;
+};
+
+struct Spline
+{
+  // p(t) = at^3 + bt^2 + ct + d, t in [0; 1]
+  struct Segment
+  {
+    Vec2 a, b, c, d;
+  };
+
+  std::vector<Segment> segments;
+
+  // Arc-length table: the length of the curve from its start to u = i / LengthSamples
+  // (only a starting point for 'parameterAt', which refines it)
+  static const int LengthSamples = 16; // by segment
+  std::vector<float> lengths;
+
+  int segmentCount() const { return int(segments.size()); }
+  float length() const { return lengths.empty() ? 0 : lengths.back(); }
+
+  Vec2 evaluate(float u) const;
+
+  // out[i] = evaluate(params[i]), four parameters at a time
+  void evaluate(span<const float> params, span<Vec2> out) const;
+
+  // The parameter at 'distance' along the curve, clamped to its ends
+  float parameterAt(float distance) const;
+};
+
+// The Catmull-Rom spline going through all the control points.
+// (an open one needs at least 2 of them, a closed one at least 3)
+Spline createCatmullRomSpline(span<const Vec2> controlPoints, const CatmullRomOptions& options);
+
+// Appends to 'out' a polyline staying within 'tolerance' of the curve.
+// Each segment is split where it bends, instead of uniformly: straight parts get few vertices.
+void tessellate(const Spline& spline, float tolerance, std::vector<Vec2>& out);
+
+// Appends to 'out' points every 'spacing' along the curve (constant-speed sampling),
+// from the start to the end: the last point is the end of the curve, closer than 'spacing'
+// to the previous one when the length isn't a multiple of it.
+void sampleByDistance(const Spline& spline, float spacing, std::vector<Vec2>& out);
@@ -6,89 +6,156 @@
 #include <algorithm>
 #include <cassert>
 #include <cmath>
-#include <map>
 
 static constexpr auto epsilon = 0.01f;
 
-// dedup vertices
-int addVertex(Polygon2f& poly, Vec2 a)
+namespace
+{
+using VertexGrid = SplitPolygonBuffers::VertexGrid;
+
+uint64_t cellKey(int64_t x, int64_t y) { return (uint64_t(uint32_t(x)) << 32) | uint32_t(y); }
+
+// the slot of 'key', or the empty slot where it would go
+int findSlot(const VertexGrid& grid, uint64_t key)
+{
+  const int mask = int(grid.cells.size()) - 1;
+  int slot = int((key * 0x9E3779B97F4A7C15ull) >> 40) & mask;
+  while(grid.firstVertex[slot] >= 0 && grid.cells[slot] != key)
+    slot = (slot + 1) & mask;
+  return slot;
+}
+
+void insertVertex(VertexGrid& grid, Vec2 v, int index)
+{
+  const uint64_t key = cellKey(int64_t(std::floor(v.x / epsilon)), int64_t(std::floor(v.y / epsilon)));
+  const int slot = findSlot(grid, key);
+
+  if(grid.firstVertex[slot] < 0)
+  {
+    grid.cells[slot] = key;
+    grid.cellCount++;
+  }
+
+  if(index >= (int)grid.nextVertex.size())
+    grid.nextVertex.resize(index + 1);
+
+  grid.nextVertex[index] = grid.firstVertex[slot];
+  grid.firstVertex[slot] = index;
+}
+
+// Empties the grid, making room for about 'vertexCount' vertices
+void resetGrid(VertexGrid& grid, int vertexCount)
+{
+  int size = 16;
+  while(size < vertexCount * 2)
+    size *= 2;
+
+  grid.cells.resize(std::max(size, (int)grid.cells.size()));
+  grid.firstVertex.assign(grid.cells.size(), -1);
+  grid.nextVertex.clear();
+  grid.cellCount = 0;
+}
+
+// dedup vertices: the first one closer than 'epsilon' is reused
+int addVertex(Polygon2f& poly, VertexGrid& grid, Vec2 a)
 {
   const auto N = (int)poly.vertices.size();
 
-  for(int i = 0; i < N; ++i)
+  const int64_t cx = int64_t(std::floor(a.x / epsilon));
+  const int64_t cy = int64_t(std::floor(a.y / epsilon));
+
+  int found = N;
+  for(int64_t y = cy - 1; y <= cy + 1; ++y)
   {
-    auto delta = poly.vertices[i] - a;
-    if(dotProduct(delta, delta) < epsilon * epsilon)
-      return i;
+    for(int64_t x = cx - 1; x <= cx + 1; ++x)
+    {
+      const int slot = findSlot(grid, cellKey(x, y));
+      for(int i = grid.firstVertex[slot]; i >= 0; i = grid.nextVertex[i])
+      {
+        auto delta = poly.vertices[i] - a;
+        if(i < found && dotProduct(delta, delta) < epsilon * epsilon)
+          found = i;
+      }
+    }
   }
 
+  if(found < N)
+    return found;
+
   poly.vertices.push_back(a);
+
+  // keep the load factor under 1/2
+  if((grid.cellCount + 1) * 2 > (int)grid.cells.size())
+  {
+    resetGrid(grid, grid.cells.size());
+    for(int i = 0; i < N + 1; ++i)
+      insertVertex(grid, poly.vertices[i], i);
+  }
+  else
+  {
+    insertVertex(grid, a, N);
+  }
+
   return N;
 }
 
-void addFace(Polygon2f& poly, Vec2 a, Vec2 b)
+void addFace(Polygon2f& poly, VertexGrid& grid, Vec2 a, Vec2 b)
 {
   if(magnitude(a - b) < epsilon)
     return;
 
-  const auto ia = addVertex(poly, a);
-  const auto ib = addVertex(poly, b);
+  const auto ia = addVertex(poly, grid, a);
+  const auto ib = addVertex(poly, grid, b);
   poly.faces.push_back({ia, ib});
 }
 
-void closePolygon(Polygon2f& poly, Vec2 tangentCut)
+// The vertices are unique: the ones used by a single face are the ends of the cut
+void closePolygon(Polygon2f& poly, VertexGrid& grid, Vec2 tangentCut, SplitPolygonBuffers& buffers)
 {
-  struct LessVec2f
-  {
-    bool operator()(Vec2 a, Vec2 b) const
-    {
-      if(a.x != b.x)
-        return a.x < b.x;
-      return a.y < b.y;
-    }
-  };
-
-  std::map<Vec2, int, LessVec2f> points;
+  auto& degrees = buffers.degrees;
+  degrees.assign(poly.vertices.size(), 0);
   for(auto face : poly.faces)
   {
-    points[poly.vertices[face.a]]++;
-    points[poly.vertices[face.b]]++;
+    degrees[face.a]++;
+    degrees[face.b]++;
   }
 
-  std::vector<Vec2> orphans;
-  for(auto& p : points)
+  auto& orphans = buffers.orphans;
+  orphans.clear();
+  for(int i = 0; i < (int)poly.vertices.size(); ++i)
   {
-    assert(p.second == 1 || p.second == 2);
-    if(p.second == 1)
-      orphans.push_back(p.first);
+    assert(degrees[i] == 1 || degrees[i] == 2);
+    if(degrees[i] == 1)
+      orphans.push_back(i);
   }
 
-  auto byTangentCoord = [tangentCut](Vec2 a, Vec2 b) { return dotProduct(a, tangentCut) < dotProduct(b, tangentCut); };
+  auto byTangentCoord = [&](int a, int b)
+  { return dotProduct(poly.vertices[a], tangentCut) < dotProduct(poly.vertices[b], tangentCut); };
 
   std::sort(orphans.begin(), orphans.end(), byTangentCoord);
 
   assert(orphans.size() % 2 == 0);
-  for(int i = 0; i < (int)orphans.size(); i += 2)
-    addFace(poly, orphans[i + 0], orphans[i + 1]);
+  for(int i = 0; i + 1 < (int)orphans.size(); i += 2)
+    addFace(poly, grid, poly.vertices[orphans[i + 0]], poly.vertices[orphans[i + 1]]);
 }
 
-void splitPolygonAgainstPlane(const Polygon2f& poly, Plane plane, Polygon2f& front, Polygon2f& back)
+void clearPolygon(Polygon2f& poly, VertexGrid& grid, int vertexCount)
 {
-  const auto T = rotateLeft(plane.normal);
+  poly.vertices.clear();
+  poly.faces.clear();
+  resetGrid(grid, vertexCount);
+}
 
-  for(auto v : poly.vertices)
-  {
-    const auto dist = dotProduct(v, plane.normal) - plane.dist;
-    Color c;
-    if(dist > epsilon)
-      c = LightBlue;
-    else if(dist < -epsilon)
-      c = Green;
-    else
-      c = Yellow;
+// 'back' can be null, when only the front side is needed
+void split(const Polygon2f& poly, Plane plane, Polygon2f& front, Polygon2f* back, SplitPolygonBuffers& buffers)
+{
+  const auto T = rotateLeft(plane.normal);
 
-    sandbox_circle(v, 0.2, c);
-  }
+  // at most one intersection per face
+  const int capacity = poly.vertices.size() + poly.faces.size();
+  clearPolygon(front, buffers.front, capacity);
+  if(back)
+    clearPolygon(*back, buffers.back, capacity);
 
   for(auto face : poly.faces)
   {
@@ -104,11 +171,12 @@ void splitPolygonAgainstPlane(const Polygon2f& poly, Plane plane, Polygon2f& fro
     }
     else if(dist_a >= 0 && dist_b >= 0)
     {
-      addFace(front, a, b);
+      addFace(front, buffers.front, a, b);
     }
     else if(dist_a <= 0 && dist_b <= 0)
     {
-      addFace(back, a, b);
+      if(back)
+        addFace(*back, buffers.back, a, b);
     }
     else // the face is crossing the plane, split it
     {
@@ -116,18 +184,75 @@ void splitPolygonAgainstPlane(const Polygon2f& poly, Plane plane, Polygon2f& fro
 
       if(dist_a > 0 && dist_b < 0)
       {
-        addFace(front, a, intersection);
-        addFace(back, intersection, b);
+        addFace(front, buffers.front, a, intersection);
+        if(back)
+          addFace(*back, buffers.back, intersection, b);
       }
       else
       {
         assert(dist_a < 0 && dist_b > 0);
-        addFace(front, intersection, b);
-        addFace(back, a, intersection);
+        addFace(front, buffers.front, intersection, b);
+        if(back)
+          addFace(*back, buffers.back, a, intersection);
       }
     }
   }
 
-  closePolygon(back, T);
-  closePolygon(front, -T);
+  if(back)
+    closePolygon(*back, buffers.back, T, buffers);
+  closePolygon(front, buffers.front, -T, buffers);
+}
+}
+
+void splitPolygonAgainstPlane(const Polygon2f& poly, Plane plane, Polygon2f& front, Polygon2f& back)
+{
+  SplitPolygonBuffers buffers;
+  splitPolygonAgainstPlane(poly, plane, front, back, buffers);
+}
+
+void splitPolygonAgainstPlane(
+      const Polygon2f& poly, Plane plane, Polygon2f& front, Polygon2f& back, SplitPolygonBuffers& buffers)
+{
+  for(auto v : poly.vertices)
+  {
+    const auto dist = dotProduct(v, plane.normal) - plane.dist;
+    Color c;
+    if(dist > epsilon)
+      c = LightBlue;
+    else if(dist < -epsilon)
+      c = Green;
+    else
+      c = Yellow;
+
+    sandbox_circle(v, 0.2, c);
+  }
+
+  split(poly, plane, front, &back, buffers);
+}
+
+void clipPolygonAgainstPlanes(
+      const Polygon2f& poly, span<const Plane> planes, Polygon2f& result, SplitPolygonBuffers& buffers)
+{
+  if(planes.len == 0)
+  {
+    result = poly;
+    return;
+  }
+
+  // from one piece to the other, the last plane writing to 'result'
+  const Polygon2f* input = &poly;
+  for(int i = 0; i < (int)planes.len; ++i)
+  {
+    const bool isLast = i + 1 == (int)planes.len;
+    Polygon2f& output = isLast ? result : buffers.pieces[i % 2];
+    split(*input, planes[i], output, nullptr, buffers);
+    input = &output;
+
+    if(output.faces.empty())
+    {
+      result.vertices.clear();
+      result.faces.clear();
+      break;
+    }
+  }
 }
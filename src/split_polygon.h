@@ -2,6 +2,9 @@
 
 #include "core/geom.h"
 
+#include <cstdint>
+#include <vector>
+
 #include "polygon.h"
 
 struct Plane
@@ -10,4 +13,35 @@ struct Plane
   float dist;
 };
 
+// Temporary storage of the splits: keeping it from one call to the next avoids most allocations.
+struct SplitPolygonBuffers
+{
+  // The vertices of an output polygon, by cell of a grid (hashed): vertices closer
+  // than the welding distance can only be in neighbouring cells.
+  struct VertexGrid
+  {
+    std::vector<uint64_t> cells;
+    std::vector<int> firstVertex; // by cell, -1 for an empty slot
+    std::vector<int> nextVertex; // in the same cell
+    int cellCount = 0;
+  };
+
+  VertexGrid front;
+  VertexGrid back;
+  std::vector<int> degrees;
+  std::vector<int> orphans;
+  Polygon2f pieces[2];
+};
+
+// Cuts 'poly' in two along the plane (the front side is where the normal points to).
+// Vertices closer than a small distance are merged, and 'front' and 'back' are overwritten.
 void splitPolygonAgainstPlane(const Polygon2f& poly, Plane plane, Polygon2f& front, Polygon2f& back);
+
+// Same, reusing the storage of 'front', 'back' and 'buffers'
+void splitPolygonAgainstPlane(
+      const Polygon2f& poly, Plane plane, Polygon2f& front, Polygon2f& back, SplitPolygonBuffers& buffers);
+
+// Keeps the part of 'poly' in front of all the planes (i.e the intersection with a convex region).
+// Only the front side is built for each plane, and 'result' is overwritten.
+void clipPolygonAgainstPlanes(
+      const Polygon2f& poly, span<const Plane> planes, Polygon2f& result, SplitPolygonBuffers& buffers);
@@ -0,0 +1,246 @@
+#include "stroke_polyline.h"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "parallel.h"
+
+namespace
+{
+// Cross products below this are straight lines: no join
+const float CollinearEpsilon = 1e-6;
+
+float cross(Vec2 a, Vec2 b) { return a.x * b.y - a.y * b.x; }
+
+// The stroking is done twice: once to count the vertices and indices, then to write them.
+struct Counter
+{
+  int vertexCount = 0;
+  int indexCount = 0;
+
+  int vertex(Vec2) { return vertexCount++; }
+  void triangle(int, int, int) { indexCount += 3; }
+};
+
+struct Writer
+{
+  Writer(Vec2* vertices_, int* indices_, int vertexBase_)
+      : vertices(vertices_)
+      , indices(indices_)
+      , vertexBase(vertexBase_)
+  {
+  }
+
+  Vec2* vertices;
+  int* indices;
+  int vertexBase;
+  int vertexCount = 0;
+  int indexCount = 0;
+
+  int vertex(Vec2 p)
+  {
+    vertices[vertexCount] = p;
+    return vertexBase + vertexCount++;
+  }
+
+  // the wedges can turn either way: the winding is fixed here
+  void triangle(int a, int b, int c)
+  {
+    const Vec2 pa = vertices[a - vertexBase];
+    const Vec2 pb = vertices[b - vertexBase];
+    const Vec2 pc = vertices[c - vertexBase];
+    if(cross(pb - pa, pc - pa) < 0)
+      std::swap(b, c);
+
+    indices[indexCount++] = a;
+    indices[indexCount++] = b;
+    indices[indexCount++] = c;
+  }
+};
+
+Vec2 rotate(Vec2 v, float cosAngle, float sinAngle)
+{
+  return {v.x * cosAngle - v.y * sinAngle, v.x * sinAngle + v.y * cosAngle};
+}
+
+// Fan around 'center', from the vertex 'first' (at center + from) to the vertex 'last',
+// turning by 'angle' (counter-clockwise if positive).
+template<typename Sink>
+void fan(Sink& sink, Vec2 center, Vec2 from, float angle, int first, int last, int steps)
+{
+  const int c = sink.vertex(center);
+  const float cosStep = cos(angle / steps);
+  const float sinStep = sin(angle / steps);
+
+  int prev = first;
+  Vec2 offset = from;
+  for(int i = 1; i < steps; ++i)
+  {
+    offset = rotate(offset, cosStep, sinStep);
+    const int v = sink.vertex(center + offset);
+    sink.triangle(c, prev, v);
+    prev = v;
+  }
+  sink.triangle(c, prev, last);
+}
+
+int roundSteps(float angle, int roundSegments)
+{
+  return std::max(1, int(ceil(angle / M_PI * roundSegments - 1e-3)));
+}
+
+// Fills the outer side of the turn at 'p', from the end of the previous quad to the start of the next one
+template<typename Sink>
+void join(Sink& sink, const StrokeOptions& options, Vec2 p, Vec2 d0, Vec2 d1, int prevLeft, int prevRight,
+      int nextLeft, int nextRight)
+{
+  const float turn = cross(d0, d1);
+  if(fabs(turn) <= CollinearEpsilon && d0 * d1 > 0)
+    return;
+
+  // turning left, the gap is on the right
+  const float w = options.halfWidth;
+  const bool left = turn >= 0;
+  const Vec2 outer0 = rotateLeft(d0) * (left ? -w : w);
+  const Vec2 outer1 = rotateLeft(d1) * (left ? -w : w);
+  const int first = left ? prevRight : prevLeft;
+  const int last = left ? nextRight : nextLeft;
+
+  if(options.join == LineJoin::Round)
+  {
+    const float angle = acos(std::max(-1.0f, std::min(1.0f, (outer0 * outer1) / (w * w))));
+    fan(sink, p, outer0, left ? angle : -angle, first, last, roundSteps(angle, options.roundSegments));
+    return;
+  }
+
+  const int c = sink.vertex(p);
+
+  if(options.join == LineJoin::Miter)
+  {
+    const Vec2 bisector = outer0 + outer1;
+    const float bisectorLength = magnitude(bisector);
+
+    // cosine of half the angle between the normals: the miter is w / cosHalf long
+    const float cosHalf = bisectorLength > 0 ? (bisector * outer0) / (bisectorLength * w) : 0;
+    if(cosHalf * options.miterLimit >= 1)
+    {
+      const int tip = sink.vertex(p + bisector * (w / (cosHalf * bisectorLength)));
+      sink.triangle(c, first, tip);
+      sink.triangle(c, tip, last);
+      return;
+    }
+  }
+
+  sink.triangle(c, first, last);
+}
+
+template<typename Sink>
+void stroke(span<const Vec2> polyline, const StrokeOptions& options, Sink& sink)
+{
+  const int n = polyline.len;
+  const float w = options.halfWidth;
+
+  auto nextDistinct = [&](int i)
+  {
+    int j = i + 1;
+    while(j < n && polyline[j] == polyline[i])
+      ++j;
+    return j;
+  };
+
+  int i = 0;
+  int j = nextDistinct(0);
+  if(j >= n)
+    return;
+
+  Vec2 prevDir{};
+  int prevLeft = -1;
+  int prevRight = -1;
+
+  while(j < n)
+  {
+    const int next = nextDistinct(j);
+    const bool first = prevLeft < 0;
+    const bool last = next >= n;
+
+    const Vec2 dir = normalize(polyline[j] - polyline[i]);
+    const Vec2 normal = rotateLeft(dir) * w;
+
+    Vec2 a = polyline[i];
+    Vec2 b = polyline[j];
+    if(options.cap == LineCap::Square)
+    {
+      if(first)
+        a = a - dir * w;
+      if(last)
+        b = b + dir * w;
+    }
+
+    const int aLeft = sink.vertex(a + normal);
+    const int aRight = sink.vertex(a - normal);
+    const int bLeft = sink.vertex(b + normal);
+    const int bRight = sink.vertex(b - normal);
+    sink.triangle(aRight, bRight, bLeft);
+    sink.triangle(aRight, bLeft, aLeft);
+
+    if(first)
+    {
+      if(options.cap == LineCap::Round)
+        fan(sink, a, normal, M_PI, aLeft, aRight, options.roundSegments);
+    }
+    else
+    {
+      join(sink, options, polyline[i], prevDir, dir, prevLeft, prevRight, aLeft, aRight);
+    }
+
+    if(last && options.cap == LineCap::Round)
+      fan(sink, b, -normal, M_PI, bRight, bLeft, options.roundSegments);
+
+    prevDir = dir;
+    prevLeft = bLeft;
+    prevRight = bRight;
+    i = j;
+    j = next;
+  }
+}
+
+span<const Vec2> polylineOf(span<const Vec2> points, span<const int> start, int i)
+{
+  return {size_t(start[i + 1] - start[i]), points.ptr + start[i]};
+}
+}
+
+void strokePolylines(span<const Vec2> points, span<const int> start, const StrokeOptions& options, StrokeMesh& mesh)
+{
+  const int count = std::max(0, int(start.len) - 1);
+
+  mesh.vertexStart.assign(count + 1, 0);
+  mesh.indexStart.assign(count + 1, 0);
+
+  parallelFor(count, options.threadCount,
+        [&](int i)
+        {
+          Counter counter;
+          stroke(polylineOf(points, start, i), options, counter);
+          mesh.vertexStart[i + 1] = counter.vertexCount;
+          mesh.indexStart[i + 1] = counter.indexCount;
+        });
+
+  for(int i = 0; i < count; ++i)
+  {
+    mesh.vertexStart[i + 1] += mesh.vertexStart[i];
+    mesh.indexStart[i + 1] += mesh.indexStart[i];
+  }
+
+  mesh.vertices.resize(mesh.vertexStart[count]);
+  mesh.indices.resize(mesh.indexStart[count]);
+
+  parallelFor(count, options.threadCount,
+        [&](int i)
+        {
+          Writer writer(mesh.vertices.data() + mesh.vertexStart[i], mesh.indices.data() + mesh.indexStart[i],
+                mesh.vertexStart[i]);
+          stroke(polylineOf(points, start, i), options, writer);
+        });
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+// Polyline stroking: thick lines (roads, trails ...) as indexed triangles, ready for a GPU buffer.
+
+#include "core/geom.h"
+
+#include <vector>
+
+enum class LineJoin
+{
+  Miter,
+  Bevel,
+  Round,
+};
+
+enum class LineCap
+{
+  Butt,
+  Square,
+  Round,
+};
+
+struct StrokeOptions
+{
+  float halfWidth = 1;
+  LineJoin join = LineJoin::Miter;
+  LineCap cap = LineCap::Butt;
+
+  // a miter longer than this many half-widths is replaced by a bevel
+  float miterLimit = 4;
+
+  // triangles of a round cap (half a turn). Round joins use as many for the same angle.
+  int roundSegments = 8;
+
+  // 0: one per hardware thread
+  int threadCount = 1;
+};
+
+// One quad per segment, and wedges filling the outer side of joins.
+// The polyline i gets vertices[vertexStart[i]] ... vertices[vertexStart[i + 1] - 1],
+// and the triangles in indices[indexStart[i]] ... indices[indexStart[i + 1] - 1], 3 per triangle,
+// counter-clockwise. The indices refer to the whole vertex buffer.
+struct StrokeMesh
+{
+  std::vector<Vec2> vertices;
+  std::vector<int> indices;
+  std::vector<int> vertexStart;
+  std::vector<int> indexStart;
+};
+
+// Strokes the polylines points[start[i]] ... points[start[i + 1] - 1] into 'mesh', which is overwritten
+// (reusing it from one call to the next keeps its buffers).
+// The sizes are counted first, so each polyline is then written in place, in parallel.
+// Repeated points are skipped. A polyline with less than two distinct points gives nothing.
+void strokePolylines(span<const Vec2> points, span<const int> start, const StrokeOptions& options, StrokeMesh& mesh);
@@ -0,0 +1,63 @@
+#include "triangle_mesh.h"
+
+#include <algorithm>
+
+std::vector<Edge> computeEdges(const TriangleMesh& mesh)
+{
+  std::vector<Edge> edges;
+  edges.reserve(mesh.triangles.size() * 3 / 2 + 3);
+
+  for(int t = 0; t < (int)mesh.triangles.size(); ++t)
+  {
+    auto& triangle = mesh.triangles[t];
+
+    // an interior edge belongs to two triangles: emit it from the lowest one
+    for(int i = 0; i < 3; ++i)
+    {
+      if(triangle.neighbours[i] < t)
+        edges.push_back({triangle.vertices[i], triangle.vertices[(i + 1) % 3]});
+    }
+  }
+
+  return edges;
+}
+
+void linkNeighbours(TriangleMesh& mesh)
+{
+  struct HalfEdge
+  {
+    int lo, hi; // vertices
+    int triangle;
+    int slot;
+  };
+
+  std::vector<HalfEdge> halfEdges;
+  halfEdges.reserve(mesh.triangles.size() * 3);
+
+  for(int t = 0; t < (int)mesh.triangles.size(); ++t)
+  {
+    auto& triangle = mesh.triangles[t];
+    for(int i = 0; i < 3; ++i)
+    {
+      const int a = triangle.vertices[i];
+      const int b = triangle.vertices[(i + 1) % 3];
+      halfEdges.push_back({std::min(a, b), std::max(a, b), t, i});
+      triangle.neighbours[i] = -1;
+    }
+  }
+
+  auto byEdge = [](const HalfEdge& u, const HalfEdge& v) { return u.lo != v.lo ? u.lo < v.lo : u.hi < v.hi; };
+  std::sort(halfEdges.begin(), halfEdges.end(), byEdge);
+
+  for(int i = 0; i + 1 < (int)halfEdges.size(); ++i)
+  {
+    auto& u = halfEdges[i];
+    auto& v = halfEdges[i + 1];
+    if(u.lo != v.lo || u.hi != v.hi)
+      continue;
+
+    mesh.triangles[u.triangle].neighbours[u.slot] = v.triangle;
+    mesh.triangles[v.triangle].neighbours[v.slot] = u.triangle;
+    ++i;
+  }
+}
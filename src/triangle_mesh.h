@@ -0,0 +1,33 @@
+#pragma once
+
+// Output of the triangulations: indexed triangles which know their neighbours,
+// so the topology doesn't have to be rebuilt from an edge list (e.g to walk a navmesh).
+
+#include "core/geom.h"
+
+#include <vector>
+
+struct Edge
+{
+  int a, b;
+};
+
+// Counter-clockwise vertices (indices of the input points), and neighbours:
+// 'neighbours[i]' is the triangle across the edge (vertices[i], vertices[(i + 1) % 3]), or -1 on the hull.
+struct MeshTriangle
+{
+  int vertices[3];
+  int neighbours[3];
+};
+
+struct TriangleMesh
+{
+  std::vector<MeshTriangle> triangles;
+};
+
+// Each edge of the mesh once
+std::vector<Edge> computeEdges(const TriangleMesh& mesh);
+
+// Fills the neighbours from the vertices: two triangles are neighbours if they share an edge
+// (in opposite directions). By sorting the edges, in O(n log n).
+void linkNeighbours(TriangleMesh& mesh);
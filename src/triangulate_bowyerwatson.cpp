@@ -10,11 +10,19 @@
 
 #include "triangulate_bowyerwatson.h"
 
+#include "core/arena.h"
 #include "core/geom.h"
 #include "core/sandbox.h"
+#include "core/vec2_array.h"
+#include "core/zones.h"
 
+#include <cstdint>
 #include <vector>
 
+#include "morton.h"
+#include "predicates.h"
+#include "random.h"
+
 namespace
 {
 
@@ -68,18 +76,13 @@ Triangle makeTriangle(int p0, int p1, int p2, span<const Vec2> coords)
 
 Triangle createSuperTriangle(std::vector<Vec2>& coords)
 {
-  float min_x = coords[0].x;
-  float max_x = coords[0].x;
-  float min_y = coords[0].y;
-  float max_y = coords[0].y;
+  Vec2 min, max;
+  computeBounds(coords, min, max);
 
-  for(auto& p : coords)
-  {
-    min_x = std::min(min_x, p.x);
-    max_x = std::max(max_x, p.x);
-    min_y = std::min(min_y, p.y);
-    max_y = std::max(max_y, p.y);
-  }
+  float min_x = min.x;
+  float max_x = max.x;
+  float min_y = min.y;
+  float max_y = max.y;
 
   const float margin = std::max(max_x - min_x, max_y - min_y) * 10.0f;
 
@@ -139,10 +142,17 @@ std::vector<Edge> triangulate_BowyerWatson(span<const Vec2> inputCoords)
   // Add, one by one, all input points.
   for(int p = 0; p < (int)inputCoords.len; ++p)
   {
-    std::vector<Edge> edges;
+    ScratchScope scratch;
+    ScratchVector<Edge> edges;
 
     // Put at the end of the array the triangles whose circles contains 'p'.
-    const int s = reorder(triangulation, points[p]);
+    int s;
+    {
+      SANDBOX_ZONE("bowyerwatson: reorder");
+      s = reorder(triangulation, points[p]);
+    }
+
+    sandbox_count("bowyerwatson: removed triangles", triangulation.size() - s);
 
     // Save their edges ...
     for(int i = s; i < (int)triangulation.size(); ++i)
@@ -153,19 +163,27 @@ std::vector<Edge> triangulate_BowyerWatson(span<const Vec2> inputCoords)
     triangulation.resize(s);
 
     // This creates a hole. Compute its contour.
-    std::vector<int> edgeIsOnCountour(edges.size(), true);
+    ScratchVector<int> edgeIsOnCountour(edges.size(), true);
+
+    {
+      SANDBOX_ZONE("bowyerwatson: contour");
 
-    for(int j = 0; j < (int)edges.size(); ++j)
-      for(int k = j + 1; k < (int)edges.size(); ++k)
-        if((edges[j].a == edges[k].a && edges[j].b == edges[k].b) ||
-              (edges[j].a == edges[k].b && edges[j].b == edges[k].a))
-          edgeIsOnCountour[j] = edgeIsOnCountour[k] = false;
+      for(int j = 0; j < (int)edges.size(); ++j)
+        for(int k = j + 1; k < (int)edges.size(); ++k)
+          if((edges[j].a == edges[k].a && edges[j].b == edges[k].b) ||
+                (edges[j].a == edges[k].b && edges[j].b == edges[k].a))
+            edgeIsOnCountour[j] = edgeIsOnCountour[k] = false;
+    }
 
     // For each edge on the contour of the hole, create a new triangle using 'p'.
-    for(int j = 0; j < (int)edges.size(); ++j)
     {
-      if(edgeIsOnCountour[j])
-        triangulation.push_back(makeTriangle(edges[j].b, edges[j].a, p, points));
+      SANDBOX_ZONE("bowyerwatson: retriangulate");
+
+      for(int j = 0; j < (int)edges.size(); ++j)
+      {
+        if(edgeIsOnCountour[j])
+          triangulation.push_back(makeTriangle(edges[j].b, edges[j].a, p, points));
+      }
     }
 
     // Export internal state for visualisation.
@@ -186,3 +204,315 @@ std::vector<Edge> triangulate_BowyerWatson(span<const Vec2> inputCoords)
 
   return edges;
 }
+
+namespace
+{
+// Triangle of the fast version: counter-clockwise vertices,
+// and neighbours: 'neighbours[i]' is across the edge (vertices[i], vertices[(i + 1) % 3]).
+// The hull is closed by ghost triangles: one per hull edge, whose third vertex is the point at infinity.
+struct LinkedTriangle
+{
+  int vertices[3];
+  int neighbours[3];
+  int cavity; // last insertion which put it in the cavity, or -1
+};
+
+struct FastTriangulation
+{
+  span<const Vec2> points;
+  int ghost; // index of the point at infinity, one past the input points
+  std::vector<LinkedTriangle> triangles;
+  std::vector<int> freeSlots;
+
+  int create(int a, int b, int c)
+  {
+    int i;
+    if(freeSlots.empty())
+    {
+      i = triangles.size();
+      triangles.push_back({});
+    }
+    else
+    {
+      i = freeSlots.back();
+      freeSlots.pop_back();
+    }
+
+    triangles[i] = {{a, b, c}, {-1, -1, -1}, -1};
+    return i;
+  }
+
+  // index of the finite edge of a ghost triangle, or -1 for a finite triangle
+  int ghostEdge(int triangle) const
+  {
+    auto& v = triangles[triangle].vertices;
+    for(int i = 0; i < 3; ++i)
+    {
+      if(v[i] == ghost)
+        return (i + 1) % 3;
+    }
+    return -1;
+  }
+
+  // The circumcircle of a ghost triangle is the open half-plane beyond its hull edge,
+  // plus the inside of the edge itself.
+  bool circumcircleContains(int triangle, Vec2 p) const
+  {
+    auto& v = triangles[triangle].vertices;
+    const int edge = ghostEdge(triangle);
+    if(edge < 0)
+      return incircle(points[v[0]], points[v[1]], points[v[2]], p) > 0;
+
+    const Vec2 a = points[v[edge]];
+    const Vec2 b = points[v[(edge + 1) % 3]];
+    const int side = orient2d(a, b, p);
+    if(side != 0)
+      return side > 0;
+
+    return (p - a) * (b - a) > 0 && (p - b) * (a - b) > 0;
+  }
+
+  // Visibility walk, from 'start' to the triangle containing 'p':
+  // cross any edge having 'p' on its other side, starting at a varying edge, so it can't cycle.
+  // Stops at the first ghost triangle entered, when 'p' is outside the hull.
+  int locate(int start, Vec2 p, uint32_t& seed) const
+  {
+    int curr = start;
+
+    if(ghostEdge(curr) >= 0)
+      curr = triangles[curr].neighbours[ghostEdge(curr)];
+
+    while(true)
+    {
+      auto& t = triangles[curr];
+
+      seed = seed * 1664525 + 1013904223;
+      const int first = (seed >> 16) % 3;
+
+      int next = -1;
+      for(int k = 0; k < 3; ++k)
+      {
+        const int i = (first + k) % 3;
+        if(orient2d(points[t.vertices[i]], points[t.vertices[(i + 1) % 3]], p) < 0)
+        {
+          next = t.neighbours[i];
+          break;
+        }
+      }
+
+      if(next < 0 || ghostEdge(next) >= 0)
+        return next < 0 ? curr : next;
+
+      curr = next;
+    }
+  }
+};
+
+// Biased randomized insertion order: a random permutation, cut in rounds of doubling sizes,
+// each round sorted along a Z-order curve.
+std::vector<int> computeInsertionOrder(span<const Vec2> points)
+{
+  const int n = points.len;
+
+  std::vector<int> order(n);
+  for(int i = 0; i < n; ++i)
+    order[i] = i;
+
+  RandomGenerator random(n);
+  for(int i = n - 1; i > 0; --i)
+    std::swap(order[i], order[random.nextInt(0, i + 1)]);
+
+  std::vector<uint32_t> codes(n);
+  computeMortonCodes(points, codes);
+
+  for(int end = n; end > 0;)
+  {
+    const int begin = end < 64 ? 0 : end / 2;
+    sortByMortonCode({size_t(end - begin), order.data() + begin}, codes);
+    end = begin;
+  }
+
+  return order;
+}
+}
+
+TriangleMesh triangulateMesh_BowyerWatsonFast(span<const Vec2> points)
+{
+  const int n = points.len;
+
+  std::vector<int> order;
+  {
+    SANDBOX_ZONE("bowyerwatson: insertion order");
+    order = computeInsertionOrder(points);
+  }
+
+  // The first triangle: the first two distinct points, and the first point not aligned with them.
+  int first[3] = {};
+  int count = n > 0 ? 1 : 0;
+  for(int k = 1; k < n && count < 3; ++k)
+  {
+    const Vec2 a = points[order[first[0]]];
+    const Vec2 pos = points[order[k]];
+    const bool found = count == 1 ? !(pos == a) : orient2d(a, points[order[first[1]]], pos) != 0;
+    if(found)
+      first[count++] = k;
+  }
+
+  if(count < 3)
+    return {}; // all the points are aligned
+
+  FastTriangulation tri;
+  tri.points = points;
+  tri.ghost = n;
+
+  {
+    int a = order[first[0]];
+    int b = order[first[1]];
+    const int c = order[first[2]];
+    if(orient2d(points[a], points[b], points[c]) < 0)
+      std::swap(a, b);
+
+    const int t = tri.create(a, b, c);
+    const int ghosts[3] = {tri.create(b, a, n), tri.create(c, b, n), tri.create(a, c, n)};
+    for(int i = 0; i < 3; ++i)
+    {
+      tri.triangles[t].neighbours[i] = ghosts[i];
+      tri.triangles[ghosts[i]].neighbours[0] = t;
+      tri.triangles[ghosts[i]].neighbours[1] = ghosts[(i + 2) % 3];
+      tri.triangles[ghosts[i]].neighbours[2] = ghosts[(i + 1) % 3];
+    }
+  }
+
+  int last = 0;
+
+  // new triangle whose first vertex is the given one, during an insertion
+  std::vector<int> triangleStartingAt(n + 1, -1);
+
+  struct ContourEdge
+  {
+    int a, b; // counter-clockwise around the cavity
+    int outside; // the triangle across
+  };
+
+  std::vector<int> cavity;
+  std::vector<ContourEdge> contour;
+  std::vector<int> created;
+  uint32_t seed = 0;
+
+  SANDBOX_ZONE("bowyerwatson: insertions");
+
+  for(int k = 1; k < n; ++k)
+  {
+    if(k == first[1] || k == first[2])
+      continue;
+
+    const int p = order[k];
+    const Vec2 pos = points[p];
+
+    const int seedTriangle = tri.locate(last, pos, seed);
+
+    bool duplicate = false;
+    for(auto v : tri.triangles[seedTriangle].vertices)
+      duplicate |= v != n && points[v] == pos;
+
+    if(duplicate)
+      continue;
+
+    // The cavity: the triangles whose circumcircle contains 'p', connected to the one containing it.
+    cavity.clear();
+    cavity.push_back(seedTriangle);
+    tri.triangles[seedTriangle].cavity = k;
+
+    for(int i = 0; i < (int)cavity.size(); ++i)
+    {
+      for(auto neighbour : tri.triangles[cavity[i]].neighbours)
+      {
+        if(tri.triangles[neighbour].cavity == k)
+          continue;
+
+        if(tri.circumcircleContains(neighbour, pos))
+        {
+          tri.triangles[neighbour].cavity = k;
+          cavity.push_back(neighbour);
+        }
+      }
+    }
+
+    // Connect 'p' to each edge of the contour of the cavity.
+    // There are two more of them than triangles in the cavity, so all the slots of these get reused.
+    contour.clear();
+    for(auto t : cavity)
+    {
+      const auto& old = tri.triangles[t];
+      for(int i = 0; i < 3; ++i)
+      {
+        const int outside = old.neighbours[i];
+        if(tri.triangles[outside].cavity == k)
+          continue;
+
+        contour.push_back({old.vertices[i], old.vertices[(i + 1) % 3], outside});
+      }
+    }
+
+    for(auto t : cavity)
+      tri.freeSlots.push_back(t);
+
+    created.clear();
+    for(auto& e : contour)
+    {
+      const int t = tri.create(e.a, e.b, p);
+      tri.triangles[t].neighbours[0] = e.outside;
+
+      auto& outside = tri.triangles[e.outside];
+      for(int i = 0; i < 3; ++i)
+      {
+        if(outside.vertices[i] == e.b && outside.vertices[(i + 1) % 3] == e.a)
+          outside.neighbours[i] = t;
+      }
+
+      triangleStartingAt[e.a] = t;
+      created.push_back(t);
+    }
+
+    // (b, p) is shared with the triangle starting at 'b', and (p, a) with the one ending at 'a'
+    for(auto t : created)
+    {
+      auto& triangle = tri.triangles[t];
+      const int next = triangleStartingAt[triangle.vertices[1]];
+      triangle.neighbours[1] = next;
+      tri.triangles[next].neighbours[2] = t;
+    }
+
+    last = created.back();
+  }
+
+  // Remove the ghost triangles
+  std::vector<int> remap(tri.triangles.size(), -1);
+
+  TriangleMesh mesh;
+  for(int t = 0; t < (int)tri.triangles.size(); ++t)
+  {
+    auto& v = tri.triangles[t].vertices;
+    if(tri.ghostEdge(t) < 0)
+    {
+      remap[t] = mesh.triangles.size();
+      mesh.triangles.push_back({{v[0], v[1], v[2]}, {}});
+    }
+  }
+
+  for(int t = 0; t < (int)tri.triangles.size(); ++t)
+  {
+    if(remap[t] < 0)
+      continue;
+
+    for(int i = 0; i < 3; ++i)
+      mesh.triangles[remap[t]].neighbours[i] = remap[tri.triangles[t].neighbours[i]];
+  }
+
+  return mesh;
+}
+
+std::vector<Edge> triangulate_BowyerWatsonFast(span<const Vec2> points)
+{
+  return computeEdges(triangulateMesh_BowyerWatsonFast(points));
+}
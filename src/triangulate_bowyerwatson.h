@@ -14,9 +14,21 @@
 
 #include <vector>
 
-struct Edge
-{
-  int a, b;
-};
+#include "triangle_mesh.h"
 
 std::vector<Edge> triangulate_BowyerWatson(span<const Vec2> points);
+
+// Same algorithm, in O(n log n) instead of O(n^2), and without the visualization.
+// Instead of a finite super-triangle, the hull is closed by ghost triangles sharing a point at infinity
+// (whose circumcircle is the half-plane beyond their hull edge), tested with the exact predicates:
+// the result is the Delaunay triangulation of the whole convex hull, even near the hull or for nearly
+// collinear points, where the super-triangle of the other version may drop triangles.
+// The triangles know their neighbours: each point is located by walking from the last created triangle,
+// and the triangles whose circumcircle contains it are found by growing the cavity from there.
+// The points are inserted in a biased randomized order (rounds of doubling sizes, each round
+// sorted along a Z-order curve), so consecutive points are close to each other.
+// Each edge is returned once. Duplicate points are ignored, and collinear points give no edge.
+std::vector<Edge> triangulate_BowyerWatsonFast(span<const Vec2> points);
+
+// Same, keeping the triangles and their adjacency
+TriangleMesh triangulateMesh_BowyerWatsonFast(span<const Vec2> points);
@@ -11,238 +11,544 @@
 
 #include "core/geom.h"
 #include "core/sandbox.h"
+#include "core/zones.h"
 
 #include <algorithm>
-#include <map>
+#include <cassert>
+#include <cstdint>
 #include <vector>
 
+#include "parallel.h"
+#include "predicates.h"
+
 namespace
 {
-float det2d(Vec2 a, Vec2 b) { return a.x * b.y - a.y * b.x; }
+// smaller strips aren't worth the cost of their seams
+const int MinStripSize = 4096;
 
-void printHull(std::map<int, int> hull, span<const Vec2> points, int head)
+// compares point indices, by x then y
+struct FromLeftToRight
 {
-  int curr = head;
+  span<const Vec2> points;
 
-  do
+  bool operator()(int ia, int ib) const
   {
-    int next = hull[curr];
-    sandbox_line(points[curr], points[next]);
-    curr = next;
-  } while(curr != head);
+    auto a = points[ia];
+    auto b = points[ib];
+
+    if(a.x != b.x)
+      return a.x < b.x;
 
-  sandbox_line(points[head] + Vec2(-1, -1), points[head] + Vec2(+1, +1));
-  sandbox_line(points[head] + Vec2(-1, +1), points[head] + Vec2(+1, -1));
+    return a.y < b.y;
+  }
+};
 
-  sandbox_breakpoint();
+std::vector<int> identityOrder(int n)
+{
+  std::vector<int> order(n);
+
+  for(int i = 0; i < n; ++i)
+    order[i] = i;
+
+  return order;
+}
+
+std::vector<int> sortPointsFromLeftToRight(span<const Vec2> points)
+{
+  auto order = identityOrder(points.len);
+  std::sort(order.begin(), order.end(), FromLeftToRight{points});
+  return order;
 }
 
-struct Triangle
+// Half-edges, by triangle: 3 * t + i goes from the vertex i of the triangle t to the next one
+// (counter-clockwise), and 'twin' is the opposite half-edge, in the neighbour triangle.
+struct HalfEdge
 {
-  int a, b, c;
+  int point; // where the half-edge starts
+  int twin = -1; // -1 on the hull
 };
 
-std::vector<int> sortPointsFromLeftToRight(span<const Vec2> points)
+struct Mesh
 {
-  std::vector<int> order(points.len);
+  std::vector<HalfEdge> he;
+  int leftmost = -1; // first point in the sweep order
+  int rightmost = -1; // last point in the sweep order (duplicates excluded)
 
-  for(int i = 0; i < (int)points.len; ++i)
-    order[i] = i;
+  static int next(int e) { return e - e % 3 + (e + 1) % 3; }
 
-  auto byCoordinates = [&](int ia, int ib)
+  // Creates the triangle (a, b, c), returns its half-edge (a -> b).
+  // The others are (b -> c) and (c -> a), at the next indices.
+  int addTriangle(int a, int b, int c)
   {
-    auto a = points[ia];
-    auto b = points[ib];
+    const int e0 = he.size();
+    he.push_back({a});
+    he.push_back({b});
+    he.push_back({c});
+    return e0;
+  }
 
-    if(a.x != b.x)
-      return a.x < b.x;
+  void link(int e, int f)
+  {
+    he[e].twin = f;
+    if(f >= 0)
+      he[f].twin = e;
+  }
+};
+
+// Counter-clockwise cycle of points, indexed by point: 'edge' is the half-edge going from a hull point
+// to the next one (inside the mesh, so it has no twin).
+// Meshes built from disjoint sets of points can share the same one.
+struct Hull
+{
+  std::vector<int> next;
+  std::vector<int> prev;
+  std::vector<int> edge;
+
+  explicit Hull(int pointCount)
+      : next(pointCount, -1)
+      , prev(pointCount, -1)
+      , edge(pointCount, -1)
+  {
+  }
+};
+
+void drawTriangle(span<const Vec2> points, const Mesh& mesh, int e, Color color)
+{
+  for(int k = 0; k < 3; ++k)
+  {
+    sandbox_line(points[mesh.he[e].point], points[mesh.he[Mesh::next(e)].point], color);
+    e = Mesh::next(e);
+  }
+}
 
-    if(a.y != b.y)
-      return a.y < b.y;
+// Lawson's flips: each queued edge which isn't locally Delaunay gets flipped,
+// then the 4 edges around it might have become illegal.
+// After the insertion of a point 'p', the queue holds the edges facing 'p', and only the two edges
+// facing 'p' in the new triangles need checking: the ones ending at 'p' are always legal.
+// 'hullEdge' is kept up to date, as a flip moves the half-edges around.
+int legalize(span<const Vec2> points, Mesh& mesh, std::vector<int>& queue, span<int> hullEdge, bool afterInsertion)
+{
+  auto& he = mesh.he;
+  int flipCount = 0;
 
-    return true;
-  };
+  while(!queue.empty())
+  {
+    // |              c             |
+    // |             /|\            |
+    // |         L2 / | \ L1        |
+    // |           /  |  \          |
+    // |          /   |   \         |
+    // |        a \  E|   / b       |
+    // |           \  |  /          |
+    // |         R1 \ | / R2        |
+    // |             \|/            |
+    // |              d             |
+    // E goes from 'a' to 'b', its twin T goes from 'b' to 'a' (and 'c' is the inserted point, if any).
+    const auto E = queue.back();
+    queue.pop_back();
 
-  std::sort(order.begin(), order.end(), byCoordinates);
+    const auto T = he[E].twin;
+    if(T < 0)
+      continue; // on the hull
 
-  return order;
+    const auto L1 = Mesh::next(E);
+    const auto L2 = Mesh::next(L1);
+
+    const auto R1 = Mesh::next(T);
+    const auto R2 = Mesh::next(R1);
+
+    const int a = he[E].point;
+    const int b = he[L1].point;
+    const int c = he[L2].point;
+    const int d = he[R2].point;
+
+    if(incircle(points[a], points[b], points[c], points[d]) <= 0)
+      continue;
+
+    // Replace the diagonal (a, b) with (c, d), keeping each triangle in its slot:
+    // (a, b, c) becomes (d, b, c), and (b, a, d) becomes (c, a, d).
+    // E now goes from 'd' to 'b' (replacing R2), T from 'c' to 'a' (replacing L2),
+    // and L2, R2 are the new diagonal.
+    const int outsideL2 = he[L2].twin;
+    const int outsideR2 = he[R2].twin;
+
+    he[E].point = d;
+    he[T].point = c;
+
+    mesh.link(E, outsideR2);
+    mesh.link(T, outsideL2);
+    mesh.link(L2, R2);
+
+    if(outsideR2 < 0)
+      hullEdge[d] = E;
+
+    if(outsideL2 < 0)
+      hullEdge[c] = T;
+
+    queue.push_back(E);
+    queue.push_back(R1);
+
+    if(!afterInsertion)
+    {
+      queue.push_back(L1);
+      queue.push_back(T);
+    }
+
+    ++flipCount;
+
+    sandbox_line(points[c], points[d], Green);
+    sandbox_breakpoint();
+  }
+
+  return flipCount;
 }
 
-std::vector<Triangle> createBasicTriangulation(span<const Vec2> points)
+// Sweeps the points from left to right: each new point is connected
+// to the part of the hull it sees, which always includes the previous point.
+// Then, the new triangles are legalized, so the triangulation stays Delaunay after each insertion.
+// 'order' holds the indices of the points to triangulate, sorted from left to right.
+Mesh createDelaunayTriangulation(span<const Vec2> points, span<const int> order, Hull& hull)
 {
-  const auto order = sortPointsFromLeftToRight(points);
-  span<const int> queue = order;
+  const int n = order.len;
 
-  std::vector<Triangle> triangles;
-  std::map<int, int> hull;
+  Mesh mesh;
+
+  // skip duplicates, and the leading points which are collinear with the first two
+  std::vector<int> chain;
+  int k = 0;
+  for(; k < n; ++k)
+  {
+    const int idx = order[k];
+    if(!chain.empty() && points[chain.back()] == points[idx])
+      continue;
 
-  if(points.len < 3)
-    return {};
+    if(chain.size() >= 2 && orient2d(points[chain[0]], points[chain[1]], points[idx]) != 0)
+      break;
 
-  // bootstrap triangulation with first triangle
+    chain.push_back(idx);
+  }
+
+  if(k == n)
+    return {}; // all the points are collinear: no triangle
+
+  mesh.he.reserve(6 * n);
+
+  auto& hullNext = hull.next;
+  auto& hullPrev = hull.prev;
+  auto& hullEdge = hull.edge;
+
+  // bootstrap: fan the collinear chain from the first point off its line
+  // (no flip needed: the circumcircles of the fan triangles only contain their own vertices)
   {
-    int i0 = queue.pop();
-    int i1 = queue.pop();
-    int i2 = queue.pop();
+    const int idx = order[k];
 
-    // make the triangle CCW if needed
-    if(det2d(points[i1] - points[i0], points[i2] - points[i0]) < 0)
-      std::swap(i1, i2);
+    // make the triangles CCW
+    if(orient2d(points[chain[0]], points[chain[1]], points[idx]) < 0)
+      std::reverse(chain.begin(), chain.end());
+
+    int prevEdge = -1;
+    for(int i = 0; i + 1 < (int)chain.size(); ++i)
+    {
+      const int e = mesh.addTriangle(chain[i], chain[i + 1], idx);
+      mesh.link(e + 2, prevEdge);
+      prevEdge = e + 1;
+
+      hullEdge[chain[i]] = e;
+      hullNext[chain[i]] = chain[i + 1];
+      hullPrev[chain[i + 1]] = chain[i];
+    }
 
-    triangles.push_back({i0, i1, i2});
+    hullEdge[chain.back()] = prevEdge;
+    hullNext[chain.back()] = idx;
+    hullPrev[idx] = chain.back();
 
-    hull[i0] = i1;
-    hull[i1] = i2;
-    hull[i2] = i0;
+    hullEdge[idx] = 2; // (idx -> chain[0]), in the first triangle
+    hullNext[idx] = chain[0];
+    hullPrev[chain[0]] = idx;
+
+    for(int e = 0; e < (int)mesh.he.size(); e += 3)
+      drawTriangle(points, mesh, e, White);
+
+    sandbox_breakpoint();
   }
 
-  int hullHead = hull.begin()->first;
+  int last = order[k];
 
-  printHull(hull, points, hullHead);
+  std::vector<int> queue;
+  int flipCount = 0;
 
-  while(queue.len > 0)
+  for(++k; k < n; ++k)
   {
-    const int idx = queue[0];
+    const int idx = order[k];
     const auto p = points[idx];
 
-    // recompute hullHead so its on the left of the hull
-    while(1)
-    {
-      auto a = points[hullHead];
-      auto b = points[hull[hullHead]];
+    if(p == points[last])
+      continue;
 
-      if(det2d(p - a, b - a) <= 0)
-        break;
+    auto sees = [&](int a) { return orient2d(points[a], points[hullNext[a]], p) < 0; };
 
-      hullHead = hull[hullHead];
-    }
+    // the visible part of the hull, from 'first' to 'end'
+    int first = last;
+    while(sees(hullPrev[first]))
+      first = hullPrev[first];
 
-    const int hullFirst = hullHead;
-    int hullCurr = hullFirst;
+    int end = last;
+    while(sees(end))
+      end = hullNext[end];
 
-    do
+    // connect 'idx' to each visible hull edge
+    int prevEdge = -1;
+    int firstEdge = -1;
+    for(int a = first; a != end; a = hullNext[a])
     {
-      const int hullNext = hull[hullCurr];
+      const int e = mesh.addTriangle(a, idx, hullNext[a]);
+      mesh.link(e + 2, hullEdge[a]);
+      mesh.link(e, prevEdge);
+      prevEdge = e + 1;
 
-      const auto a = points[hullCurr];
-      const auto b = points[hullNext];
+      if(firstEdge < 0)
+        firstEdge = e;
 
-      if(det2d(p - a, b - a) > 0.001)
-      {
-        triangles.push_back({hullCurr, idx, hullNext});
+      queue.push_back(e + 2);
 
-        hull[idx] = hullNext;
-        hull[hullCurr] = idx;
-        hullHead = idx;
+      drawTriangle(points, mesh, e, Yellow);
+    }
+
+    sandbox_breakpoint();
 
-        printHull(hull, points, hullHead);
-      }
+    hullEdge[first] = firstEdge;
+    hullNext[first] = idx;
+    hullPrev[idx] = first;
 
-      hullCurr = hullNext;
-    } while(hullCurr != hullFirst);
+    hullEdge[idx] = prevEdge;
+    hullNext[idx] = end;
+    hullPrev[end] = idx;
 
-    queue += 1;
+    last = idx;
+
+    flipCount += legalize(points, mesh, queue, hullEdge, true);
   }
 
-  return triangles;
+  sandbox_count("flip: flips", flipCount);
+
+  mesh.leftmost = order[0];
+  mesh.rightmost = last;
+  return mesh;
 }
 
-struct HalfEdge
+// Joins two meshes stored in 'mesh', separated by a vertical line: 'left' and 'right' are the rightmost point
+// of the one on the left, and the leftmost point of the other one.
+// The gap between both hulls, from their lower to their upper common tangent, is triangulated
+// by advancing on either side each time (as in Guibas and Stolfi's merge, but only along the hulls),
+// then the new edges are legalized.
+void merge(span<const Vec2> points, Mesh& mesh, Hull& hull, int left, int right)
 {
-  int point;
-  int next;
-  int twin = -1;
-};
+  auto orient = [&](int a, int b, int c) { return orient2d(points[a], points[b], points[c]); };
 
-std::vector<HalfEdge> convertToHalfEdge(span<const Vec2> points, span<const Triangle> triangles)
-{
-  (void)points;
-  std::vector<HalfEdge> he;
-  std::map<std::pair<int, int>, int> pointToEdge;
+  // the left hull goes up counter-clockwise from 'left', the right hull goes up clockwise from 'right'
+  int bottomLeft = left;
+  int bottomRight = right;
+  while(true)
+  {
+    if(orient(bottomLeft, bottomRight, hull.prev[bottomLeft]) < 0)
+      bottomLeft = hull.prev[bottomLeft];
+    else if(orient(bottomLeft, bottomRight, hull.next[bottomRight]) < 0)
+      bottomRight = hull.next[bottomRight];
+    else
+      break;
+  }
 
-  auto findHalfEdge = [&](int a, int b)
+  int topLeft = left;
+  int topRight = right;
+  while(true)
   {
-    auto i = pointToEdge.find({a, b});
+    if(orient(topLeft, topRight, hull.next[topLeft]) > 0)
+      topLeft = hull.next[topLeft];
+    else if(orient(topLeft, topRight, hull.prev[topRight]) > 0)
+      topRight = hull.prev[topRight];
+    else
+      break;
+  }
+
+  // 'c' doesn't go inside the polygon of the hull at its vertex 'v' (preceded by 'prev', followed by 'next')
+  auto outside = [&](int prev, int v, int next, int c) { return orient(prev, v, c) <= 0 || orient(v, next, c) <= 0; };
 
-    if(i == pointToEdge.end())
-      return -1;
+  std::vector<int> queue;
 
-    return i->second;
-  };
+  // the base (l, r) goes up: each triangle is built above it, using the next point on either hull
+  int l = bottomLeft;
+  int r = bottomRight;
+  int baseTwin = -1; // the half-edge (r -> l) of the last triangle
+  int bottomEdge = -1;
 
-  for(auto& t : triangles)
+  while(l != topLeft || r != topRight)
   {
-    const auto e0 = (int)he.size() + 0;
-    const auto e1 = (int)he.size() + 1;
-    const auto e2 = (int)he.size() + 2;
-    he.push_back({t.a, e1});
-    he.push_back({t.b, e2});
-    he.push_back({t.c, e0});
+    const int nextL = hull.next[l];
+    const int nextR = hull.prev[r];
 
-    // search for a twin for e0 (=the edge that links [t.a -> t.b])
-    he[e0].twin = findHalfEdge(t.b, t.a);
-    he[e1].twin = findHalfEdge(t.c, t.b);
-    he[e2].twin = findHalfEdge(t.a, t.c);
+    const bool canUseL = l != topLeft && orient(l, r, nextL) > 0 && outside(nextR, r, hull.next[r], nextL);
+    const bool canUseR = r != topRight && orient(l, r, nextR) > 0 && outside(hull.prev[l], l, nextL, nextR);
+    assert(canUseL || canUseR);
 
-    pointToEdge[{t.a, t.b}] = e0;
-    pointToEdge[{t.b, t.c}] = e1;
-    pointToEdge[{t.c, t.a}] = e2;
+    // of both, prefer the one giving a Delaunay triangle, so there are fewer flips
+    const bool useL = canUseL && (!canUseR || incircle(points[l], points[r], points[nextL], points[nextR]) <= 0);
+
+    int e;
+    if(useL)
+    {
+      e = mesh.addTriangle(l, r, nextL);
+      mesh.link(e + 2, hull.edge[l]);
+      mesh.link(e, baseTwin);
+      baseTwin = e + 1;
+      queue.push_back(e + 2);
+      l = nextL;
+    }
+    else
+    {
+      e = mesh.addTriangle(l, r, nextR);
+      mesh.link(e + 1, hull.edge[nextR]);
+      mesh.link(e, baseTwin);
+      baseTwin = e + 2;
+      queue.push_back(e + 1);
+      r = nextR;
+    }
+
+    queue.push_back(e);
+
+    if(bottomEdge < 0)
+      bottomEdge = e;
+
+    drawTriangle(points, mesh, e, Yellow);
   }
 
-  return he;
+  sandbox_breakpoint();
+
+  hull.edge[bottomLeft] = bottomEdge;
+  hull.next[bottomLeft] = bottomRight;
+  hull.prev[bottomRight] = bottomLeft;
+
+  hull.edge[topRight] = baseTwin;
+  hull.next[topRight] = topLeft;
+  hull.prev[topLeft] = topRight;
+
+  const int flipCount = legalize(points, mesh, queue, hull.edge, false);
+  sandbox_count("flip: seam flips", flipCount);
 }
 
-std::vector<Edge> flipTriangulation(span<const Vec2> points, span<HalfEdge> he)
+TriangleMesh toTriangleMesh(const Mesh& mesh)
 {
-  std::vector<int> stack;
-  stack.reserve(he.len);
+  TriangleMesh r;
+  r.triangles.resize(mesh.he.size() / 3);
 
-  for(int i = 0; i < (int)he.len; ++i)
-    if(i > he[i].twin) // of both twins, only push one
-      stack.push_back(i);
+  for(int e = 0; e < (int)mesh.he.size(); ++e)
+  {
+    auto& triangle = r.triangles[e / 3];
+    triangle.vertices[e % 3] = mesh.he[e].point;
+    triangle.neighbours[e % 3] = mesh.he[e].twin < 0 ? -1 : mesh.he[e].twin / 3;
+  }
 
-  while(!stack.empty())
+  return r;
+}
+} // namespace
+
+TriangleMesh triangulateMesh_Flip(span<const Vec2> points)
+{
+  SANDBOX_ZONE("flip: triangulate");
+
+  const auto order = sortPointsFromLeftToRight(points);
+
+  Hull hull(points.len);
+  return toTriangleMesh(createDelaunayTriangulation(points, order, hull));
+}
+
+std::vector<Edge> triangulate_Flip(span<const Vec2> points) { return computeEdges(triangulateMesh_Flip(points)); }
+
+TriangleMesh triangulateMesh_FlipParallel(span<const Vec2> points, int threadCount)
+{
+  const int n = points.len;
+
+  auto order = identityOrder(n);
+  const FromLeftToRight byCoordinates{points};
+
+  // Cut the points in vertical strips of about the same size: nth_element puts each strip in place,
+  // then the strips are sorted concurrently.
+  std::vector<int> stripBegin;
   {
-    // |              .             |
-    // |             /|\            |
-    // |         L1 / | \ R2        |
-    // |           /  |  \          |
-    // |          /   |   \         |
-    // |          \  E|   /         |
-    // |           \  |  /          |
-    // |         L2 \ | / R1        |
-    // |             \|/            |
-    // |              .             |
-    const auto E = stack.back();
-    stack.pop_back();
+    SANDBOX_ZONE("flip: sort");
 
-    const auto L1 = he[E].next;
-    const auto L2 = he[L1].next;
+    const int maxStripCount = std::max(1, std::min(resolveThreadCount(threadCount), n / MinStripSize));
+    for(int i = 0; i <= maxStripCount; ++i)
+      stripBegin.push_back(int64_t(n) * i / maxStripCount);
 
-    const auto R1 = he[he[E].twin].next;
-    const auto R2 = he[L1].next;
+    for(int i = 1; i < maxStripCount; ++i)
+      std::nth_element(order.begin() + stripBegin[i - 1], order.begin() + stripBegin[i], order.end(), byCoordinates);
 
-    (void)L1;
-    (void)L2;
-    (void)R1;
-    (void)R2;
+    parallelFor(maxStripCount, threadCount,
+          [&](int i) { std::sort(order.begin() + stripBegin[i], order.begin() + stripBegin[i + 1], byCoordinates); });
+  }
 
-    for(auto edge : he)
-      sandbox_line(points[edge.point], points[he[edge.next].point]);
+  // The hulls of the strips must be separated by vertical lines: join the strips whose points
+  // have the same x at their boundary (put together, the sorted strips are sorted).
+  {
+    std::vector<int> separated{0};
+    for(int i = 1; i + 1 < (int)stripBegin.size(); ++i)
+    {
+      const int begin = stripBegin[i];
+      if(points[order[begin]].x != points[order[begin - 1]].x)
+        separated.push_back(begin);
+    }
 
-    sandbox_breakpoint();
+    stripBegin = std::move(separated);
   }
 
-  std::vector<Edge> r;
+  const int stripCount = stripBegin.size();
+  stripBegin.push_back(n);
 
-  return r;
-}
-} // namespace
+  Hull hull(n);
+  std::vector<Mesh> strips(stripCount);
 
-std::vector<Edge> triangulate_Flip(span<const Vec2> points)
-{
-  auto triangles = createBasicTriangulation(points);
-  auto he = convertToHalfEdge(points, triangles);
+  {
+    SANDBOX_ZONE("flip: strips");
+    parallelFor(stripCount, threadCount,
+          [&](int i)
+          {
+            const span<const int> stripOrder{size_t(stripBegin[i + 1] - stripBegin[i]), order.data() + stripBegin[i]};
+            strips[i] = createDelaunayTriangulation(points, stripOrder, hull);
+          });
+  }
+
+  // collinear points in a strip give no triangle, and can't be merged
+  for(auto& strip : strips)
+  {
+    if(strip.he.empty())
+    {
+      Hull wholeHull(n);
+      return toTriangleMesh(createDelaunayTriangulation(points, order, wholeHull));
+    }
+  }
+
+  // gather all the strips in a single mesh
+  Mesh mesh = std::move(strips[0]);
+
+  for(int i = 1; i < stripCount; ++i)
+  {
+    const int offset = mesh.he.size();
+    for(auto e : strips[i].he)
+      mesh.he.push_back({e.point, e.twin < 0 ? -1 : e.twin + offset});
+
+    for(int k = stripBegin[i]; k < stripBegin[i + 1]; ++k)
+    {
+      auto& edge = hull.edge[order[k]];
+      if(edge >= 0)
+        edge += offset;
+    }
+  }
+
+  {
+    SANDBOX_ZONE("flip: merge");
+    for(int i = 1; i < stripCount; ++i)
+      merge(points, mesh, hull, strips[i - 1].rightmost, strips[i].leftmost);
+  }
 
-  return flipTriangulation(points, he);
+  return toTriangleMesh(mesh);
 }
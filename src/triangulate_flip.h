@@ -5,7 +5,7 @@
 // License, or (at your option) any later version.
 
 ///////////////////////////////////////////////////////////////////////////////
-// Triangulation, Bowyer-Watson algorithm
+// Triangulation, Flip algorithm
 // This is the algorithm implementation.
 
 #pragma once
@@ -14,9 +14,17 @@
 
 #include <vector>
 
-struct Edge
-{
-  int a, b;
-};
+#include "triangle_mesh.h"
 
+// Sweeps the points from left to right, connecting each one to the visible part of the hull,
+// then flips the new edges which aren't locally Delaunay, so the triangulation stays Delaunay.
+// Each edge is returned once. Duplicate points are ignored, and collinear points give no edge.
 std::vector<Edge> triangulate_Flip(span<const Vec2> points);
+
+// Same, keeping the triangles and their adjacency
+TriangleMesh triangulateMesh_Flip(span<const Vec2> points);
+
+// Same, with the points cut in vertical strips, triangulated concurrently on 'threadCount' threads
+// (see parallel.h: 0 means one per hardware thread). Then, the strips are joined from left to right,
+// and the edges along each seam are flipped until the whole triangulation is Delaunay.
+TriangleMesh triangulateMesh_FlipParallel(span<const Vec2> points, int threadCount = 1);
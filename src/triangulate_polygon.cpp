@@ -0,0 +1,608 @@
+#include "triangulate_polygon.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <set>
+#include <vector>
+
+#include "bounding_box.h"
+#include "predicates.h"
+
+namespace
+{
+// The loops of the polygon, with the interior on their left:
+// counter-clockwise, and clockwise for the holes.
+PolygonRings findLoops(const Polygon2f& polygon)
+{
+  PolygonRings r;
+  toRings(polygon, r);
+
+  // the outer loop decides the orientation of everything
+  if(r.signedArea() < 0)
+    r.reverse();
+
+  return r;
+}
+
+void addTriangle(TriangleMesh& mesh, int a, int b, int c) { mesh.triangles.push_back({{a, b, c}, {-1, -1, -1}}); }
+
+// 'p' inside the counter-clockwise triangle (a, b, c), or on its boundary
+bool isInsideTriangle(Vec2 a, Vec2 b, Vec2 c, Vec2 p)
+{
+  return orient2d(a, b, p) >= 0 && orient2d(b, c, p) >= 0 && orient2d(c, a, p) >= 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Ear clipping
+
+// The reflex vertices of the polygon, by cell (same layout as 'SegmentGrid').
+// Clipping ears never makes a vertex reflex: the ones which become convex are only flagged.
+struct ReflexGrid
+{
+  Vec2 origin{};
+  float cellSize = 1;
+  int width = 0;
+  int height = 0;
+  std::vector<int> cellStart;
+  std::vector<int> cellVertices;
+
+  int cellX(float x) const { return std::clamp(int((x - origin.x) / cellSize), 0, width - 1); }
+  int cellY(float y) const { return std::clamp(int((y - origin.y) / cellSize), 0, height - 1); }
+};
+
+ReflexGrid gridReflexVertices(span<const Vec2> points, span<const int> reflexVertices)
+{
+  ReflexGrid r;
+
+  BoundingBox bounds;
+  for(auto v : reflexVertices)
+    bounds.add(points[v]);
+
+  // about one vertex per cell
+  const Vec2 size = bounds.max - bounds.min;
+  const float area = std::max(size.x * size.y, 1e-12f);
+  r.cellSize = std::max({std::sqrt(area / reflexVertices.len), size.x / 1024, size.y / 1024, 1e-6f});
+
+  r.origin = bounds.min;
+  r.width = int(size.x / r.cellSize) + 1;
+  r.height = int(size.y / r.cellSize) + 1;
+
+  auto cellOf = [&](Vec2 p) { return r.cellX(p.x) + r.cellY(p.y) * r.width; };
+
+  r.cellStart.assign(r.width * r.height + 1, 0);
+  for(auto v : reflexVertices)
+    r.cellStart[cellOf(points[v]) + 1]++;
+
+  for(int i = 0; i < r.width * r.height; ++i)
+    r.cellStart[i + 1] += r.cellStart[i];
+
+  std::vector<int> fill(r.cellStart.begin(), r.cellStart.end() - 1);
+  r.cellVertices.resize(reflexVertices.len);
+  for(auto v : reflexVertices)
+    r.cellVertices[fill[cellOf(points[v])]++] = v;
+
+  return r;
+}
+
+struct EarClipper
+{
+  span<const Vec2> points;
+  std::vector<int> prev;
+  std::vector<int> next;
+  std::vector<bool> reflex; // still reflex, and still in the ring
+  ReflexGrid grid;
+  bool hasReflexVertices = false;
+
+  bool isConvex(int v) const { return orient2d(points[prev[v]], points[v], points[next[v]]) > 0; }
+
+  bool isEar(int v) const
+  {
+    if(!isConvex(v))
+      return false;
+
+    if(!hasReflexVertices)
+      return true;
+
+    const int a = prev[v];
+    const int b = next[v];
+    const Vec2 pa = points[a];
+    const Vec2 pv = points[v];
+    const Vec2 pb = points[b];
+
+    const int x0 = grid.cellX(std::min({pa.x, pv.x, pb.x}));
+    const int x1 = grid.cellX(std::max({pa.x, pv.x, pb.x}));
+    const int y0 = grid.cellY(std::min({pa.y, pv.y, pb.y}));
+    const int y1 = grid.cellY(std::max({pa.y, pv.y, pb.y}));
+
+    for(int y = y0; y <= y1; ++y)
+    {
+      for(int x = x0; x <= x1; ++x)
+      {
+        const int cell = x + y * grid.width;
+        for(int i = grid.cellStart[cell]; i < grid.cellStart[cell + 1]; ++i)
+        {
+          const int r = grid.cellVertices[i];
+          if(reflex[r] && r != a && r != b && isInsideTriangle(pa, pv, pb, points[r]))
+            return false;
+        }
+      }
+    }
+
+    return true;
+  }
+
+  // removes 'v' from the ring, adding the triangle it was the tip of
+  void clip(TriangleMesh& mesh, int v)
+  {
+    const int a = prev[v];
+    const int b = next[v];
+    addTriangle(mesh, a, v, b);
+
+    next[a] = b;
+    prev[b] = a;
+    reflex[v] = false;
+
+    if(reflex[a] && isConvex(a))
+      reflex[a] = false;
+
+    if(reflex[b] && isConvex(b))
+      reflex[b] = false;
+  }
+};
+
+///////////////////////////////////////////////////////////////////////////////
+// Monotone partition
+
+// 'a' comes before 'b' when sweeping from top to bottom (then from left to right, for the same y)
+bool above(Vec2 a, Vec2 b) { return a.y > b.y || (a.y == b.y && a.x < b.x); }
+
+enum class VertexType
+{
+  Start,
+  End,
+  Split,
+  Merge,
+  Regular,
+};
+
+// Everything is indexed by position in the loops.
+// The edge i goes from the vertex i to the next one of its loop.
+struct MonotonePartition
+{
+  span<const Vec2> points;
+  const PolygonRings& loops;
+
+  Vec2 pos(int i) const { return points[loops.vertexOf[i]]; }
+  int prev(int i) const { return loops.prev[i]; }
+  int next(int i) const { return loops.next[i]; }
+
+  // The edges crossing the sweep line, having the interior of the polygon on their right, from left to right.
+  // They all go down. Comparing with a point tells which side of the edge it's on.
+  struct FromLeftToRight
+  {
+    using is_transparent = void;
+
+    const MonotonePartition* partition;
+
+    bool operator()(int e, int f) const
+    {
+      const Vec2 et = partition->pos(e);
+      const Vec2 eb = partition->pos(partition->next(e));
+      const Vec2 ft = partition->pos(f);
+      const Vec2 fb = partition->pos(partition->next(f));
+
+      // the edge starting last is compared to the other one, where it starts
+      if(above(ft, et))
+        return orient2d(ft, fb, et) < 0;
+      else
+        return orient2d(et, eb, ft) > 0;
+    }
+
+    bool operator()(int e, Vec2 p) const { return orient2d(partition->pos(e), partition->pos(partition->next(e)), p) > 0; }
+    bool operator()(Vec2 p, int e) const { return orient2d(partition->pos(e), partition->pos(partition->next(e)), p) < 0; }
+  };
+
+  VertexType type(int i) const
+  {
+    const Vec2 p = pos(prev(i));
+    const Vec2 v = pos(i);
+    const Vec2 n = pos(next(i));
+
+    const bool convex = orient2d(p, v, n) > 0;
+
+    if(above(v, p) && above(v, n))
+      return convex ? VertexType::Start : VertexType::Split;
+
+    if(above(p, v) && above(n, v))
+      return convex ? VertexType::End : VertexType::Merge;
+
+    return VertexType::Regular;
+  }
+
+  // The diagonals splitting the polygon in y-monotone pieces (de Berg et al., "Computational Geometry", chapter 3)
+  std::vector<Edge> computeDiagonals() const
+  {
+    const int n = loops.size();
+
+    std::vector<VertexType> types(n);
+    for(int i = 0; i < n; ++i)
+      types[i] = type(i);
+
+    std::vector<int> order(n);
+    for(int i = 0; i < n; ++i)
+      order[i] = i;
+
+    std::sort(order.begin(), order.end(), [&](int a, int b) { return above(pos(a), pos(b)); });
+
+    using Status = std::set<int, FromLeftToRight>;
+    Status status(FromLeftToRight{this});
+    std::vector<Status::iterator> inStatus(n);
+    std::vector<int> helper(n, -1);
+
+    std::vector<Edge> diagonals;
+
+    auto insert = [&](int e)
+    {
+      inStatus[e] = status.insert(e).first;
+      helper[e] = e;
+    };
+
+    auto connectToMergeHelper = [&](int v, int e)
+    {
+      if(types[helper[e]] == VertexType::Merge)
+        diagonals.push_back({v, helper[e]});
+    };
+
+    // the edge directly on the left of 'v'
+    auto leftEdge = [&](int v)
+    {
+      auto i = status.lower_bound(pos(v));
+      assert(i != status.begin());
+      return *std::prev(i);
+    };
+
+    for(auto v : order)
+    {
+      const int e = prev(v); // the edge ending at 'v'
+
+      switch(types[v])
+      {
+      case VertexType::Start:
+        insert(v);
+        break;
+      case VertexType::End:
+        connectToMergeHelper(v, e);
+        status.erase(inStatus[e]);
+        break;
+      case VertexType::Split:
+      {
+        const int left = leftEdge(v);
+        diagonals.push_back({v, helper[left]});
+        helper[left] = v;
+        insert(v);
+        break;
+      }
+      case VertexType::Merge:
+      {
+        connectToMergeHelper(v, e);
+        status.erase(inStatus[e]);
+        const int left = leftEdge(v);
+        connectToMergeHelper(v, left);
+        helper[left] = v;
+        break;
+      }
+      case VertexType::Regular:
+        if(above(pos(e), pos(v)))
+        {
+          // on a left boundary: the interior is on the right
+          connectToMergeHelper(v, e);
+          status.erase(inStatus[e]);
+          insert(v);
+        }
+        else
+        {
+          const int left = leftEdge(v);
+          connectToMergeHelper(v, left);
+          helper[left] = v;
+        }
+        break;
+      }
+    }
+
+    return diagonals;
+  }
+
+  // Splits the polygon along the diagonals: each piece is given to 'onPiece',
+  // as a list of positions in counter-clockwise order.
+  // Half-edges: i < n goes from i to i + 1, and diagonals are stored on both sides after that.
+  template<typename OnPiece>
+  void forEachPiece(span<const Edge> diagonals, OnPiece onPiece) const
+  {
+    const int n = loops.size();
+
+    struct DiagonalSide
+    {
+      int from, to;
+    };
+
+    // At each vertex, the diagonals going out of it, counter-clockwise from the polygon edge going out of it.
+    // They're all inside the polygon, so the angle of each one (from that edge) tells where it goes.
+    std::vector<DiagonalSide> sides;
+    sides.reserve(diagonals.len * 2);
+    for(auto& d : diagonals)
+    {
+      sides.push_back({d.a, d.b});
+      sides.push_back({d.b, d.a});
+    }
+
+    auto counterClockwise = [&](const DiagonalSide& u, const DiagonalSide& v)
+    {
+      if(u.from != v.from)
+        return u.from < v.from;
+
+      const Vec2 o = pos(u.from);
+      const Vec2 ref = pos(next(u.from));
+
+      // 0 for the half-plane on the left of the polygon edge, 1 for the other one
+      auto half = [&](int to) { return orient2d(o, ref, pos(to)) > 0 ? 0 : 1; };
+      const int hu = half(u.to);
+      const int hv = half(v.to);
+      if(hu != hv)
+        return hu < hv;
+
+      return orient2d(o, pos(u.to), pos(v.to)) > 0;
+    };
+
+    std::sort(sides.begin(), sides.end(), counterClockwise);
+
+    // the diagonals of each vertex
+    std::vector<int> firstSide(n + 1, 0);
+    for(auto& s : sides)
+      firstSide[s.from + 1]++;
+    for(int i = 0; i < n; ++i)
+      firstSide[i + 1] += firstSide[i];
+
+    // each side of a diagonal knows the other one
+    std::vector<int> twin(sides.size());
+    {
+      std::vector<int> bySides(sides.size());
+      for(int i = 0; i < (int)sides.size(); ++i)
+        bySides[i] = i;
+
+      auto byEdge = [&](int i, int j)
+      {
+        const auto& u = sides[i];
+        const auto& v = sides[j];
+        const int ulo = std::min(u.from, u.to), uhi = std::max(u.from, u.to);
+        const int vlo = std::min(v.from, v.to), vhi = std::max(v.from, v.to);
+        return ulo != vlo ? ulo < vlo : uhi < vhi;
+      };
+
+      std::sort(bySides.begin(), bySides.end(), byEdge);
+      for(int i = 0; i + 1 < (int)bySides.size(); i += 2)
+      {
+        twin[bySides[i]] = bySides[i + 1];
+        twin[bySides[i + 1]] = bySides[i];
+      }
+    }
+
+    // Arriving at a vertex, the piece continues with the first half-edge clockwise from where it came from.
+    // From the polygon edge, that's the last diagonal, and from a diagonal, the previous one.
+    auto nextHalfEdge = [&](int h)
+    {
+      if(h < n)
+      {
+        const int v = next(h);
+        return firstSide[v] < firstSide[v + 1] ? n + firstSide[v + 1] - 1 : v;
+      }
+
+      const int back = twin[h - n];
+      const int v = sides[back].from;
+      return back > firstSide[v] ? n + back - 1 : v;
+    };
+
+    std::vector<bool> visited(n + sides.size());
+    std::vector<int> piece;
+
+    for(int start = 0; start < (int)visited.size(); ++start)
+    {
+      if(visited[start])
+        continue;
+
+      piece.clear();
+      int h = start;
+      do
+      {
+        visited[h] = true;
+        piece.push_back(h < n ? h : sides[h - n].from);
+        h = nextHalfEdge(h);
+      } while(h != start);
+
+      onPiece(span<const int>{piece.size(), piece.data()});
+    }
+  }
+
+  // Stack-based triangulation of a y-monotone piece (counter-clockwise positions)
+  void triangulateMonotone(span<const int> piece, TriangleMesh& mesh) const
+  {
+    const int k = piece.len;
+    if(k < 3)
+      return;
+
+    auto emit = [&](int a, int b, int c)
+    {
+      if(orient2d(pos(a), pos(b), pos(c)) < 0)
+        std::swap(b, c);
+      addTriangle(mesh, loops.vertexOf[a], loops.vertexOf[b], loops.vertexOf[c]);
+    };
+
+    if(k == 3)
+    {
+      emit(piece[0], piece[1], piece[2]);
+      return;
+    }
+
+    int top = 0;
+    int bottom = 0;
+    for(int i = 1; i < k; ++i)
+    {
+      if(above(pos(piece[i]), pos(piece[top])))
+        top = i;
+      if(above(pos(piece[bottom]), pos(piece[i])))
+        bottom = i;
+    }
+
+    // Merge both chains from top to bottom. Counter-clockwise from the top, the left chain goes down.
+    struct Vertex
+    {
+      int pos;
+      bool left;
+    };
+
+    std::vector<Vertex> sorted;
+    sorted.reserve(k);
+    sorted.push_back({piece[top], true});
+
+    int l = (top + 1) % k;
+    int r = (top + k - 1) % k;
+    while(l != bottom || r != bottom)
+    {
+      if(r == bottom || (l != bottom && above(pos(piece[l]), pos(piece[r]))))
+      {
+        sorted.push_back({piece[l], true});
+        l = (l + 1) % k;
+      }
+      else
+      {
+        sorted.push_back({piece[r], false});
+        r = (r + k - 1) % k;
+      }
+    }
+
+    sorted.push_back({piece[bottom], true});
+
+    std::vector<Vertex> stack{sorted[0], sorted[1]};
+
+    for(int j = 2; j + 1 < k; ++j)
+    {
+      const auto u = sorted[j];
+
+      if(u.left != stack.back().left)
+      {
+        // all of the stack is visible from 'u'
+        for(int s = 0; s + 1 < (int)stack.size(); ++s)
+          emit(u.pos, stack[s].pos, stack[s + 1].pos);
+
+        stack = {sorted[j - 1], u};
+      }
+      else
+      {
+        // connect 'u' to the stack, as long as the diagonals are inside
+        auto last = stack.back();
+        stack.pop_back();
+
+        while(!stack.empty())
+        {
+          const int o = orient2d(pos(stack.back().pos), pos(last.pos), pos(u.pos));
+          if(u.left ? o <= 0 : o >= 0)
+            break;
+
+          emit(u.pos, last.pos, stack.back().pos);
+          last = stack.back();
+          stack.pop_back();
+        }
+
+        stack.push_back(last);
+        stack.push_back(u);
+      }
+    }
+
+    const int lowest = sorted.back().pos;
+    for(int s = 0; s + 1 < (int)stack.size(); ++s)
+      emit(lowest, stack[s].pos, stack[s + 1].pos);
+  }
+};
+}
+
+TriangleMesh triangulatePolygon_EarClipping(const Polygon2f& polygon)
+{
+  TriangleMesh mesh;
+
+  const auto loops = findLoops(polygon);
+  if(loops.ringCount() > 1)
+    return triangulatePolygon_Monotone(polygon);
+
+  const auto& ring = loops.vertexOf;
+  const int n = ring.size();
+  if(n < 3)
+    return mesh;
+
+  EarClipper clipper;
+  clipper.points = polygon.vertices;
+  clipper.prev.resize(polygon.vertices.size());
+  clipper.next.resize(polygon.vertices.size());
+  clipper.reflex.resize(polygon.vertices.size());
+
+  for(int i = 0; i < n; ++i)
+  {
+    clipper.prev[ring[i]] = ring[(i + n - 1) % n];
+    clipper.next[ring[i]] = ring[(i + 1) % n];
+  }
+
+  std::vector<int> reflexVertices;
+  for(auto v : ring)
+  {
+    if(!clipper.isConvex(v))
+    {
+      clipper.reflex[v] = true;
+      reflexVertices.push_back(v);
+    }
+  }
+
+  clipper.hasReflexVertices = !reflexVertices.empty();
+  if(clipper.hasReflexVertices)
+    clipper.grid = gridReflexVertices(polygon.vertices, reflexVertices);
+
+  mesh.triangles.reserve(n - 2);
+
+  int v = ring[0];
+  int stop = v; // a whole turn without an ear: the polygon is degenerate
+  for(int remaining = n; remaining > 3;)
+  {
+    if(clipper.isEar(v) || clipper.next[v] == stop)
+    {
+      // skipping the next vertex gives fewer thin triangles
+      const int after = clipper.next[clipper.next[v]];
+      clipper.clip(mesh, v);
+      --remaining;
+      v = stop = after;
+      continue;
+    }
+
+    v = clipper.next[v];
+  }
+
+  addTriangle(mesh, clipper.prev[v], v, clipper.next[v]);
+
+  linkNeighbours(mesh);
+  return mesh;
+}
+
+TriangleMesh triangulatePolygon_Monotone(const Polygon2f& polygon)
+{
+  TriangleMesh mesh;
+
+  const auto loops = findLoops(polygon);
+  if(loops.size() < 3)
+    return mesh;
+
+  MonotonePartition partition{polygon.vertices, loops};
+  const auto diagonals = partition.computeDiagonals();
+
+  mesh.triangles.reserve(loops.size() + 2 * loops.ringCount());
+  partition.forEachPiece(diagonals, [&](span<const int> piece) { partition.triangulateMonotone(piece, mesh); });
+
+  linkNeighbours(mesh);
+  return mesh;
+}
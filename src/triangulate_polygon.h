@@ -0,0 +1,23 @@
+#pragma once
+
+// Triangulation of simple polygons: a single loop of faces, stored in any order, in either orientation.
+// The triangles are counter-clockwise, and index the vertices of the polygon.
+// Their neighbours are across the diagonals (-1 across the faces of the polygon).
+// A polygon of n vertices gives n - 2 triangles.
+//
+// Polygons with holes have more loops, all with the interior on the same side of their faces
+// (e.g counter-clockwise, and clockwise for the holes). With h holes, there are n + 2h - 2 triangles.
+
+#include "polygon.h"
+#include "triangle_mesh.h"
+
+// Ear clipping, over a linked ring of vertices.
+// Only the reflex vertices can be inside an ear: they're stored in a uniform grid,
+// so each ear test only looks at the ones near it.
+// Quadratic in the worst case, but close to linear on most polygons.
+// Polygons with holes are given to triangulatePolygon_Monotone.
+TriangleMesh triangulatePolygon_EarClipping(const Polygon2f& polygon);
+
+// Partition in y-monotone pieces with a sweep, then triangulation of each piece in linear time.
+// O(n log n), whatever the shape of the polygon.
+TriangleMesh triangulatePolygon_Monotone(const Polygon2f& polygon);
@@ -0,0 +1,191 @@
+#include "voronoi_cells.h"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+namespace
+{
+// The cells are built and clipped with doubles: the circumcentre of a thin triangle
+// on the hull can be very far from the box.
+struct Point
+{
+  double x, y;
+
+  Point operator+(Point o) const { return {x + o.x, y + o.y}; }
+  Point operator-(Point o) const { return {x - o.x, y - o.y}; }
+  Point operator*(double f) const { return {x * f, y * f}; }
+};
+
+Point toPoint(Vec2 v) { return {v.x, v.y}; }
+
+// outward, for the counter-clockwise hull
+Point outwardNormal(Vec2 a, Vec2 b)
+{
+  const Point d = toPoint(b) - toPoint(a);
+  const double length = std::sqrt(d.x * d.x + d.y * d.y);
+  return Point{d.y, -d.x} * (1 / length);
+}
+
+Point circumcentre(Vec2 a, Vec2 b, Vec2 c)
+{
+  const double bx = b.x - a.x;
+  const double by = b.y - a.y;
+  const double cx = c.x - a.x;
+  const double cy = c.y - a.y;
+  const double d = 2 * (bx * cy - by * cx);
+  const double b2 = bx * bx + by * by;
+  const double c2 = cx * cx + cy * cy;
+  return {a.x + (cy * b2 - by * c2) / d, a.y + (bx * c2 - cx * b2) / d};
+}
+
+// Sutherland-Hodgman, against each side of the box
+void clip(std::vector<Point>& polygon, const BoundingBox& bounds, std::vector<Point>& scratch)
+{
+  // each side is 'p[axis] * sign <= limit'
+  const struct
+  {
+    int axis;
+    double sign;
+    double limit;
+  } sides[] = {
+        {0, -1, -bounds.min.x},
+        {0, 1, bounds.max.x},
+        {1, -1, -bounds.min.y},
+        {1, 1, bounds.max.y},
+  };
+
+  for(auto& side : sides)
+  {
+    auto distance = [&](Point p) { return (side.axis == 0 ? p.x : p.y) * side.sign - side.limit; };
+
+    scratch.clear();
+    for(int i = 0; i < (int)polygon.size(); ++i)
+    {
+      const Point a = polygon[i];
+      const Point b = polygon[(i + 1) % polygon.size()];
+      const double da = distance(a);
+      const double db = distance(b);
+
+      if(da <= 0)
+        scratch.push_back(a);
+
+      if((da < 0 && db > 0) || (da > 0 && db < 0))
+        scratch.push_back(a + (b - a) * (da / (da - db)));
+    }
+
+    std::swap(polygon, scratch);
+  }
+}
+}
+
+VoronoiCells computeVoronoiCells(span<const Vec2> sites, const TriangleMesh& delaunay, const BoundingBox& bounds)
+{
+  const auto& triangles = delaunay.triangles;
+
+  VoronoiCells r;
+  r.cellStart.reserve(sites.len + 1);
+  r.vertices.reserve(triangles.size() * 3);
+
+  std::vector<Point> centres(triangles.size());
+  for(int t = 0; t < (int)triangles.size(); ++t)
+  {
+    auto& v = triangles[t].vertices;
+    centres[t] = circumcentre(sites[v[0]], sites[v[1]], sites[v[2]]);
+  }
+
+  // one triangle of each site
+  std::vector<int> siteTriangle(sites.len, -1);
+  for(int t = 0; t < (int)triangles.size(); ++t)
+  {
+    for(auto v : triangles[t].vertices)
+      siteTriangle[v] = t;
+  }
+
+  auto slotOf = [&](int t, int site)
+  {
+    auto& v = triangles[t].vertices;
+    return v[0] == site ? 0 : v[1] == site ? 1 : 2;
+  };
+
+  auto isInside = [&](Point p)
+  { return bounds.min.x <= p.x && p.x <= bounds.max.x && bounds.min.y <= p.y && p.y <= bounds.max.y; };
+
+  const Point boxCentre = toPoint((bounds.min + bounds.max) * 0.5f);
+  const Point boxSize = toPoint(bounds.max - bounds.min);
+  const double boxRadius = std::sqrt(boxSize.x * boxSize.x + boxSize.y * boxSize.y);
+
+  std::vector<Point> cell;
+  std::vector<Point> scratch;
+
+  for(int site = 0; site < (int)sites.len; ++site)
+  {
+    r.cellStart.push_back(r.vertices.size());
+
+    const int first = siteTriangle[site];
+    if(first < 0)
+      continue;
+
+    // Around the site, the next triangle counter-clockwise is across the edge arriving at the site.
+    // On the hull, go back clockwise to the first one.
+    int start = first;
+    bool onHull = false;
+    while(true)
+    {
+      const int prev = triangles[start].neighbours[slotOf(start, site)];
+      if(prev < 0)
+      {
+        onHull = true;
+        break;
+      }
+
+      start = prev;
+      if(start == first)
+        break;
+    }
+
+    cell.clear();
+    int last = start;
+    for(int t = start;;)
+    {
+      cell.push_back(centres[t]);
+      last = t;
+      t = triangles[t].neighbours[(slotOf(t, site) + 2) % 3];
+      if(t < 0 || t == start)
+        break;
+    }
+
+    if(onHull)
+    {
+      // The cell goes to infinity, along the bisectors of both hull edges.
+      // It's closed far away: beyond the box, seen from its circumcentres on the hull.
+      const Vec2 p = sites[site];
+      const Point dirIn = outwardNormal(p, sites[triangles[start].vertices[(slotOf(start, site) + 1) % 3]]);
+      const Point dirOut = outwardNormal(sites[triangles[last].vertices[(slotOf(last, site) + 2) % 3]], p);
+
+      Point middle = dirIn + dirOut;
+      if(middle.x * middle.x + middle.y * middle.y < 1e-12)
+        middle = {-dirOut.y, dirOut.x};
+
+      auto distanceToBox = [&](Point c) { return std::hypot(c.x - boxCentre.x, c.y - boxCentre.y); };
+      const double far = 4 * (boxRadius + std::max(distanceToBox(cell.front()), distanceToBox(cell.back())) + 1);
+
+      const Point farIn = cell.front() + dirIn * far;
+      const Point farOut = cell.back() + dirOut * far;
+      const double middleLength = std::sqrt(middle.x * middle.x + middle.y * middle.y);
+      cell.insert(cell.begin(), farIn);
+      cell.push_back(farOut);
+      cell.push_back((farIn + farOut) * 0.5 + middle * (far / middleLength));
+    }
+
+    if(!std::all_of(cell.begin(), cell.end(), isInside))
+      clip(cell, bounds, scratch);
+
+    for(auto& v : cell)
+      r.vertices.push_back(Vec2(v.x, v.y));
+  }
+
+  r.cellStart.push_back(r.vertices.size());
+
+  return r;
+}
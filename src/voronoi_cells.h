@@ -0,0 +1,25 @@
+#pragma once
+
+// Voronoi cells, derived from a Delaunay triangulation of the sites:
+// the vertices of the cells are the circumcentres of the triangles.
+
+#include "core/geom.h"
+
+#include <vector>
+
+#include "bounding_box.h"
+#include "triangle_mesh.h"
+
+// The vertices of all the cells, one after the other: the cell of the site i is
+// vertices[cellStart[i]] ... vertices[cellStart[i + 1] - 1], convex and counter-clockwise.
+struct VoronoiCells
+{
+  std::vector<Vec2> vertices;
+  std::vector<int> cellStart;
+};
+
+// Walks the triangles around each site, in linear time. 'delaunay' must be a Delaunay triangulation
+// of 'sites' (e.g from triangulateMesh_Flip). The cells are clipped to 'bounds', including the infinite
+// ones on the hull. A site which isn't in any triangle (a duplicate, or when all the sites are collinear),
+// or whose cell is outside of 'bounds', has an empty cell.
+VoronoiCells computeVoronoiCells(span<const Vec2> sites, const TriangleMesh& delaunay, const BoundingBox& bounds);
@@ -0,0 +1,526 @@
+// Copyright (C) 2022 - Vivien Bonnet
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+
+///////////////////////////////////////////////////////////////////////////////
+// Voronoi diagram: Fortune algorithm
+// This is the algorithm implementation.
+
+#include "voronoi_fortune.h"
+
+#include "core/geom.h"
+#include "core/sandbox.h"
+#include "core/zones.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#include "predicates.h"
+#include "random.h"
+
+namespace
+{
+struct Point
+{
+  double x, y;
+};
+
+Point toPoint(Vec2 v) { return {v.x, v.y}; }
+
+// x of the breakpoint between the arcs of 'left' and 'right' (in this order on the beach line),
+// for a sweep line at 'sweepY'. Each arc is the parabola of points as far from its site as from the sweep line.
+double breakpoint(Point left, Point right, double sweepY)
+{
+  const double dl = 2 * (left.y - sweepY);
+  const double dr = 2 * (right.y - sweepY);
+
+  if(dl == 0 && dr == 0)
+    return (left.x + right.x) / 2;
+
+  if(dl == 0)
+    return left.x;
+
+  if(dr == 0)
+    return right.x;
+
+  // the left parabola minus the right one: a.x^2 + b.x + c, increasing at the breakpoint
+  const double a = 1 / dl - 1 / dr;
+  const double b = -2 * (left.x / dl - right.x / dr);
+  const double c = (left.x * left.x + left.y * left.y - sweepY * sweepY) / dl -
+        (right.x * right.x + right.y * right.y - sweepY * sweepY) / dr;
+
+  const double sqrtDelta = std::sqrt(std::max(0.0, b * b - 4 * a * c));
+
+  // (-b + sqrtDelta) / 2a, without cancellation (also when a = 0: both sites at the same height)
+  if(b >= 0)
+    return 2 * c / (-b - sqrtDelta);
+  else
+    return (-b + sqrtDelta) / (2 * a);
+}
+
+// y of the arc of 'site' at 'x'
+double arcY(Point site, double x, double sweepY)
+{
+  const double d = 2 * (site.y - sweepY);
+  return ((x - site.x) * (x - site.x) + site.y * site.y - sweepY * sweepY) / d;
+}
+
+struct Arc
+{
+  int site;
+  int rightEdge = -1; // traced by the breakpoint between this arc and the next one
+  Point circleCenter{}; // where the arc vanishes, if it has a circle event
+
+  // the beach line, from left to right
+  int prev = -1;
+  int next = -1;
+
+  // the tree (a treap: also a heap of the priorities)
+  int parent = -1;
+  int child[2] = {-1, -1};
+  uint32_t priority = 0;
+};
+
+// The arcs are ordered by their position on the beach line, which never changes:
+// the tree is searched with the breakpoints at the current sweep line.
+// Removed arcs are recycled.
+struct BeachLine
+{
+  std::vector<Arc> arcs;
+  std::vector<int> freeArcs;
+  int root = -1;
+  RandomGenerator priorities;
+
+  int create(int site)
+  {
+    Arc arc{};
+    arc.site = site;
+    arc.priority = priorities.next();
+
+    if(freeArcs.empty())
+    {
+      arcs.push_back(arc);
+      return int(arcs.size()) - 1;
+    }
+
+    const int r = freeArcs.back();
+    freeArcs.pop_back();
+    arcs[r] = arc;
+    return r;
+  }
+
+  // The arc whose site is the closest to the sweep line, at 'x'
+  int findAbove(span<const Point> sites, double x, double sweepY) const
+  {
+    int i = root;
+    while(true)
+    {
+      const Arc& arc = arcs[i];
+      int dir = -1;
+
+      if(arc.prev >= 0 && x < breakpoint(sites[arcs[arc.prev].site], sites[arc.site], sweepY))
+        dir = 0;
+      else if(arc.next >= 0 && x > breakpoint(sites[arc.site], sites[arcs[arc.next].site], sweepY))
+        dir = 1;
+
+      if(dir < 0 || arc.child[dir] < 0)
+        return i;
+
+      i = arc.child[dir];
+    }
+  }
+
+  // Inserts 'arc' on the right of 'where' (-1 for the first arc)
+  void insertAfter(int where, int arc)
+  {
+    if(where < 0)
+    {
+      root = arc;
+      return;
+    }
+
+    const int next = arcs[where].next;
+    arcs[arc].prev = where;
+    arcs[arc].next = next;
+    arcs[where].next = arc;
+    if(next >= 0)
+      arcs[next].prev = arc;
+
+    // Just after 'where' in the tree: its right child, or the left child of its successor
+    if(arcs[where].child[1] < 0)
+      attach(where, 1, arc);
+    else
+      attach(next, 0, arc);
+
+    while(arcs[arc].parent >= 0 && arcs[arc].priority > arcs[arcs[arc].parent].priority)
+      rotateUp(arc);
+  }
+
+  void remove(int arc)
+  {
+    // down to a leaf, keeping the priorities in order
+    while(true)
+    {
+      const int left = arcs[arc].child[0];
+      const int right = arcs[arc].child[1];
+      if(left < 0 && right < 0)
+        break;
+
+      if(right < 0 || (left >= 0 && arcs[left].priority > arcs[right].priority))
+        rotateUp(left);
+      else
+        rotateUp(right);
+    }
+
+    const int parent = arcs[arc].parent;
+    if(parent < 0)
+      root = -1;
+    else
+      arcs[parent].child[arcs[parent].child[1] == arc] = -1;
+
+    const int prev = arcs[arc].prev;
+    const int next = arcs[arc].next;
+    if(prev >= 0)
+      arcs[prev].next = next;
+    if(next >= 0)
+      arcs[next].prev = prev;
+
+    freeArcs.push_back(arc);
+  }
+
+private:
+  void attach(int parent, int side, int arc)
+  {
+    arcs[parent].child[side] = arc;
+    arcs[arc].parent = parent;
+  }
+
+  // Moves 'arc' above its parent, keeping the order of the arcs
+  void rotateUp(int arc)
+  {
+    const int parent = arcs[arc].parent;
+    const int grandParent = arcs[parent].parent;
+    const int side = arcs[parent].child[1] == arc;
+    const int inner = arcs[arc].child[1 - side];
+
+    arcs[parent].child[side] = inner;
+    if(inner >= 0)
+      arcs[inner].parent = parent;
+
+    attach(arc, 1 - side, parent);
+
+    arcs[arc].parent = grandParent;
+    if(grandParent < 0)
+      root = arc;
+    else
+      arcs[grandParent].child[arcs[grandParent].child[1] == parent] = arc;
+  }
+};
+
+// The circle events, at most one per arc: a binary heap of arcs, the highest event first.
+// Each arc knows its position in the heap, so its event can be removed in O(log n).
+struct CircleEventQueue
+{
+  struct Entry
+  {
+    double y;
+    int arc;
+  };
+
+  std::vector<Entry> heap;
+  std::vector<int> position; // in 'heap', by arc (-1 if the arc has no event)
+
+  bool empty() const { return heap.empty(); }
+  double topY() const { return heap[0].y; }
+
+  int pop()
+  {
+    const int arc = heap[0].arc;
+    remove(arc);
+    return arc;
+  }
+
+  void push(int arc, double y)
+  {
+    if(arc >= (int)position.size())
+      position.resize(arc + 1, -1);
+
+    heap.push_back({y, arc});
+    position[arc] = int(heap.size()) - 1;
+    siftUp(int(heap.size()) - 1);
+  }
+
+  void remove(int arc)
+  {
+    if(arc >= (int)position.size() || position[arc] < 0)
+      return;
+
+    const int i = position[arc];
+    position[arc] = -1;
+
+    const Entry last = heap.back();
+    heap.pop_back();
+    if(i == (int)heap.size())
+      return;
+
+    place(i, last);
+    siftUp(i);
+    siftDown(position[last.arc]);
+  }
+
+private:
+  void place(int i, Entry entry)
+  {
+    heap[i] = entry;
+    position[entry.arc] = i;
+  }
+
+  void siftUp(int i)
+  {
+    const Entry entry = heap[i];
+    while(i > 0 && heap[(i - 1) / 2].y < entry.y)
+    {
+      place(i, heap[(i - 1) / 2]);
+      i = (i - 1) / 2;
+    }
+    place(i, entry);
+  }
+
+  void siftDown(int i)
+  {
+    const int n = heap.size();
+    const Entry entry = heap[i];
+    while(true)
+    {
+      int child = 2 * i + 1;
+      if(child >= n)
+        break;
+      if(child + 1 < n && heap[child + 1].y > heap[child].y)
+        ++child;
+      if(heap[child].y <= entry.y)
+        break;
+      place(i, heap[child]);
+      i = child;
+    }
+    place(i, entry);
+  }
+};
+
+struct Sweep
+{
+  Sweep(span<const Vec2> input, VoronoiDiagram& diagram)
+      : input(input)
+      , diagram(diagram)
+  {
+    sites.resize(input.len);
+    for(int i = 0; i < (int)input.len; ++i)
+      sites[i] = toPoint(input[i]);
+  }
+
+  span<const Vec2> input;
+  std::vector<Point> sites;
+  VoronoiDiagram& diagram;
+
+  BeachLine beachLine;
+  CircleEventQueue circleEvents;
+
+  // Both ends are infinite, until the breakpoints reach them.
+  // 'onEdge' can be any point of the line of the edge: it stays between both ends
+  // only while they are infinite, so 'endEdge' moves it when one of them becomes finite.
+  int createEdge(int siteA, int siteB, Point onEdge)
+  {
+    const Vec2 v(onEdge.x, onEdge.y);
+    diagram.edges.push_back({{siteA, siteB}, {v, v}, {false, false}});
+    return int(diagram.edges.size()) - 1;
+  }
+
+  // The breakpoint between the arcs of 'leftSite' and of the other site of 'edge' went down to 'vertex'
+  void endEdge(int edge, int leftSite, Point vertex)
+  {
+    auto& e = diagram.edges[edge];
+
+    // this breakpoint moves along rotateRight(right - left): toward vertices[0] when 'leftSite' is sites[0]
+    const int end = e.sites[0] == leftSite ? 0 : 1;
+    e.vertices[end] = Vec2(vertex.x, vertex.y);
+    e.finite[end] = true;
+
+    // the point of the other end, if still infinite, must be on the ray going away from this vertex
+    // (e.g the middle of two sites of the first row can be below the vertex of their edge)
+    if(!e.finite[1 - end])
+    {
+      const Vec2 direction = rotateLeft(input[e.sites[1]] - input[e.sites[0]]);
+      e.vertices[1 - end] = e.vertices[end] + (end == 0 ? direction : -direction);
+    }
+
+    if(e.finite[0] && e.finite[1])
+      sandbox_line(e.vertices[0], e.vertices[1], Yellow);
+  }
+
+  void addSite(int site)
+  {
+    const Point p = sites[site];
+    sandbox_rect(input[site] - Vec2(0.2, 0.2), Vec2(0.4, 0.4), Green);
+
+    if(beachLine.root < 0)
+    {
+      beachLine.insertAfter(-1, beachLine.create(site));
+      return;
+    }
+
+    const int above = beachLine.findAbove(sites, p.x, p.y);
+    const int aboveSite = beachLine.arcs[above].site;
+    const Point q = sites[aboveSite];
+
+    if(q.y == p.y)
+    {
+      // The first sites are all on the sweep line: their arcs are vertical rays, from left to right,
+      // and the edges between them start at infinity.
+      const int arc = beachLine.create(site);
+      const int edge = createEdge(aboveSite, site, {(p.x + q.x) / 2, p.y});
+      beachLine.arcs[arc].rightEdge = beachLine.arcs[above].rightEdge;
+      beachLine.arcs[above].rightEdge = edge;
+      beachLine.insertAfter(above, arc);
+      return;
+    }
+
+    // The arc above is split in two, with the new one in the middle.
+    // Their breakpoints trace the same edge, in opposite directions.
+    circleEvents.remove(above);
+
+    const int edge = createEdge(aboveSite, site, {p.x, arcY(q, p.x, p.y)});
+    const int middle = beachLine.create(site);
+    const int right = beachLine.create(aboveSite);
+
+    beachLine.arcs[right].rightEdge = beachLine.arcs[above].rightEdge;
+    beachLine.arcs[middle].rightEdge = edge;
+    beachLine.arcs[above].rightEdge = edge;
+
+    beachLine.insertAfter(above, middle);
+    beachLine.insertAfter(middle, right);
+
+    addCircleEvent(above, p.y);
+    addCircleEvent(right, p.y);
+  }
+
+  // The breakpoints around 'arc' met: it vanishes, leaving a vertex of the diagram
+  void removeArc(int arc, double sweepY)
+  {
+    const Arc& a = beachLine.arcs[arc];
+    const int prev = a.prev;
+    const int next = a.next;
+    const Point vertex = a.circleCenter;
+
+    sandbox_rect(Vec2(vertex.x, vertex.y) - Vec2(0.2, 0.2), Vec2(0.4, 0.4), LightBlue);
+
+    const int prevSite = beachLine.arcs[prev].site;
+    const int nextSite = beachLine.arcs[next].site;
+
+    endEdge(beachLine.arcs[prev].rightEdge, prevSite, vertex);
+    endEdge(a.rightEdge, a.site, vertex);
+
+    // the new breakpoint goes away from the vertex, toward vertices[0]
+    const int edge = createEdge(prevSite, nextSite, vertex);
+    endEdge(edge, nextSite, vertex);
+    beachLine.arcs[prev].rightEdge = edge;
+
+    beachLine.remove(arc);
+
+    circleEvents.remove(prev);
+    circleEvents.remove(next);
+    addCircleEvent(prev, sweepY);
+    addCircleEvent(next, sweepY);
+  }
+
+  // The arc vanishes if the breakpoints on both sides converge:
+  // the three sites are clockwise, and then it happens at the bottom of their circle.
+  void addCircleEvent(int arc, double sweepY)
+  {
+    const Arc& b = beachLine.arcs[arc];
+    if(b.prev < 0 || b.next < 0)
+      return;
+
+    const int siteA = beachLine.arcs[b.prev].site;
+    const int siteC = beachLine.arcs[b.next].site;
+    if(siteA == siteC)
+      return;
+
+    if(orient2d(input[siteA], input[b.site], input[siteC]) >= 0)
+      return;
+
+    const Point pa = sites[siteA];
+    const Point pb = sites[b.site];
+    const Point pc = sites[siteC];
+
+    const double bx = pb.x - pa.x;
+    const double by = pb.y - pa.y;
+    const double cx = pc.x - pa.x;
+    const double cy = pc.y - pa.y;
+    const double d = 2 * (bx * cy - by * cx);
+    const double b2 = bx * bx + by * by;
+    const double c2 = cx * cx + cy * cy;
+    const double ux = (cy * b2 - by * c2) / d;
+    const double uy = (bx * c2 - cx * b2) / d;
+
+    beachLine.arcs[arc].circleCenter = {pa.x + ux, pa.y + uy};
+
+    // never above the sweep line, whatever the rounding
+    const double y = std::min(pa.y + uy - std::sqrt(ux * ux + uy * uy), sweepY);
+    circleEvents.push(arc, y);
+  }
+};
+}
+
+VoronoiDiagram computeVoronoi_Fortune(span<const Vec2> input)
+{
+  SANDBOX_ZONE("fortune: voronoi");
+
+  VoronoiDiagram diagram;
+
+  // from top to bottom, then from left to right
+  std::vector<int> order(input.len);
+  for(int i = 0; i < (int)input.len; ++i)
+    order[i] = i;
+
+  auto fromTopToBottom = [&](int a, int b)
+  {
+    const Vec2 pa = input[a];
+    const Vec2 pb = input[b];
+    return pa.y != pb.y ? pa.y > pb.y : pa.x < pb.x;
+  };
+
+  std::sort(order.begin(), order.end(), fromTopToBottom);
+
+  auto isDuplicate = [&](int a, int b) { return input[a].x == input[b].x && input[a].y == input[b].y; };
+  order.erase(std::unique(order.begin(), order.end(), isDuplicate), order.end());
+
+  Sweep sweep(input, diagram);
+
+  diagram.edges.reserve(order.size() * 3);
+
+  int nextSite = 0;
+  while(nextSite < (int)order.size() || !sweep.circleEvents.empty())
+  {
+    const bool isSiteEvent = nextSite < (int)order.size() &&
+          (sweep.circleEvents.empty() || sweep.sites[order[nextSite]].y > sweep.circleEvents.topY());
+
+    if(isSiteEvent)
+    {
+      sweep.addSite(order[nextSite++]);
+    }
+    else
+    {
+      const double sweepY = sweep.circleEvents.topY();
+      sweep.removeArc(sweep.circleEvents.pop(), sweepY);
+    }
+
+    sandbox_breakpoint();
+  }
+
+  sandbox_count("fortune: edges", diagram.edges.size());
+
+  return diagram;
+}
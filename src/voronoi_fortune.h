@@ -0,0 +1,38 @@
+// Copyright (C) 2022 - Vivien Bonnet
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+
+///////////////////////////////////////////////////////////////////////////////
+// Voronoi diagram: Fortune algorithm
+// This is the algorithm implementation.
+
+#pragma once
+
+#include "core/geom.h"
+
+#include <vector>
+
+// An edge of the diagram, on the bisector of two sites (indices in the input).
+// It goes from vertices[0] to vertices[1], with sites[0] on its left, along
+// rotateLeft(sites[1] - sites[0]). An edge can extend to infinity on either end:
+// then, the vertex of that end is only some point of the edge: if the other end is finite,
+// a point of the ray going away from it, so vertices[1] - vertices[0] is still along the edge.
+struct VoronoiEdge
+{
+  int sites[2];
+  Vec2 vertices[2];
+  bool finite[2];
+};
+
+struct VoronoiDiagram
+{
+  std::vector<VoronoiEdge> edges;
+};
+
+// Sweeps the sites from top to bottom, in O(n log n):
+// the beach line is a balanced tree, searched at each site event, and the circle
+// events are kept in an indexed heap, so a false alarm is removed without a scan.
+// Duplicate sites are ignored.
+VoronoiDiagram computeVoronoi_Fortune(span<const Vec2> sites);